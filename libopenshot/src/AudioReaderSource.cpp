@@ -11,8 +11,13 @@
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
 #include "AudioReaderSource.h"
-#include "Exceptions.h"
 #include "Frame.h"
+#include "Settings.h"
+#include "ZmqLogger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 
 using namespace std;
 using namespace openshot;
@@ -20,81 +25,206 @@ using namespace openshot;
 // Constructor that reads samples from a reader
 AudioReaderSource::AudioReaderSource(ReaderBase *audio_reader, int64_t starting_frame_number)
 	: reader(audio_reader), frame_position(starting_frame_number), videoCache(NULL), frame(NULL),
-      sample_position(0), speed(1), stream_position(0) {
+      sample_position(0), speed(1), stream_position(0), preroll_samples(0), is_preroll_done(false),
+      seek_position(starting_frame_number), seek_generation(0), mixed_generation(-1), flushed_generation(-1),
+      is_played(false), underruns(0), read_errors(0), is_mixing(false) {
 }
 
 // Destructor
 AudioReaderSource::~AudioReaderSource()
 {
+	StopMixing();
 }
 
 // Get the next block of audio samples
 void AudioReaderSource::getNextAudioBlock(const juce::AudioSourceChannelInfo& info)
 {
-	if (info.numSamples > 0) {
-	    int remaining_samples = info.numSamples;
-	    int remaining_position = info.startSample;
+	if (info.numSamples <= 0 || !ring) {
+		info.clearActiveBufferRegion();
+		return;
+	}
+
+	// Skip the audio mixed before a seek (once the mixing thread has moved to the new position)
+	const int64_t generation = mixed_generation;
+	if (generation != flushed_generation) {
+		ring->Clear();
+		is_preroll_done = false;
+		flushed_generation = generation;
+	}
+
+	// Pause and fill buffer with silence (wait for pre-roll, and for any seek to be mixed)
+	if (speed != 1 || (videoCache && !videoCache->isReady()) || generation != seek_generation) {
+		info.clearActiveBufferRegion();
+		return;
+	}
 
-		// Pause and fill buffer with silence (wait for pre-roll)
-		if (speed != 1 || !videoCache->isReady()) {
-			info.buffer->clear();
+	// Wait for enough audio to be mixed ahead (after each seek)
+	if (!is_preroll_done) {
+		if (ring->Available() < preroll_samples) {
+			info.clearActiveBufferRegion();
 			return;
 		}
+		is_preroll_done = true;
+	}
+
+	// Copy the mixed samples (and fill any missing samples with silence)
+	is_played = true;
+	const int samples = ring->Read(*info.buffer, info.startSample, info.numSamples);
+	if (samples < info.numSamples) {
+		info.buffer->clear(info.startSample + samples, info.numSamples - samples);
+		underruns++;
+	}
+}
+
+// Mix the audio of frames into the ring (runs on the mixing thread)
+void AudioReaderSource::Mix()
+{
+	std::shared_ptr<Frame> mixing_frame;
+	int64_t generation = -1;
+	int64_t reported_underruns = 0;
 
-        while (remaining_samples > 0) {
-            try {
-                // Get current frame object
-                if (reader) {
-                    frame = reader->GetFrame(frame_position);
-                }
-            }
-            catch (const ReaderClosed & e) { }
-            catch (const OutOfBoundsFrame & e) { }
-
-            // Get audio samples
-            if (reader && frame) {
-                if (sample_position + remaining_samples <= frame->GetAudioSamplesCount()) {
-                    // Success, we have enough samples
-                    for (int channel = 0; channel < frame->GetAudioChannelsCount(); channel++) {
-                        if (channel < info.buffer->getNumChannels()) {
-                            info.buffer->addFrom(channel, remaining_position, *frame->GetAudioSampleBuffer(),
-                                                 channel, sample_position, remaining_samples);
-                        }
-                    }
-                    sample_position += remaining_samples;
-                    remaining_position += remaining_samples;
-                    remaining_samples = 0;
-
-                } else if (sample_position + remaining_samples > frame->GetAudioSamplesCount()) {
-                    // Not enough samples, take what we can
-                    int amount_to_copy = frame->GetAudioSamplesCount() - sample_position;
-                    for (int channel = 0; channel < frame->GetAudioChannelsCount(); channel++) {
-                        if (channel < info.buffer->getNumChannels()) {
-                            info.buffer->addFrom(channel, remaining_position, *frame->GetAudioSampleBuffer(), channel,
-                                                 sample_position, amount_to_copy);
-                        }
-                    }
-                    sample_position += amount_to_copy;
-                    remaining_position += amount_to_copy;
-                    remaining_samples -= amount_to_copy;
-                }
-
-                // Increment frame position (if samples are all used up)
-                if (sample_position == frame->GetAudioSamplesCount()) {
-                    frame_position += speed;
-                    sample_position = 0; // reset for new frame
-                }
-
-            }
+	std::unique_lock<std::mutex> lock(mix_mutex);
+	while (is_mixing) {
+		// Start from the new position after each seek
+		if (seek_generation != generation) {
+			generation = seek_generation;
+			frame_position = seek_position;
+			sample_position = 0;
+			mixing_frame.reset();
+			mixed_generation = generation;
 		}
+
+		if (underruns != reported_underruns) {
+			reported_underruns = underruns;
+			ZmqLogger::Instance()->AppendDebugMethod("AudioReaderSource::Mix (audio underrun)",
+				"underruns", reported_underruns, "frame_position", frame_position);
+		}
+
+		// Wait for the ring to be flushed (after a seek), for free space, and for the pre-roll of the video cache
+		if (flushed_generation != generation || ring->Space() == 0 || (videoCache && !videoCache->isReady())) {
+			mix_condition.wait_for(lock, std::chrono::milliseconds(2));
+			continue;
+		}
+
+		if (!mixing_frame) {
+			try {
+				// Get current frame object
+				if (reader)
+					mixing_frame = reader->GetFrame(frame_position);
+			}
+			catch (const std::exception& e) {
+				read_errors++;
+				ZmqLogger::Instance()->AppendDebugMethod(std::string("AudioReaderSource::Mix (reader failed: ") + e.what() + ")",
+					"read_errors", read_errors, "frame_position", frame_position);
+			}
+			catch (...) {
+				read_errors++;
+				ZmqLogger::Instance()->AppendDebugMethod("AudioReaderSource::Mix (reader failed)",
+					"read_errors", read_errors, "frame_position", frame_position);
+			}
+
+			if (!mixing_frame) {
+				// No frame (or the reader failed), so try again later
+				mix_condition.wait_for(lock, std::chrono::milliseconds(10));
+				continue;
+			}
+			std::atomic_store(&frame, mixing_frame);
+			sample_position = 0;
+		}
+
+		// Mix as many samples as fit into the ring
+		const int samples_count = mixing_frame->GetAudioSamplesCount();
+		sample_position += ring->Write(*mixing_frame->GetAudioSampleBuffer(), sample_position,
+		                               samples_count - sample_position);
+
+		// Increment frame position (if samples are all used up)
+		if (sample_position >= samples_count) {
+			mixing_frame.reset();
+			frame_position++;
+			sample_position = 0;
+		}
+	}
+}
+
+// Start the mixing thread (and allocate the ring)
+void AudioReaderSource::StartMixing(int samples_per_block)
+{
+	StopMixing();
+	if (!reader)
+		return;
+
+	// Mix a few frames ahead (and at least a few blocks)
+	const double fps = reader->info.fps.ToDouble();
+	const int frame_samples = (fps > 0.0) ? int(std::ceil(reader->info.sample_rate / fps)) : reader->info.sample_rate / 30;
+	const int frames = std::max(Settings::Instance()->PLAYBACK_AUDIO_MIX_FRAMES, 2);
+	const int block_samples = std::max(samples_per_block, 1);
+	const int capacity = std::max(frame_samples * frames, block_samples * 4);
+	ring = std::make_unique<AudioRingBuffer>(std::max(reader->info.channels, 1), capacity);
+	preroll_samples = std::max(capacity / 2, block_samples);
+	is_preroll_done = false;
+
+	// The new ring needs no flush
+	mixed_generation = -1;
+	flushed_generation = -1;
+
+	is_mixing = true;
+	mix_thread = std::thread(&AudioReaderSource::Mix, this);
+}
+
+// Stop the mixing thread (if running)
+void AudioReaderSource::StopMixing()
+{
+	{
+		const std::lock_guard<std::mutex> lock(mix_mutex);
+		if (!is_mixing)
+			return;
+		is_mixing = false;
 	}
+	mix_condition.notify_all();
+	if (mix_thread.joinable())
+		mix_thread.join();
+}
+
+// Seek to a specific frame
+void AudioReaderSource::Seek(int64_t new_position)
+{
+	// Seeking to the same position again (before any samples are played) keeps the mixed audio
+	const bool was_played = is_played.exchange(false);
+	if (!was_played && new_position == seek_position)
+		return;
+
+	seek_position = new_position;
+	seek_generation++;
+	mix_condition.notify_all();
+}
+
+// Set the reader
+void AudioReaderSource::Reader(ReaderBase *audio_reader)
+{
+	int64_t position = 0;
+	{
+		// Wait for the mixing thread to finish the current frame
+		const std::lock_guard<std::mutex> lock(mix_mutex);
+		reader = audio_reader;
+		position = frame_position;
+	}
+
+	// Mix the new reader from the current position
+	is_played = true;
+	Seek(position);
 }
 
 // Prepare to play this audio source
-void AudioReaderSource::prepareToPlay(int, double) {}
+void AudioReaderSource::prepareToPlay(int samplesPerBlockExpected, double)
+{
+	StartMixing(samplesPerBlockExpected);
+}
 
 // Release all resources
-void AudioReaderSource::releaseResources() { }
+void AudioReaderSource::releaseResources()
+{
+	StopMixing();
+}
 
 // Get the total length (in samples) of this audio source
 juce::int64 AudioReaderSource::getTotalLength() const
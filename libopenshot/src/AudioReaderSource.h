@@ -13,9 +13,16 @@
 #ifndef OPENSHOT_AUDIOREADERSOURCE_H
 #define OPENSHOT_AUDIOREADERSOURCE_H
 
+#include "AudioRingBuffer.h"
 #include "ReaderBase.h"
 #include "Qt/VideoCacheThread.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
 #include <AppConfig.h>
 #include <juce_audio_basics/juce_audio_basics.h>
 
@@ -27,19 +34,52 @@ namespace openshot
 	 * @brief This class is used to expose any ReaderBase derived class as an AudioSource in JUCE.
 	 *
 	 * This allows any reader to play audio through JUCE (our audio framework).
+	 *
+	 * The audio of frames is mixed ahead of time by a separate thread (which gets frames from the reader,
+	 * usually from the frames cached by openshot::VideoCacheThread), into a lock-free openshot::AudioRingBuffer.
+	 * The audio device callback only copies samples from the ring, so it never waits for a frame to be
+	 * rendered, locks or allocates memory. If the ring is empty, the missing samples are silent, and counted
+	 * as an underrun (see getUnderruns()). Frames which the reader fails to get are logged, counted (see
+	 * getReadErrors()) and retried.
 	 */
 	class AudioReaderSource : public juce::PositionableAudioSource
 	{
 	private:
 	    int stream_position; /// The absolute stream position (required by PositionableAudioSource, but ignored)
-		int frame_position; /// The frame position (current frame for audio playback)
-		int speed;          /// The speed and direction to playback a reader (1=normal, 2=fast, 3=faster, -1=rewind, etc...)
+		int64_t frame_position; /// The frame position (next frame mixed by the mixing thread)
+		std::atomic<int> speed; /// The speed and direction to playback a reader (1=normal, 2=fast, 3=faster, -1=rewind, etc...)
 
 		ReaderBase *reader; /// The reader to pull samples from
 		std::shared_ptr<Frame> frame; /// The current frame object that is being read
 		int64_t sample_position; /// The position of the current frame's audio buffer
         openshot::VideoCacheThread *videoCache; /// The cache thread (for pre-roll checking)
 
+		std::unique_ptr<AudioRingBuffer> ring; /// The samples mixed ahead of the audio device
+		int preroll_samples; /// The number of samples mixed before playback starts (after each seek)
+		bool is_preroll_done; /// Has playback started since the last seek (only used by the audio device thread)
+
+		std::atomic<int64_t> seek_position; /// The frame position of the last seek
+		std::atomic<int64_t> seek_generation; /// The number of seeks
+		std::atomic<int64_t> mixed_generation; /// The last seek started by the mixing thread
+		std::atomic<int64_t> flushed_generation; /// The last seek flushed from the ring (by the audio device thread)
+		std::atomic<bool> is_played; /// Have any samples been played since the last seek
+		std::atomic<int64_t> underruns; /// The number of blocks which were missing samples
+		std::atomic<int64_t> read_errors; /// The number of times the reader failed to get a frame (which is retried)
+
+		std::thread mix_thread;
+		std::mutex mix_mutex;
+		std::condition_variable mix_condition;
+		bool is_mixing;
+
+		/// Mix the audio of frames into the ring (runs on the mixing thread)
+		void Mix();
+
+		/// Start the mixing thread (and allocate the ring)
+		void StartMixing(int samples_per_block);
+
+		/// Stop the mixing thread (if running)
+		void StopMixing();
+
 	public:
 
 		/// @brief Constructor that reads samples from a reader
@@ -50,12 +90,12 @@ namespace openshot
 		/// Destructor
 		~AudioReaderSource();
 
-		/// @brief Get the next block of audio samples
+		/// @brief Get the next block of audio samples (this never blocks, locks or allocates memory)
 		/// @param info This struct informs us of which samples are needed next.
 		void getNextAudioBlock (const juce::AudioSourceChannelInfo& info);
 
-		/// Prepare to play this audio source
-		void prepareToPlay(int, double);
+		/// Prepare to play this audio source (and start mixing audio ahead of playback)
+		void prepareToPlay(int samplesPerBlockExpected, double);
 
 		/// Release all resources
 		void releaseResources();
@@ -77,24 +117,30 @@ namespace openshot
 		/// @param shouldLoop Determines if the audio source should repeat when it reaches the end
 		void setLooping (bool shouldLoop) {  };
 
-	    /// Return the current frame object
-	    std::shared_ptr<Frame> getFrame() const { return frame; }
+	    /// Return the current frame object (the last frame mixed)
+	    std::shared_ptr<Frame> getFrame() const { return std::atomic_load(&frame); }
 
 	    /// Set Speed (The speed and direction to playback a reader (1=normal, 2=fast, 3=faster, -1=rewind, etc...)
 	    void setSpeed(int new_speed) { speed = new_speed; }
 	    /// Get Speed (The speed and direction to playback a reader (1=normal, 2=fast, 3=faster, -1=rewind, etc...)
 	    int getSpeed() const { return speed; }
 
+	    /// Get the number of audio blocks which were missing samples (because frames were not mixed in time)
+	    int64_t getUnderruns() const { return underruns; }
+
+	    /// Get the number of times the reader failed to get a frame (the mixing thread keeps retrying the frame)
+	    int64_t getReadErrors() const { return read_errors; }
+
 	    /// Set playback video cache thread (for pre-roll reference)
 	    void setVideoCache(openshot::VideoCacheThread *newCache) { videoCache = newCache; }
 
 	    /// Set Reader
-	    void Reader(ReaderBase *audio_reader) { reader = audio_reader; }
+	    void Reader(ReaderBase *audio_reader);
 	    /// Get Reader
 	    ReaderBase* Reader() const { return reader; }
 
-	    /// Seek to a specific frame
-	    void Seek(int64_t new_position) { frame_position = new_position; sample_position=0; }
+	    /// Seek to a specific frame (the audio mixed before the seek is skipped)
+	    void Seek(int64_t new_position);
 
 	};
 
@@ -0,0 +1,74 @@
+/**
+ * @file
+ * @brief Source file for AudioRingBuffer class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "AudioRingBuffer.h"
+
+#include <algorithm>
+
+using namespace openshot;
+
+// Create a ring (the FIFO keeps 1 sample empty, to tell a full ring from an empty ring)
+AudioRingBuffer::AudioRingBuffer(int num_channels, int capacity)
+	: fifo(std::max(capacity, 1) + 1), samples(std::max(num_channels, 1), std::max(capacity, 1) + 1)
+{
+	samples.clear();
+	channels = samples.getArrayOfWritePointers();
+}
+
+// Write samples (writer thread only)
+int AudioRingBuffer::Write(const juce::AudioBuffer<float>& source, int start, int count)
+{
+	int start1, size1, start2, size2;
+	fifo.prepareToWrite(std::max(count, 0), start1, size1, start2, size2);
+
+	for (int channel = 0; channel < samples.getNumChannels(); channel++) {
+		if (channel < source.getNumChannels()) {
+			const float* source_data = source.getReadPointer(channel) + start;
+			juce::FloatVectorOperations::copy(channels[channel] + start1, source_data, size1);
+			juce::FloatVectorOperations::copy(channels[channel] + start2, source_data + size1, size2);
+		} else {
+			juce::FloatVectorOperations::clear(channels[channel] + start1, size1);
+			juce::FloatVectorOperations::clear(channels[channel] + start2, size2);
+		}
+	}
+
+	fifo.finishedWrite(size1 + size2);
+	return size1 + size2;
+}
+
+// Read samples (reader thread only)
+int AudioRingBuffer::Read(juce::AudioBuffer<float>& destination, int start, int count)
+{
+	int start1, size1, start2, size2;
+	fifo.prepareToRead(std::max(count, 0), start1, size1, start2, size2);
+
+	for (int channel = 0; channel < destination.getNumChannels(); channel++) {
+		if (channel < samples.getNumChannels()) {
+			destination.copyFrom(channel, start, channels[channel] + start1, size1);
+			destination.copyFrom(channel, start + size1, channels[channel] + start2, size2);
+		} else {
+			destination.clear(channel, start, size1 + size2);
+		}
+	}
+
+	fifo.finishedRead(size1 + size2);
+	return size1 + size2;
+}
+
+// Skip samples without reading them (reader thread only)
+int AudioRingBuffer::Discard(int count)
+{
+	int start1, size1, start2, size2;
+	fifo.prepareToRead(std::max(count, 0), start1, size1, start2, size2);
+	fifo.finishedRead(size1 + size2);
+	return size1 + size2;
+}
@@ -0,0 +1,89 @@
+/**
+ * @file
+ * @brief Header file for AudioRingBuffer class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_AUDIO_RING_BUFFER_H
+#define OPENSHOT_AUDIO_RING_BUFFER_H
+
+#include <AppConfig.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+
+namespace openshot {
+
+	/**
+	 * @brief This class is a lock-free FIFO of audio samples, for a single writer thread and a single reader thread
+	 *
+	 * Samples are written by one thread (such as a thread which mixes the audio of frames ahead of time), and read
+	 * by another thread (such as a realtime audio device callback). Reading and writing never lock, wait or allocate
+	 * memory (all memory is allocated by the constructor), so it is safe to use from an audio callback.
+	 *
+	 * Only the writer thread may call Write() and Space(), and only the reader thread may call Read(), Discard() and
+	 * Clear(). Available() can be called by either thread.
+	 *
+	 * @code
+	 * AudioRingBuffer ring(2, 44100);
+	 *
+	 * // Writer thread (returns the number of samples written, which is less than requested if the ring is full)
+	 * int written = ring.Write(*frame->GetAudioSampleBuffer(), 0, frame->GetAudioSamplesCount());
+	 *
+	 * // Reader thread (returns the number of samples read, which is less than requested if the ring is empty)
+	 * int read = ring.Read(*info.buffer, info.startSample, info.numSamples);
+	 * @endcode
+	 */
+	class AudioRingBuffer {
+	private:
+		juce::AbstractFifo fifo;
+		juce::AudioBuffer<float> samples;
+		float* const* channels; ///< The samples of each channel (juce::AudioBuffer methods change its "is clear" flag, which is not thread-safe)
+
+	public:
+		/// @brief Create a ring
+		/// @param num_channels The number of channels of audio
+		/// @param capacity The max number of samples (per channel) held by the ring
+		AudioRingBuffer(int num_channels, int capacity);
+
+		/// Get the max number of samples (per channel) held by the ring
+		int Capacity() const { return samples.getNumSamples() - 1; }
+
+		/// Get the number of channels of audio
+		int Channels() const { return samples.getNumChannels(); }
+
+		/// Get the number of samples which can be read
+		int Available() const { return fifo.getNumReady(); }
+
+		/// Get the number of samples which can be written (writer thread only)
+		int Space() const { return fifo.getFreeSpace(); }
+
+		/// @brief Write samples (writer thread only)
+		/// @param source The audio to write (missing channels are written as silence, and extra channels are ignored)
+		/// @param start The first sample of the source to write
+		/// @param count The number of samples to write
+		/// @returns The number of samples written (less than count if the ring is full)
+		int Write(const juce::AudioBuffer<float>& source, int start, int count);
+
+		/// @brief Read samples (reader thread only)
+		/// @param destination The audio to read into (extra channels are cleared)
+		/// @param start The first sample of the destination to read into
+		/// @param count The number of samples to read
+		/// @returns The number of samples read (less than count if the ring is empty, and the rest are not changed)
+		int Read(juce::AudioBuffer<float>& destination, int start, int count);
+
+		/// @brief Skip samples without reading them (reader thread only)
+		/// @returns The number of samples skipped
+		int Discard(int count);
+
+		/// Skip all samples which have been written (reader thread only)
+		void Clear() { Discard(Available()); }
+	};
+
+}
+
+#endif // OPENSHOT_AUDIO_RING_BUFFER_H
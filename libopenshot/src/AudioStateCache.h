@@ -0,0 +1,280 @@
+/**
+ * @file
+ * @brief Header file for AudioStateCache class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_AUDIO_STATE_CACHE_H
+#define OPENSHOT_AUDIO_STATE_CACHE_H
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <AppConfig.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+
+namespace openshot {
+
+	/**
+	 * @brief A ring buffer of audio samples (such as a delay line) in the state of an audio effect
+	 *
+	 * The samples are kept in blocks, which are shared by every copy of the buffer until a copy writes to
+	 * them. So a snapshot of the state (see openshot::AudioStateCache) only copies the blocks which are
+	 * written after it, instead of the whole buffer (which is several seconds of audio).
+	 */
+	class AudioStateBuffer {
+	private:
+		static constexpr int BLOCK_BITS = 12;
+		static constexpr int BLOCK_SAMPLES = 1 << BLOCK_BITS;
+		typedef std::array<float, BLOCK_SAMPLES> Block;
+
+		int channels = 0;
+		int samples = 0;
+		int channel_blocks = 0;
+		std::vector<std::shared_ptr<Block>> blocks; ///< The blocks of every channel (one channel after another)
+
+	public:
+		/// The samples of a channel (only valid until the buffer is changed)
+		class Channel {
+		private:
+			std::vector<float*> blocks;
+			friend class AudioStateBuffer;
+
+		public:
+			/// Get a sample (only the samples which were prepared for writing can be changed)
+			float& operator[](int index) const {
+				return blocks[index >> BLOCK_BITS][index & (BLOCK_SAMPLES - 1)];
+			}
+		};
+
+		/// Get the number of channels
+		int Channels() const { return channels; }
+
+		/// Get the number of samples of each channel
+		int Samples() const { return samples; }
+
+		/// Set the number of channels and samples (and clear every sample)
+		void SetSize(int new_channels, int new_samples) {
+			channels = new_channels;
+			samples = new_samples;
+			channel_blocks = (samples + BLOCK_SAMPLES - 1) >> BLOCK_BITS;
+
+			// Every block starts as the same silent block (which is copied when it's written)
+			auto silence = std::make_shared<Block>();
+			silence->fill(0.0f);
+			blocks.assign(size_t(channels) * channel_blocks, silence);
+		}
+
+		/// @brief Get the samples of a channel, to read any sample and write some of them
+		/// @param channel The channel
+		/// @param position The first sample which is written
+		/// @param count The number of samples which are written (after position, wrapping around the end)
+		Channel GetChannel(int channel, int position, int count) {
+			auto channel_begin = blocks.begin() + size_t(channel) * channel_blocks;
+
+			// Copy the blocks which are written (if they are shared with another buffer)
+			for (int remaining = std::min(count, samples); remaining > 0; ) {
+				std::shared_ptr<Block>& block = channel_begin[position >> BLOCK_BITS];
+				if (block.use_count() > 1)
+					block = std::make_shared<Block>(*block);
+				int written = std::min({remaining, BLOCK_SAMPLES - (position & (BLOCK_SAMPLES - 1)), samples - position});
+				remaining -= written;
+				position += written;
+				if (position >= samples)
+					position = 0;
+			}
+
+			Channel samples_of_channel;
+			samples_of_channel.blocks.reserve(channel_blocks);
+			for (int block = 0; block < channel_blocks; block++)
+				samples_of_channel.blocks.push_back(channel_begin[block]->data());
+			return samples_of_channel;
+		}
+	};
+
+	/**
+	 * @brief This class keeps the state of an audio effect between frames, so frames can be processed in any order
+	 *
+	 * Audio effects with memory (such as the delay line of openshot::Echo, or the envelope of
+	 * openshot::Compressor) continue from the state left by the previous frame. Frames are not always
+	 * requested in order (seeking, re-requesting frames which were removed from a cache, or several threads),
+	 * so the state is kept by frame number:
+	 *
+	 * - A snapshot of the state after the last processed frame (which continues sequential playback), after
+	 *   every Nth frame, and after the frame before each jump (so playback can continue from there).
+	 * - The input audio of recent frames, so the state before a frame can be rebuilt by replaying the frames
+	 *   after the nearest snapshot (instead of every frame from the start of the clip).
+	 *
+	 * If no snapshot is near a frame (such as after a seek), the effect starts from an empty state, pre-rolled
+	 * with any cached audio before the frame. A frame waits while the previous frame is processed by another
+	 * thread (so it continues from its state), but frames are otherwise processed in parallel.
+	 *
+	 * A state is exact if it continues every frame from the start of the clip (an exact snapshot, or the first
+	 * frame, followed by the cached audio of every frame up to it). Frames which start before the previous
+	 * frame (such as when a frame is rendered before the frame before it) are not exact. Their states are
+	 * only used when no exact state can be rebuilt, so once the missing frame is processed, the following
+	 * frames are rebuilt from the exact snapshot before them (replaying the missing frame).
+	 *
+	 * @code
+	 * struct EnvelopeState { float level = 0.0f; };
+	 * AudioStateCache<EnvelopeState> states;
+	 *
+	 * states.Process(frame->number, *frame->audio, [&](EnvelopeState& state, juce::AudioBuffer<float>& audio, int64_t number) {
+	 *     // Process the audio of frame 'number' (starting from, and updating, the state)
+	 * });
+	 * @endcode
+	 */
+	template <typename State>
+	class AudioStateCache {
+	private:
+		std::mutex mutex;
+		std::condition_variable processed;
+		std::set<int64_t> processing; ///< Frames which are being processed (by any thread)
+		// The state after a frame, and whether it continues every frame before it
+		struct Snapshot {
+			State state;
+			bool exact;
+		};
+		std::map<int64_t, Snapshot> snapshots; ///< The state after each frame
+		std::map<int64_t, juce::AudioBuffer<float>> inputs; ///< The input audio of recent frames
+		int max_preroll;
+		int snapshot_interval;
+		size_t max_snapshots;
+
+		// Remove the item which is the farthest from a frame (if there are too many items)
+		template <typename Map>
+		static void Trim(Map& items, size_t max_items, int64_t frame_number) {
+			while (items.size() > max_items && items.size() > 1) {
+				if (frame_number - items.begin()->first > items.rbegin()->first - frame_number)
+					items.erase(items.begin());
+				else
+					items.erase(std::prev(items.end()));
+			}
+		}
+
+	public:
+		/// @brief Create a cache
+		/// @param max_preroll The max number of frames replayed before a frame (and of cached input frames)
+		/// @param snapshot_interval Keep the state after every Nth frame
+		/// @param max_snapshots The max number of states kept
+		AudioStateCache(int max_preroll = 60, int snapshot_interval = 30, size_t max_snapshots = 8)
+			: max_preroll(max_preroll), snapshot_interval(snapshot_interval), max_snapshots(max_snapshots) {}
+
+		/// @brief Process the audio of a frame (starting from the state after the previous frame)
+		/// @param frame_number The number of the frame
+		/// @param audio The audio of the frame (processed in place)
+		/// @param process Called with the state, audio and number of each frame (first with any frames which
+		/// are replayed, to rebuild the state). It must only depend on the state, audio and frame number.
+		template <typename Function>
+		void Process(int64_t frame_number, juce::AudioBuffer<float>& audio, Function process) {
+			State state;
+			bool exact = false;
+			int64_t first = frame_number;
+			std::vector<std::pair<int64_t, juce::AudioBuffer<float>>> replay;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+
+				// Wait for the previous frame (and this frame) to be processed by other threads
+				processed.wait(lock, [&] {
+					return !processing.count(frame_number - 1) && !processing.count(frame_number);
+				});
+
+				if (!inputs.count(frame_number))
+					inputs.emplace(frame_number, audio);
+				Trim(inputs, size_t(max_preroll) + 1, frame_number);
+
+				// Find the frames before this frame, which have cached audio
+				while (frame_number - first < max_preroll && inputs.count(first - 1))
+					first--;
+
+				// Start from the newest exact snapshot within those frames (or an empty state, if those frames
+				// start at the first frame)
+				auto next = snapshots.lower_bound(frame_number);
+				auto snapshot = snapshots.end();
+				for (auto before = next; before != snapshots.begin() && std::prev(before)->first >= first - 1; before--) {
+					if (std::prev(before)->second.exact) {
+						snapshot = std::prev(before);
+						break;
+					}
+				}
+				exact = snapshot != snapshots.end() || first <= 1;
+
+				// Otherwise, start from the newest snapshot within those frames (or an empty state)
+				if (!exact && next != snapshots.begin() && std::prev(next)->first >= first - 1)
+					snapshot = std::prev(next);
+
+				if (snapshot != snapshots.end()) {
+					first = snapshot->first + 1;
+					if (snapshot->first % snapshot_interval != 0 && first == frame_number) {
+						// The state after the previous frame is replaced by the state after this frame
+						state = std::move(snapshot->second.state);
+						snapshots.erase(snapshot);
+					} else {
+						state = snapshot->second.state;
+					}
+				}
+				for (int64_t number = first; number < frame_number; number++)
+					replay.emplace_back(number, inputs.at(number));
+
+				processing.insert(frame_number);
+			}
+
+			try {
+				for (auto& input : replay)
+					process(state, input.second, input.first);
+				process(state, audio, frame_number);
+			} catch (...) {
+				const std::lock_guard<std::mutex> lock(mutex);
+				processing.erase(frame_number);
+				processed.notify_all();
+				throw;
+			}
+
+			const std::lock_guard<std::mutex> lock(mutex);
+			processing.erase(frame_number);
+			if (exact) {
+				// The states of the replayed frames, which were not exact, are replaced by this state
+				for (auto snapshot = snapshots.lower_bound(first); snapshot != snapshots.end() && snapshot->first < frame_number; ) {
+					if (!snapshot->second.exact)
+						snapshot = snapshots.erase(snapshot);
+					else
+						snapshot++;
+				}
+				snapshots.insert_or_assign(frame_number, Snapshot{std::move(state), true});
+			} else {
+				// An exact state is never replaced by a state which is not exact
+				auto snapshot = snapshots.find(frame_number);
+				if (snapshot == snapshots.end())
+					snapshots.emplace(frame_number, Snapshot{std::move(state), false});
+				else if (!snapshot->second.exact)
+					snapshot->second.state = std::move(state);
+			}
+			Trim(snapshots, max_snapshots, frame_number);
+			processed.notify_all();
+		}
+
+		/// Remove all states and cached audio (when the properties of the effect change)
+		void Clear() {
+			const std::lock_guard<std::mutex> lock(mutex);
+			snapshots.clear();
+			inputs.clear();
+		}
+	};
+
+}
+
+#endif // OPENSHOT_AUDIO_STATE_CACHE_H
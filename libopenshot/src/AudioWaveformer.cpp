@@ -35,12 +35,12 @@ AudioWaveformData AudioWaveformer::ExtractSamples(int channel, int num_per_secon
 
     if (reader) {
         // Open reader (if needed)
-        bool does_reader_have_video = reader->info.has_video;
+        bool was_audio_only = reader->AudioOnly();
         if (!reader->IsOpen()) {
             reader->Open();
         }
-        // Disable video for faster processing
-        reader->info.has_video = false;
+        // Only read audio (no video is decoded) for faster processing
+        reader->AudioOnly(true);
 
         int sample_rate = reader->info.sample_rate;
         int sample_divisor = sample_rate / num_per_second;
@@ -125,8 +125,8 @@ AudioWaveformData AudioWaveformer::ExtractSamples(int channel, int num_per_secon
             data.scale(total_samples, scale);
         }
 
-        // Resume previous has_video value
-        reader->info.has_video = does_reader_have_video;
+        // Resume previous audio-only mode
+        reader->AudioOnly(was_audio_only);
     }
 
 
@@ -0,0 +1,114 @@
+/**
+ * @file
+ * @brief Header file for BlockingQueue class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_BLOCKING_QUEUE_H
+#define OPENSHOT_BLOCKING_QUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+namespace openshot {
+
+	/**
+	 * @brief This class is a bounded, thread-safe FIFO queue, used to pass work between pipeline stages
+	 *
+	 * Push() blocks while the queue is full, and Pop() blocks while the queue is empty, so a slow
+	 * stage applies back-pressure to the stages in front of it. Once Close() is called, Push() fails,
+	 * and Pop() keeps returning the remaining items until the queue is drained.
+	 *
+	 * @code
+	 * BlockingQueue<int> queue(4);
+	 * std::thread consumer([&]() {
+	 *     int value;
+	 *     while (queue.Pop(value))
+	 *         std::cout << value << std::endl;
+	 * });
+	 * queue.Push(1);
+	 * queue.Push(2);
+	 * queue.Close();
+	 * consumer.join();
+	 * @endcode
+	 */
+	template <typename T>
+	class BlockingQueue {
+	private:
+		std::deque<T> items;
+		size_t capacity;
+		bool is_closed;
+		mutable std::mutex queue_mutex;
+		std::condition_variable not_empty;
+		std::condition_variable not_full;
+
+	public:
+		/// Constructor, which sets the max number of queued items (minimum of 1)
+		BlockingQueue(size_t capacity = 8) : capacity(capacity > 0 ? capacity : 1), is_closed(false) { }
+
+		/// Add an item to the back of the queue (blocks while full). Returns false if the queue is closed.
+		bool Push(T item) {
+			std::unique_lock<std::mutex> lock(queue_mutex);
+			not_full.wait(lock, [this]() { return is_closed || items.size() < capacity; });
+			if (is_closed)
+				return false;
+			items.push_back(std::move(item));
+			lock.unlock();
+			not_empty.notify_one();
+			return true;
+		}
+
+		/// Remove an item from the front of the queue (blocks while empty). Returns false once closed and drained.
+		bool Pop(T& item) {
+			std::unique_lock<std::mutex> lock(queue_mutex);
+			not_empty.wait(lock, [this]() { return is_closed || !items.empty(); });
+			if (items.empty())
+				return false;
+			item = std::move(items.front());
+			items.pop_front();
+			lock.unlock();
+			not_full.notify_one();
+			return true;
+		}
+
+		/// Close the queue (wakes all waiting threads). Items already queued can still be popped.
+		void Close() {
+			{
+				const std::lock_guard<std::mutex> lock(queue_mutex);
+				is_closed = true;
+			}
+			not_empty.notify_all();
+			not_full.notify_all();
+		}
+
+		/// Re-open a closed queue, removing any remaining items
+		void Reset() {
+			const std::lock_guard<std::mutex> lock(queue_mutex);
+			items.clear();
+			is_closed = false;
+		}
+
+		/// Change the max number of queued items (only use when no other thread is using the queue)
+		void SetCapacity(size_t new_capacity) {
+			const std::lock_guard<std::mutex> lock(queue_mutex);
+			capacity = new_capacity > 0 ? new_capacity : 1;
+		}
+
+		/// Get the number of queued items
+		size_t Size() const {
+			const std::lock_guard<std::mutex> lock(queue_mutex);
+			return items.size();
+		}
+	};
+
+}
+
+#endif // OPENSHOT_BLOCKING_QUEUE_H
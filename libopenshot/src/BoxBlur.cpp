@@ -0,0 +1,367 @@
+/**
+ * @file
+ * @brief Source file for BoxBlur class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "BoxBlur.h"
+#include "BufferPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+	#define OPENSHOT_BLUR_SSE2
+	#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	#define OPENSHOT_BLUR_NEON
+	#include <arm_neon.h>
+#endif
+
+using namespace openshot;
+
+namespace {
+
+	// The number of bytes in each strip of columns (each strip is blurred vertically by a single thread)
+	const int STRIP_BYTES = 512;
+
+	// Get the index of a pixel of a row or column, for an index which can be beyond its edges (which repeat the
+	// edge pixel, or reflect the pixels before the edge without repeating the edge pixel)
+	inline int EdgeIndex(int index, int last, BoxBlur::EdgeMode edges) {
+		if (index >= 0 && index <= last)
+			return index;
+		if (edges == BoxBlur::EDGE_REPEAT || last == 0)
+			return std::clamp(index, 0, last);
+
+		// Reflect as many times as needed (for radii larger than the image)
+		const int period = 2 * last;
+		index %= period;
+		if (index < 0)
+			index += period;
+		return index <= last ? index : period - index;
+	}
+
+	// Round a running sum to the average of its window
+	inline unsigned char Average(int32_t sum, float inverse) {
+		return (unsigned char) int(float(sum) * inverse + 0.5f);
+	}
+
+#ifdef OPENSHOT_BLUR_SSE2
+	// Load the 4 channels of a pixel as 32-bit integers
+	inline __m128i LoadPixel(const unsigned char* pixel) {
+		int32_t value;
+		std::memcpy(&value, pixel, 4);
+		const __m128i zero = _mm_setzero_si128();
+		return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(value), zero), zero);
+	}
+
+	// Round running sums to averages (as 32-bit integers)
+	inline __m128i Averages(__m128i sums, __m128 inverse) {
+		return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(sums), inverse), _mm_set1_ps(0.5f)));
+	}
+
+	// Widen 8 signed 16-bit differences to 2 vectors of 32-bit integers
+	inline __m128i WidenLow(__m128i differences) {
+		return _mm_srai_epi32(_mm_unpacklo_epi16(differences, differences), 16);
+	}
+	inline __m128i WidenHigh(__m128i differences) {
+		return _mm_srai_epi32(_mm_unpackhi_epi16(differences, differences), 16);
+	}
+#endif
+
+#ifdef OPENSHOT_BLUR_NEON
+	// Load the 4 channels of a pixel as 32-bit integers
+	inline int32x4_t LoadPixel(const unsigned char* pixel) {
+		uint32_t value;
+		std::memcpy(&value, pixel, 4);
+		uint16x8_t wide = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(value)));
+		return vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(wide)));
+	}
+
+	// Round running sums to averages (as 32-bit integers)
+	inline int32x4_t Averages(int32x4_t sums, float32x4_t inverse) {
+		return vcvtq_s32_f32(vaddq_f32(vmulq_f32(vcvtq_f32_s32(sums), inverse), vdupq_n_f32(0.5f)));
+	}
+#endif
+
+	// Blur a row of pixels horizontally (the source and target rows must not overlap)
+	void BlurRow(const unsigned char* source, unsigned char* target, int width, int channels, int radius,
+				 BoxBlur::EdgeMode edges) {
+		const float inverse = 1.0f / (radius + radius + 1);
+		const int last = width - 1;
+
+		// Sum the window of the first pixel
+		const int inside = std::min(radius, last);
+		int32_t sums[4] = {0, 0, 0, 0};
+		for (int channel = 0; channel < channels; ++channel) {
+			if (edges == BoxBlur::EDGE_REPEAT) {
+				sums[channel] = (radius + 1) * source[channel] + (radius - inside) * source[last * channels + channel];
+				for (int x = 1; x <= inside; ++x)
+					sums[channel] += source[x * channels + channel];
+			} else {
+				for (int x = -radius; x <= radius; ++x)
+					sums[channel] += source[EdgeIndex(x, last, edges) * channels + channel];
+			}
+		}
+
+#if defined(OPENSHOT_BLUR_SSE2) || defined(OPENSHOT_BLUR_NEON)
+		if (channels == 4) {
+#ifdef OPENSHOT_BLUR_SSE2
+			const __m128 inverses = _mm_set1_ps(inverse);
+			__m128i sum = _mm_loadu_si128((const __m128i*) sums);
+			for (int x = 0; x < width; ++x) {
+				__m128i averages = Averages(sum, inverses);
+				averages = _mm_packs_epi32(averages, averages);
+				int32_t pixel = _mm_cvtsi128_si32(_mm_packus_epi16(averages, averages));
+				std::memcpy(target + x * 4, &pixel, 4);
+
+				// Slide the window (adding the next pixel, and removing the first pixel)
+				__m128i entering = LoadPixel(source + EdgeIndex(x + radius + 1, last, edges) * 4);
+				__m128i leaving = LoadPixel(source + EdgeIndex(x - radius, last, edges) * 4);
+				sum = _mm_add_epi32(sum, _mm_sub_epi32(entering, leaving));
+			}
+#else
+			const float32x4_t inverses = vdupq_n_f32(inverse);
+			int32x4_t sum = vld1q_s32(sums);
+			for (int x = 0; x < width; ++x) {
+				uint16x4_t averages = vqmovun_s32(Averages(sum, inverses));
+				uint32_t pixel = vget_lane_u32(vreinterpret_u32_u8(vqmovn_u16(vcombine_u16(averages, averages))), 0);
+				std::memcpy(target + x * 4, &pixel, 4);
+
+				// Slide the window (adding the next pixel, and removing the first pixel)
+				int32x4_t entering = LoadPixel(source + EdgeIndex(x + radius + 1, last, edges) * 4);
+				int32x4_t leaving = LoadPixel(source + EdgeIndex(x - radius, last, edges) * 4);
+				sum = vaddq_s32(sum, vsubq_s32(entering, leaving));
+			}
+#endif
+			return;
+		}
+#endif
+
+		for (int x = 0; x < width; ++x) {
+			const unsigned char* entering = source + EdgeIndex(x + radius + 1, last, edges) * channels;
+			const unsigned char* leaving = source + EdgeIndex(x - radius, last, edges) * channels;
+			for (int channel = 0; channel < channels; ++channel) {
+				target[x * channels + channel] = Average(sums[channel], inverse);
+				sums[channel] += entering[channel] - leaving[channel];
+			}
+		}
+	}
+
+	// Blur a strip of columns vertically (the source and target images must not overlap)
+	void BlurStrip(const unsigned char* source, unsigned char* target, int height, int64_t bytes_per_line,
+				   int begin, int end, int radius, BoxBlur::EdgeMode edges) {
+		const float inverse = 1.0f / (radius + radius + 1);
+		const int last = height - 1;
+		const int bytes = end - begin;
+		source += begin;
+		target += begin;
+
+		// Sum the window of the first row, for each column
+		int32_t sums[STRIP_BYTES];
+		if (edges == BoxBlur::EDGE_REPEAT) {
+			const int inside = std::min(radius, last);
+			const unsigned char* last_row = source + last * bytes_per_line;
+			for (int i = 0; i < bytes; ++i)
+				sums[i] = (radius + 1) * source[i] + (radius - inside) * last_row[i];
+			for (int y = 1; y <= inside; ++y) {
+				const unsigned char* row = source + y * bytes_per_line;
+				for (int i = 0; i < bytes; ++i)
+					sums[i] += row[i];
+			}
+		} else {
+			std::fill(sums, sums + bytes, 0);
+			for (int y = -radius; y <= radius; ++y) {
+				const unsigned char* row = source + EdgeIndex(y, last, edges) * bytes_per_line;
+				for (int i = 0; i < bytes; ++i)
+					sums[i] += row[i];
+			}
+		}
+
+		for (int y = 0; y < height; ++y) {
+			const unsigned char* entering = source + EdgeIndex(y + radius + 1, last, edges) * bytes_per_line;
+			const unsigned char* leaving = source + EdgeIndex(y - radius, last, edges) * bytes_per_line;
+			unsigned char* output = target + y * bytes_per_line;
+
+			int i = 0;
+#ifdef OPENSHOT_BLUR_SSE2
+			const __m128 inverses = _mm_set1_ps(inverse);
+			const __m128i zero = _mm_setzero_si128();
+			for (; i + 16 <= bytes; i += 16) {
+				__m128i* sum = (__m128i*) (sums + i);
+				__m128i sum0 = _mm_loadu_si128(sum), sum1 = _mm_loadu_si128(sum + 1);
+				__m128i sum2 = _mm_loadu_si128(sum + 2), sum3 = _mm_loadu_si128(sum + 3);
+				__m128i low = _mm_packs_epi32(Averages(sum0, inverses), Averages(sum1, inverses));
+				__m128i high = _mm_packs_epi32(Averages(sum2, inverses), Averages(sum3, inverses));
+				_mm_storeu_si128((__m128i*) (output + i), _mm_packus_epi16(low, high));
+
+				// Slide the windows (adding the next row, and removing the first row)
+				__m128i entering_bytes = _mm_loadu_si128((const __m128i*) (entering + i));
+				__m128i leaving_bytes = _mm_loadu_si128((const __m128i*) (leaving + i));
+				__m128i low_differences = _mm_sub_epi16(_mm_unpacklo_epi8(entering_bytes, zero), _mm_unpacklo_epi8(leaving_bytes, zero));
+				__m128i high_differences = _mm_sub_epi16(_mm_unpackhi_epi8(entering_bytes, zero), _mm_unpackhi_epi8(leaving_bytes, zero));
+				_mm_storeu_si128(sum, _mm_add_epi32(sum0, WidenLow(low_differences)));
+				_mm_storeu_si128(sum + 1, _mm_add_epi32(sum1, WidenHigh(low_differences)));
+				_mm_storeu_si128(sum + 2, _mm_add_epi32(sum2, WidenLow(high_differences)));
+				_mm_storeu_si128(sum + 3, _mm_add_epi32(sum3, WidenHigh(high_differences)));
+			}
+#endif
+#ifdef OPENSHOT_BLUR_NEON
+			const float32x4_t inverses = vdupq_n_f32(inverse);
+			for (; i + 16 <= bytes; i += 16) {
+				int32_t* sum = sums + i;
+				int32x4_t sum0 = vld1q_s32(sum), sum1 = vld1q_s32(sum + 4);
+				int32x4_t sum2 = vld1q_s32(sum + 8), sum3 = vld1q_s32(sum + 12);
+				uint16x8_t low = vcombine_u16(vqmovun_s32(Averages(sum0, inverses)), vqmovun_s32(Averages(sum1, inverses)));
+				uint16x8_t high = vcombine_u16(vqmovun_s32(Averages(sum2, inverses)), vqmovun_s32(Averages(sum3, inverses)));
+				vst1q_u8(output + i, vcombine_u8(vqmovn_u16(low), vqmovn_u16(high)));
+
+				// Slide the windows (adding the next row, and removing the first row)
+				uint8x16_t entering_bytes = vld1q_u8(entering + i);
+				uint8x16_t leaving_bytes = vld1q_u8(leaving + i);
+				int16x8_t low_differences = vreinterpretq_s16_u16(vsubl_u8(vget_low_u8(entering_bytes), vget_low_u8(leaving_bytes)));
+				int16x8_t high_differences = vreinterpretq_s16_u16(vsubl_u8(vget_high_u8(entering_bytes), vget_high_u8(leaving_bytes)));
+				vst1q_s32(sum, vaddw_s16(sum0, vget_low_s16(low_differences)));
+				vst1q_s32(sum + 4, vaddw_s16(sum1, vget_high_s16(low_differences)));
+				vst1q_s32(sum + 8, vaddw_s16(sum2, vget_low_s16(high_differences)));
+				vst1q_s32(sum + 12, vaddw_s16(sum3, vget_high_s16(high_differences)));
+			}
+#endif
+			for (; i < bytes; ++i) {
+				output[i] = Average(sums[i], inverse);
+				sums[i] += entering[i] - leaving[i];
+			}
+		}
+	}
+
+	// Blur every row of an image horizontally (the source and target may be the same image)
+	void BlurRows(const unsigned char* source, unsigned char* target, int width, int height,
+				  int64_t bytes_per_line, int channels, int radius, BoxBlur::EdgeMode edges) {
+		#pragma omp parallel
+		{
+			// Blurring in place needs a copy of each row
+			std::vector<unsigned char> row(source == target ? size_t(width) * channels : 0);
+
+			#pragma omp for
+			for (int y = 0; y < height; ++y) {
+				const unsigned char* input = source + y * bytes_per_line;
+				if (!row.empty()) {
+					std::memcpy(row.data(), input, row.size());
+					input = row.data();
+				}
+				BlurRow(input, target + y * bytes_per_line, width, channels, radius, edges);
+			}
+		}
+	}
+
+	// Blur every column of an image vertically, one strip of columns at a time (the images must not overlap)
+	void BlurColumns(const unsigned char* source, unsigned char* target, int width, int height,
+					 int64_t bytes_per_line, int channels, int radius, BoxBlur::EdgeMode edges) {
+		const int row_bytes = width * channels;
+		const int strips = (row_bytes + STRIP_BYTES - 1) / STRIP_BYTES;
+
+		#pragma omp parallel for
+		for (int strip = 0; strip < strips; ++strip) {
+			int begin = strip * STRIP_BYTES;
+			BlurStrip(source, target, height, bytes_per_line, begin, std::min(begin + STRIP_BYTES, row_bytes), radius, edges);
+		}
+	}
+
+}
+
+// Blur an image with box blurs
+void BoxBlur::Blur(QImage& image, int horizontal_radius, int vertical_radius, int iterations) {
+	if (image.isNull() || image.depth() % 8 != 0 || image.depth() > 32 || iterations <= 0)
+		return;
+
+	std::vector<int> horizontal_radii(iterations, horizontal_radius);
+	std::vector<int> vertical_radii(iterations, vertical_radius);
+	Blur(image.bits(), image.width(), image.height(), image.bytesPerLine(), image.depth() / 8,
+		 horizontal_radii, vertical_radii);
+}
+
+// Blur pixels with a box blur for each radius
+void BoxBlur::Blur(unsigned char* pixels, int width, int height, int64_t bytes_per_line, int channels,
+				   const std::vector<int>& horizontal_radii, const std::vector<int>& vertical_radii, EdgeMode edges) {
+	if (!pixels || width <= 0 || height <= 0 || channels < 1 || channels > 4)
+		return;
+
+	// Each vertical pass reads from a copy of the image (which is only allocated when needed)
+	const size_t passes = std::min(horizontal_radii.size(), vertical_radii.size());
+	const size_t bytes = size_t(bytes_per_line) * height;
+	unsigned char* copy = nullptr;
+	for (size_t pass = 0; pass < passes; ++pass) {
+		if (vertical_radii[pass] > 0 && !copy)
+			copy = (unsigned char*) BufferPool::Instance()->Allocate(bytes);
+	}
+
+	for (size_t pass = 0; pass < passes; ++pass) {
+		const int horizontal_radius = horizontal_radii[pass];
+		const int vertical_radius = vertical_radii[pass];
+
+		if (horizontal_radius > 0 && vertical_radius > 0) {
+			// Blur rows into the copy, and columns back into the image
+			BlurRows(pixels, copy, width, height, bytes_per_line, channels, horizontal_radius, edges);
+			BlurColumns(copy, pixels, width, height, bytes_per_line, channels, vertical_radius, edges);
+		}
+		else if (horizontal_radius > 0) {
+			BlurRows(pixels, pixels, width, height, bytes_per_line, channels, horizontal_radius, edges);
+		}
+		else if (vertical_radius > 0) {
+			std::memcpy(copy, pixels, bytes);
+			BlurColumns(copy, pixels, width, height, bytes_per_line, channels, vertical_radius, edges);
+		}
+	}
+
+	BufferPool::Instance()->Release(copy);
+}
+
+// Approximate a Gaussian blur with 3 box blurs
+void BoxBlur::GaussianBlur(QImage& image, double sigma) {
+	if (image.isNull() || image.depth() % 8 != 0 || image.depth() > 32)
+		return;
+
+	std::vector<int> radii = GaussianRadii(sigma);
+	Blur(image.bits(), image.width(), image.height(), image.bytesPerLine(), image.depth() / 8, radii, radii);
+}
+
+// Get the radii of 3 box blurs which approximate a Gaussian blur
+std::vector<int> BoxBlur::GaussianRadii(double sigma) {
+	const int n = 3;
+	if (sigma <= 0.0)
+		return std::vector<int>(n, 0);
+
+	// Ideal width of each box (rounded down, and up, to odd widths)
+	double ideal_width = std::sqrt((12.0 * sigma * sigma / n) + 1.0);
+	int lower_width = int(std::floor(ideal_width));
+	if (lower_width % 2 == 0)
+		lower_width--;
+	int upper_width = lower_width + 2;
+
+	// Number of boxes with the lower width (which brings the variance closest to sigma squared)
+	double ideal_count = (12.0 * sigma * sigma - n * lower_width * lower_width - 4.0 * n * lower_width - 3.0 * n)
+						 / (-4.0 * lower_width - 4.0);
+	int count = int(std::round(ideal_count));
+
+	std::vector<int> radii;
+	for (int i = 0; i < n; ++i)
+		radii.push_back(((i < count ? lower_width : upper_width) - 1) / 2);
+	return radii;
+}
+
+// Get the radii of 3 box blurs which reach as far as the Gaussian kernel of OpenCV
+std::vector<int> BoxBlur::KernelRadii(double sigma) {
+	// OpenCV's kernel for 8-bit images is 6 sigma + 1 pixels wide (rounded to an odd width)
+	const int reach = (int(std::lrint(sigma * 6.0 + 1.0)) | 1) / 2;
+	std::vector<int> radii;
+	for (int i = 0; i < 3; ++i)
+		radii.push_back(reach / 3 + (i < reach % 3 ? 1 : 0));
+	return radii;
+}
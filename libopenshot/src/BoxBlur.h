@@ -0,0 +1,97 @@
+/**
+ * @file
+ * @brief Header file for BoxBlur class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_BOX_BLUR_H
+#define OPENSHOT_BOX_BLUR_H
+
+#include <cstdint>
+#include <vector>
+
+#include <QImage>
+
+namespace openshot {
+
+	/**
+	 * @brief This class blurs images with box blurs (the shared blur engine of openshot::Blur,
+	 * openshot::Sharpen and openshot::Outline)
+	 *
+	 * A box blur replaces each pixel with the average of the pixels within a radius, horizontally and then
+	 * vertically. Pixels beyond the edges of the image repeat the edge pixel, or reflect the pixels before the
+	 * edge (as the default border of OpenCV does, see EdgeMode). Repeating a box blur 3 times closely
+	 * approximates a Gaussian blur (see GaussianBlur()).
+	 *
+	 * Each pass keeps a running sum of the pixels in its window (adding the pixel entering the window, and
+	 * subtracting the pixel leaving it), so the cost of a blur does not depend on its radius. All channels
+	 * of a pixel are summed together, as 32-bit integers in SIMD registers (SSE2 or NEON). The vertical pass
+	 * keeps a running sum for each column of a strip of columns, and walks down the rows of the strip, so
+	 * every pass reads and writes memory row by row. Rows (and strips of columns) are blurred in parallel.
+	 *
+	 * Each average is rounded to the nearest integer.
+	 *
+	 * @code
+	 * // Blur a frame image by 10 pixels horizontally, and 5 pixels vertically (3 times)
+	 * BoxBlur::Blur(*frame->GetImage(), 10, 5, 3);
+	 *
+	 * // Approximate a Gaussian blur (with a standard deviation of 4.5 pixels)
+	 * BoxBlur::GaussianBlur(*frame->GetImage(), 4.5);
+	 * @endcode
+	 */
+	class BoxBlur {
+	public:
+		/// The pixels beyond the edges of an image
+		enum EdgeMode {
+			EDGE_REPEAT, ///< Repeat the edge pixel (aaa|abcd|ddd)
+			EDGE_REFLECT ///< Reflect the pixels before the edge, without the edge pixel (dcb|abcd|cba)
+		};
+
+		/// @brief Blur an image with box blurs (each iteration blurs horizontally, then vertically)
+		/// @param image The image to blur (with 8-bit channels, and 1 to 4 channels per pixel)
+		/// @param horizontal_radius The horizontal radius of each box (0 = no horizontal blur)
+		/// @param vertical_radius The vertical radius of each box (0 = no vertical blur)
+		/// @param iterations The number of times to blur the image
+		static void Blur(QImage& image, int horizontal_radius, int vertical_radius, int iterations = 1);
+
+		/// @brief Blur pixels with a box blur for each radius (each box blurs horizontally, then vertically)
+		/// @param pixels The pixels to blur (8-bit channels)
+		/// @param width The width of the image (in pixels)
+		/// @param height The height of the image (in pixels)
+		/// @param bytes_per_line The number of bytes between the start of each row
+		/// @param channels The number of channels of each pixel (1 to 4)
+		/// @param horizontal_radii The horizontal radius of each box (0 = no horizontal blur)
+		/// @param vertical_radii The vertical radius of each box (0 = no vertical blur)
+		/// @param edges The pixels beyond the edges of the image
+		static void Blur(unsigned char* pixels, int width, int height, int64_t bytes_per_line, int channels,
+						 const std::vector<int>& horizontal_radii, const std::vector<int>& vertical_radii,
+						 EdgeMode edges = EDGE_REPEAT);
+
+		/// @brief Approximate a Gaussian blur with 3 box blurs
+		/// @param image The image to blur (with 8-bit channels, and 1 to 4 channels per pixel)
+		/// @param sigma The standard deviation of the Gaussian (in pixels)
+		static void GaussianBlur(QImage& image, double sigma);
+
+		/// @brief Get the radii of 3 box blurs which approximate a Gaussian blur
+		///
+		/// Credit: http://blog.ivank.net/fastest-gaussian-blur.html (MIT License)
+		/// @param sigma The standard deviation of the Gaussian (in pixels)
+		static std::vector<int> GaussianRadii(double sigma);
+
+		/// @brief Get the radii of 3 box blurs which reach as far as the Gaussian kernel of OpenCV
+		///
+		/// Blurring a mask with these boxes spreads it as far as cv::GaussianBlur() does (with the same sigma),
+		/// although the weights within the kernel differ.
+		/// @param sigma The standard deviation of the Gaussian (in pixels)
+		static std::vector<int> KernelRadii(double sigma);
+	};
+
+}
+
+#endif // OPENSHOT_BOX_BLUR_H
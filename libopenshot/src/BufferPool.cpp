@@ -0,0 +1,251 @@
+/**
+ * @file
+ * @brief Source file for BufferPool class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "BufferPool.h"
+
+#include <new>
+
+#include "FFmpegUtilities.h"
+#include "QtUtilities.h"
+
+using namespace openshot;
+
+// Size of the header before each buffer (which stores the size), and the alignment of each buffer
+static const size_t BUFFER_HEADER_BYTES = 64;
+
+// Buffers are pooled by size, rounded up to a whole page
+static const size_t BUFFER_PAGE_BYTES = 4096;
+
+// Max number of free buffers each thread keeps for itself
+static const size_t THREAD_BUFFERS = 2;
+
+// Extra bytes at the end of image buffers (for SIMD and swscale reads / writes past the last pixel)
+static const size_t IMAGE_PADDING_BYTES = 128;
+
+namespace openshot {
+
+	/// Free buffers kept by a single thread (returned to the shared pool when the thread exits)
+	struct ThreadBuffers {
+		std::vector<void*> buffers;
+
+		~ThreadBuffers();
+	};
+
+	static thread_local ThreadBuffers thread_buffers;
+
+	// Set once a thread's buffers are destroyed (images can still be freed later, during thread or program exit)
+	static thread_local bool is_thread_exiting = false;
+
+	ThreadBuffers::~ThreadBuffers() {
+		is_thread_exiting = true;
+		BufferPool *pool = BufferPool::Instance();
+		for (void* buffer : buffers) {
+			size_t size = BufferPool::SizeOf(buffer);
+			pool->buffers_retained--;
+			pool->bytes_retained -= size;
+			pool->PushShared(buffer, size);
+		}
+		buffers.clear();
+	}
+}
+
+// Global reference to pool
+BufferPool *BufferPool::m_pInstance = nullptr;
+
+// Create or Get an instance of the pool singleton
+BufferPool *BufferPool::Instance()
+{
+	static std::once_flag init_flag;
+	std::call_once(init_flag, []() {
+		// Create the actual instance of the pool only once
+		m_pInstance = new BufferPool;
+	});
+
+	return m_pInstance;
+}
+
+// Default constructor
+BufferPool::BufferPool() : hits(0), misses(0), buffers_retained(0), bytes_retained(0), max_bytes(0),
+	max_cache_bytes(0), is_max_bytes_set(false) { }
+
+// Get a buffer of at least the requested size
+void* BufferPool::Allocate(size_t bytes) {
+	size_t size = RoundSize(bytes);
+
+	// Check this thread's buffers first (no locking needed)
+	if (!is_thread_exiting) {
+		for (auto buffer = thread_buffers.buffers.begin(); buffer != thread_buffers.buffers.end(); ++buffer) {
+			if (SizeOf(*buffer) == size) {
+				void* found = *buffer;
+				thread_buffers.buffers.erase(buffer);
+				buffers_retained--;
+				bytes_retained -= size;
+				hits++;
+				return found;
+			}
+		}
+	}
+
+	// Check the shared buffers
+	void* found = PopShared(size);
+	if (found) {
+		hits++;
+		return found;
+	}
+
+	// Allocate a new buffer (and store its size in the header)
+	misses++;
+	unsigned char* base = (unsigned char*) aligned_malloc(size + BUFFER_HEADER_BYTES, BUFFER_HEADER_BYTES);
+	if (!base)
+		throw std::bad_alloc();
+	*reinterpret_cast<size_t*>(base) = size;
+	return base + BUFFER_HEADER_BYTES;
+}
+
+// Return a buffer to the pool
+void BufferPool::Release(void* buffer) {
+	if (!buffer)
+		return;
+	size_t size = SizeOf(buffer);
+
+	// Keep the buffer for this thread (if there's room)
+	if (!is_thread_exiting && thread_buffers.buffers.size() < THREAD_BUFFERS && bytes_retained + int64_t(size) <= max_bytes) {
+		thread_buffers.buffers.push_back(buffer);
+		buffers_retained++;
+		bytes_retained += size;
+		return;
+	}
+
+	PushShared(buffer, size);
+}
+
+// Take a free buffer from the shared pool
+void* BufferPool::PopShared(size_t size) {
+	const std::lock_guard<std::mutex> lock(buffers_mutex);
+	auto bucket = buffers.find(size);
+	if (bucket == buffers.end() || bucket->second.empty())
+		return nullptr;
+
+	void* buffer = bucket->second.back();
+	bucket->second.pop_back();
+	buffers_retained--;
+	bytes_retained -= size;
+	return buffer;
+}
+
+// Add a free buffer to the shared pool (or free it, if the pool is full)
+void BufferPool::PushShared(void* buffer, size_t size) {
+	{
+		const std::lock_guard<std::mutex> lock(buffers_mutex);
+		if (bytes_retained + int64_t(size) <= max_bytes) {
+			buffers[size].push_back(buffer);
+			buffers_retained++;
+			bytes_retained += size;
+			return;
+		}
+	}
+	FreeBuffer(buffer);
+}
+
+// Free all buffers held by the shared pool (and the calling thread)
+void BufferPool::Clear() {
+	if (!is_thread_exiting) {
+		for (void* buffer : thread_buffers.buffers) {
+			buffers_retained--;
+			bytes_retained -= SizeOf(buffer);
+			FreeBuffer(buffer);
+		}
+		thread_buffers.buffers.clear();
+	}
+
+	const std::lock_guard<std::mutex> lock(buffers_mutex);
+	for (auto& bucket : buffers) {
+		for (void* buffer : bucket.second) {
+			buffers_retained--;
+			bytes_retained -= bucket.first;
+			FreeBuffer(buffer);
+		}
+	}
+	buffers.clear();
+}
+
+// Create an image which uses a pooled buffer for its pixels
+std::shared_ptr<QImage> BufferPool::CreateImage(int width, int height, QImage::Format format) {
+	int bytes_per_line = width * 4;
+	void* buffer = Allocate(size_t(bytes_per_line) * height + IMAGE_PADDING_BYTES);
+	return std::make_shared<QImage>(
+		(uchar*) buffer, width, height, bytes_per_line, format,
+		(QImageCleanupFunction) &BufferPool::ReleaseImageBuffer, buffer);
+}
+
+// Get the statistics of the pool
+BufferPoolStats BufferPool::GetStats() const {
+	BufferPoolStats stats;
+	stats.hits = hits;
+	stats.misses = misses;
+	stats.buffers_retained = buffers_retained;
+	stats.bytes_retained = bytes_retained;
+	stats.max_bytes = max_bytes;
+	return stats;
+}
+
+// Reset the hit and miss counters
+void BufferPool::ResetStats() {
+	hits = 0;
+	misses = 0;
+}
+
+// Set the max bytes of free buffers the pool holds
+void BufferPool::SetMaxBytes(int64_t bytes) {
+	is_max_bytes_set = true;
+	max_bytes = bytes;
+
+	// Free shared buffers over the new limit
+	const std::lock_guard<std::mutex> lock(buffers_mutex);
+	for (auto bucket = buffers.begin(); bucket != buffers.end() && bytes_retained > max_bytes; ++bucket) {
+		while (!bucket->second.empty() && bytes_retained > max_bytes) {
+			FreeBuffer(bucket->second.back());
+			bucket->second.pop_back();
+			buffers_retained--;
+			bytes_retained -= bucket->first;
+		}
+	}
+}
+
+// Raise the default max bytes to 1/8th of a cache's max bytes
+void BufferPool::SetMaxBytesFromCache(int64_t cache_bytes) {
+	int64_t previous = max_cache_bytes;
+	while (cache_bytes > previous && !max_cache_bytes.compare_exchange_weak(previous, cache_bytes)) { }
+
+	if (!is_max_bytes_set)
+		max_bytes = max_cache_bytes / 8;
+}
+
+// Free a buffer (which was allocated by this pool)
+void BufferPool::FreeBuffer(void* buffer) {
+	aligned_free((unsigned char*) buffer - BUFFER_HEADER_BYTES);
+}
+
+// Get the pooled size of a buffer
+size_t BufferPool::RoundSize(size_t bytes) {
+	return ((bytes + BUFFER_PAGE_BYTES - 1) / BUFFER_PAGE_BYTES) * BUFFER_PAGE_BYTES;
+}
+
+// Get the allocated size of a buffer
+size_t BufferPool::SizeOf(void* buffer) {
+	return *reinterpret_cast<size_t*>((unsigned char*) buffer - BUFFER_HEADER_BYTES);
+}
+
+// Cleanup function for images which use pooled buffers
+void BufferPool::ReleaseImageBuffer(void* buffer) {
+	Instance()->Release(buffer);
+}
@@ -0,0 +1,131 @@
+/**
+ * @file
+ * @brief Header file for BufferPool class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_BUFFER_POOL_H
+#define OPENSHOT_BUFFER_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <QImage>
+
+namespace openshot {
+
+	/// Statistics of the openshot::BufferPool
+	struct BufferPoolStats {
+		int64_t hits; ///< Number of allocations which re-used a pooled buffer
+		int64_t misses; ///< Number of allocations which allocated a new buffer
+		int64_t buffers_retained; ///< Number of free buffers currently held by the pool
+		int64_t bytes_retained; ///< Bytes of free buffers currently held by the pool
+		int64_t max_bytes; ///< Max bytes of free buffers the pool will hold
+	};
+
+	/**
+	 * @brief This class is a pool of large, aligned memory buffers, used for frame images
+	 *
+	 * Images of the same size are created (and freed) many times per second when decoding and
+	 * compositing frames. Large allocations are usually mapped and unmapped by the system allocator
+	 * every time, which causes page faults and lock contention. This pool keeps released buffers
+	 * (grouped by size), and re-uses them for the next allocation of the same size.
+	 *
+	 * Each thread keeps a few released buffers for itself (which need no locking), and the remaining
+	 * buffers are shared by all threads. Free buffers are limited to max bytes (which defaults to 1/8th
+	 * of the largest openshot::CacheBase max bytes), and any buffer released over that limit is freed.
+	 *
+	 * @code
+	 * // Create an image which returns its pixels to the pool when deleted
+	 * std::shared_ptr<QImage> image = BufferPool::Instance()->CreateImage(1920, 1080, QImage::Format_RGBA8888_Premultiplied);
+	 * @endcode
+	 */
+	class BufferPool {
+	private:
+		std::map<size_t, std::vector<void*>> buffers; ///< Free buffers (shared by all threads), grouped by size
+		std::mutex buffers_mutex;
+		std::atomic<int64_t> hits;
+		std::atomic<int64_t> misses;
+		std::atomic<int64_t> buffers_retained;
+		std::atomic<int64_t> bytes_retained;
+		std::atomic<int64_t> max_bytes;
+		std::atomic<int64_t> max_cache_bytes;
+		std::atomic<bool> is_max_bytes_set;
+
+		/// Private variable to keep track of singleton instance
+		static BufferPool * m_pInstance;
+
+		/// Default constructor (use Instance() to get the singleton)
+		BufferPool();
+
+		/// Free a buffer (which was allocated by this pool)
+		static void FreeBuffer(void* buffer);
+
+		/// Take a free buffer from the shared pool (returns nullptr if none are available)
+		void* PopShared(size_t size);
+
+		/// Add a free buffer to the shared pool (or free it, if the pool is full)
+		void PushShared(void* buffer, size_t size);
+
+		/// Get the pooled size of a buffer (i.e. the allocated size, rounded up to a whole page)
+		static size_t RoundSize(size_t bytes);
+
+		/// Get the allocated size of a buffer (which was allocated by this pool)
+		static size_t SizeOf(void* buffer);
+
+		/// Cleanup function for images which use pooled buffers
+		static void ReleaseImageBuffer(void* buffer);
+
+		/// Per-thread free buffers
+		friend struct ThreadBuffers;
+
+	public:
+		/// Create or get an instance of this pool singleton
+		static BufferPool * Instance();
+
+		/// @brief Get a buffer of at least the requested size (aligned to 64 bytes)
+		/// @param bytes The size of the buffer (in bytes)
+		void* Allocate(size_t bytes);
+
+		/// Free all buffers held by the shared pool (and the calling thread)
+		void Clear();
+
+		/// @brief Create an image which uses a pooled buffer for its pixels (the buffer is returned to the pool when the image is deleted)
+		///
+		/// The pixels are not initialized. Only 32-bit formats are supported, and extra padding is added to
+		/// the end of the buffer (so SIMD code and swscale can safely read or write past the last pixel).
+		/// @param width The width of the image
+		/// @param height The height of the image
+		/// @param format The format of the image (a 32-bit format, such as Format_RGBA8888_Premultiplied)
+		std::shared_ptr<QImage> CreateImage(int width, int height, QImage::Format format);
+
+		/// Get the statistics of the pool (hits, misses, and free buffers currently retained)
+		BufferPoolStats GetStats() const;
+
+		/// Return a buffer to the pool (it must have been returned by Allocate)
+		void Release(void* buffer);
+
+		/// Reset the hit and miss counters
+		void ResetStats();
+
+		/// Set the max bytes of free buffers the pool holds (0 = don't keep any free buffers)
+		void SetMaxBytes(int64_t bytes);
+
+		/// Raise the default max bytes to 1/8th of a cache's max bytes (ignored once SetMaxBytes() is called)
+		void SetMaxBytesFromCache(int64_t cache_bytes);
+	};
+
+}
+
+#endif // OPENSHOT_BUFFER_POOL_H
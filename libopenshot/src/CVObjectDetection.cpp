@@ -11,9 +11,11 @@
 //
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
+#include <algorithm>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <thread>
 
 #include "CVObjectDetection.h"
 #include "Exceptions.h"
@@ -25,6 +27,16 @@ using namespace std;
 using namespace openshot;
 using google::protobuf::util::TimeUtil;
 
+namespace {
+    // Set the number of threads used by OpenCV (which is global to the process) until the end of a scope
+    struct ScopedNumThreads {
+        int previousThreads;
+
+        ScopedNumThreads(int threads) : previousThreads(cv::getNumThreads()) { cv::setNumThreads(threads); }
+        ~ScopedNumThreads() { cv::setNumThreads(previousThreads); }
+    };
+}
+
 CVObjectDetection::CVObjectDetection(std::string processInfoJson, ProcessingController &processingController)
 : processingController(&processingController), processingDevice("CPU"){
     SetJson(processInfoJson);
@@ -66,64 +78,203 @@ void CVObjectDetection::detectObjectsClip(openshot::Clip &video, size_t _start,
         return;
     net = cv::dnn::readNetFromDarknet(modelConfiguration, modelWeights);
     setProcessingDevice();
+    outputNames = getOutputsNames(net);
 
-    size_t frame_number;
     if(!process_interval || end <= 1 || end-start == 0){
         // Get total number of frames in video
         start = (int)(video.Start() * video.Reader()->info.fps.ToFloat());
         end = (int)(video.End() * video.Reader()->info.fps.ToFloat());
     }
 
-    for (frame_number = start; frame_number <= end; frame_number++)
-    {
-         // Stop the feature tracker process
-        if(processingController->ShouldStop()){
-            return;
-        }
+    // Use the cores which are not busy decoding or postprocessing for inference. The number of OpenCV threads is
+    // global to the process, so it's restored when detection ends (even if a stage throws)
+    int threads = dnnThreads;
+    if(threads <= 0)
+        threads = std::max(1, (int)std::thread::hardware_concurrency() - 2);
+    ScopedNumThreads scopedThreads(threads);
+
+    // Queues between the stages of the pipeline (2 batches of frames in front of each stage). The frames to decode
+    // depend on the tracker (see detectionStep), so with a detection interval, decoding only runs 1 batch ahead of
+    // each stage (or frames which are queued would skip frames after the tracker stops being reliable)
+    int queuedBatches = detectionInterval > 1 ? 1 : 2;
+    BlockingQueue<DecodedFrame> decoded(queuedBatches * batchSize);
+    BlockingQueue<FrameBatch> batches(queuedBatches);
+    BlockingQueue<FrameOutputs> outputs(queuedBatches * batchSize);
+    pipelineError = nullptr;
+    detectionStep = 1;
+
+    std::thread decodeThread(&CVObjectDetection::decodeFrames, this, std::ref(video), std::ref(decoded));
+    std::thread preprocessThread(&CVObjectDetection::preprocessFrames, this, std::ref(decoded), std::ref(batches));
+    std::thread postprocessThread(&CVObjectDetection::postprocessFrames, this, std::ref(outputs));
+    inferBatches(batches, outputs);
+
+    decodeThread.join();
+    preprocessThread.join();
+    postprocessThread.join();
+
+    if(pipelineError)
+        std::rethrow_exception(pipelineError);
+}
+
+// Get each frame of the clip which needs detection (decode stage)
+void CVObjectDetection::decodeFrames(openshot::Clip &video, BlockingQueue<DecodedFrame> &decoded)
+{
+    try {
+        for (size_t frame_number = start; frame_number <= end; )
+        {
+            // Stop the object detection process
+            if(processingController->ShouldStop())
+                break;
 
-        std::shared_ptr<openshot::Frame> f = video.GetFrame(frame_number);
+            if(!decoded.Push(DecodedFrame{frame_number, video.GetFrame(frame_number)}))
+                break;
 
-        // Grab OpenCV Mat image
-        cv::Mat cvimage = f->GetImageCV();
+            // Skip the frames between detections (which are predicted by the tracker), but always detect the last frame
+            if(frame_number == end)
+                break;
+            frame_number = std::min(end, frame_number + std::max(1, detectionStep.load()));
+        }
+    } catch (...) {
+        setPipelineError(std::current_exception());
+    }
+    decoded.Close();
+}
 
-        DetectObjects(cvimage, frame_number);
+// Convert batches of frames into 4D blobs (preprocessing stage)
+void CVObjectDetection::preprocessFrames(BlockingQueue<DecodedFrame> &decoded, BlockingQueue<FrameBatch> &batches)
+{
+    // Input size of the network
+    int inpWidth, inpHeight;
+    inpWidth = inpHeight = 416;
 
-        // Update progress
-        processingController->SetProgress(uint(100*(frame_number-start)/(end-start)));
+    try {
+        bool isDecoding = true;
+        while (isDecoding)
+        {
+            FrameBatch batch;
+            std::vector<cv::Mat> images;
+            DecodedFrame decodedFrame;
+            while ((int)images.size() < batchSize && (isDecoding = decoded.Pop(decodedFrame))) {
+                // Grab OpenCV Mat image
+                images.push_back(decodedFrame.frame->GetImageCV());
+                batch.frameIds.push_back(decodedFrame.frameId);
+                batch.frameSizes.push_back(images.back().size());
+            }
+            if(images.empty())
+                break;
 
+            // Create a 4D blob from the frames
+            cv::dnn::blobFromImages(images, batch.blob, 1/255.0, cv::Size(inpWidth, inpHeight), cv::Scalar(0,0,0), true, false);
+            if(!batches.Push(std::move(batch)))
+                break;
+        }
+    } catch (...) {
+        setPipelineError(std::current_exception());
     }
+    decoded.Close();
+    batches.Close();
 }
 
-void CVObjectDetection::DetectObjects(const cv::Mat &frame, size_t frameId){
-    // Get frame as OpenCV Mat
-    cv::Mat blob;
+// Run the network on batches of frames (inference stage)
+void CVObjectDetection::inferBatches(BlockingQueue<FrameBatch> &batches, BlockingQueue<FrameOutputs> &outputs)
+{
+    try {
+        FrameBatch batch;
+        while (batches.Pop(batch))
+        {
+            // Stop the object detection process
+            if(processingController->ShouldStop())
+                break;
+
+            //Sets the input to the network
+            net.setInput(batch.blob);
+
+            // Runs the forward pass to get output of the output layers
+            std::vector<cv::Mat> outs;
+            net.forward(outs, outputNames);
+
+            // Split the outputs of each frame
+            size_t batchFrames = batch.frameIds.size();
+            std::vector<std::vector<cv::Mat>> frameOuts = splitBatchOutputs(outs, batchFrames);
+
+            bool isOpen = true;
+            for (size_t i = 0; i < batchFrames && isOpen; i++)
+                isOpen = outputs.Push(FrameOutputs{batch.frameIds[i], batch.frameSizes[i], std::move(frameOuts[i])});
+            if(!isOpen)
+                break;
+        }
+    } catch (...) {
+        setPipelineError(std::current_exception());
+    }
+    batches.Close();
+    outputs.Close();
+}
 
-    // Create a 4D blob from the frame.
-    int inpWidth, inpHeight;
-    inpWidth = inpHeight = 416;
+// Split the network outputs of a batch into the outputs of each frame
+std::vector<std::vector<cv::Mat>> CVObjectDetection::splitBatchOutputs(const std::vector<cv::Mat> &outs, size_t batchFrames)
+{
+    std::vector<std::vector<cv::Mat>> frameOuts(batchFrames);
+    for (auto &out : outs) {
+        // Each output has a row per detected box (of every frame, grouped by frame), so N-dimensional outputs are
+        // flattened into rows of the last dimension
+        cv::Mat rows = out.reshape(1, (int)(out.total() / out.size[out.dims - 1]));
+        int frameRows = rows.rows / (int)batchFrames;
+        for (size_t i = 0; i < batchFrames; i++)
+            frameOuts[i].push_back(rows.rowRange((int)i * frameRows, ((int)i + 1) * frameRows));
+    }
+    return frameOuts;
+}
 
-    cv::dnn::blobFromImage(frame, blob, 1/255.0, cv::Size(inpWidth, inpHeight), cv::Scalar(0,0,0), true, false);
+// Remove low confidence boxes and track objects, in frame order (postprocessing stage)
+void CVObjectDetection::postprocessFrames(BlockingQueue<FrameOutputs> &outputs)
+{
+    try {
+        FrameOutputs frameOutputs;
+        size_t nextFrameId = start;
+        while (outputs.Pop(frameOutputs))
+        {
+            postprocessFrame(frameOutputs, nextFrameId);
 
-    //Sets the input to the network
-    net.setInput(blob);
+            // Update progress
+            processingController->SetProgress(end > start ? uint(100*(frameOutputs.frameId-start)/(end-start)) : 100);
+        }
+    } catch (...) {
+        setPipelineError(std::current_exception());
+    }
+    outputs.Close();
+}
 
-    // Runs the forward pass to get output of the output layers
-    std::vector<cv::Mat> outs;
-    net.forward(outs, getOutputsNames(net));
+// Track the objects of a frame, after filling the frames since the previous frame with predicted positions
+void CVObjectDetection::postprocessFrame(const FrameOutputs &frameOutputs, size_t &nextFrameId)
+{
+    // Fill the frames between detections with the positions predicted by the tracker
+    for (size_t frameId = nextFrameId; frameId < frameOutputs.frameId; frameId++) {
+        sort.predict(frameId);
+        storeTrackedObjects(frameOutputs.frameSize, frameId);
+    }
+    nextFrameId = frameOutputs.frameId + 1;
 
     // Remove the bounding boxes with low confidence
-    postprocess(frame.size(), outs, frameId);
+    bool isReliable = postprocess(frameOutputs.frameSize, frameOutputs.outs, frameOutputs.frameId);
 
+    // Detect every frame while the tracker is not reliable, and then skip more frames (up to the detection interval)
+    detectionStep = isReliable ? std::min(2 * detectionStep.load(), detectionInterval) : 1;
 }
 
+// Keep the first error thrown by a stage of the pipeline
+void CVObjectDetection::setPipelineError(std::exception_ptr stageError)
+{
+    const std::lock_guard<std::mutex> lock(pipelineMutex);
+    if(!pipelineError)
+        pipelineError = stageError;
+}
 
 // Remove the bounding boxes with low confidence using non-maxima suppression
-void CVObjectDetection::postprocess(const cv::Size &frameDims, const std::vector<cv::Mat>& outs, size_t frameId)
+bool CVObjectDetection::postprocess(const cv::Size &frameDims, const std::vector<cv::Mat>& outs, size_t frameId)
 {
     std::vector<int> classIds;
     std::vector<float> confidences;
     std::vector<cv::Rect> boxes;
-    std::vector<int> objectIds;
 
     for (size_t i = 0; i < outs.size(); ++i)
     {
@@ -163,10 +314,31 @@ void CVObjectDetection::postprocess(const cv::Size &frameDims, const std::vector
     std::vector<cv::Rect> sortBoxes;
     for(auto box : boxes)
         sortBoxes.push_back(box);
+    bool wasTracking = !sort.trackers.empty();
     sort.update(sortBoxes, frameId, sqrt(pow(frameDims.width,2) + pow(frameDims.height, 2)), confidences, classIds);
 
-    // Clear data vectors
-    boxes.clear(); confidences.clear(); classIds.clear(); objectIds.clear();
+    // Save the tracked objects of this frame
+    storeTrackedObjects(frameDims, frameId);
+
+    // The tracker is reliable if it predicted every detected object (no new objects), close to its detected position
+    bool isReliable = wasTracking && sort.unmatchedDetections.empty();
+    if(isReliable && !sort.matchedPairs.empty()){
+        double predictionError = 0.0;
+        for(auto pair : sort.matchedPairs)
+            predictionError += sort.centroid_dist_matrix[pair.x][pair.y];
+        isReliable = predictionError / sort.matchedPairs.size() < sort.max_centroid_dist_norm / 2;
+    }
+    return isReliable;
+}
+
+// Save the objects tracked by SORT on a frame (removing duplicated boxes)
+void CVObjectDetection::storeTrackedObjects(const cv::Size &frameDims, size_t frameId)
+{
+    std::vector<int> classIds;
+    std::vector<float> confidences;
+    std::vector<cv::Rect> boxes;
+    std::vector<int> objectIds;
+
     // Get SORT predicted boxes
     for(auto TBox : sort.frameTrackingResult){
         if(TBox.frame == frameId){
@@ -327,9 +499,6 @@ bool CVObjectDetection::SaveObjDetectedData(){
         }
     }
 
-    // Delete all global objects allocated by libprotobuf.
-    google::protobuf::ShutdownProtobufLibrary();
-
     return true;
 
 }
@@ -383,6 +552,15 @@ void CVObjectDetection::SetJsonValue(const Json::Value root) {
     if (!root["processing-device"].isNull()){
 		processingDevice = (root["processing-device"].asString());
 	}
+    if (!root["detection-interval"].isNull()){
+		detectionInterval = std::max(1, root["detection-interval"].asInt());
+	}
+    if (!root["batch-size"].isNull()){
+		batchSize = std::max(1, root["batch-size"].asInt());
+	}
+    if (!root["dnn-threads"].isNull()){
+		dnnThreads = root["dnn-threads"].asInt();
+	}
     if (!root["model-config"].isNull()){
 		modelConfiguration = (root["model-config"].asString());
         std::ifstream infile(modelConfiguration);
@@ -419,6 +597,14 @@ void CVObjectDetection::SetJsonValue(const Json::Value root) {
 ||||||||||||||||||||||||||||||||||||||||||||||||||
 */
 
+// Postprocess the network outputs of a frame, and get the number of frames to the next detection
+int CVObjectDetection::_PostprocessFrame(size_t frameId, const cv::Size &frameSize, const std::vector<cv::Mat> &outs){
+    // The frames after the last postprocessed frame are predicted
+    size_t nextFrameId = detectionsData.empty() ? frameId : detectionsData.rbegin()->first + 1;
+    postprocessFrame(FrameOutputs{frameId, frameSize, outs}, nextFrameId);
+    return detectionStep;
+}
+
 // Load protobuf data file
 bool CVObjectDetection::_LoadObjDetectdData(){
     // Create tracker message
@@ -478,8 +664,5 @@ bool CVObjectDetection::_LoadObjDetectdData(){
         detectionsData[id] = CVDetectionData(classIds, confidences, boxes, id, objectIds);
     }
 
-    // Delete all global objects allocated by libprotobuf.
-    google::protobuf::ShutdownProtobufLibrary();
-
     return true;
 }
@@ -23,6 +23,11 @@
 #include "Json.h"
 #include "ProcessingController.h"
 #include "Clip.h"
+#include "BlockingQueue.h"
+
+#include <atomic>
+#include <exception>
+#include <mutex>
 
 #include "sort_filter/sort.hpp"
 
@@ -59,7 +64,21 @@ namespace openshot
     /**
      * @brief This class runs trought a clip to detect objects and returns the bounding boxes and its properties.
      *
-     * Object detection is performed using YoloV3 model with OpenCV DNN module
+     * Object detection is performed using YoloV3 model with OpenCV DNN module. Frames go through a pipeline,
+     * so decoding, preprocessing, inference and postprocessing overlap:
+     *
+     * - A decode thread gets the frames of the clip.
+     * - A preprocessing thread converts batches of frames into a 4D blob (with cv::dnn::blobFromImages).
+     * - The calling thread runs inference on each batch (a single forward pass for "batch-size" frames).
+     * - A postprocessing thread runs NMS and the SORT tracker on each frame (in order).
+     *
+     * With a "detection-interval" of K (greater than 1), inference only runs on every Kth frame, and the objects
+     * of the frames in between are predicted by the SORT tracker (its Kalman filters). While the tracker is not
+     * reliable (new objects are detected, or objects are far from their predicted position), every frame is
+     * detected again, and then the interval doubles (up to K) after each reliable detection.
+     *
+     * @note The number of threads of OpenCV ("dnn-threads") is global to the process, so it also applies to any
+     * other OpenCV processing which runs at the same time. It's restored once detectObjectsClip() returns.
      */
     class CVObjectDetection{
 
@@ -84,18 +103,62 @@ namespace openshot
 
         bool error = false;
 
+        int batchSize = 4; ///< Number of frames in each forward pass of the network
+        int detectionInterval = 1; ///< Max number of frames between detections (the frames in between are predicted by the tracker)
+        std::atomic<int> detectionStep{1}; ///< Current number of frames between detections (set by the postprocessing stage)
+        int dnnThreads = 0; ///< Number of threads used by OpenCV (set for the whole process while detecting, 0 = all cores not used by other stages)
+        std::vector<cv::String> outputNames;
+
+        // A frame which was decoded (waiting for preprocessing)
+        struct DecodedFrame {
+            size_t frameId;
+            std::shared_ptr<openshot::Frame> frame;
+        };
+
+        // A batch of preprocessed frames (waiting for inference)
+        struct FrameBatch {
+            std::vector<size_t> frameIds;
+            std::vector<cv::Size> frameSizes;
+            cv::Mat blob;
+        };
+
+        // The network outputs of a frame (waiting for postprocessing)
+        struct FrameOutputs {
+            size_t frameId;
+            cv::Size frameSize;
+            std::vector<cv::Mat> outs;
+        };
+
+        // The first error thrown by a stage of the pipeline
+        std::mutex pipelineMutex;
+        std::exception_ptr pipelineError;
+
         /// Will handle a Thread safely comutication between ClipProcessingJobs and the processing effect classes
         ProcessingController *processingController;
 
         void setProcessingDevice();
 
-        // Detect onbects on a single frame
-        void DetectObjects(const cv::Mat &frame, size_t frame_number);
+        // Stages of the detection pipeline
+        void decodeFrames(openshot::Clip &video, BlockingQueue<DecodedFrame> &decoded);
+        void preprocessFrames(BlockingQueue<DecodedFrame> &decoded, BlockingQueue<FrameBatch> &batches);
+        void inferBatches(BlockingQueue<FrameBatch> &batches, BlockingQueue<FrameOutputs> &outputs);
+        void postprocessFrames(BlockingQueue<FrameOutputs> &outputs);
+
+        // Track the objects of a frame (and predict the frames from nextFrameId to the frame), and set the
+        // number of frames to the next detection
+        void postprocessFrame(const FrameOutputs &frameOutputs, size_t &nextFrameId);
+
+        // Keep the first error thrown by a stage of the pipeline
+        void setPipelineError(std::exception_ptr stageError);
 
         bool iou(cv::Rect pred_box, cv::Rect sort_box);
 
-        // Remove the bounding boxes with low confidence using non-maxima suppression
-        void postprocess(const cv::Size &frameDims, const std::vector<cv::Mat>& out, size_t frame_number);
+        // Remove the bounding boxes with low confidence using non-maxima suppression, and track the objects
+        // (returns true if the tracker predicted the detected objects)
+        bool postprocess(const cv::Size &frameDims, const std::vector<cv::Mat>& out, size_t frame_number);
+
+        // Save the objects tracked by SORT on a frame
+        void storeTrackedObjects(const cv::Size &frameDims, size_t frame_number);
 
         // Get the names of the output layers
         std::vector<cv::String> getOutputsNames(const cv::dnn::Net& net);
@@ -104,6 +167,12 @@ namespace openshot
 
         std::map<size_t, CVDetectionData> detectionsData;
 
+        /// @brief Split the network outputs of a batch into the outputs of each frame
+        /// @param outs The outputs of the network (the rows of each output are grouped by frame)
+        /// @param batchFrames The number of frames in the batch
+        /// @returns The outputs of each frame (which share the data of the batch outputs)
+        static std::vector<std::vector<cv::Mat>> splitBatchOutputs(const std::vector<cv::Mat> &outs, size_t batchFrames);
+
         CVObjectDetection(std::string processInfoJson, ProcessingController &processingController);
 
         // Iterate over a clip object and run inference for each video frame
@@ -123,6 +192,10 @@ namespace openshot
 
         // Load protobuf file (ONLY FOR MAKE TEST)
         bool _LoadObjDetectdData();
+
+        // Postprocess the network outputs of a frame, as the pipeline does, and get the number of frames to
+        // the next detection (ONLY FOR MAKE TEST)
+        int _PostprocessFrame(size_t frameId, const cv::Size &frameSize, const std::vector<cv::Mat> &outs);
     };
 
 }
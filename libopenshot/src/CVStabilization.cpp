@@ -11,12 +11,16 @@
 //
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
+#include <algorithm>
+#include <exception>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <thread>
 
 #include "CVStabilization.h"
 #include "Exceptions.h"
+#include "FrameMapper.h"
 
 #include "stabilizedata.pb.h"
 #include <google/protobuf/util/time_util.h>
@@ -33,6 +37,42 @@ CVStabilization::CVStabilization(std::string processInfoJson, ProcessingControll
     end = 1;
 }
 
+// Max number of segments analysed in parallel by default (each one decodes its own copy of the clip)
+static const size_t MAX_DEFAULT_WORKERS = 4;
+
+// Can a clip be copied with its own reader (only readers of files decode the same frames once they are
+// created again from their JSON, e.g. a DummyReader loses the frames of its cache)
+static bool CanCopyClip(openshot::Clip& video){
+    Json::Value reader = video.JsonValue()["reader"];
+    if(reader["type"].asString() == "FrameMapper")
+        reader = reader["reader"];
+    std::string type = reader["type"].asString();
+    return type == "FFmpegReader" || type == "QtImageReader" || type == "ImageReader" || type == "ChunkReader";
+}
+
+// Create a copy of a clip with its own reader (so several threads can decode frames at the same time)
+static void CopyClip(openshot::Clip& video, std::unique_ptr<openshot::Clip>& copy, std::unique_ptr<openshot::FrameMapper>& mapper){
+    Json::Value root = video.JsonValue();
+
+    // Clips on a timeline are mapped to its frame rate (so the copy maps its reader in the same way)
+    openshot::FrameMapper* videoMapper = nullptr;
+    if(root["reader"]["type"].asString() == "FrameMapper"){
+        videoMapper = static_cast<openshot::FrameMapper*>(video.Reader());
+        root["reader"] = root["reader"]["reader"];
+    }
+
+    copy.reset(new openshot::Clip());
+    copy->SetJsonValue(root);
+    if(videoMapper){
+        mapper.reset(new openshot::FrameMapper(copy->Reader(), videoMapper->info.fps, openshot::PULLDOWN_NONE,
+                                               videoMapper->info.sample_rate, videoMapper->info.channels,
+                                               videoMapper->info.channel_layout));
+        copy->Reader(mapper.get());
+    }
+    copy->ParentTimeline(video.ParentTimeline());
+    copy->Open();
+}
+
 // Process clip and store necessary stabilization data
 void CVStabilization::stabilizeClip(openshot::Clip& video, size_t _start, size_t _end, bool process_interval){
 
@@ -44,41 +84,83 @@ void CVStabilization::stabilizeClip(openshot::Clip& video, size_t _start, size_t
     start = _start; end = _end;
     // Compute max and average transformation parameters
     avr_dx=0; avr_dy=0; avr_da=0; max_dx=0; max_dy=0; max_da=0;
+    prev_to_cur_transform.clear();
 
     video.Open();
     // Save original video width and height
-    cv::Size readerDims(video.Reader()->info.width, video.Reader()->info.height);
+    readerDims = cv::Size(video.Reader()->info.width, video.Reader()->info.height);
+
+    // Analyse frames at a smaller size (if requested)
+    analysisDims = readerDims;
+    if(analysisWidth > 0 && analysisWidth < readerDims.width)
+        analysisDims = cv::Size(analysisWidth, std::max(1, (int)round((double)readerDims.height * analysisWidth / readerDims.width)));
 
-    size_t frame_number;
     if(!process_interval || end <= 1 || end-start == 0){
         // Get total number of frames in video
         start = (int)(video.Start() * video.Reader()->info.fps.ToFloat()) + 1;
         end = (int)(video.End() * video.Reader()->info.fps.ToFloat()) + 1;
     }
 
-    // Extract and track opticalflow features for each frame
-    for (frame_number = start; frame_number <= end; frame_number++)
-    {
-        // Stop the feature tracker process
-        if(processingController->ShouldStop()){
-            return;
-        }
+    // Split the frames into contiguous segments (of at least 30 frames), one for each worker (clips which
+    // can't be copied are analysed by a single worker)
+    size_t totalFrames = end - start + 1;
+    size_t workers = threads > 0 ? threads : std::min<size_t>(MAX_DEFAULT_WORKERS, std::max(1u, std::thread::hardware_concurrency()));
+    workers = std::max<size_t>(1, std::min(workers, totalFrames / 30));
+    if(workers > 1 && !CanCopyClip(video))
+        workers = 1;
+    std::vector<Segment> segments(workers);
+    for(size_t i = 0; i < workers; i++){
+        segments[i].first = start + i * totalFrames / workers;
+        segments[i].last = start + (i + 1) * totalFrames / workers - 1;
+    }
 
-        std::shared_ptr<openshot::Frame> f = video.GetFrame(frame_number);
+    // Extract and track opticalflow features for each segment (the first segment uses the clip, and the
+    // others use a copy of the clip)
+    processedFrames = 0;
+    std::vector<std::exception_ptr> errors(workers);
+    std::vector<std::thread> workerThreads;
+    for(size_t i = 1; i < workers; i++){
+        workerThreads.emplace_back([this, &video, &segments, &errors, i](){
+            try {
+                // The mapper is deleted before the clip (which deletes the reader of the mapper)
+                std::unique_ptr<openshot::Clip> copy;
+                std::unique_ptr<openshot::FrameMapper> mapper;
+                CopyClip(video, copy, mapper);
+                AnalyzeSegment(*copy, segments[i]);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    try {
+        AnalyzeSegment(video, segments[0]);
+    } catch (...) {
+        errors[0] = std::current_exception();
+    }
+    for(auto &workerThread : workerThreads)
+        workerThread.join();
 
-        // Grab OpenCV Mat image
-        cv::Mat cvimage = f->GetImageCV();
-        // Resize frame to original video width and height if they differ
-        if(cvimage.size().width != readerDims.width || cvimage.size().height != readerDims.height)
-            cv::resize(cvimage, cvimage, cv::Size(readerDims.width, readerDims.height));
-        cv::cvtColor(cvimage, cvimage, cv::COLOR_RGB2GRAY);
+    for(auto &segmentError : errors)
+        if(segmentError)
+            std::rethrow_exception(segmentError);
 
-        if(!TrackFrameFeatures(cvimage, frame_number)){
-            prev_to_cur_transform.push_back(TransformParam(0, 0, 0));
-        }
+    // Stop the feature tracker process
+    if(processingController->ShouldStop()){
+        return;
+    }
 
-        // Update progress
-        processingController->SetProgress(uint(100*(frame_number-start)/(end-start)));
+    // Merge the transformations of all segments
+    for(auto &segment : segments){
+        prev_to_cur_transform.insert(prev_to_cur_transform.end(), segment.prev_to_cur_transform.begin(), segment.prev_to_cur_transform.end());
+        avr_dx += segment.avr_dx;
+        avr_dy += segment.avr_dy;
+        avr_da += segment.avr_da;
+        if(fabs(segment.max_dx) > fabs(max_dx))
+            max_dx = segment.max_dx;
+        if(fabs(segment.max_dy) > fabs(max_dy))
+            max_dy = segment.max_dy;
+        if(fabs(segment.max_da) > fabs(max_da))
+            max_da = segment.max_da;
     }
 
     // Calculate trajectory data
@@ -102,28 +184,95 @@ void CVStabilization::stabilizeClip(openshot::Clip& video, size_t _start, size_t
     }
 }
 
+// Find the transformations of a segment of frames (and the frame before it)
+void CVStabilization::AnalyzeSegment(openshot::Clip& video, Segment &segment){
+    // Find the frame before the segment which the first frame of the segment is tracked from (only to find
+    // the motion into the first frame). When the frames are analysed in order, a frame only becomes the
+    // previous frame if it is tracked from the frame before it, so black frames, frames with no features and
+    // frames with too much motion are skipped. Walking back, a frame is used once it is tracked from the
+    // nearest earlier (not black) frame, or if it is the first frame which isn't black. This assumes the
+    // earlier frame was itself tracked, so a frame after a long run of untracked frames can still differ.
+    if(segment.first > start){
+        cv::Mat candidate;
+        size_t candidate_number = 0;
+        for(size_t frame_number = segment.first; frame_number-- > start; ){
+            if(processingController->ShouldStop())
+                return;
+            cv::Mat grey = GreyFrame(video.GetFrame(frame_number));
+            if(cv::countNonZero(grey) < 1)
+                continue;
+            if(!candidate.empty()){
+                Segment probe;
+                probe.prev_grey = grey;
+                if(TrackFrameFeatures(candidate, candidate_number, probe)){
+                    segment.last_T = probe.last_T;
+                    break;
+                }
+            }
+            candidate = grey;
+            candidate_number = frame_number;
+        }
+        segment.prev_grey = candidate;
+    }
+
+    for (size_t frame_number = segment.first; frame_number <= segment.last; frame_number++)
+    {
+        // Stop the feature tracker process
+        if(processingController->ShouldStop()){
+            return;
+        }
+
+        if(!TrackFrameFeatures(GreyFrame(video.GetFrame(frame_number)), frame_number, segment)){
+            segment.prev_to_cur_transform.push_back(TransformParam(0, 0, 0));
+        }
+
+        // Update progress
+        size_t processed = ++processedFrames;
+        processingController->SetProgress(uint(100*processed/(end-start+1)));
+    }
+}
+
+// Convert a frame to a grey image (at the analysis size)
+cv::Mat CVStabilization::GreyFrame(std::shared_ptr<openshot::Frame> frame){
+    // The RGBA pixels are converted as BGRA, which gives the same grey levels as the BGR image of
+    // GetImageCV() converted with COLOR_RGB2GRAY (without copying the image twice)
+    std::shared_ptr<QImage> image = frame->GetImage();
+    cv::Mat rgba(image->height(), image->width(), CV_8UC4, (uchar*)image->constBits(), image->bytesPerLine());
+    cv::Mat grey;
+    cv::cvtColor(rgba, grey, cv::COLOR_BGRA2GRAY);
+
+    // Resize frame to the analysis width and height if they differ
+    if(grey.size() != analysisDims)
+        cv::resize(grey, grey, analysisDims, 0, 0, grey.cols > analysisDims.width ? cv::INTER_AREA : cv::INTER_LINEAR);
+    return grey;
+}
+
 // Track current frame features and find the relative transformation
-bool CVStabilization::TrackFrameFeatures(cv::Mat frame, size_t frameNum){
+bool CVStabilization::TrackFrameFeatures(cv::Mat frame, size_t frameNum, Segment &segment){
     // Check if there are black frames
     if(cv::countNonZero(frame) < 1){
         return false;
     }
 
     // Initialize prev_grey if not
-    if(prev_grey.empty()){
-        prev_grey = frame;
+    if(segment.prev_grey.empty()){
+        segment.prev_grey = frame;
         return true;
     }
 
+    // Scale of the analysed frames (features are spaced as they would be in the full size frames)
+    double scale_x = (double)readerDims.width / analysisDims.width;
+    double scale_y = (double)readerDims.height / analysisDims.height;
+
     // OpticalFlow features vector
     std::vector <cv::Point2f> prev_corner, cur_corner;
     std::vector <cv::Point2f> prev_corner2, cur_corner2;
     std::vector <uchar> status;
     std::vector <float> err;
     // Extract new image features
-    cv::goodFeaturesToTrack(prev_grey, prev_corner, 200, 0.01, 30);
+    cv::goodFeaturesToTrack(segment.prev_grey, prev_corner, 200, 0.01, std::max(1.0, 30 / scale_x));
     // Track features
-    cv::calcOpticalFlowPyrLK(prev_grey, frame, prev_corner, cur_corner, status, err);
+    cv::calcOpticalFlowPyrLK(segment.prev_grey, frame, prev_corner, cur_corner, status, err);
     // Remove untracked features
     for(size_t i=0; i < status.size(); i++) {
         if(status[i]) {
@@ -133,7 +282,7 @@ bool CVStabilization::TrackFrameFeatures(cv::Mat frame, size_t frameNum){
     }
     // In case no feature was detected
     if(prev_corner2.empty() || cur_corner2.empty()){
-        last_T = cv::Mat();
+        segment.last_T = cv::Mat();
         // prev_grey = cv::Mat();
         return false;
     }
@@ -149,14 +298,14 @@ bool CVStabilization::TrackFrameFeatures(cv::Mat frame, size_t frameNum){
     else{
         // If no transformation is found, just use the last known good transform
         if(T.data == NULL){
-            if(!last_T.empty())
-                last_T.copyTo(T);
+            if(!segment.last_T.empty())
+                segment.last_T.copyTo(T);
             else
                 return false;
         }
-        // Decompose T
-        dx = T.at<double>(0,2);
-        dy = T.at<double>(1,2);
+        // Decompose T (and scale the translation to the size of the video)
+        dx = T.at<double>(0,2) * scale_x;
+        dy = T.at<double>(1,2) * scale_y;
         da = atan2(T.at<double>(1,0), T.at<double>(0,0));
     }
 
@@ -166,20 +315,20 @@ bool CVStabilization::TrackFrameFeatures(cv::Mat frame, size_t frameNum){
     }
 
     // Keep computing average and max transformation parameters
-    avr_dx+=fabs(dx);
-    avr_dy+=fabs(dy);
-    avr_da+=fabs(da);
-    if(fabs(dx) > max_dx)
-        max_dx = dx;
-    if(fabs(dy) > max_dy)
-        max_dy = dy;
-    if(fabs(da) > max_da)
-        max_da = da;
+    segment.avr_dx+=fabs(dx);
+    segment.avr_dy+=fabs(dy);
+    segment.avr_da+=fabs(da);
+    if(fabs(dx) > segment.max_dx)
+        segment.max_dx = dx;
+    if(fabs(dy) > segment.max_dy)
+        segment.max_dy = dy;
+    if(fabs(da) > segment.max_da)
+        segment.max_da = da;
 
-    T.copyTo(last_T);
+    T.copyTo(segment.last_T);
 
-    prev_to_cur_transform.push_back(TransformParam(dx, dy, da));
-    frame.copyTo(prev_grey);
+    segment.prev_to_cur_transform.push_back(TransformParam(dx, dy, da));
+    frame.copyTo(segment.prev_grey);
 
     return true;
 }
@@ -288,9 +437,6 @@ bool CVStabilization::SaveStabilizedData(){
         return false;
     }
 
-    // Delete all global objects allocated by libprotobuf.
-    google::protobuf::ShutdownProtobufLibrary();
-
     return true;
 }
 
@@ -362,6 +508,12 @@ void CVStabilization::SetJsonValue(const Json::Value root) {
     if (!root["smoothing-window"].isNull()){
 		smoothingWindow = (root["smoothing-window"].asInt());
 	}
+	if (!root["threads"].isNull()){
+		threads = (root["threads"].asInt());
+	}
+	if (!root["analysis-width"].isNull()){
+		analysisWidth = (root["analysis-width"].asInt());
+	}
 }
 
 /*
@@ -410,8 +562,5 @@ bool CVStabilization::_LoadStabilizedData(){
         transformationData[id] = TransformParam(dx,dy,da);
     }
 
-    // Delete all global objects allocated by libprotobuf.
-    google::protobuf::ShutdownProtobufLibrary();
-
     return true;
 }
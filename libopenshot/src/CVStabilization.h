@@ -21,7 +21,9 @@
 #undef uint64
 #undef int64
 
+#include <atomic>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -71,6 +73,13 @@ struct CamTrajectory
  *
  * The relative motion between two consecutive frames is computed to obtain the global camera trajectory.
  * The camera trajectory is then smoothed to reduce jittering.
+ *
+ * The frames are split into contiguous segments, which are analysed in parallel ("threads" workers, where
+ * 0 uses up to 4 cores). Each worker decodes its own copy of the clip, starting with the frame before its
+ * segment (so the motion into its first frame is also found), and the transformations of all segments are
+ * merged before the trajectory is computed. Clips which can't be copied (such as clips of a DummyReader,
+ * whose frames are not in its JSON) are analysed by a single worker. Frames can be analysed at a smaller
+ * size ("analysis-width", in pixels), and the transformations are scaled back to the size of the video.
  */
 class CVStabilization {
 
@@ -82,11 +91,25 @@ class CVStabilization {
     size_t end;
     double avr_dx, avr_dy, avr_da, max_dx, max_dy, max_da;
 
-    cv::Mat last_T;
-    cv::Mat prev_grey;
     std::vector <TransformParam> prev_to_cur_transform; // Previous to current
     std::string protobuf_data_path;
 
+    int threads = 0; // Number of segments analysed in parallel (0 = number of cores, up to 4)
+    int analysisWidth = 0; // Width of the frames which are analysed (0 = width of the video)
+    cv::Size readerDims; // Size of the video
+    cv::Size analysisDims; // Size of the frames which are analysed
+    std::atomic<size_t> processedFrames;
+
+    // The transformations found for a contiguous segment of frames (by one worker)
+    struct Segment {
+        size_t first;
+        size_t last;
+        cv::Mat last_T;
+        cv::Mat prev_grey;
+        std::vector <TransformParam> prev_to_cur_transform;
+        double avr_dx = 0, avr_dy = 0, avr_da = 0, max_dx = 0, max_dy = 0, max_da = 0;
+    };
+
     uint progress;
     bool error = false;
 
@@ -94,7 +117,13 @@ class CVStabilization {
     ProcessingController *processingController;
 
     /// Track current frame features and find the relative transformation
-    bool TrackFrameFeatures(cv::Mat frame, size_t frameNum);
+    bool TrackFrameFeatures(cv::Mat frame, size_t frameNum, Segment &segment);
+
+    /// Find the transformations of a segment of frames (and the frame before it)
+    void AnalyzeSegment(openshot::Clip& video, Segment &segment);
+
+    /// Convert a frame to a grey image (at the analysis size)
+    cv::Mat GreyFrame(std::shared_ptr<openshot::Frame> frame);
 
     std::vector<CamTrajectory> ComputeFramesTrajectory();
     std::map<size_t,CamTrajectory> SmoothTrajectory(std::vector <CamTrajectory> &trajectory);
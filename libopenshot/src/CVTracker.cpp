@@ -11,7 +11,9 @@
 //
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
+#include <algorithm>
 #include <fstream>
+#include <future>
 #include <iomanip>
 #include <iostream>
 
@@ -54,7 +56,7 @@ cv::Ptr<OPENCV_TRACKER_TYPE> CVTracker::selectTracker(std::string trackerType){
     return nullptr;
 }
 
-// Track object in the hole clip or in a given interval
+// Track objects in the hole clip or in a given interval
 void CVTracker::trackClip(openshot::Clip& video, size_t _start, size_t _end, bool process_interval){
 
     video.Open();
@@ -77,7 +79,9 @@ void CVTracker::trackClip(openshot::Clip& video, size_t _start, size_t _end, boo
     }
 
     processingController->SetError(false, "");
-    bool trackerInit = false;
+
+    // Decode the first frame (and then each next frame while the current frame is tracked)
+    std::future<cv::Mat> nextFrame = std::async(std::launch::async, &CVTracker::loadFrame, this, std::ref(video), start);
 
     size_t frame;
     // Loop through video
@@ -90,45 +94,54 @@ void CVTracker::trackClip(openshot::Clip& video, size_t _start, size_t _end, boo
         }
 
         size_t frame_number = frame;
-        // Get current frame
-        std::shared_ptr<openshot::Frame> f = video.GetFrame(frame_number);
-
-        // Grab OpenCV Mat image
-        cv::Mat cvimage = f->GetImageCV();
+        // Get current frame (as an OpenCV Mat image)
+        cv::Mat cvimage = nextFrame.get();
+        if(frame < end)
+            nextFrame = std::async(std::launch::async, &CVTracker::loadFrame, this, std::ref(video), frame + 1);
 
         if(frame == start){
-            // Take the normalized inital bounding box and multiply to the current video shape
-            bbox = cv::Rect2d(int(bbox.x*cvimage.cols), int(bbox.y*cvimage.rows),
-                              int(bbox.width*cvimage.cols), int(bbox.height*cvimage.rows));
+            // Take the normalized inital bounding boxes and multiply to the current video shape
+            for(auto &target : targets)
+                target.bbox = cv::Rect2d(int(target.bbox.x*cvimage.cols), int(target.bbox.y*cvimage.rows),
+                                         int(target.bbox.width*cvimage.cols), int(target.bbox.height*cvimage.rows));
         }
 
-        // Pass the first frame to initialize the tracker
-        if(!trackerInit){
-
-            // Initialize the tracker
-            initTracker(cvimage, frame_number);
-
-            trackerInit = true;
-        }
-        else{
-            // Update the object tracker according to frame
-            trackerInit = trackFrame(cvimage, frame_number);
+        // Update the tracker of each object in parallel
+        cv::parallel_for_(cv::Range(0, (int)targets.size()), [&](const cv::Range &range){
+            for(int i = range.start; i < range.end; i++){
+                TrackedTarget &target = targets[i];
 
-            // Draw box on image
-            FrameData fd = GetTrackedData(frame_number);
+                // Pass the first frame to initialize the tracker
+                if(!target.initialized)
+                    target.initialized = initTracker(cvimage, frame_number, target);
+                else
+                    target.initialized = trackFrame(cvimage, frame_number, target);
+            }
+        });
 
-        }
         // Update progress
         processingController->SetProgress(uint(100*(frame_number-start)/(end-start)));
     }
 }
 
-// Initialize the tracker
-bool CVTracker::initTracker(cv::Mat &frame, size_t frameId){
+// Get a frame (at the pyramid level which is tracked)
+cv::Mat CVTracker::loadFrame(openshot::Clip& video, size_t frameId){
+    cv::Mat frame = video.GetFrame(frameId)->GetImageCV();
+    for(int level = 0; level < pyramidLevel; level++){
+        cv::Mat smaller;
+        cv::pyrDown(frame, smaller);
+        frame = smaller;
+    }
+    return frame;
+}
+
+// Initialize the tracker of an object
+bool CVTracker::initTracker(cv::Mat &frame, size_t frameId, TrackedTarget &target){
 
     // Create new tracker object
-    tracker = selectTracker(trackerType);
+    target.tracker = selectTracker(trackerType);
 
+    cv::Rect2d &bbox = target.bbox;
     // Correct if bounding box contains negative proportions (width and/or height < 0)
     if(bbox.width < 0){
         bbox.x = bbox.x - abs(bbox.width);
@@ -140,24 +153,24 @@ bool CVTracker::initTracker(cv::Mat &frame, size_t frameId){
     }
 
     // Initialize tracker
-    tracker->init(frame, bbox);
+    target.tracker->init(frame, bbox);
 
     float fw = frame.size().width;
     float fh = frame.size().height;
 
     // Add new frame data
-    trackedDataById[frameId] = FrameData(frameId, 0, (bbox.x)/fw,
-                                                     (bbox.y)/fh,
-                                                     (bbox.x+bbox.width)/fw,
-                                                     (bbox.y+bbox.height)/fh);
+    target.trackedDataById[frameId] = FrameData(frameId, 0, (bbox.x)/fw,
+                                                            (bbox.y)/fh,
+                                                            (bbox.x+bbox.width)/fw,
+                                                            (bbox.y+bbox.height)/fh);
 
     return true;
 }
 
 // Update the object tracker according to frame
-bool CVTracker::trackFrame(cv::Mat &frame, size_t frameId){
+bool CVTracker::trackFrame(cv::Mat &frame, size_t frameId, TrackedTarget &target){
     // Update the tracking result
-    bool ok = tracker->update(frame, bbox);
+    bool ok = target.tracker->update(frame, target.bbox);
 
     // Add frame number and box coords if tracker finds the object
     // Otherwise add only frame number
@@ -166,33 +179,36 @@ bool CVTracker::trackFrame(cv::Mat &frame, size_t frameId){
         float fw = frame.size().width;
         float fh = frame.size().height;
 
-        cv::Rect2d filtered_box = filter_box_jitter(frameId);
+        cv::Rect2d filtered_box = filter_box_jitter(frameId, &target - targets.data());
         // Add new frame data
-        trackedDataById[frameId] = FrameData(frameId, 0, (filtered_box.x)/fw,
-                                                         (filtered_box.y)/fh,
-                                                         (filtered_box.x+filtered_box.width)/fw,
-                                                         (filtered_box.y+filtered_box.height)/fh);
+        target.trackedDataById[frameId] = FrameData(frameId, 0, (filtered_box.x)/fw,
+                                                                (filtered_box.y)/fh,
+                                                                (filtered_box.x+filtered_box.width)/fw,
+                                                                (filtered_box.y+filtered_box.height)/fh);
     }
     else
     {
         // Copy the last frame data if the tracker get lost
-        trackedDataById[frameId] = trackedDataById[frameId-1];
+        target.trackedDataById[frameId] = target.trackedDataById[frameId-1];
     }
 
     return ok;
 }
 
-cv::Rect2d CVTracker::filter_box_jitter(size_t frameId){
+cv::Rect2d CVTracker::filter_box_jitter(size_t frameId, size_t objectIndex){
+    TrackedTarget &target = targets.at(objectIndex);
+
     // get tracked data for the previous frame
-    float last_box_width = trackedDataById[frameId-1].x2 - trackedDataById[frameId-1].x1;
-    float last_box_height = trackedDataById[frameId-1].y2 - trackedDataById[frameId-1].y1;
+    FrameData &last_box = target.trackedDataById[frameId-1];
+    float last_box_width = last_box.x2 - last_box.x1;
+    float last_box_height = last_box.y2 - last_box.y1;
 
-    float curr_box_width  = bbox.width;
-    float curr_box_height  = bbox.height;
+    float curr_box_width  = target.bbox.width;
+    float curr_box_height  = target.bbox.height;
     // keep the last width and height if the difference is less than 1%
     float threshold = 0.01;
 
-    cv::Rect2d filtered_box = bbox;
+    cv::Rect2d filtered_box = target.bbox;
     if(std::abs(1-(curr_box_width/last_box_width)) <= threshold){
         filtered_box.width = last_box_width;
     }
@@ -208,11 +224,19 @@ bool CVTracker::SaveTrackedData(){
     // Create tracker message
     pb_tracker::Tracker trackerMessage;
 
-    // Iterate over all frames data and save in protobuf message
-    for(std::map<size_t,FrameData>::iterator it=trackedDataById.begin(); it!=trackedDataById.end(); ++it){
-        FrameData fData = it->second;
-        pb_tracker::Frame* pbFrameData;
-        AddFrameDataToProto(trackerMessage.add_frame(), fData);
+    // Iterate over all frames data and save in protobuf message (the first object is saved in the frames
+    // of the message, and each other object is saved as an object of the message)
+    for(size_t objectIndex = 0; objectIndex < targets.size(); objectIndex++){
+        pb_tracker::Object* pbObject = nullptr;
+        if(objectIndex > 0){
+            pbObject = trackerMessage.add_object();
+            pbObject->set_id(objectIndex);
+        }
+
+        for(auto &it : targets[objectIndex].trackedDataById){
+            FrameData fData = it.second;
+            AddFrameDataToProto(objectIndex > 0 ? pbObject->add_frame() : trackerMessage.add_frame(), fData);
+        }
     }
 
     // Add timestamp
@@ -227,9 +251,6 @@ bool CVTracker::SaveTrackedData(){
         }
     }
 
-    // Delete all global objects allocated by libprotobuf.
-    google::protobuf::ShutdownProtobufLibrary();
-
     return true;
 
 }
@@ -249,16 +270,17 @@ void CVTracker::AddFrameDataToProto(pb_tracker::Frame* pbFrameData, FrameData& f
     box->set_y2(fData.y2);
 }
 
-// Get tracker info for the desired frame
-FrameData CVTracker::GetTrackedData(size_t frameId){
+// Get tracker info of an object for the desired frame
+FrameData CVTracker::GetTrackedData(size_t frameId, size_t objectIndex){
 
-    // Check if the tracker info for the requested frame exists
-    if ( trackedDataById.find(frameId) == trackedDataById.end() ) {
+    // Check if the tracker info for the requested object and frame exists
+    if ( objectIndex >= targets.size() ||
+         targets[objectIndex].trackedDataById.find(frameId) == targets[objectIndex].trackedDataById.end() ) {
 
         return FrameData();
     } else {
 
-        return trackedDataById[frameId];
+        return targets[objectIndex].trackedDataById[frameId];
     }
 
 }
@@ -291,16 +313,34 @@ void CVTracker::SetJsonValue(const Json::Value root) {
         trackerType = (root["tracker-type"].asString());
     }
 
-    if (!root["region"].isNull()){
-        double x = root["region"]["normalized_x"].asDouble();
-        double y = root["region"]["normalized_y"].asDouble();
-        double w = root["region"]["normalized_width"].asDouble();
-        double h = root["region"]["normalized_height"].asDouble();
-        cv::Rect2d prev_bbox(x,y,w,h);
-        bbox = prev_bbox;
+    if (!root["pyramid-level"].isNull()){
+        pyramidLevel = std::max(0, root["pyramid-level"].asInt());
+    }
 
-        if (!root["region"]["first-frame"].isNull()){
-            start = root["region"]["first-frame"].asInt64();
+    // Several objects are tracked with "regions" (and a single object with "region")
+    Json::Value regions(Json::arrayValue);
+    if (!root["regions"].isNull()){
+        regions = root["regions"];
+    }
+    else if (!root["region"].isNull()){
+        regions.append(root["region"]);
+    }
+
+    if (regions.size() > 0){
+        targets.clear();
+        for (const Json::Value &region : regions){
+            double x = region["normalized_x"].asDouble();
+            double y = region["normalized_y"].asDouble();
+            double w = region["normalized_width"].asDouble();
+            double h = region["normalized_height"].asDouble();
+            TrackedTarget target;
+            target.bbox = cv::Rect2d(x,y,w,h);
+            targets.push_back(target);
+        }
+
+        // Every object is tracked from the first frame of the first region
+        if (!regions[0u]["first-frame"].isNull()){
+            start = regions[0u]["first-frame"].asInt64();
             json_interval = true;
         }
         else{
@@ -338,30 +378,29 @@ bool CVTracker::_LoadTrackedData(){
         }
     }
 
-    // Make sure the trackedData is empty
-    trackedDataById.clear();
+    // Make sure the trackedData is empty (the first object is saved in the frames of the message)
+    targets.assign(trackerMessage.object_size() + 1, TrackedTarget());
 
-    // Iterate over all frames of the saved message
-    for (size_t i = 0; i < trackerMessage.frame_size(); i++) {
-        const pb_tracker::Frame& pbFrameData = trackerMessage.frame(i);
+    // Iterate over all frames of the saved objects
+    for (int objectIndex = 0; objectIndex <= trackerMessage.object_size(); objectIndex++) {
+        const auto &frames = objectIndex == 0 ? trackerMessage.frame() : trackerMessage.object(objectIndex-1).frame();
 
-        // Load frame and rotation data
-        size_t id = pbFrameData.id();
-        float rotation = pbFrameData.rotation();
+        for (const pb_tracker::Frame &pbFrameData : frames) {
+            // Load frame and rotation data
+            size_t id = pbFrameData.id();
+            float rotation = pbFrameData.rotation();
 
-        // Load bounding box data
-        const pb_tracker::Frame::Box& box = pbFrameData.bounding_box();
-        float x1 = box.x1();
-        float y1 = box.y1();
-        float x2 = box.x2();
-        float y2 = box.y2();
+            // Load bounding box data
+            const pb_tracker::Frame::Box& box = pbFrameData.bounding_box();
+            float x1 = box.x1();
+            float y1 = box.y1();
+            float x2 = box.x2();
+            float y2 = box.y2();
 
-        // Assign data to tracker map
-        trackedDataById[id] = FrameData(id, rotation, x1, y1, x2, y2);
+            // Assign data to tracker map
+            targets[objectIndex].trackedDataById[id] = FrameData(id, rotation, x1, y1, x2, y2);
+        }
     }
 
-    // Delete all global objects allocated by libprotobuf.
-    google::protobuf::ShutdownProtobufLibrary();
-
     return true;
 }
@@ -16,6 +16,9 @@
 
 #include "OpenCVUtilities.h"
 
+#include <map>
+#include <vector>
+
 #define int64 int64_t
 #define uint64 uint64_t
 #include <opencv2/opencv.hpp>
@@ -69,16 +72,29 @@ namespace openshot
 	};
 
 	/**
-	 * @brief The tracker class will receive one bounding box provided by the user and then iterate over the clip frames
-	 * to return the object position in all the frames.
+	 * @brief The tracker class will receive one or more bounding boxes provided by the user and then iterate over
+	 * the clip frames to return the object positions in all the frames.
+	 *
+	 * Several objects can be tracked in one pass ("regions", instead of "region"). Each frame is decoded once (the
+	 * next frame is decoded while the current frame is tracked), and the tracker of each object is updated in
+	 * parallel. Frames can be tracked at a smaller "pyramid-level" (each level halves the width and height of the
+	 * frames). The first object is saved like a single tracked object, and the other objects are saved in the same
+	 * protobuf message (which are loaded as more TrackedObjectBBox objects by the Tracker effect).
 	 */
 	class CVTracker {
 		private:
-			std::map<size_t, FrameData> trackedDataById; // Save tracked data
+			// The tracker and tracked data of one object
+			struct TrackedTarget {
+				cv::Ptr<OPENCV_TRACKER_TYPE> tracker; // Pointer of the selected tracker
+				cv::Rect2d bbox; // Bounding box coords
+				std::map<size_t, FrameData> trackedDataById; // Save tracked data
+				bool initialized = false; // The tracker is initialized (and has not lost the object)
+			};
+
+			std::vector<TrackedTarget> targets; // Tracked objects (in the order of the regions)
 			std::string trackerType; // Name of the chosen tracker
-			cv::Ptr<OPENCV_TRACKER_TYPE> tracker; // Pointer of the selected tracker
+			int pyramidLevel = 0; // Number of times the frames are halved before tracking
 
-			cv::Rect2d bbox; // Bounding box coords
 			SortTracker sort;
 
 			std::string protobuf_data_path; // Path to protobuf data file
@@ -94,11 +110,14 @@ namespace openshot
 
 			bool error = false;
 
-			// Initialize the tracker
-			bool initTracker(cv::Mat &frame, size_t frameId);
+			// Get a frame (at the pyramid level which is tracked)
+			cv::Mat loadFrame(openshot::Clip& video, size_t frameId);
+
+			// Initialize the tracker of an object
+			bool initTracker(cv::Mat &frame, size_t frameId, TrackedTarget &target);
 
 			// Update the object tracker according to frame
-			bool trackFrame(cv::Mat &frame, size_t frameId);
+			bool trackFrame(cv::Mat &frame, size_t frameId, TrackedTarget &target);
 
 		public:
 
@@ -108,16 +127,19 @@ namespace openshot
 			// Set desirable tracker method
 			cv::Ptr<OPENCV_TRACKER_TYPE> selectTracker(std::string trackerType);
 
-			/// Track object in the hole clip or in a given interval
+			/// Track objects in the hole clip or in a given interval
 			///
 			/// If start, end and process_interval are passed as argument, clip will be processed in [start,end)
 			void trackClip(openshot::Clip& video, size_t _start=0, size_t _end=0, bool process_interval=false);
 
-			/// Filter current bounding box jitter
-			cv::Rect2d filter_box_jitter(size_t frameId);
+			/// Filter current bounding box jitter (of an object)
+			cv::Rect2d filter_box_jitter(size_t frameId, size_t objectIndex=0);
+
+			/// Get the number of tracked objects
+			size_t ObjectCount() const { return targets.size(); }
 
-			/// Get tracked data for a given frame
-			FrameData GetTrackedData(size_t frameId);
+			/// Get tracked data of an object for a given frame
+			FrameData GetTrackedData(size_t frameId, size_t objectIndex=0);
 
 			// Protobuf Save and Load methods
 			/// Save protobuf file
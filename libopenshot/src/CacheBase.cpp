@@ -11,6 +11,7 @@
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
 #include "CacheBase.h"
+#include "BufferPool.h"
 
 using namespace std;
 using namespace openshot;
@@ -22,6 +23,17 @@ CacheBase::CacheBase() : CacheBase::CacheBase(0) { }
 CacheBase::CacheBase(int64_t max_bytes) : max_bytes(max_bytes) {
 	// Init the mutex
 	cacheMutex = new std::recursive_mutex();
+
+	// Size the frame buffer pool to match the largest cache
+	BufferPool::Instance()->SetMaxBytesFromCache(max_bytes);
+}
+
+// Set maximum bytes
+void CacheBase::SetMaxBytes(int64_t number_of_bytes) {
+	max_bytes = number_of_bytes;
+
+	// Size the frame buffer pool to match the largest cache
+	BufferPool::Instance()->SetMaxBytesFromCache(max_bytes);
 }
 
 // Set maximum bytes to a different amount based on a ReaderInfo struct
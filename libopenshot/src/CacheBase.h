@@ -102,7 +102,7 @@ namespace openshot {
 
 		/// @brief Set maximum bytes to a different amount
 		/// @param number_of_bytes The maximum bytes to allow in the cache. Once exceeded, the cache will purge the oldest frames.
-		void SetMaxBytes(int64_t number_of_bytes) { max_bytes = number_of_bytes; };
+		void SetMaxBytes(int64_t number_of_bytes);
 
 		/// @brief Set maximum bytes to a different amount based on a ReaderInfo struct
 		/// @param number_of_frames The maximum number of frames to hold in cache
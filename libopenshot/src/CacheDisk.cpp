@@ -14,7 +14,11 @@
 #include "Exceptions.h"
 #include "Frame.h"
 #include "QtUtilities.h"
+#include "ZmqLogger.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <Qt>
 #include <QString>
 #include <QTextStream>
@@ -22,6 +26,25 @@
 using namespace std;
 using namespace openshot;
 
+// Max size of a raw segment file, before a new segment is started
+static const int64_t RAW_SEGMENT_BYTES = 256 * 1024 * 1024;
+
+// Raw records (and the pixel data after their header) are aligned to this many bytes
+static const int64_t RAW_RECORD_ALIGNMENT = 64;
+
+// Header written before each raw frame (to validate records when reading)
+struct RawFrameHeader {
+	char magic[4];
+	int32_t width;
+	int32_t height;
+	int32_t bytes_per_line;
+	int32_t channels;
+	int32_t samples;
+	int64_t frame_number;
+	char padding[RAW_RECORD_ALIGNMENT - 40];
+};
+static_assert(sizeof(RawFrameHeader) == RAW_RECORD_ALIGNMENT, "Raw pixel data must be aligned");
+
 // Default constructor, no max bytes
 CacheDisk::CacheDisk(std::string cache_path, std::string format, float quality, float scale) : CacheBase(0) {
 	// Set cache type name
@@ -33,6 +56,8 @@ CacheDisk::CacheDisk(std::string cache_path, std::string format, float quality,
 	image_quality = quality;
 	image_scale = scale;
 	max_bytes = 0;
+	raw_segment = 0;
+	raw_bytes = 0;
 
 	// Init path directory
 	InitPath(cache_path);
@@ -48,6 +73,8 @@ CacheDisk::CacheDisk(std::string cache_path, std::string format, float quality,
 	image_format = format;
 	image_quality = quality;
 	image_scale = scale;
+	raw_segment = 0;
+	raw_bytes = 0;
 
 	// Init path directory
 	InitPath(cache_path);
@@ -98,51 +125,248 @@ void CacheDisk::Add(std::shared_ptr<Frame> frame)
 
 	else
 	{
+		// Save raw frame to segment file (if needed)
+		if (IsRaw() && !AddRaw(frame))
+			return;
+
 		// Add frame to queue and map
 		frames[frame_number] = frame_number;
 		frame_numbers.push_front(frame_number);
 		ordered_frame_numbers.push_back(frame_number);
 		needs_range_processing = true;
 
-		// Save image to disk (if needed)
-		QString frame_path(path.path() + "/" + QString("%1.").arg(frame_number) + QString(image_format.c_str()).toLower());
-		frame->Save(frame_path.toStdString(), image_scale, image_format, image_quality);
-		if (frame_size_bytes == 0) {
-			// Get compressed size of frame image (to correctly apply max size against)
-			QFile image_file(frame_path);
-			frame_size_bytes = image_file.size();
-		}
+		if (!IsRaw())
+			SaveFiles(frame);
 
-		// Save audio data (if needed)
-		if (frame->has_audio_data) {
-			QString audio_path(path.path() + "/" + QString("%1").arg(frame_number) + ".audio");
-			QFile audio_file(audio_path);
+		// Clean up old frames
+		CleanUp();
+	}
+}
 
-			if (audio_file.open(QIODevice::WriteOnly)) {
-				QTextStream audio_stream(&audio_file);
-				audio_stream << frame->SampleRate() << Qt::endl;
-				audio_stream << frame->GetAudioChannelsCount() << Qt::endl;
-				audio_stream << frame->GetAudioSamplesCount() << Qt::endl;
-				audio_stream << frame->ChannelsLayout() << Qt::endl;
-
-				// Loop through all samples
-				for (int channel = 0; channel < frame->GetAudioChannelsCount(); channel++)
-				{
-					// Get audio for this channel
-					float *samples = frame->GetAudioSamples(channel);
-					for (int sample = 0; sample < frame->GetAudioSamplesCount(); sample++)
-						audio_stream << samples[sample] << Qt::endl;
-				}
+// Save a frame as an image file (and a text audio file)
+void CacheDisk::SaveFiles(std::shared_ptr<Frame> frame)
+{
+	int64_t frame_number = frame->number;
 
+	// Save image to disk (if needed)
+	QString frame_path(path.path() + "/" + QString("%1.").arg(frame_number) + QString(image_format.c_str()).toLower());
+	frame->Save(frame_path.toStdString(), image_scale, image_format, image_quality);
+	if (frame_size_bytes == 0) {
+		// Get compressed size of frame image (to correctly apply max size against)
+		QFile image_file(frame_path);
+		frame_size_bytes = image_file.size();
+	}
+
+	// Save audio data (if needed)
+	if (frame->has_audio_data) {
+		QString audio_path(path.path() + "/" + QString("%1").arg(frame_number) + ".audio");
+		QFile audio_file(audio_path);
+
+		if (audio_file.open(QIODevice::WriteOnly)) {
+			QTextStream audio_stream(&audio_file);
+			audio_stream << frame->SampleRate() << Qt::endl;
+			audio_stream << frame->GetAudioChannelsCount() << Qt::endl;
+			audio_stream << frame->GetAudioSamplesCount() << Qt::endl;
+			audio_stream << frame->ChannelsLayout() << Qt::endl;
+
+			// Loop through all samples
+			for (int channel = 0; channel < frame->GetAudioChannelsCount(); channel++)
+			{
+				// Get audio for this channel
+				float *samples = frame->GetAudioSamples(channel);
+				for (int sample = 0; sample < frame->GetAudioSamplesCount(); sample++)
+					audio_stream << samples[sample] << Qt::endl;
 			}
 
 		}
 
-		// Clean up old frames
-		CleanUp();
 	}
 }
 
+// Is this cache storing raw frames (instead of image files)
+bool CacheDisk::IsRaw() const
+{
+	return QString(image_format.c_str()).toUpper() == "RAW";
+}
+
+// Append a frame to the current raw segment file
+bool CacheDisk::AddRaw(std::shared_ptr<Frame> frame)
+{
+	// Get image (scaled if needed)
+	std::shared_ptr<QImage> image = frame->GetImage();
+	if (fabs(image_scale) > 1.001 || fabs(image_scale) < 0.999)
+		image = std::make_shared<QImage>(image->scaled(
+				image->width() * image_scale, image->height() * image_scale,
+				Qt::KeepAspectRatio, Qt::SmoothTransformation));
+
+	RawRecord record;
+	record.width = image->width();
+	record.height = image->height();
+	record.bytes_per_line = image->bytesPerLine();
+	record.image_format = image->format();
+	record.sample_rate = frame->SampleRate();
+	record.channels = frame->has_audio_data ? frame->GetAudioChannelsCount() : 0;
+	record.samples = frame->has_audio_data ? frame->GetAudioSamplesCount() : 0;
+	record.channel_layout = frame->ChannelsLayout();
+
+	int64_t image_bytes = int64_t(record.bytes_per_line) * record.height;
+	int64_t audio_bytes = int64_t(sizeof(float)) * record.channels * record.samples;
+	int64_t unaligned_size = sizeof(RawFrameHeader) + image_bytes + audio_bytes;
+	record.size = (unaligned_size + RAW_RECORD_ALIGNMENT - 1) / RAW_RECORD_ALIGNMENT * RAW_RECORD_ALIGNMENT;
+
+	// Start a new segment (if the current one is full)
+	auto segment = raw_segments.find(raw_segment);
+	if (segment != raw_segments.end() && segment->second.size >= RAW_SEGMENT_BYTES) {
+		raw_segment++;
+		segment = raw_segments.end();
+	}
+	if (segment == raw_segments.end()) {
+		QString segment_path(path.path() + "/" + QString("segment-%1.raw").arg(raw_segment));
+		RawSegment new_segment = {std::make_unique<QFile>(segment_path), nullptr, 0, 0, 0};
+		if (!new_segment.file->open(QIODevice::ReadWrite | QIODevice::Truncate | QIODevice::Unbuffered)) {
+			ZmqLogger::Instance()->AppendDebugMethod(
+				"CacheDisk::AddRaw (could not open segment)",
+				"frame->number", frame->number,
+				"raw_segment", raw_segment);
+			return false;
+		}
+		segment = raw_segments.emplace(raw_segment, std::move(new_segment)).first;
+	}
+	QFile* file = segment->second.file.get();
+	record.segment = raw_segment;
+	record.offset = segment->second.size;
+
+	// Write header, pixels and audio (one plane per channel)
+	RawFrameHeader header = {};
+	memcpy(header.magic, "OSRF", 4);
+	header.width = record.width;
+	header.height = record.height;
+	header.bytes_per_line = record.bytes_per_line;
+	header.channels = record.channels;
+	header.samples = record.samples;
+	header.frame_number = frame->number;
+
+	bool success = file->seek(record.offset);
+	success = success && file->write(reinterpret_cast<const char*>(&header), sizeof(header)) == qint64(sizeof(header));
+	success = success && file->write(reinterpret_cast<const char*>(image->constBits()), image_bytes) == image_bytes;
+	for (int channel = 0; success && channel < record.channels; channel++) {
+		const char* samples = reinterpret_cast<const char*>(frame->GetAudioSamples(channel));
+		int64_t channel_bytes = int64_t(sizeof(float)) * record.samples;
+		success = file->write(samples, channel_bytes) == channel_bytes;
+	}
+	if (success && record.size > unaligned_size) {
+		const char padding[RAW_RECORD_ALIGNMENT] = {};
+		success = file->write(padding, record.size - unaligned_size) == record.size - unaligned_size;
+	}
+
+	if (!success) {
+		// Discard partial record (i.e. disk is full)
+		file->resize(record.offset);
+		ZmqLogger::Instance()->AppendDebugMethod(
+			"CacheDisk::AddRaw (could not write frame)",
+			"frame->number", frame->number,
+			"raw_segment", raw_segment);
+		return false;
+	}
+
+	// Add to index
+	segment->second.size += record.size;
+	segment->second.live_frames++;
+	raw_bytes += record.size;
+	raw_records[frame->number] = record;
+
+	return true;
+}
+
+// Read a frame from a memory mapped raw segment file
+std::shared_ptr<Frame> CacheDisk::GetRaw(int64_t frame_number)
+{
+	auto record_itr = raw_records.find(frame_number);
+	if (record_itr == raw_records.end())
+		return std::shared_ptr<Frame>();
+	const RawRecord& record = record_itr->second;
+	auto segment_itr = raw_segments.find(record.segment);
+	if (segment_itr == raw_segments.end())
+		return std::shared_ptr<Frame>();
+	RawSegment& segment = segment_itr->second;
+
+	// Map the segment file (again, if it has grown since it was last mapped)
+	if (!segment.mapped || segment.mapped_size < record.offset + record.size) {
+		if (segment.mapped)
+			segment.file->unmap(segment.mapped);
+		segment.mapped = segment.file->map(0, segment.size);
+		segment.mapped_size = segment.mapped ? segment.size : 0;
+		if (!segment.mapped)
+			return std::shared_ptr<Frame>();
+	}
+
+	// Validate record
+	const uchar* data = segment.mapped + record.offset;
+	const RawFrameHeader* header = reinterpret_cast<const RawFrameHeader*>(data);
+	if (memcmp(header->magic, "OSRF", 4) != 0 || header->frame_number != frame_number)
+		return std::shared_ptr<Frame>();
+	data += sizeof(RawFrameHeader);
+
+	// Copy pixels (no decoding needed)
+	auto image = std::make_shared<QImage>(record.width, record.height, (QImage::Format) record.image_format);
+	if (image->bytesPerLine() == record.bytes_per_line) {
+		memcpy(image->bits(), data, int64_t(record.bytes_per_line) * record.height);
+	} else {
+		int line_bytes = std::min(image->bytesPerLine(), record.bytes_per_line);
+		for (int row = 0; row < record.height; row++)
+			memcpy(image->scanLine(row), data + int64_t(row) * record.bytes_per_line, line_bytes);
+	}
+	data += int64_t(record.bytes_per_line) * record.height;
+
+	// Create frame object
+	auto frame = std::make_shared<Frame>();
+	frame->number = frame_number;
+	frame->AddImage(image);
+
+	// Copy audio (if any)
+	if (record.channels > 0) {
+		frame->ResizeAudio(record.channels, record.samples, record.sample_rate, (ChannelLayout) record.channel_layout);
+		const float* samples = reinterpret_cast<const float*>(data);
+		for (int channel = 0; channel < record.channels; channel++)
+			frame->AddAudio(true, channel, 0, samples + int64_t(channel) * record.samples, record.samples, 1.0);
+	}
+
+	return frame;
+}
+
+// Remove a frame from the raw index (deleting its segment file, once empty)
+void CacheDisk::RemoveRaw(int64_t frame_number)
+{
+	auto record = raw_records.find(frame_number);
+	if (record == raw_records.end())
+		return;
+	raw_bytes -= record->second.size;
+	auto segment = raw_segments.find(record->second.segment);
+	raw_records.erase(record);
+
+	if (segment != raw_segments.end() && --segment->second.live_frames <= 0) {
+		// No frames left in this segment
+		if (segment->second.mapped)
+			segment->second.file->unmap(segment->second.mapped);
+		segment->second.file->remove();
+		raw_segments.erase(segment);
+	}
+}
+
+// Close (and un-map) all raw segment files
+void CacheDisk::CloseRawSegments()
+{
+	for (auto& segment : raw_segments) {
+		if (segment.second.mapped)
+			segment.second.file->unmap(segment.second.mapped);
+		segment.second.file->close();
+	}
+	raw_segments.clear();
+	raw_records.clear();
+	raw_segment = 0;
+	raw_bytes = 0;
+}
+
 // Check if frame is already contained in cache
 bool CacheDisk::Contains(int64_t frame_number) {
 	if (frames.count(frame_number) > 0) {
@@ -159,6 +383,9 @@ std::shared_ptr<Frame> CacheDisk::GetFrame(int64_t frame_number)
 	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
 
 	// Does frame exists in cache?
+	if (frames.count(frame_number) && IsRaw())
+		return GetRaw(frame_number);
+
 	if (frames.count(frame_number)) {
 		// Does frame exist on disk
 		QString frame_path(path.path() + "/" + QString("%1.").arg(frame_number) + QString(image_format.c_str()).toLower());
@@ -268,6 +495,10 @@ int64_t CacheDisk::GetBytes()
 	// Create a scoped lock, to protect the cache from multiple threads
 	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
 
+	// Raw frames are different sizes (so their total is tracked as they are added)
+	if (IsRaw())
+		return raw_bytes;
+
 	int64_t  total_bytes = 0;
 
 	// Loop through frames, and calculate total bytes
@@ -312,6 +543,9 @@ void CacheDisk::Remove(int64_t start_frame_number, int64_t end_frame_number)
 			// erase frame number
 			frames.erase(*itr_ordered);
 
+			// Remove raw frame (if any)
+			RemoveRaw(*itr_ordered);
+
 			// Remove the image file (if it exists)
 			QString frame_path(path.path() + "/" + QString("%1.").arg(*itr_ordered) + QString(image_format.c_str()).toLower());
 			QFile image_file(frame_path);
@@ -374,6 +608,9 @@ void CacheDisk::Clear()
 	needs_range_processing = true;
 	frame_size_bytes = 0;
 
+	// Close raw segment files (before they are deleted)
+	CloseRawSegments();
+
 	// Delete cache directory, and recreate it
 	QString current_path = path.path();
 	path.removeRecursively();
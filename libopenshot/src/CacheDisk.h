@@ -16,6 +16,8 @@
 #include "CacheBase.h"
 
 #include <QDir>
+#include <QFile>
+#include <memory>
 
 namespace openshot {
 	class Frame;
@@ -26,6 +28,15 @@ namespace openshot {
 	 * It is used by the Timeline class, if enabled, to cache video and audio frames to disk, to cut down on CPU
 	 * and memory utilization. This will thrash a user's disk, but save their memory and CPU. It's a trade off that
 	 * sometimes makes perfect sense. You can also set the max number of bytes to cache.
+	 *
+	 * Frames are saved as compressed image files (ppm, jpg, png) and text audio files by default. With the "RAW"
+	 * format, frames are instead appended to large segment files as raw RGBA pixels and float audio samples,
+	 * and read back through a memory map (with no image decode or text parsing), which is much faster.
+	 *
+	 * @code
+	 * // Raw, full-size disk cache (limited to 2 GB)
+	 * CacheDisk cache("", "RAW", 1.0, 1.0, 2LL * 1024 * 1024 * 1024);
+	 * @endcode
 	 */
 	class CacheDisk : public CacheBase {
 	private:
@@ -37,23 +48,70 @@ namespace openshot {
 		float image_scale;
 		int64_t frame_size_bytes; ///< The size of the cached frame in bytes
 
+		/// The location (and layout) of a frame stored in a raw segment file
+		struct RawRecord {
+			int segment;
+			int64_t offset; ///< Offset of the pixel data in the segment file
+			int64_t size; ///< Size of the record (header, pixels and audio) in bytes
+			int width;
+			int height;
+			int bytes_per_line;
+			int image_format;
+			int sample_rate;
+			int channels;
+			int samples;
+			int channel_layout;
+		};
+
+		/// A raw segment file, which holds many frames (and is memory mapped for reading)
+		struct RawSegment {
+			std::unique_ptr<QFile> file;
+			uchar* mapped; ///< Memory map of the segment file (or nullptr)
+			int64_t mapped_size; ///< Size of the memory map
+			int64_t size; ///< Size of the segment file
+			int live_frames; ///< Number of frames still cached in this segment
+		};
+
+		std::map<int64_t, RawRecord> raw_records; ///< The index of frames stored in raw segment files
+		std::map<int, RawSegment> raw_segments; ///< Open raw segment files
+		int raw_segment; ///< The segment new frames are appended to
+		int64_t raw_bytes; ///< Size of all cached raw frames in bytes
+
+		/// Is this cache storing raw frames (instead of image files)
+		bool IsRaw() const;
+
+		/// Append a frame to the current raw segment file (returns false if it could not be written)
+		bool AddRaw(std::shared_ptr<openshot::Frame> frame);
+
+		/// Read a frame from a memory mapped raw segment file
+		std::shared_ptr<openshot::Frame> GetRaw(int64_t frame_number);
+
+		/// Remove a frame from the raw index (deleting its segment file, once empty)
+		void RemoveRaw(int64_t frame_number);
+
+		/// Close (and un-map) all raw segment files
+		void CloseRawSegments();
+
 		/// Clean up cached frames that exceed the max number of bytes
 		void CleanUp();
 
 		/// Init path directory
 		void InitPath(std::string cache_path);
 
+		/// Save a frame as an image file (and a text audio file)
+		void SaveFiles(std::shared_ptr<openshot::Frame> frame);
+
 	public:
 		/// @brief Default constructor, no max bytes
 		/// @param cache_path The folder path of the cache directory (empty string = /tmp/preview-cache/)
-		/// @param format The image format for disk caching (ppm, jpg, png)
+		/// @param format The image format for disk caching (ppm, jpg, png, or raw)
 		/// @param quality The quality of the image (1.0=highest quality/slowest speed, 0.0=worst quality/fastest speed)
 		/// @param scale The scale factor for the preview images (1.0 = original size, 0.5=half size, 0.25=quarter size, etc...)
 		CacheDisk(std::string cache_path, std::string format, float quality, float scale);
 
 		/// @brief Constructor that sets the max bytes to cache
 		/// @param cache_path The folder path of the cache directory (empty string = /tmp/preview-cache/)
-		/// @param format The image format for disk caching (ppm, jpg, png)
+		/// @param format The image format for disk caching (ppm, jpg, png, or raw)
 		/// @param quality The quality of the image (1.0=highest quality/slowest speed, 0.0=worst quality/fastest speed)
 		/// @param scale The scale factor for the preview images (1.0 = original size, 0.5=half size, 0.25=quarter size, etc...)
 		/// @param max_bytes The maximum bytes to allow in the cache. Once exceeded, the cache will purge the oldest frames.
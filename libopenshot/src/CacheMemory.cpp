@@ -14,11 +14,13 @@
 #include "Exceptions.h"
 #include "Frame.h"
 
+#include <algorithm>
+
 using namespace std;
 using namespace openshot;
 
 // Default constructor, no max bytes
-CacheMemory::CacheMemory() : CacheBase(0) {
+CacheMemory::CacheMemory() : CacheBase(0), total_bytes(0) {
 	// Set cache type name
 	cache_type = "CacheMemory";
 	range_version = 0;
@@ -26,7 +28,7 @@ CacheMemory::CacheMemory() : CacheBase(0) {
 }
 
 // Constructor that sets the max bytes to cache
-CacheMemory::CacheMemory(int64_t max_bytes) : CacheBase(max_bytes) {
+CacheMemory::CacheMemory(int64_t max_bytes) : CacheBase(max_bytes), total_bytes(0) {
 	// Set cache type name
 	cache_type = "CacheMemory";
 	range_version = 0;
@@ -57,9 +59,13 @@ void CacheMemory::Add(std::shared_ptr<Frame> frame)
 	else
 	{
 		// Add frame to queue and map
-		frames[frame_number] = frame;
 		frame_numbers.push_front(frame_number);
-		ordered_frame_numbers.push_back(frame_number);
+		int64_t frame_bytes = frame->GetBytes();
+		{
+			const std::unique_lock<std::shared_mutex> frames_lock(framesMutex);
+			frames[frame_number] = CacheEntry{frame, frame_numbers.begin(), frame_bytes};
+		}
+		total_bytes += frame_bytes;
 		needs_range_processing = true;
 
 		// Clean up old frames
@@ -69,23 +75,22 @@ void CacheMemory::Add(std::shared_ptr<Frame> frame)
 
 // Check if frame is already contained in cache
 bool CacheMemory::Contains(int64_t frame_number) {
-	if (frames.count(frame_number) > 0) {
-		return true;
-	} else {
-		return false;
-	}
+	// Readers share the lock
+	const std::shared_lock<std::shared_mutex> frames_lock(framesMutex);
+	return frames.count(frame_number) > 0;
 }
 
 // Get a frame from the cache (or NULL shared_ptr if no frame is found)
 std::shared_ptr<Frame> CacheMemory::GetFrame(int64_t frame_number)
 {
-	// Create a scoped lock, to protect the cache from multiple threads
-	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
+	// Readers share the lock
+	const std::shared_lock<std::shared_mutex> frames_lock(framesMutex);
 
 	// Does frame exists in cache?
-	if (frames.count(frame_number))
+	auto entry = frames.find(frame_number);
+	if (entry != frames.end())
 		// return the Frame object
-		return frames[frame_number];
+		return entry->second.frame;
 
 	else
 		// no Frame found
@@ -98,13 +103,13 @@ std::vector<std::shared_ptr<openshot::Frame>> CacheMemory::GetFrames()
 	// Create a scoped lock, to protect the cache from multiple threads
 	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
 
+	// Sort frame numbers (if anything has changed)
+	UpdateOrderedFrameNumbers();
+
 	std::vector<std::shared_ptr<openshot::Frame>> all_frames;
-	std::vector<int64_t>::iterator itr_ordered;
-	for(itr_ordered = ordered_frame_numbers.begin(); itr_ordered != ordered_frame_numbers.end(); ++itr_ordered)
-	{
-		int64_t frame_number = *itr_ordered;
-		all_frames.push_back(GetFrame(frame_number));
-	}
+	all_frames.reserve(ordered_frame_numbers.size());
+	for (const auto frame_number : ordered_frame_numbers)
+		all_frames.push_back(frames.at(frame_number).frame);
 
 	return all_frames;
 }
@@ -116,17 +121,16 @@ std::shared_ptr<Frame> CacheMemory::GetSmallestFrame()
 	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
 
 	// Loop through frame numbers
-	std::deque<int64_t>::iterator itr;
 	int64_t smallest_frame = -1;
-	for(itr = frame_numbers.begin(); itr != frame_numbers.end(); ++itr)
+	for (const auto& entry : frames)
 	{
-		if (*itr < smallest_frame || smallest_frame == -1)
-			smallest_frame = *itr;
+		if (entry.first < smallest_frame || smallest_frame == -1)
+			smallest_frame = entry.first;
 	}
 
 	// Return frame (if any)
 	if (smallest_frame != -1) {
-		return frames[smallest_frame];
+		return frames.at(smallest_frame).frame;
 	} else {
 		return NULL;
 	}
@@ -138,15 +142,6 @@ int64_t CacheMemory::GetBytes()
 	// Create a scoped lock, to protect the cache from multiple threads
 	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
 
-	int64_t total_bytes = 0;
-
-	// Loop through frames, and calculate total bytes
-	std::deque<int64_t>::reverse_iterator itr;
-	for(itr = frame_numbers.rbegin(); itr != frame_numbers.rend(); ++itr)
-	{
-		total_bytes += frames[*itr]->GetBytes();
-	}
-
 	return total_bytes;
 }
 
@@ -161,31 +156,33 @@ void CacheMemory::Remove(int64_t start_frame_number, int64_t end_frame_number)
 {
 	// Create a scoped lock, to protect the cache from multiple threads
 	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
+	const std::unique_lock<std::shared_mutex> frames_lock(framesMutex);
 
-	// Loop through frame numbers
-	std::deque<int64_t>::iterator itr;
-	for(itr = frame_numbers.begin(); itr != frame_numbers.end();)
-	{
-		if (*itr >= start_frame_number && *itr <= end_frame_number)
-		{
-			// erase frame number
-			itr = frame_numbers.erase(itr);
-		}else
-			itr++;
+	if (end_frame_number - start_frame_number < int64_t(frames.size())) {
+		// Small range: look up each frame number
+		for (int64_t frame_number = start_frame_number; frame_number <= end_frame_number; frame_number++)
+			RemoveEntry(frame_number);
+	} else {
+		// Large range: scan the cached frames
+		std::vector<int64_t> remove_frames;
+		for (const auto& entry : frames)
+			if (entry.first >= start_frame_number && entry.first <= end_frame_number)
+				remove_frames.push_back(entry.first);
+		for (const auto frame_number : remove_frames)
+			RemoveEntry(frame_number);
 	}
+}
 
-	// Loop through ordered frame numbers
-	std::vector<int64_t>::iterator itr_ordered;
-	for(itr_ordered = ordered_frame_numbers.begin(); itr_ordered != ordered_frame_numbers.end();)
-	{
-		if (*itr_ordered >= start_frame_number && *itr_ordered <= end_frame_number)
-		{
-			// erase frame number
-			frames.erase(*itr_ordered);
-			itr_ordered = ordered_frame_numbers.erase(itr_ordered);
-		}else
-			itr_ordered++;
-	}
+// Remove a cached frame
+void CacheMemory::RemoveEntry(int64_t frame_number)
+{
+	auto entry = frames.find(frame_number);
+	if (entry == frames.end())
+		return;
+
+	total_bytes -= entry->second.bytes;
+	frame_numbers.erase(entry->second.recent);
+	frames.erase(entry);
 
 	// Needs range processing (since cache has changed)
 	needs_range_processing = true;
@@ -198,22 +195,16 @@ void CacheMemory::Touch(int64_t frame_number)
 	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
 
 	// Does frame exists in cache?
-	if (frames.count(frame_number))
+	auto entry = frames.find(frame_number);
+	if (entry != frames.end())
 	{
-		// Loop through frame numbers
-		std::deque<int64_t>::iterator itr;
-		for(itr = frame_numbers.begin(); itr != frame_numbers.end(); ++itr)
-		{
-			if (*itr == frame_number)
-			{
-				// erase frame number
-				frame_numbers.erase(itr);
-
-				// add frame number to 'front' of queue
-				frame_numbers.push_front(frame_number);
-				break;
-			}
-		}
+		// Move frame number to 'front' of queue
+		frame_numbers.splice(frame_numbers.begin(), frame_numbers, entry->second.recent);
+
+		// Update size (in case the frame has changed since it was added)
+		int64_t frame_bytes = entry->second.frame->GetBytes();
+		total_bytes += frame_bytes - entry->second.bytes;
+		entry->second.bytes = frame_bytes;
 	}
 }
 
@@ -222,25 +213,39 @@ void CacheMemory::Clear()
 {
 	// Create a scoped lock, to protect the cache from multiple threads
 	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
+	const std::unique_lock<std::shared_mutex> frames_lock(framesMutex);
 
 	frames.clear();
 	frame_numbers.clear();
-	frame_numbers.shrink_to_fit();
 	ordered_frame_numbers.clear();
 	ordered_frame_numbers.shrink_to_fit();
+	total_bytes = 0;
 	needs_range_processing = true;
 }
 
 // Count the frames in the queue
 int64_t CacheMemory::Count()
 {
-	// Create a scoped lock, to protect the cache from multiple threads
-	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
+	// Readers share the lock
+	const std::shared_lock<std::shared_mutex> frames_lock(framesMutex);
 
 	// Return the number of frames in the cache
 	return frames.size();
 }
 
+// Sort the cached frame numbers (only needed when the cache has changed)
+void CacheMemory::UpdateOrderedFrameNumbers()
+{
+	if (!needs_range_processing)
+		return;
+
+	ordered_frame_numbers.clear();
+	ordered_frame_numbers.reserve(frames.size());
+	for (const auto& entry : frames)
+		ordered_frame_numbers.push_back(entry.first);
+	std::sort(ordered_frame_numbers.begin(), ordered_frame_numbers.end());
+}
+
 // Clean up cached frames that exceed the number in our max_bytes variable
 void CacheMemory::CleanUp()
 {
@@ -249,19 +254,16 @@ void CacheMemory::CleanUp()
 	{
 		// Create a scoped lock, to protect the cache from multiple threads
 		const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
+		const std::unique_lock<std::shared_mutex> frames_lock(framesMutex);
 
-		while (GetBytes() > max_bytes && frame_numbers.size() > 20)
+		while (total_bytes > max_bytes && frame_numbers.size() > 20)
 		{
-			// Get the oldest frame number.
-			int64_t frame_to_remove = frame_numbers.back();
-
-			// Remove frame_number and frame
-			Remove(frame_to_remove);
+			// Remove the oldest frame
+			RemoveEntry(frame_numbers.back());
 		}
 	}
 }
 
-
 // Generate JSON string of this object
 std::string CacheMemory::Json() {
 
@@ -273,6 +275,8 @@ std::string CacheMemory::Json() {
 Json::Value CacheMemory::JsonValue() {
 
 	// Process range data (if anything has changed)
+	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
+	UpdateOrderedFrameNumbers();
 	CalculateRanges();
 
 	// Create root json object
@@ -15,6 +15,10 @@
 
 #include "CacheBase.h"
 
+#include <list>
+#include <shared_mutex>
+#include <unordered_map>
+
 namespace openshot {
 	class Frame;
 
@@ -25,15 +29,34 @@ namespace openshot {
 	 * high cost of decoding streams, once a frame is decoded, converted to RGB, and a Frame object is created,
 	 * it critical to keep these Frames cached for performance reasons.  However, the larger the cache, the more memory
 	 * is required.  You can set the max number of bytes to cache.
+	 *
+	 * Frames are kept in a hash map, and their recency in a linked list (most recent first), so adding, touching,
+	 * removing and evicting a frame are all O(1). The total size of the cache is tracked as frames are added and
+	 * removed. GetFrame() and Contains() only take a shared (reader) lock, so many threads can read at once.
 	 */
 	class CacheMemory : public CacheBase {
 	private:
-		std::map<int64_t, std::shared_ptr<openshot::Frame> > frames;	///< This map holds the frame number and Frame objects
-		std::deque<int64_t> frame_numbers;	///< This queue holds a sequential list of cached Frame numbers
+		/// A cached frame, its position in the recency list, and its size (when it was added or last touched)
+		struct CacheEntry {
+			std::shared_ptr<openshot::Frame> frame;
+			std::list<int64_t>::iterator recent;
+			int64_t bytes;
+		};
+
+		std::unordered_map<int64_t, CacheEntry> frames;	///< This map holds the frame number and Frame objects
+		std::list<int64_t> frame_numbers;	///< This list holds the cached Frame numbers (most recently used first)
+		int64_t total_bytes; ///< The size of all cached frames in bytes
+		mutable std::shared_mutex framesMutex; ///< Guards the frames map (shared for readers, exclusive for changes)
 
 		/// Clean up cached frames that exceed the max number of bytes
 		void CleanUp();
 
+		/// Remove a cached frame (the caller must hold both the cache mutex and an exclusive frames lock)
+		void RemoveEntry(int64_t frame_number);
+
+		/// Sort the cached frame numbers (only needed when the cache has changed)
+		void UpdateOrderedFrameNumbers();
+
 	public:
 		/// Default constructor, no max bytes
 		CacheMemory();
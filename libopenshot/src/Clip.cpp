@@ -13,11 +13,14 @@
 #include "Clip.h"
 
 #include "AudioResampler.h"
+#include "BufferPool.h"
 #include "Exceptions.h"
 #include "FFmpegReader.h"
 #include "FrameMapper.h"
 #include "QtImageReader.h"
 #include "ChunkReader.h"
+#include "ColorPipeline.h"
+#include "Compositor.h"
 #include "DummyReader.h"
 #include "Timeline.h"
 #include "ZmqLogger.h"
@@ -316,6 +319,10 @@ void Clip::Reader(ReaderBase* new_reader)
 	if (reader) {
 		reader->ParentClip(this);
 
+		// Keep the new reader in the same mode as this clip
+		if (audio_only)
+			reader->AudioOnly(true);
+
 		// Init reader info struct
 		init_reader_settings();
 	}
@@ -402,6 +409,20 @@ void Clip::ParentTimeline(openshot::TimelineBase* new_timeline) {
 	final_cache.Clear();
 }
 
+// Enable or disable audio-only mode (of this clip and its reader)
+void Clip::AudioOnly(bool enabled)
+{
+	const std::lock_guard<std::recursive_mutex> lock(getFrameMutex);
+	if (enabled != audio_only) {
+		ReaderBase::AudioOnly(enabled);
+
+		// Cached frames have no image (or an image which is no longer needed)
+		final_cache.Clear();
+	}
+	if (reader)
+		reader->AudioOnly(enabled);
+}
+
 // Create an openshot::Frame object for a specific frame number of this reader.
 std::shared_ptr<Frame> Clip::GetFrame(int64_t clip_frame_number)
 {
@@ -448,6 +469,14 @@ std::shared_ptr<Frame> Clip::GetFrame(std::shared_ptr<openshot::Frame> backgroun
             // Get time mapped frame object (used to increase speed, change direction, etc...)
             apply_timemapping(frame);
 
+            // Audio-only mode only needs the audio (and audio effects)
+            if (audio_only) {
+                apply_effects(frame, timeline_frame_number, options, true);
+                apply_effects(frame, timeline_frame_number, options, false);
+                final_cache.Add(frame);
+                return frame;
+            }
+
             // Apply waveform image (if any)
             apply_waveform(frame, timeline_size);
 
@@ -464,6 +493,10 @@ std::shared_ptr<Frame> Clip::GetFrame(std::shared_ptr<openshot::Frame> backgroun
             final_cache.Add(frame);
         }
 
+        // Audio-only mode has no image to composite
+        if (audio_only)
+            return frame;
+
         if (!background_frame) {
             // Create missing background_frame w/ transparent color (if needed)
             background_frame = std::make_shared<Frame>(frame->number, frame->GetWidth(), frame->GetHeight(),
@@ -700,9 +733,10 @@ std::shared_ptr<Frame> Clip::GetOrCreateFrame(int64_t number, bool enable_time)
 		if (reader_frame) {
 			// Create a new copy of reader frame
 			// This allows a clip to modify the pixels and audio of this frame without
-			// changing the underlying reader's frame data
+			// changing the underlying reader's frame data. The image is shared with the
+			// reader's frame, and is only duplicated if an effect or keyframe modifies it.
 			auto reader_copy = std::make_shared<Frame>(*reader_frame.get());
-			if (has_video.GetInt(number) == 0) {
+			if (has_video.GetInt(number) == 0 && !audio_only) {
 				// No video, so add transparent pixels
 				reader_copy->AddColor(QColor(Qt::transparent));
 			}
@@ -1108,6 +1142,8 @@ void Clip::SetJsonValue(const Json::Value root) {
 			if (reader) {
 				reader->ParentClip(this);
 				allocated_reader = reader;
+				if (audio_only)
+					reader->AudioOnly(true);
 			}
 
 			// Re-Open reader (if needed)
@@ -1188,13 +1224,15 @@ void Clip::RemoveEffect(EffectBase* effect)
 void Clip::apply_background(std::shared_ptr<openshot::Frame> frame, std::shared_ptr<openshot::Frame> background_frame) {
 	// Add background canvas
 	std::shared_ptr<QImage> background_canvas = background_frame->GetImage();
-	QPainter painter(background_canvas.get());
-	painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform | QPainter::TextAntialiasing, true);
 
-	// Composite a new layer onto the image
-	painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-	painter.drawImage(0, 0, *frame->GetImage());
-	painter.end();
+	// Composite a new layer onto the image (QPainter is only needed for other image formats)
+	if (!Compositor::Composite(*background_canvas, *frame->GetImage(), QTransform())) {
+		QPainter painter(background_canvas.get());
+		painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform | QPainter::TextAntialiasing, true);
+		painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+		painter.drawImage(0, 0, *frame->GetImage());
+		painter.end();
+	}
 
 	// Add new QImage to frame
 	frame->AddImage(background_canvas);
@@ -1203,15 +1241,23 @@ void Clip::apply_background(std::shared_ptr<openshot::Frame> frame, std::shared_
 // Apply effects to the source frame (if any)
 void Clip::apply_effects(std::shared_ptr<Frame> frame, int64_t timeline_frame_number, TimelineInfoStruct* options, bool before_keyframes)
 {
+	// Adjacent color effects are applied together (in a single pass)
+	ColorPipeline color_pipeline;
+
 	for (auto effect : effects)
 	{
-		// Apply the effect to this frame
-		if (effect->info.apply_before_clip && before_keyframes) {
-			effect->GetFrame(frame, frame->number);
-		} else if (!effect->info.apply_before_clip && !before_keyframes) {
+		if (effect->info.apply_before_clip != before_keyframes)
+			continue; // skip effect, if this filter does not match
+		if (audio_only && !effect->info.has_audio)
+			continue; // skip video effects in audio-only mode
+
+		// Apply the effect to this frame (after any pending color effects)
+		if (!color_pipeline.Add(effect, frame->number)) {
+			color_pipeline.Apply(frame);
 			effect->GetFrame(frame, frame->number);
 		}
 	}
+	color_pipeline.Apply(frame);
 
 	if (timeline != NULL && options != NULL) {
 		// Apply global timeline effects (i.e. transitions & masks... if any)
@@ -1237,24 +1283,33 @@ void Clip::apply_keyframes(std::shared_ptr<Frame> frame, QSize timeline_size) {
 
 	// Get image from clip, and create transparent background image
 	std::shared_ptr<QImage> source_image = frame->GetImage();
-	std::shared_ptr<QImage> background_canvas = std::make_shared<QImage>(timeline_size.width(),
-                                                                         timeline_size.height(),
-																		 QImage::Format_RGBA8888_Premultiplied);
+	std::shared_ptr<QImage> background_canvas = BufferPool::Instance()->CreateImage(
+		timeline_size.width(), timeline_size.height(), QImage::Format_RGBA8888_Premultiplied);
 	background_canvas->fill(QColor(Qt::transparent));
 
-	// Get transform from clip's keyframes
+	// Get transform and opacity from clip's keyframes
 	QTransform transform = get_transform(frame, background_canvas->width(), background_canvas->height());
+	float alpha_value = alpha.GetValue(frame->number);
 
-	// Load timeline's new frame image into a QPainter
-	QPainter painter(background_canvas.get());
-	painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform | QPainter::TextAntialiasing, true);
+	// Composite a new layer onto the image (translate, rotate, scale)
+	bool is_composited = Compositor::Composite(*background_canvas, *source_image, transform, alpha_value);
 
-	// Apply transform (translate, rotate, scale)
-	painter.setTransform(transform);
-
-	// Composite a new layer onto the image
-	painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-	painter.drawImage(0, 0, *source_image);
+	// Debug output
+	ZmqLogger::Instance()->AppendDebugMethod("Clip::apply_keyframes (Composite)",
+		"frame->number", frame->number,
+		"alpha_value", alpha_value,
+		"is_composited", is_composited);
+
+	if (!is_composited) {
+		// Fall back to QPainter (for image formats and transforms the compositor doesn't support)
+		QPainter painter(background_canvas.get());
+		painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform | QPainter::TextAntialiasing, true);
+		painter.setTransform(transform);
+		painter.setOpacity(alpha_value);
+		painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+		painter.drawImage(0, 0, *source_image);
+		painter.end();
+	}
 
 	if (timeline) {
 		Timeline *t = static_cast<Timeline *>(timeline);
@@ -1281,11 +1336,13 @@ void Clip::apply_keyframes(std::shared_ptr<Frame> frame, QSize timeline_size) {
 			}
 
 			// Draw frame number on top of image
+			QPainter painter(background_canvas.get());
+			painter.setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing, true);
 			painter.setPen(QColor("#ffffff"));
 			painter.drawText(20, 20, QString(frame_number_str.str().c_str()));
+			painter.end();
 		}
 	}
-	painter.end();
 
 	// Add new QImage to frame
 	frame->AddImage(background_canvas);
@@ -1347,31 +1404,6 @@ QTransform Clip::get_transform(std::shared_ptr<Frame> frame, int width, int heig
 	// Get image from clip
 	std::shared_ptr<QImage> source_image = frame->GetImage();
 
-	/* ALPHA & OPACITY */
-	if (alpha.GetValue(frame->number) != 1.0)
-	{
-		float alpha_value = alpha.GetValue(frame->number);
-
-		// Get source image's pixels
-		unsigned char *pixels = source_image->bits();
-
-		// Loop through pixels
-		for (int pixel = 0, byte_index=0; pixel < source_image->width() * source_image->height(); pixel++, byte_index+=4)
-		{
-			// Apply alpha to pixel values (since we use a premultiplied value, we must
-			// multiply the alpha with all colors).
-			pixels[byte_index + 0] *= alpha_value;
-			pixels[byte_index + 1] *= alpha_value;
-			pixels[byte_index + 2] *= alpha_value;
-			pixels[byte_index + 3] *= alpha_value;
-		}
-
-		// Debug output
-		ZmqLogger::Instance()->AppendDebugMethod("Clip::get_transform (Set Alpha & Opacity)",
-			"alpha_value", alpha_value,
-			"frame->number", frame->number);
-	}
-
 	/* RESIZE SOURCE IMAGE - based on scale type */
 	QSize source_size = scale_size(source_image->size(), scale, width, height);
 
@@ -271,6 +271,13 @@ namespace openshot {
 		/// Open the internal reader
 		void Open() override;
 
+		/// @brief Enable or disable audio-only mode (of this clip and its reader)
+		///
+		/// In audio-only mode, frames only contain audio (with time mapping and audio effects applied), and
+		/// no video is decoded, no images are created and no video effects or keyframes are applied.
+		void AudioOnly(bool enabled) override;
+		using ReaderBase::AudioOnly;
+
 		/// @brief Set the current reader
 		/// @param new_reader The reader to be used by this clip
 		void Reader(openshot::ReaderBase* new_reader);
@@ -0,0 +1,293 @@
+/**
+ * @file
+ * @brief Source file for ColorLut class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "ColorLut.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+
+#include <QByteArray>
+#include <QFile>
+
+#include "DataFileCache.h"
+#include "ZmqLogger.h"
+
+#if defined(__SSE2__)
+	#define OPENSHOT_LUT_SSE2
+	#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	#define OPENSHOT_LUT_NEON
+	#include <arm_neon.h>
+#endif
+
+using namespace openshot;
+
+// Max number of points along each side of a table (so every point index fits in a float exactly)
+static const int MAX_LUT_POINTS = 256;
+
+// Tables loaded from files (by path), 16 at most
+typedef DataFileCache<ColorLut, 16> LutFileCache;
+
+// The 4 corners of the tetrahedron which contains a color, and the weight of each corner
+struct Tetrahedron {
+	size_t points[4];
+	float weights[4];
+};
+
+// Find the tetrahedron which contains a color (from the point before the color, and the distance to the next point)
+static inline Tetrahedron GetTetrahedron(const float* index, const float* distance, int size) {
+	const float r = distance[0];
+	const float g = distance[1];
+	const float b = distance[2];
+	const size_t step_green = size_t(size);
+	const size_t step_blue = size_t(size) * size;
+
+	// Step from the first point along the axis with the largest distance, then the axis with the next
+	// largest distance, to the last point (ties may pick either tetrahedron, since both give the same color)
+	const bool red_largest = r >= g && r >= b;
+	const bool green_largest = !red_largest && g >= b;
+	const bool red_smallest = r < g && r < b;
+	const bool green_smallest = !red_smallest && g < b;
+	const size_t first_step = red_largest ? 1 : (green_largest ? step_green : step_blue);
+	const size_t last_step = red_smallest ? 1 : (green_smallest ? step_green : step_blue);
+
+	const float largest = std::max(r, std::max(g, b));
+	const float smallest = std::min(r, std::min(g, b));
+	const float middle = std::max(std::min(r, g), std::min(std::max(r, g), b));
+
+	const size_t base = size_t(index[0]) + size_t(index[1]) * step_green + size_t(index[2]) * step_blue;
+	const size_t corner = 1 + step_green + step_blue;
+	return {{base, base + first_step, base + corner - last_step, base + corner},
+			{1.0f - largest, largest - middle, middle - smallest, smallest}};
+}
+
+// Create a table from the colors of each point
+ColorLut::ColorLut(const std::string& key, int size, const std::vector<float>& colors)
+	: key(key), size(size), offset(0.0f), scale(0.0f), points(size_t(size) * size * size * 4, 0) {
+	const size_t values = points.size() / 4 * 3;
+	if (size < 2 || colors.size() < values)
+		return;
+
+	// Pack each value between the smallest and largest values of the table
+	float smallest = *std::min_element(colors.begin(), colors.begin() + values);
+	float largest = *std::max_element(colors.begin(), colors.begin() + values);
+	float range = largest - smallest;
+	offset = smallest * 255.0f;
+	scale = range * 255.0f / 65535.0f;
+
+	for (size_t point = 0; point < values / 3; point++) {
+		for (int channel = 0; channel < 3; channel++) {
+			float value = range > 0.0f ? (colors[point * 3 + channel] - smallest) / range : 0.0f;
+			points[point * 4 + channel] = uint16_t(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f));
+		}
+	}
+}
+
+// Parse the text of a .cube file
+bool ColorLut::Parse(const std::string& text, int& size, std::vector<float>& colors) {
+	int parsed_size = 0;
+	size_t total = 0;
+	std::vector<float> parsed;
+
+	const char* position = text.data();
+	const char* end = position + text.size();
+	while (position < end) {
+		// Get the next line (without leading and trailing whitespace)
+		const char* line_end = std::find(position, end, '\n');
+		const char* first = position;
+		const char* last = line_end;
+		position = line_end + (line_end < end ? 1 : 0);
+		while (first < last && std::isspace((unsigned char) *first))
+			first++;
+		while (last > first && std::isspace((unsigned char) last[-1]))
+			last--;
+		if (first == last || *first == '#')
+			continue;
+
+		// Find the size of the table (before any points)
+		if (parsed_size == 0) {
+			if (last - first > 11 && std::strncmp(first, "LUT_3D_SIZE", 11) == 0) {
+				parsed_size = QByteArray::fromRawData(first + 11, int(last - first - 11)).trimmed().toInt();
+				if (parsed_size < 2 || parsed_size > MAX_LUT_POINTS)
+					return false;
+				total = size_t(parsed_size) * parsed_size * parsed_size * 3;
+				parsed.reserve(total);
+			}
+			continue;
+		}
+
+		// Skip keywords (such as TITLE and DOMAIN_MIN)
+		if (std::isalpha((unsigned char) *first))
+			continue;
+
+		// Read the red, green and blue of a point
+		float point[3];
+		int count = 0;
+		for (const char* value = first; value < last && count < 3; ) {
+			const char* value_end = value;
+			while (value_end < last && !std::isspace((unsigned char) *value_end))
+				value_end++;
+			point[count++] = QByteArray::fromRawData(value, int(value_end - value)).toFloat();
+			value = value_end;
+			while (value < last && std::isspace((unsigned char) *value))
+				value++;
+		}
+		if (count == 3) {
+			parsed.insert(parsed.end(), point, point + 3);
+			if (parsed.size() == total)
+				break;
+		}
+	}
+
+	if (parsed_size == 0 || parsed.size() != total)
+		return false;
+
+	size = parsed_size;
+	colors.swap(parsed);
+	return true;
+}
+
+// Load a table from a .cube file (or get the cached table of the file)
+std::shared_ptr<const ColorLut> ColorLut::Load(const std::string& path) {
+	return LutFileCache::Create(path, [](const std::string& path, qint64 modified) {
+		QFile file(QString::fromStdString(path));
+		if (!file.open(QIODevice::ReadOnly))
+			return std::shared_ptr<const ColorLut>();
+		QByteArray contents = file.readAll();
+
+		int size = 0;
+		std::vector<float> colors;
+		std::shared_ptr<const ColorLut> lut;
+		if (Parse(std::string(contents.constData(), contents.size()), size, colors))
+			lut = std::make_shared<ColorLut>(path + "@" + std::to_string(modified) + ":" + std::to_string(contents.size()), size, colors);
+
+		// Debug output
+		ZmqLogger::Instance()->AppendDebugMethod("ColorLut::Load (Parse LUT)",
+			"bytes", contents.size(),
+			"size", size,
+			"valid", lut != nullptr);
+
+		return lut;
+	});
+}
+
+// Remove all tables loaded from files from the cache
+void ColorLut::ClearCache() {
+	LutFileCache::Clear();
+}
+
+// Look up the new color of each pixel
+void ColorLut::Lookup(const float* red, const float* green, const float* blue,
+					  float* new_red, float* new_green, float* new_blue, int pixels) const {
+	const float position_scale = (size - 1) / 255.0f;
+	const float last_position = float(size - 1);
+	const float last_index = float(size - 2);
+	const uint16_t* table = points.data();
+	int pixel = 0;
+
+#if defined(OPENSHOT_LUT_SSE2) || defined(OPENSHOT_LUT_NEON)
+	for (; pixel + 4 <= pixels; pixel += 4) {
+		// Find the point before each color (and the distance to the next point), for 4 pixels
+		float index[3][4];
+		float distance[3][4];
+		const float* colors[3] = {red + pixel, green + pixel, blue + pixel};
+		for (int channel = 0; channel < 3; channel++) {
+#if defined(OPENSHOT_LUT_SSE2)
+			__m128 position = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(colors[channel]), _mm_set1_ps(position_scale)),
+													_mm_setzero_ps()), _mm_set1_ps(last_position));
+			__m128 before = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(position)), _mm_set1_ps(last_index));
+			_mm_storeu_ps(index[channel], before);
+			_mm_storeu_ps(distance[channel], _mm_sub_ps(position, before));
+#else
+			float32x4_t position = vminq_f32(vmaxq_f32(vmulq_n_f32(vld1q_f32(colors[channel]), position_scale),
+													   vdupq_n_f32(0.0f)), vdupq_n_f32(last_position));
+			float32x4_t before = vminq_f32(vrndq_f32(position), vdupq_n_f32(last_index));
+			vst1q_f32(index[channel], before);
+			vst1q_f32(distance[channel], vsubq_f32(position, before));
+#endif
+		}
+
+		float results[4][4];
+		for (int i = 0; i < 4; i++) {
+			const float pixel_index[3] = {index[0][i], index[1][i], index[2][i]};
+			const float pixel_distance[3] = {distance[0][i], distance[1][i], distance[2][i]};
+			const Tetrahedron tetrahedron = GetTetrahedron(pixel_index, pixel_distance, size);
+			const uint16_t* point0 = table + tetrahedron.points[0] * 4;
+			const uint16_t* point1 = table + tetrahedron.points[1] * 4;
+			const uint16_t* point2 = table + tetrahedron.points[2] * 4;
+			const uint16_t* point3 = table + tetrahedron.points[3] * 4;
+			const float* weights = tetrahedron.weights;
+
+#if defined(OPENSHOT_LUT_SSE2)
+			const __m128i zero = _mm_setzero_si128();
+			__m128 color = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*) point0), zero)), _mm_set1_ps(weights[0]));
+			color = _mm_add_ps(color, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*) point1), zero)), _mm_set1_ps(weights[1])));
+			color = _mm_add_ps(color, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*) point2), zero)), _mm_set1_ps(weights[2])));
+			color = _mm_add_ps(color, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*) point3), zero)), _mm_set1_ps(weights[3])));
+			_mm_storeu_ps(results[i], _mm_add_ps(_mm_mul_ps(color, _mm_set1_ps(scale)), _mm_set1_ps(offset)));
+#else
+			float32x4_t color = vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vld1_u16(point0))), weights[0]);
+			color = vaddq_f32(color, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vld1_u16(point1))), weights[1]));
+			color = vaddq_f32(color, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vld1_u16(point2))), weights[2]));
+			color = vaddq_f32(color, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vld1_u16(point3))), weights[3]));
+			vst1q_f32(results[i], vaddq_f32(vmulq_n_f32(color, scale), vdupq_n_f32(offset)));
+#endif
+		}
+
+		// Split the channels of the 4 pixels
+#if defined(OPENSHOT_LUT_SSE2)
+		__m128 row0 = _mm_loadu_ps(results[0]);
+		__m128 row1 = _mm_loadu_ps(results[1]);
+		__m128 row2 = _mm_loadu_ps(results[2]);
+		__m128 row3 = _mm_loadu_ps(results[3]);
+		_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+		_mm_storeu_ps(new_red + pixel, row0);
+		_mm_storeu_ps(new_green + pixel, row1);
+		_mm_storeu_ps(new_blue + pixel, row2);
+#else
+		float32x4x4_t channels = vld4q_f32(results[0]);
+		vst1q_f32(new_red + pixel, channels.val[0]);
+		vst1q_f32(new_green + pixel, channels.val[1]);
+		vst1q_f32(new_blue + pixel, channels.val[2]);
+#endif
+	}
+#endif
+
+	for (; pixel < pixels; pixel++) {
+		const float colors[3] = {red[pixel], green[pixel], blue[pixel]};
+		float index[3];
+		float distance[3];
+		for (int channel = 0; channel < 3; channel++) {
+			float position = std::min(std::max(colors[channel] * position_scale, 0.0f), last_position);
+			index[channel] = std::min(float(int(position)), last_index);
+			distance[channel] = position - index[channel];
+		}
+
+		const Tetrahedron tetrahedron = GetTetrahedron(index, distance, size);
+		const uint16_t* point0 = table + tetrahedron.points[0] * 4;
+		const uint16_t* point1 = table + tetrahedron.points[1] * 4;
+		const uint16_t* point2 = table + tetrahedron.points[2] * 4;
+		const uint16_t* point3 = table + tetrahedron.points[3] * 4;
+		const float* weights = tetrahedron.weights;
+
+		float* new_colors[3] = {new_red + pixel, new_green + pixel, new_blue + pixel};
+		for (int channel = 0; channel < 3; channel++) {
+			float color = point0[channel] * weights[0];
+			color = color + point1[channel] * weights[1];
+			color = color + point2[channel] * weights[2];
+			color = color + point3[channel] * weights[3];
+			*new_colors[channel] = color * scale + offset;
+		}
+	}
+}
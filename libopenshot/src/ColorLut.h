@@ -0,0 +1,94 @@
+/**
+ * @file
+ * @brief Header file for ColorLut class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_COLOR_LUT_H
+#define OPENSHOT_COLOR_LUT_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace openshot {
+
+	/**
+	 * @brief This class is a 3D color lookup table (LUT), which maps each color to a new color
+	 *
+	 * A LUT is a cube of points (red changes fastest, then green, then blue), and each point stores the new
+	 * color of that point. Colors between the points are interpolated from the 4 corners of the tetrahedron
+	 * (of the 6 tetrahedrons which split the cube between the 8 nearest points) that contains the color,
+	 * which is faster than trilinear interpolation (of all 8 points), and keeps neutral colors neutral.
+	 *
+	 * Points are packed as 16-bit integers (between the smallest and largest value of the table), with 4
+	 * channels per point, so each point is a single 8-byte load. Lookups transform 4 pixels at a time with
+	 * SIMD (SSE2 or NEON).
+	 *
+	 * Tables loaded from .cube files are cached for the whole process by openshot::DataFileCache (by path,
+	 * size and modification time), so every effect which uses the same file shares a single parsed table.
+	 *
+	 * @code
+	 * std::shared_ptr<const ColorLut> lut = ColorLut::Load("/home/user/film.cube");
+	 * if (lut)
+	 *     lut->Lookup(red, green, blue, new_red, new_green, new_blue, pixels);
+	 * @endcode
+	 */
+	class ColorLut {
+	private:
+		std::string key;
+		int size;
+		float offset;	///< The value of a packed 0 (scaled to 0.0 to 255.0)
+		float scale;	///< The difference between packed values (scaled to 0.0 to 255.0)
+		std::vector<uint16_t> points; ///< Red, green, blue (and an unused 4th channel) of each point
+
+	public:
+		/// @brief Create a table from the colors of each point
+		/// @param key A key which identifies this table (tables with equal keys must have the same colors)
+		/// @param size The number of points along each side of the cube (2 or more)
+		/// @param colors The red, green and blue of each point (0.0 to 1.0, red changes fastest, then green, then blue)
+		ColorLut(const std::string& key, int size, const std::vector<float>& colors);
+
+		/// @brief Load a table from a .cube file (or get the cached table of the file, if it's unchanged)
+		/// @returns The table, or nullptr if the file can't be read, or isn't a valid 3D LUT
+		/// @param path The path of the .cube file
+		static std::shared_ptr<const ColorLut> Load(const std::string& path);
+
+		/// @brief Parse the text of a .cube file
+		/// @returns True if the text contains a complete 3D LUT
+		/// @param text The text of the .cube file
+		/// @param size The number of points along each side of the cube (set if successful)
+		/// @param colors The red, green and blue of each point (set if successful)
+		static bool Parse(const std::string& text, int& size, std::vector<float>& colors);
+
+		/// Remove all tables loaded from files from the cache (tables which are still in use are not freed)
+		static void ClearCache();
+
+		/// Get the key which identifies this table (the path, modification time and size of a .cube file)
+		const std::string& Key() const { return key; }
+
+		/// Get the number of points along each side of the cube
+		int Size() const { return size; }
+
+		/// @brief Look up the new color of each pixel
+		/// @param red The red values of each pixel (0.0 to 255.0)
+		/// @param green The green values of each pixel (0.0 to 255.0)
+		/// @param blue The blue values of each pixel (0.0 to 255.0)
+		/// @param new_red The new red values of each pixel (0.0 to 255.0, unless the table has values outside 0.0 to 1.0)
+		/// @param new_green The new green values of each pixel
+		/// @param new_blue The new blue values of each pixel
+		/// @param pixels The number of pixels
+		void Lookup(const float* red, const float* green, const float* blue,
+					float* new_red, float* new_green, float* new_blue, int pixels) const;
+	};
+
+}
+
+#endif // OPENSHOT_COLOR_LUT_H
@@ -0,0 +1,841 @@
+/**
+ * @file
+ * @brief Source file for ColorPipeline class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "ColorPipeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <mutex>
+
+#include "EffectBase.h"
+#include "Frame.h"
+#include "Settings.h"
+#include "ZmqLogger.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define OPENSHOT_COLOR_X86
+	#include <immintrin.h>
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+	#define OPENSHOT_COLOR_NEON
+	#include <arm_neon.h>
+#endif
+
+using namespace openshot;
+
+// Number of pixels transformed at a time (small enough to stay in the CPU cache between transforms)
+static const int PIPELINE_BLOCK_PIXELS = 1024;
+
+// Max number of baked lookup tables (and max size of each table)
+static const size_t MAX_BAKED_LUTS = 8;
+// Max number of transforms which are remembered (after they are used once) before they are baked
+static const size_t MAX_SEEN_LUTS = 64;
+static const int MAX_LUT_SIZE = 65;
+
+// Constants used for color saturation formula (the same as openshot::Saturation)
+static const double SATURATION_R = .299;
+static const double SATURATION_G = .587;
+static const double SATURATION_B = .114;
+
+// Lookup tables for removing (and multiplying) alpha, indexed by alpha (instead of dividing each color by alpha)
+struct AlphaTables {
+	float reciprocal[256];	///< Multiplier which removes pre-multiplied alpha
+	float percent[256];		///< Multiplier which pre-multiplies alpha
+
+	AlphaTables() {
+		for (int A = 0; A < 256; A++) {
+			// Rounded up slightly, so colors which are exact multiples of alpha are not truncated down
+			reciprocal[A] = A == 255 ? 1.0f : (A ? (255.0f / A) * (1.0f + 1.0f / (1 << 20)) : 0.0f);
+			percent[A] = A / 255.0;
+		}
+	}
+};
+
+static const AlphaTables& GetAlphaTables() {
+	static const AlphaTables tables;
+	return tables;
+}
+
+// Kernels for removing alpha, multiplying alpha, and transforming rows of colors
+typedef void (*UnpremultiplyRowFunction)(const unsigned char* pixels, float* red, float* green, float* blue, int count);
+typedef void (*PremultiplyRowFunction)(unsigned char* pixels, const float* red, const float* green, const float* blue, int count);
+typedef void (*LookupRowFunction)(float* colors, int count, const float* table);
+typedef void (*MatrixRowFunction)(float* red, float* green, float* blue, int count, const float* matrix);
+typedef void (*SaturateRowFunction)(float* red, float* green, float* blue, int count, const double* saturation);
+
+struct ColorKernels {
+	const char* name;
+	UnpremultiplyRowFunction unpremultiply;
+	PremultiplyRowFunction premultiply;
+	LookupRowFunction lookup;
+	MatrixRowFunction matrix;
+	SaturateRowFunction saturate;
+};
+
+// Constrain a color value from 0 to 255
+static inline int Constrain(int color_value) {
+	return color_value < 0 ? 0 : (color_value > 255 ? 255 : color_value);
+}
+
+// Remove pre-multiplied alpha from a row of pixels
+static void UnpremultiplyRowScalar(const unsigned char* pixels, float* red, float* green, float* blue, int count) {
+	const float* reciprocal = GetAlphaTables().reciprocal;
+	for (int pixel = 0; pixel < count; pixel++, pixels += 4) {
+		float alpha_reciprocal = reciprocal[pixels[3]];
+		red[pixel] = pixels[0] * alpha_reciprocal;
+		green[pixel] = pixels[1] * alpha_reciprocal;
+		blue[pixel] = pixels[2] * alpha_reciprocal;
+	}
+}
+
+// Pre-multiply alpha back into a row of pixels (transparent pixels are unchanged)
+static void PremultiplyRowScalar(unsigned char* pixels, const float* red, const float* green, const float* blue, int count) {
+	const float* percent = GetAlphaTables().percent;
+	for (int pixel = 0; pixel < count; pixel++, pixels += 4) {
+		int A = pixels[3];
+		if (A == 0)
+			continue;
+		float alpha_percent = percent[A];
+		pixels[0] = (unsigned char) (std::min(std::max(red[pixel], 0.0f), 255.0f) * alpha_percent);
+		pixels[1] = (unsigned char) (std::min(std::max(green[pixel], 0.0f), 255.0f) * alpha_percent);
+		pixels[2] = (unsigned char) (std::min(std::max(blue[pixel], 0.0f), 255.0f) * alpha_percent);
+	}
+}
+
+// Replace each color with an entry of a table
+static void LookupRowScalar(float* colors, int count, const float* table) {
+	for (int pixel = 0; pixel < count; pixel++)
+		colors[pixel] = table[Constrain(int(colors[pixel]))];
+}
+
+// Multiply colors by a 3x3 matrix
+static void MatrixRowScalar(float* red, float* green, float* blue, int count, const float* matrix) {
+	for (int pixel = 0; pixel < count; pixel++) {
+		int R = red[pixel];
+		int G = green[pixel];
+		int B = blue[pixel];
+		red[pixel] = Constrain(R * matrix[0] + G * matrix[1] + B * matrix[2]);
+		green[pixel] = Constrain(R * matrix[3] + G * matrix[4] + B * matrix[5]);
+		blue[pixel] = Constrain(R * matrix[6] + G * matrix[7] + B * matrix[8]);
+	}
+}
+
+// Adjust the saturation of colors (overall, and then for each channel)
+static void SaturateRowScalar(float* red, float* green, float* blue, int count, const double* saturation) {
+	for (int pixel = 0; pixel < count; pixel++) {
+		int R = red[pixel];
+		int G = green[pixel];
+		int B = blue[pixel];
+
+		// Common saturation adjustment
+		double p = sqrt((R * R * SATURATION_R) + (G * G * SATURATION_G) + (B * B * SATURATION_B));
+		R = Constrain(p + (R - p) * saturation[0]);
+		G = Constrain(p + (G - p) * saturation[0]);
+		B = Constrain(p + (B - p) * saturation[0]);
+
+		// Color-separated saturation adjustment (each channel is split into red, green and blue)
+		const double p_r = sqrt(R * R * SATURATION_R);
+		const double p_g = sqrt(G * G * SATURATION_G);
+		const double p_b = sqrt(B * B * SATURATION_B);
+
+		const int Rr = p_r + (R - p_r) * saturation[1];
+		const int Gr = p_r + (0 - p_r) * saturation[1];
+		const int Rg = p_g + (0 - p_g) * saturation[2];
+		const int Gg = p_g + (G - p_g) * saturation[2];
+		const int Rb = p_b + (0 - p_b) * saturation[3];
+		const int Bb = p_b + (B - p_b) * saturation[3];
+
+		// Recombine the brightness of the split channels (the other terms are equal to Gr, Rg and Rb)
+		red[pixel] = Constrain(Rr + Rg + Rb);
+		green[pixel] = Constrain(Gr + Gg + Rb);
+		blue[pixel] = Constrain(Gr + Rg + Bb);
+	}
+}
+
+#ifdef OPENSHOT_COLOR_X86
+
+// Remove pre-multiplied alpha from a row of pixels, 4 pixels at a time
+__attribute__((target("sse4.1")))
+static void UnpremultiplyRowSSE41(const unsigned char* pixels, float* red, float* green, float* blue, int count) {
+	const float* reciprocal = GetAlphaTables().reciprocal;
+	const __m128i channel_mask = _mm_set1_epi32(0xFF);
+	int pixel = 0;
+	for (; pixel + 4 <= count; pixel += 4) {
+		const unsigned char* source = pixels + pixel * 4;
+		__m128i values = _mm_loadu_si128((const __m128i*) source);
+		__m128 alpha_reciprocal = _mm_set_ps(reciprocal[source[15]], reciprocal[source[11]], reciprocal[source[7]], reciprocal[source[3]]);
+		_mm_storeu_ps(red + pixel, _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(values, channel_mask)), alpha_reciprocal));
+		_mm_storeu_ps(green + pixel, _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(values, 8), channel_mask)), alpha_reciprocal));
+		_mm_storeu_ps(blue + pixel, _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(values, 16), channel_mask)), alpha_reciprocal));
+	}
+	UnpremultiplyRowScalar(pixels + pixel * 4, red + pixel, green + pixel, blue + pixel, count - pixel);
+}
+
+// Constrain colors from 0.0 to 255.0, multiply them by alpha, and truncate them to integers
+__attribute__((target("sse4.1")))
+static inline __m128i PremultiplyChannelSSE41(const float* colors, __m128 alpha_percent) {
+	__m128 color = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(colors), _mm_setzero_ps()), _mm_set1_ps(255.0f));
+	return _mm_cvttps_epi32(_mm_mul_ps(color, alpha_percent));
+}
+
+// Pre-multiply alpha back into a row of pixels, 4 pixels at a time
+__attribute__((target("sse4.1")))
+static void PremultiplyRowSSE41(unsigned char* pixels, const float* red, const float* green, const float* blue, int count) {
+	const float* percent = GetAlphaTables().percent;
+	const __m128i alpha_mask = _mm_set1_epi32(int(0xFF000000));
+	int pixel = 0;
+	for (; pixel + 4 <= count; pixel += 4) {
+		unsigned char* destination = pixels + pixel * 4;
+		__m128i values = _mm_loadu_si128((const __m128i*) destination);
+		__m128 alpha_percent = _mm_set_ps(percent[destination[15]], percent[destination[11]], percent[destination[7]], percent[destination[3]]);
+		__m128i alpha = _mm_and_si128(values, alpha_mask);
+		__m128i result = _mm_or_si128(
+			_mm_or_si128(PremultiplyChannelSSE41(red + pixel, alpha_percent), _mm_slli_epi32(PremultiplyChannelSSE41(green + pixel, alpha_percent), 8)),
+			_mm_or_si128(_mm_slli_epi32(PremultiplyChannelSSE41(blue + pixel, alpha_percent), 16), alpha));
+
+		// Transparent pixels are unchanged
+		__m128i transparent = _mm_cmpeq_epi32(alpha, _mm_setzero_si128());
+		_mm_storeu_si128((__m128i*) destination, _mm_blendv_epi8(result, values, transparent));
+	}
+	PremultiplyRowScalar(pixels + pixel * 4, red + pixel, green + pixel, blue + pixel, count - pixel);
+}
+
+// Replace each color with an entry of a table, 4 colors at a time
+__attribute__((target("sse4.1")))
+static void LookupRowSSE41(float* colors, int count, const float* table) {
+	const __m128i max_index = _mm_set1_epi32(255);
+	int pixel = 0;
+	for (; pixel + 4 <= count; pixel += 4) {
+		__m128i index = _mm_min_epi32(_mm_max_epi32(_mm_cvttps_epi32(_mm_loadu_ps(colors + pixel)), _mm_setzero_si128()), max_index);
+		_mm_storeu_ps(colors + pixel, _mm_set_ps(table[_mm_extract_epi32(index, 3)], table[_mm_extract_epi32(index, 2)],
+			table[_mm_extract_epi32(index, 1)], table[_mm_extract_epi32(index, 0)]));
+	}
+	LookupRowScalar(colors + pixel, count - pixel, table);
+}
+
+// Multiply colors by a row of a matrix, and constrain the result (truncated to an integer)
+__attribute__((target("sse4.1")))
+static inline __m128 MatrixChannelSSE41(__m128 R, __m128 G, __m128 B, const float* row) {
+	__m128 value = _mm_add_ps(_mm_add_ps(_mm_mul_ps(R, _mm_set1_ps(row[0])), _mm_mul_ps(G, _mm_set1_ps(row[1]))), _mm_mul_ps(B, _mm_set1_ps(row[2])));
+	__m128i color = _mm_min_epi32(_mm_max_epi32(_mm_cvttps_epi32(value), _mm_setzero_si128()), _mm_set1_epi32(255));
+	return _mm_cvtepi32_ps(color);
+}
+
+// Multiply colors by a 3x3 matrix, 4 pixels at a time
+__attribute__((target("sse4.1")))
+static void MatrixRowSSE41(float* red, float* green, float* blue, int count, const float* matrix) {
+	int pixel = 0;
+	for (; pixel + 4 <= count; pixel += 4) {
+		__m128 R = _mm_round_ps(_mm_loadu_ps(red + pixel), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+		__m128 G = _mm_round_ps(_mm_loadu_ps(green + pixel), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+		__m128 B = _mm_round_ps(_mm_loadu_ps(blue + pixel), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+		_mm_storeu_ps(red + pixel, MatrixChannelSSE41(R, G, B, matrix));
+		_mm_storeu_ps(green + pixel, MatrixChannelSSE41(R, G, B, matrix + 3));
+		_mm_storeu_ps(blue + pixel, MatrixChannelSSE41(R, G, B, matrix + 6));
+	}
+	MatrixRowScalar(red + pixel, green + pixel, blue + pixel, count - pixel, matrix);
+}
+
+// Truncate to integers, and constrain from 0 to 255
+__attribute__((target("sse4.1")))
+static inline __m128d ConstrainSSE41(__m128d value) {
+	value = _mm_round_pd(value, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+	return _mm_min_pd(_mm_max_pd(value, _mm_setzero_pd()), _mm_set1_pd(255.0));
+}
+
+// Adjust saturation around a brightness: p + (color - p) * saturation (truncated to an integer)
+__attribute__((target("sse4.1")))
+static inline __m128d SaturateChannelSSE41(__m128d p, __m128d color, __m128d saturation) {
+	return _mm_round_pd(_mm_add_pd(p, _mm_mul_pd(_mm_sub_pd(color, p), saturation)), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+}
+
+// Adjust the saturation of colors, 2 pixels at a time (in double precision, the same as the scalar kernel)
+__attribute__((target("sse4.1")))
+static void SaturateRowSSE41(float* red, float* green, float* blue, int count, const double* saturation) {
+	const __m128d zero = _mm_setzero_pd();
+	const __m128d pR = _mm_set1_pd(SATURATION_R);
+	const __m128d pG = _mm_set1_pd(SATURATION_G);
+	const __m128d pB = _mm_set1_pd(SATURATION_B);
+	const __m128d saturation_value = _mm_set1_pd(saturation[0]);
+	const __m128d saturation_R = _mm_set1_pd(saturation[1]);
+	const __m128d saturation_G = _mm_set1_pd(saturation[2]);
+	const __m128d saturation_B = _mm_set1_pd(saturation[3]);
+	int pixel = 0;
+	for (; pixel + 2 <= count; pixel += 2) {
+		__m128d R = _mm_round_pd(_mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i*) (red + pixel)))), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+		__m128d G = _mm_round_pd(_mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i*) (green + pixel)))), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+		__m128d B = _mm_round_pd(_mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i*) (blue + pixel)))), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+
+		// Common saturation adjustment
+		__m128d p = _mm_sqrt_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(_mm_mul_pd(R, R), pR), _mm_mul_pd(_mm_mul_pd(G, G), pG)), _mm_mul_pd(_mm_mul_pd(B, B), pB)));
+		R = ConstrainSSE41(SaturateChannelSSE41(p, R, saturation_value));
+		G = ConstrainSSE41(SaturateChannelSSE41(p, G, saturation_value));
+		B = ConstrainSSE41(SaturateChannelSSE41(p, B, saturation_value));
+
+		// Color-separated saturation adjustment
+		__m128d p_r = _mm_sqrt_pd(_mm_mul_pd(_mm_mul_pd(R, R), pR));
+		__m128d p_g = _mm_sqrt_pd(_mm_mul_pd(_mm_mul_pd(G, G), pG));
+		__m128d p_b = _mm_sqrt_pd(_mm_mul_pd(_mm_mul_pd(B, B), pB));
+		__m128d Rr = SaturateChannelSSE41(p_r, R, saturation_R);
+		__m128d Gr = SaturateChannelSSE41(p_r, zero, saturation_R);
+		__m128d Rg = SaturateChannelSSE41(p_g, zero, saturation_G);
+		__m128d Gg = SaturateChannelSSE41(p_g, G, saturation_G);
+		__m128d Rb = SaturateChannelSSE41(p_b, zero, saturation_B);
+		__m128d Bb = SaturateChannelSSE41(p_b, B, saturation_B);
+
+		R = ConstrainSSE41(_mm_add_pd(_mm_add_pd(Rr, Rg), Rb));
+		G = ConstrainSSE41(_mm_add_pd(_mm_add_pd(Gr, Gg), Rb));
+		B = ConstrainSSE41(_mm_add_pd(_mm_add_pd(Gr, Rg), Bb));
+		_mm_storel_epi64((__m128i*) (red + pixel), _mm_castps_si128(_mm_cvtpd_ps(R)));
+		_mm_storel_epi64((__m128i*) (green + pixel), _mm_castps_si128(_mm_cvtpd_ps(G)));
+		_mm_storel_epi64((__m128i*) (blue + pixel), _mm_castps_si128(_mm_cvtpd_ps(B)));
+	}
+	SaturateRowScalar(red + pixel, green + pixel, blue + pixel, count - pixel, saturation);
+}
+
+// Remove pre-multiplied alpha from a row of pixels, 8 pixels at a time
+__attribute__((target("avx2")))
+static void UnpremultiplyRowAVX2(const unsigned char* pixels, float* red, float* green, float* blue, int count) {
+	const float* reciprocal = GetAlphaTables().reciprocal;
+	const __m256i channel_mask = _mm256_set1_epi32(0xFF);
+	int pixel = 0;
+	for (; pixel + 8 <= count; pixel += 8) {
+		__m256i values = _mm256_loadu_si256((const __m256i*) (pixels + pixel * 4));
+		__m256 alpha_reciprocal = _mm256_i32gather_ps(reciprocal, _mm256_srli_epi32(values, 24), 4);
+		_mm256_storeu_ps(red + pixel, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(values, channel_mask)), alpha_reciprocal));
+		_mm256_storeu_ps(green + pixel, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(values, 8), channel_mask)), alpha_reciprocal));
+		_mm256_storeu_ps(blue + pixel, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(values, 16), channel_mask)), alpha_reciprocal));
+	}
+	UnpremultiplyRowScalar(pixels + pixel * 4, red + pixel, green + pixel, blue + pixel, count - pixel);
+}
+
+// Constrain colors from 0.0 to 255.0, multiply them by alpha, and truncate them to integers
+__attribute__((target("avx2")))
+static inline __m256i PremultiplyChannelAVX2(const float* colors, __m256 alpha_percent) {
+	__m256 color = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(colors), _mm256_setzero_ps()), _mm256_set1_ps(255.0f));
+	return _mm256_cvttps_epi32(_mm256_mul_ps(color, alpha_percent));
+}
+
+// Pre-multiply alpha back into a row of pixels, 8 pixels at a time
+__attribute__((target("avx2")))
+static void PremultiplyRowAVX2(unsigned char* pixels, const float* red, const float* green, const float* blue, int count) {
+	const float* percent = GetAlphaTables().percent;
+	const __m256i alpha_mask = _mm256_set1_epi32(int(0xFF000000));
+	int pixel = 0;
+	for (; pixel + 8 <= count; pixel += 8) {
+		__m256i values = _mm256_loadu_si256((const __m256i*) (pixels + pixel * 4));
+		__m256 alpha_percent = _mm256_i32gather_ps(percent, _mm256_srli_epi32(values, 24), 4);
+		__m256i alpha = _mm256_and_si256(values, alpha_mask);
+		__m256i result = _mm256_or_si256(
+			_mm256_or_si256(PremultiplyChannelAVX2(red + pixel, alpha_percent), _mm256_slli_epi32(PremultiplyChannelAVX2(green + pixel, alpha_percent), 8)),
+			_mm256_or_si256(_mm256_slli_epi32(PremultiplyChannelAVX2(blue + pixel, alpha_percent), 16), alpha));
+
+		// Transparent pixels are unchanged
+		__m256i transparent = _mm256_cmpeq_epi32(alpha, _mm256_setzero_si256());
+		_mm256_storeu_si256((__m256i*) (pixels + pixel * 4), _mm256_blendv_epi8(result, values, transparent));
+	}
+	PremultiplyRowScalar(pixels + pixel * 4, red + pixel, green + pixel, blue + pixel, count - pixel);
+}
+
+// Replace each color with an entry of a table, 8 colors at a time
+__attribute__((target("avx2")))
+static void LookupRowAVX2(float* colors, int count, const float* table) {
+	const __m256i max_index = _mm256_set1_epi32(255);
+	int pixel = 0;
+	for (; pixel + 8 <= count; pixel += 8) {
+		__m256i index = _mm256_min_epi32(_mm256_max_epi32(_mm256_cvttps_epi32(_mm256_loadu_ps(colors + pixel)), _mm256_setzero_si256()), max_index);
+		_mm256_storeu_ps(colors + pixel, _mm256_i32gather_ps(table, index, 4));
+	}
+	LookupRowScalar(colors + pixel, count - pixel, table);
+}
+
+// Multiply colors by a row of a matrix, and constrain the result (truncated to an integer)
+__attribute__((target("avx2")))
+static inline __m256 MatrixChannelAVX2(__m256 R, __m256 G, __m256 B, const float* row) {
+	__m256 value = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(R, _mm256_set1_ps(row[0])), _mm256_mul_ps(G, _mm256_set1_ps(row[1]))), _mm256_mul_ps(B, _mm256_set1_ps(row[2])));
+	__m256i color = _mm256_min_epi32(_mm256_max_epi32(_mm256_cvttps_epi32(value), _mm256_setzero_si256()), _mm256_set1_epi32(255));
+	return _mm256_cvtepi32_ps(color);
+}
+
+// Multiply colors by a 3x3 matrix, 8 pixels at a time
+__attribute__((target("avx2")))
+static void MatrixRowAVX2(float* red, float* green, float* blue, int count, const float* matrix) {
+	int pixel = 0;
+	for (; pixel + 8 <= count; pixel += 8) {
+		__m256 R = _mm256_round_ps(_mm256_loadu_ps(red + pixel), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+		__m256 G = _mm256_round_ps(_mm256_loadu_ps(green + pixel), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+		__m256 B = _mm256_round_ps(_mm256_loadu_ps(blue + pixel), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+		_mm256_storeu_ps(red + pixel, MatrixChannelAVX2(R, G, B, matrix));
+		_mm256_storeu_ps(green + pixel, MatrixChannelAVX2(R, G, B, matrix + 3));
+		_mm256_storeu_ps(blue + pixel, MatrixChannelAVX2(R, G, B, matrix + 6));
+	}
+	MatrixRowScalar(red + pixel, green + pixel, blue + pixel, count - pixel, matrix);
+}
+
+// Truncate to integers, and constrain from 0 to 255
+__attribute__((target("avx2")))
+static inline __m256d ConstrainAVX2(__m256d value) {
+	value = _mm256_round_pd(value, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+	return _mm256_min_pd(_mm256_max_pd(value, _mm256_setzero_pd()), _mm256_set1_pd(255.0));
+}
+
+// Adjust saturation around a brightness: p + (color - p) * saturation (truncated to an integer)
+__attribute__((target("avx2")))
+static inline __m256d SaturateChannelAVX2(__m256d p, __m256d color, __m256d saturation) {
+	return _mm256_round_pd(_mm256_add_pd(p, _mm256_mul_pd(_mm256_sub_pd(color, p), saturation)), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+}
+
+// Adjust the saturation of colors, 4 pixels at a time (in double precision, the same as the scalar kernel)
+__attribute__((target("avx2")))
+static void SaturateRowAVX2(float* red, float* green, float* blue, int count, const double* saturation) {
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d pR = _mm256_set1_pd(SATURATION_R);
+	const __m256d pG = _mm256_set1_pd(SATURATION_G);
+	const __m256d pB = _mm256_set1_pd(SATURATION_B);
+	const __m256d saturation_value = _mm256_set1_pd(saturation[0]);
+	const __m256d saturation_R = _mm256_set1_pd(saturation[1]);
+	const __m256d saturation_G = _mm256_set1_pd(saturation[2]);
+	const __m256d saturation_B = _mm256_set1_pd(saturation[3]);
+	int pixel = 0;
+	for (; pixel + 4 <= count; pixel += 4) {
+		__m256d R = _mm256_round_pd(_mm256_cvtps_pd(_mm_loadu_ps(red + pixel)), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+		__m256d G = _mm256_round_pd(_mm256_cvtps_pd(_mm_loadu_ps(green + pixel)), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+		__m256d B = _mm256_round_pd(_mm256_cvtps_pd(_mm_loadu_ps(blue + pixel)), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+
+		// Common saturation adjustment
+		__m256d p = _mm256_sqrt_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(R, R), pR), _mm256_mul_pd(_mm256_mul_pd(G, G), pG)), _mm256_mul_pd(_mm256_mul_pd(B, B), pB)));
+		R = ConstrainAVX2(SaturateChannelAVX2(p, R, saturation_value));
+		G = ConstrainAVX2(SaturateChannelAVX2(p, G, saturation_value));
+		B = ConstrainAVX2(SaturateChannelAVX2(p, B, saturation_value));
+
+		// Color-separated saturation adjustment
+		__m256d p_r = _mm256_sqrt_pd(_mm256_mul_pd(_mm256_mul_pd(R, R), pR));
+		__m256d p_g = _mm256_sqrt_pd(_mm256_mul_pd(_mm256_mul_pd(G, G), pG));
+		__m256d p_b = _mm256_sqrt_pd(_mm256_mul_pd(_mm256_mul_pd(B, B), pB));
+		__m256d Rr = SaturateChannelAVX2(p_r, R, saturation_R);
+		__m256d Gr = SaturateChannelAVX2(p_r, zero, saturation_R);
+		__m256d Rg = SaturateChannelAVX2(p_g, zero, saturation_G);
+		__m256d Gg = SaturateChannelAVX2(p_g, G, saturation_G);
+		__m256d Rb = SaturateChannelAVX2(p_b, zero, saturation_B);
+		__m256d Bb = SaturateChannelAVX2(p_b, B, saturation_B);
+
+		_mm_storeu_ps(red + pixel, _mm256_cvtpd_ps(ConstrainAVX2(_mm256_add_pd(_mm256_add_pd(Rr, Rg), Rb))));
+		_mm_storeu_ps(green + pixel, _mm256_cvtpd_ps(ConstrainAVX2(_mm256_add_pd(_mm256_add_pd(Gr, Gg), Rb))));
+		_mm_storeu_ps(blue + pixel, _mm256_cvtpd_ps(ConstrainAVX2(_mm256_add_pd(_mm256_add_pd(Gr, Rg), Bb))));
+	}
+	SaturateRowScalar(red + pixel, green + pixel, blue + pixel, count - pixel, saturation);
+}
+
+#endif // OPENSHOT_COLOR_X86
+
+#ifdef OPENSHOT_COLOR_NEON
+
+// Remove pre-multiplied alpha from a row of pixels, 4 pixels at a time
+static void UnpremultiplyRowNEON(const unsigned char* pixels, float* red, float* green, float* blue, int count) {
+	const float* reciprocal = GetAlphaTables().reciprocal;
+	const uint32x4_t channel_mask = vdupq_n_u32(0xFF);
+	int pixel = 0;
+	for (; pixel + 4 <= count; pixel += 4) {
+		const unsigned char* source = pixels + pixel * 4;
+		uint32x4_t values = vreinterpretq_u32_u8(vld1q_u8(source));
+		const float alpha_values[4] = {reciprocal[source[3]], reciprocal[source[7]], reciprocal[source[11]], reciprocal[source[15]]};
+		float32x4_t alpha_reciprocal = vld1q_f32(alpha_values);
+		vst1q_f32(red + pixel, vmulq_f32(vcvtq_f32_u32(vandq_u32(values, channel_mask)), alpha_reciprocal));
+		vst1q_f32(green + pixel, vmulq_f32(vcvtq_f32_u32(vandq_u32(vshrq_n_u32(values, 8), channel_mask)), alpha_reciprocal));
+		vst1q_f32(blue + pixel, vmulq_f32(vcvtq_f32_u32(vandq_u32(vshrq_n_u32(values, 16), channel_mask)), alpha_reciprocal));
+	}
+	UnpremultiplyRowScalar(pixels + pixel * 4, red + pixel, green + pixel, blue + pixel, count - pixel);
+}
+
+// Constrain colors from 0.0 to 255.0, multiply them by alpha, and truncate them to integers
+static inline uint32x4_t PremultiplyChannelNEON(const float* colors, float32x4_t alpha_percent) {
+	float32x4_t color = vminq_f32(vmaxq_f32(vld1q_f32(colors), vdupq_n_f32(0.0f)), vdupq_n_f32(255.0f));
+	return vcvtq_u32_f32(vmulq_f32(color, alpha_percent));
+}
+
+// Pre-multiply alpha back into a row of pixels, 4 pixels at a time
+static void PremultiplyRowNEON(unsigned char* pixels, const float* red, const float* green, const float* blue, int count) {
+	const float* percent = GetAlphaTables().percent;
+	const uint32x4_t alpha_mask = vdupq_n_u32(0xFF000000);
+	int pixel = 0;
+	for (; pixel + 4 <= count; pixel += 4) {
+		unsigned char* destination = pixels + pixel * 4;
+		uint32x4_t values = vreinterpretq_u32_u8(vld1q_u8(destination));
+		const float alpha_values[4] = {percent[destination[3]], percent[destination[7]], percent[destination[11]], percent[destination[15]]};
+		float32x4_t alpha_percent = vld1q_f32(alpha_values);
+		uint32x4_t alpha = vandq_u32(values, alpha_mask);
+		uint32x4_t result = vorrq_u32(
+			vorrq_u32(PremultiplyChannelNEON(red + pixel, alpha_percent), vshlq_n_u32(PremultiplyChannelNEON(green + pixel, alpha_percent), 8)),
+			vorrq_u32(vshlq_n_u32(PremultiplyChannelNEON(blue + pixel, alpha_percent), 16), alpha));
+
+		// Transparent pixels are unchanged
+		uint32x4_t transparent = vceqq_u32(alpha, vdupq_n_u32(0));
+		vst1q_u8(destination, vreinterpretq_u8_u32(vbslq_u32(transparent, values, result)));
+	}
+	PremultiplyRowScalar(pixels + pixel * 4, red + pixel, green + pixel, blue + pixel, count - pixel);
+}
+
+// Multiply colors by a row of a matrix, and constrain the result (truncated to an integer)
+static inline float32x4_t MatrixChannelNEON(float32x4_t R, float32x4_t G, float32x4_t B, const float* row) {
+	float32x4_t value = vaddq_f32(vaddq_f32(vmulq_n_f32(R, row[0]), vmulq_n_f32(G, row[1])), vmulq_n_f32(B, row[2]));
+	int32x4_t color = vminq_s32(vmaxq_s32(vcvtq_s32_f32(value), vdupq_n_s32(0)), vdupq_n_s32(255));
+	return vcvtq_f32_s32(color);
+}
+
+// Multiply colors by a 3x3 matrix, 4 pixels at a time
+static void MatrixRowNEON(float* red, float* green, float* blue, int count, const float* matrix) {
+	int pixel = 0;
+	for (; pixel + 4 <= count; pixel += 4) {
+		float32x4_t R = vrndq_f32(vld1q_f32(red + pixel));
+		float32x4_t G = vrndq_f32(vld1q_f32(green + pixel));
+		float32x4_t B = vrndq_f32(vld1q_f32(blue + pixel));
+		vst1q_f32(red + pixel, MatrixChannelNEON(R, G, B, matrix));
+		vst1q_f32(green + pixel, MatrixChannelNEON(R, G, B, matrix + 3));
+		vst1q_f32(blue + pixel, MatrixChannelNEON(R, G, B, matrix + 6));
+	}
+	MatrixRowScalar(red + pixel, green + pixel, blue + pixel, count - pixel, matrix);
+}
+
+// Truncate to integers, and constrain from 0 to 255
+static inline float64x2_t ConstrainNEON(float64x2_t value) {
+	return vminq_f64(vmaxq_f64(vrndq_f64(value), vdupq_n_f64(0.0)), vdupq_n_f64(255.0));
+}
+
+// Adjust saturation around a brightness: p + (color - p) * saturation (truncated to an integer)
+static inline float64x2_t SaturateChannelNEON(float64x2_t p, float64x2_t color, double saturation) {
+	return vrndq_f64(vaddq_f64(p, vmulq_n_f64(vsubq_f64(color, p), saturation)));
+}
+
+// Adjust the saturation of colors, 2 pixels at a time (in double precision, the same as the scalar kernel)
+static void SaturateRowNEON(float* red, float* green, float* blue, int count, const double* saturation) {
+	const float64x2_t zero = vdupq_n_f64(0.0);
+	int pixel = 0;
+	for (; pixel + 2 <= count; pixel += 2) {
+		float64x2_t R = vrndq_f64(vcvt_f64_f32(vld1_f32(red + pixel)));
+		float64x2_t G = vrndq_f64(vcvt_f64_f32(vld1_f32(green + pixel)));
+		float64x2_t B = vrndq_f64(vcvt_f64_f32(vld1_f32(blue + pixel)));
+
+		// Common saturation adjustment
+		float64x2_t p = vsqrtq_f64(vaddq_f64(vaddq_f64(vmulq_n_f64(vmulq_f64(R, R), SATURATION_R),
+			vmulq_n_f64(vmulq_f64(G, G), SATURATION_G)), vmulq_n_f64(vmulq_f64(B, B), SATURATION_B)));
+		R = ConstrainNEON(SaturateChannelNEON(p, R, saturation[0]));
+		G = ConstrainNEON(SaturateChannelNEON(p, G, saturation[0]));
+		B = ConstrainNEON(SaturateChannelNEON(p, B, saturation[0]));
+
+		// Color-separated saturation adjustment
+		float64x2_t p_r = vsqrtq_f64(vmulq_n_f64(vmulq_f64(R, R), SATURATION_R));
+		float64x2_t p_g = vsqrtq_f64(vmulq_n_f64(vmulq_f64(G, G), SATURATION_G));
+		float64x2_t p_b = vsqrtq_f64(vmulq_n_f64(vmulq_f64(B, B), SATURATION_B));
+		float64x2_t Rr = SaturateChannelNEON(p_r, R, saturation[1]);
+		float64x2_t Gr = SaturateChannelNEON(p_r, zero, saturation[1]);
+		float64x2_t Rg = SaturateChannelNEON(p_g, zero, saturation[2]);
+		float64x2_t Gg = SaturateChannelNEON(p_g, G, saturation[2]);
+		float64x2_t Rb = SaturateChannelNEON(p_b, zero, saturation[3]);
+		float64x2_t Bb = SaturateChannelNEON(p_b, B, saturation[3]);
+
+		vst1_f32(red + pixel, vcvt_f32_f64(ConstrainNEON(vaddq_f64(vaddq_f64(Rr, Rg), Rb))));
+		vst1_f32(green + pixel, vcvt_f32_f64(ConstrainNEON(vaddq_f64(vaddq_f64(Gr, Gg), Rb))));
+		vst1_f32(blue + pixel, vcvt_f32_f64(ConstrainNEON(vaddq_f64(vaddq_f64(Gr, Rg), Bb))));
+	}
+	SaturateRowScalar(red + pixel, green + pixel, blue + pixel, count - pixel, saturation);
+}
+
+#endif // OPENSHOT_COLOR_NEON
+
+// Kernels for each instruction set
+static const ColorKernels scalar_kernels = {"scalar", UnpremultiplyRowScalar, PremultiplyRowScalar, LookupRowScalar, MatrixRowScalar, SaturateRowScalar};
+#ifdef OPENSHOT_COLOR_X86
+static const ColorKernels sse41_kernels = {"sse4.1", UnpremultiplyRowSSE41, PremultiplyRowSSE41, LookupRowSSE41, MatrixRowSSE41, SaturateRowSSE41};
+static const ColorKernels avx2_kernels = {"avx2", UnpremultiplyRowAVX2, PremultiplyRowAVX2, LookupRowAVX2, MatrixRowAVX2, SaturateRowAVX2};
+#endif
+#ifdef OPENSHOT_COLOR_NEON
+static const ColorKernels neon_kernels = {"neon", UnpremultiplyRowNEON, PremultiplyRowNEON, LookupRowScalar, MatrixRowNEON, SaturateRowNEON};
+#endif
+
+// Get the kernels supported by this CPU (fastest first)
+static std::vector<const ColorKernels*> GetSupportedKernels() {
+	std::vector<const ColorKernels*> kernels;
+#ifdef OPENSHOT_COLOR_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		kernels.push_back(&avx2_kernels);
+	if (__builtin_cpu_supports("sse4.1"))
+		kernels.push_back(&sse41_kernels);
+#endif
+#ifdef OPENSHOT_COLOR_NEON
+	kernels.push_back(&neon_kernels);
+#endif
+	kernels.push_back(&scalar_kernels);
+	return kernels;
+}
+
+// Kernels in use (the fastest supported kernels, unless changed by SetKernel)
+static std::atomic<const ColorKernels*> active_kernels(nullptr);
+
+static const ColorKernels* GetKernels() {
+	const ColorKernels* kernels = active_kernels.load();
+	if (!kernels) {
+		kernels = GetSupportedKernels().front();
+		active_kernels = kernels;
+	}
+	return kernels;
+}
+
+// Replace each color of a channel with an entry of a table
+void ColorTransform::LookupRow(float* colors, int pixels, const float* table) {
+	GetKernels()->lookup(colors, pixels, table);
+}
+
+// Multiply colors by a 3x3 matrix
+void ColorTransform::MatrixRow(float* red, float* green, float* blue, int pixels, const float* matrix) {
+	GetKernels()->matrix(red, green, blue, pixels, matrix);
+}
+
+// Adjust the saturation of colors
+void ColorTransform::SaturateRow(float* red, float* green, float* blue, int pixels, const double* saturation) {
+	GetKernels()->saturate(red, green, blue, pixels, saturation);
+}
+
+namespace openshot {
+
+	/// A list of color transforms, baked into a 3D lookup table (LUT) with trilinear interpolation
+	class BakedColorTransform : public ColorTransform {
+	private:
+		std::string key;
+		int size;
+		std::vector<float> table; ///< Red, green and blue of each point (red changes fastest, then green, then blue)
+
+	public:
+		BakedColorTransform(const std::string& key, int size, const std::vector<const ColorTransform*>& transforms)
+			: key(key), size(size), table(size_t(size) * size * size * 3) {
+			// Transform the color of every point of the table
+			const int points = size * size * size;
+			std::vector<float> red(points), green(points), blue(points);
+			for (int b = 0, point = 0; b < size; b++) {
+				for (int g = 0; g < size; g++) {
+					for (int r = 0; r < size; r++, point++) {
+						red[point] = r * 255.0f / (size - 1);
+						green[point] = g * 255.0f / (size - 1);
+						blue[point] = b * 255.0f / (size - 1);
+					}
+				}
+			}
+			for (const ColorTransform* transform : transforms)
+				transform->TransformRow(red.data(), green.data(), blue.data(), points);
+			for (int point = 0; point < points; point++) {
+				table[point * 3 + 0] = red[point];
+				table[point * 3 + 1] = green[point];
+				table[point * 3 + 2] = blue[point];
+			}
+		}
+
+		std::string Key() const override { return key; }
+
+		void TransformRow(float* red, float* green, float* blue, int pixels) const override {
+			const float scale = (size - 1) / 255.0f;
+			for (int pixel = 0; pixel < pixels; pixel++) {
+				float* colors[3] = {red + pixel, green + pixel, blue + pixel};
+
+				// Find the point before each color (and the distance to the next point)
+				int index[3];
+				float distance[3];
+				for (int channel = 0; channel < 3; channel++) {
+					float position = std::min(std::max(*colors[channel] * scale, 0.0f), float(size - 1));
+					index[channel] = std::min(int(position), size - 2);
+					distance[channel] = position - index[channel];
+				}
+
+				const float* base = table.data() + ((size_t(index[2]) * size + index[1]) * size + index[0]) * 3;
+				const size_t next_green = size_t(size) * 3;
+				const size_t next_blue = size_t(size) * size * 3;
+				for (int channel = 0; channel < 3; channel++) {
+					const float* point = base + channel;
+					float c00 = point[0] + (point[3] - point[0]) * distance[0];
+					float c10 = point[next_green] + (point[next_green + 3] - point[next_green]) * distance[0];
+					float c01 = point[next_blue] + (point[next_blue + 3] - point[next_blue]) * distance[0];
+					float c11 = point[next_blue + next_green] + (point[next_blue + next_green + 3] - point[next_blue + next_green]) * distance[0];
+					float c0 = c00 + (c10 - c00) * distance[1];
+					float c1 = c01 + (c11 - c01) * distance[1];
+					*colors[channel] = c0 + (c1 - c0) * distance[2];
+				}
+			}
+		}
+	};
+
+}
+
+// Lookup tables baked from transforms (and when each table was last used)
+struct BakedLut {
+	std::shared_ptr<const ColorTransform> lut;
+	uint64_t last_used;
+};
+static std::mutex baked_luts_mutex;
+static std::map<std::string, BakedLut> baked_luts;
+// Transforms which have been seen once, but not baked yet (and when each was seen)
+static std::map<std::string, uint64_t> seen_luts;
+static uint64_t baked_luts_clock = 0;
+
+// Remove the least recently used item of a cache (if there are too many items)
+template <typename Map, typename Function>
+static void EvictLeastRecentlyUsed(Map& items, size_t max_items, Function last_used) {
+	while (items.size() > max_items) {
+		auto oldest = items.begin();
+		for (auto item = items.begin(); item != items.end(); item++)
+			if (last_used(item->second) < last_used(oldest->second))
+				oldest = item;
+		items.erase(oldest);
+	}
+}
+
+// Get a lookup table for a list of transforms (only once the same transforms and values are used a 2nd time)
+static std::shared_ptr<const ColorTransform> GetBakedLut(const std::vector<const ColorTransform*>& transforms, int size) {
+	std::string key = std::to_string(size);
+	for (const ColorTransform* transform : transforms)
+		key += "|" + transform->Key();
+
+	{
+		const std::lock_guard<std::mutex> lock(baked_luts_mutex);
+		baked_luts_clock++;
+		auto baked = baked_luts.find(key);
+		if (baked != baked_luts.end()) {
+			baked->second.last_used = baked_luts_clock;
+			return baked->second.lut;
+		}
+		auto seen = seen_luts.find(key);
+		if (seen == seen_luts.end()) {
+			// Don't bake transforms which are only used once (i.e. animated values, which are kept apart
+			// from the baked tables, so they never evict them)
+			seen_luts[key] = baked_luts_clock;
+			EvictLeastRecentlyUsed(seen_luts, MAX_SEEN_LUTS, [](uint64_t last_used) { return last_used; });
+			return nullptr;
+		}
+		seen_luts.erase(seen);
+	}
+
+	// Bake a new table (without holding the lock)
+	auto lut = std::make_shared<BakedColorTransform>(key, size, transforms);
+
+	// Debug output
+	ZmqLogger::Instance()->AppendDebugMethod("ColorPipeline::GetBakedLut (Bake LUT)",
+		"size", size,
+		"transforms", transforms.size());
+
+	const std::lock_guard<std::mutex> lock(baked_luts_mutex);
+	baked_luts[key] = {lut, ++baked_luts_clock};
+	EvictLeastRecentlyUsed(baked_luts, MAX_BAKED_LUTS, [](const BakedLut& baked) { return baked.last_used; });
+	return lut;
+}
+
+// Add an effect to the pipeline (if it's a color effect)
+bool ColorPipeline::Add(EffectBase* effect, int64_t frame_number) {
+	std::shared_ptr<ColorTransform> transform = effect->GetColorTransform(frame_number);
+	if (!transform)
+		return false;
+
+	stages.push_back({effect, frame_number, transform});
+	return true;
+}
+
+// Apply all effects in the pipeline to a frame
+std::shared_ptr<Frame> ColorPipeline::Apply(std::shared_ptr<Frame> frame) {
+	if (stages.size() == 1) {
+		// Nothing to fuse (so let the effect apply itself)
+		frame = stages.front().effect->GetFrame(frame, stages.front().frame_number);
+
+	} else if (stages.size() > 1) {
+		// Debug output
+		ZmqLogger::Instance()->AppendDebugMethod("ColorPipeline::Apply (Fuse Effects)",
+			"frame->number", frame->number,
+			"effects", stages.size());
+
+		std::vector<std::shared_ptr<ColorTransform>> transforms;
+		for (const Stage& stage : stages)
+			transforms.push_back(stage.transform);
+		Apply(*frame->GetImage(), transforms);
+	}
+
+	stages.clear();
+	return frame;
+}
+
+// Apply color transforms to the pixels of an image
+void ColorPipeline::Apply(QImage& image, const std::vector<std::shared_ptr<ColorTransform>>& transforms) {
+	std::vector<const ColorTransform*> active_transforms;
+	for (const auto& transform : transforms) {
+		if (transform)
+			active_transforms.push_back(transform.get());
+	}
+	if (active_transforms.empty() || image.isNull() || image.depth() != 32)
+		return;
+
+	// Replace 2 or more transforms with a lookup table (if enabled)
+	std::shared_ptr<const ColorTransform> lut;
+	int lut_size = std::min(Settings::Instance()->COLOR_LUT_SIZE, MAX_LUT_SIZE);
+	if (lut_size >= 2 && active_transforms.size() > 1) {
+		lut = GetBakedLut(active_transforms, lut_size);
+		if (lut)
+			active_transforms.assign(1, lut.get());
+	}
+
+	const ColorKernels* kernels = GetKernels();
+	unsigned char *bits = image.bits();
+	int64_t bytes_per_line = image.bytesPerLine();
+	int width = image.width();
+	int height = image.height();
+
+	#pragma omp parallel for schedule(static)
+	for (int row = 0; row < height; row++) {
+		float red[PIPELINE_BLOCK_PIXELS];
+		float green[PIPELINE_BLOCK_PIXELS];
+		float blue[PIPELINE_BLOCK_PIXELS];
+		for (int first_pixel = 0; first_pixel < width; first_pixel += PIPELINE_BLOCK_PIXELS) {
+			int pixel_count = std::min(PIPELINE_BLOCK_PIXELS, width - first_pixel);
+			unsigned char *pixels = bits + row * bytes_per_line + first_pixel * 4;
+
+			// Remove pre-multiplied alpha
+			kernels->unpremultiply(pixels, red, green, blue, pixel_count);
+
+			// Transform the colors of this block
+			for (const ColorTransform* transform : active_transforms)
+				transform->TransformRow(red, green, blue, pixel_count);
+
+			// Pre-multiply the alpha back into the color channels (transparent pixels are unchanged)
+			kernels->premultiply(pixels, red, green, blue, pixel_count);
+		}
+	}
+}
+
+// Get the name of the kernels in use
+std::string ColorPipeline::Kernel() {
+	return GetKernels()->name;
+}
+
+// Get the names of all kernels supported by this CPU
+std::vector<std::string> ColorPipeline::SupportedKernels() {
+	std::vector<std::string> names;
+	for (const ColorKernels* kernels : GetSupportedKernels())
+		names.push_back(kernels->name);
+	return names;
+}
+
+// Change the kernels in use
+bool ColorPipeline::SetKernel(const std::string& name) {
+	for (const ColorKernels* kernels : GetSupportedKernels()) {
+		if (name == kernels->name) {
+			active_kernels = kernels;
+			return true;
+		}
+	}
+	return false;
+}
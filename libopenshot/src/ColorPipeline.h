@@ -0,0 +1,153 @@
+/**
+ * @file
+ * @brief Header file for ColorPipeline and ColorTransform classes
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_COLOR_PIPELINE_H
+#define OPENSHOT_COLOR_PIPELINE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <QImage>
+
+namespace openshot {
+
+	class EffectBase;
+	class Frame;
+
+	/**
+	 * @brief This abstract class is the base class of per-pixel color transforms (i.e. color effects)
+	 *
+	 * A color transform changes the color of each pixel, based only on the color of that pixel (and the
+	 * effect's keyframe values for a single frame). Effects such as openshot::Brightness return a transform
+	 * from EffectBase::GetColorTransform(), which allows adjacent color effects to be fused into a single
+	 * pass over an image (see openshot::ColorPipeline).
+	 *
+	 * Transforms work on straight (i.e. not premultiplied) colors, so alpha is removed only once for all
+	 * fused transforms, and only re-applied after the last transform.
+	 */
+	class ColorTransform {
+	protected:
+		/// Constrain a color value from 0 to 255
+		static int constrain(int color_value) { return color_value < 0 ? 0 : (color_value > 255 ? 255 : color_value); }
+
+		/// @brief Replace each color of a channel with an entry of a table (using the color, truncated to an integer, as the index)
+		/// @param colors The colors of a single channel
+		/// @param pixels The number of pixels
+		/// @param table The new color for each color from 0 to 255
+		static void LookupRow(float* colors, int pixels, const float* table);
+
+		/// @brief Multiply colors (truncated to integers) by a 3x3 matrix, and constrain the results (truncated to integers)
+		/// @param red The red values of each pixel
+		/// @param green The green values of each pixel
+		/// @param blue The blue values of each pixel
+		/// @param pixels The number of pixels
+		/// @param matrix The rows of the matrix (the 1st row calculates red, the 2nd green, and the 3rd blue)
+		static void MatrixRow(float* red, float* green, float* blue, int pixels, const float* matrix);
+
+		/// @brief Adjust the saturation of colors (truncated to integers), using the formula of openshot::Saturation
+		/// @param red The red values of each pixel
+		/// @param green The green values of each pixel
+		/// @param blue The blue values of each pixel
+		/// @param pixels The number of pixels
+		/// @param saturation The overall, red, green and blue saturation
+		static void SaturateRow(float* red, float* green, float* blue, int pixels, const double* saturation);
+
+	public:
+		virtual ~ColorTransform() = default;
+
+		/// Get a key which identifies this transform and its values (transforms with equal keys must change colors identically)
+		virtual std::string Key() const = 0;
+
+		/// @brief Transform a row of straight (i.e. not premultiplied) colors, in place
+		/// @param red The red values of each pixel (0.0 to 255.0)
+		/// @param green The green values of each pixel (0.0 to 255.0)
+		/// @param blue The blue values of each pixel (0.0 to 255.0)
+		/// @param pixels The number of pixels
+		virtual void TransformRow(float* red, float* green, float* blue, int pixels) const = 0;
+	};
+
+	/**
+	 * @brief This class fuses adjacent color effects, and applies them in a single pass over an image
+	 *
+	 * Each color effect (such as openshot::Brightness, openshot::Saturation, openshot::Hue, openshot::Negate
+	 * and openshot::ColorMap) normally removes alpha from every pixel, changes the color, and multiplies alpha
+	 * back in, on its own pass over the entire image. Adding these effects to a pipeline instead delays them,
+	 * until the pipeline is applied (i.e. before the next effect which is not a color effect), and then applies
+	 * all of them at once: one small block of pixels at a time, while the block is still in the CPU cache.
+	 *
+	 * Alpha is removed, and multiplied back in, with SIMD kernels (AVX2, SSE4.1 or NEON), chosen at runtime for the
+	 * current CPU (with a scalar fallback). These kernels also handle the math of the color effects, through the
+	 * helpers of openshot::ColorTransform. Every kernel produces the same colors as the scalar kernel.
+	 *
+	 * When openshot::Settings::COLOR_LUT_SIZE is set, and the same transforms (with the same keyframe values)
+	 * are applied to more than one frame, they are baked into a 3D lookup table (LUT), which replaces all of the
+	 * transforms with a single interpolated lookup for each pixel.
+	 *
+	 * @code
+	 * ColorPipeline pipeline;
+	 * for (auto effect : effects) {
+	 *     if (!pipeline.Add(effect, frame->number)) {
+	 *         // Apply pending color effects, before any other effect
+	 *         frame = pipeline.Apply(frame);
+	 *         frame = effect->GetFrame(frame, frame->number);
+	 *     }
+	 * }
+	 * frame = pipeline.Apply(frame);
+	 * @endcode
+	 */
+	class ColorPipeline {
+	private:
+		/// A color effect waiting to be applied
+		struct Stage {
+			EffectBase* effect;
+			int64_t frame_number;
+			std::shared_ptr<ColorTransform> transform;
+		};
+		std::vector<Stage> stages;
+
+	public:
+		/// @brief Add an effect to the pipeline (if it's a color effect)
+		/// @returns False if the effect is not a color effect (and it was not added)
+		/// @param effect The effect to add
+		/// @param frame_number The frame number of the effect
+		bool Add(EffectBase* effect, int64_t frame_number);
+
+		/// @brief Apply all effects in the pipeline to a frame (and remove them from the pipeline)
+		/// @returns The modified frame
+		/// @param frame The frame to apply the effects to
+		std::shared_ptr<openshot::Frame> Apply(std::shared_ptr<openshot::Frame> frame);
+
+		/// Get the number of effects waiting to be applied
+		size_t Count() const { return stages.size(); }
+
+		/// @brief Apply color transforms to the pixels of an image (in a single pass)
+		/// @param image The image to modify (32-bit premultiplied pixels, with alpha as the 4th byte)
+		/// @param transforms The transforms to apply (in order)
+		static void Apply(QImage& image, const std::vector<std::shared_ptr<ColorTransform>>& transforms);
+
+		/// Get the name of the SIMD kernels in use ("avx2", "sse4.1", "neon" or "scalar")
+		static std::string Kernel();
+
+		/// Get the names of all kernels supported by this CPU (fastest first)
+		static std::vector<std::string> SupportedKernels();
+
+		/// @brief Change the kernels in use (which defaults to the fastest kernels supported by this CPU)
+		/// @returns False if the kernels are not supported by this CPU (and the kernels in use are unchanged)
+		/// @param name The name of the kernels ("avx2", "sse4.1", "neon" or "scalar")
+		static bool SetKernel(const std::string& name);
+	};
+
+}
+
+#endif // OPENSHOT_COLOR_PIPELINE_H
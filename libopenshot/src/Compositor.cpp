@@ -0,0 +1,633 @@
+/**
+ * @file
+ * @brief Source file for Compositor class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "Compositor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define OPENSHOT_COMPOSITOR_X86
+	#include <immintrin.h>
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+	#define OPENSHOT_COMPOSITOR_NEON
+	#include <arm_neon.h>
+#endif
+
+using namespace openshot;
+
+// Number of destination rows in each tile (tiles are composited in parallel)
+static const int COMPOSITE_TILE_ROWS = 16;
+
+// Min number of destination pixels to composite tiles in parallel
+static const int64_t COMPOSITE_PARALLEL_PIXELS = 64 * 1024;
+
+// Source coordinates are fixed point numbers (with 32 fractional bits)
+static const int FIXED_BITS = 32;
+static const int64_t FIXED_ONE = int64_t(1) << FIXED_BITS;
+static const int64_t FIXED_HALF = FIXED_ONE >> 1;
+
+// Bilinear weights have 7 bits (so the sum of 2 weighted pixels fits in a signed 16-bit SIMD lane)
+static const int WEIGHT_BITS = 7;
+static const int WEIGHT_ONE = 1 << WEIGHT_BITS;
+
+// A row of destination pixels, mapped back to the source image
+struct SourceSpan {
+	const unsigned char* pixels;	///< Pixels of the source image
+	int64_t stride;		///< Bytes per line of the source image
+	int width;			///< Width of the source image
+	int height;			///< Height of the source image
+	int64_t u;			///< Source X coordinate of the center of the first destination pixel (fixed point)
+	int64_t v;			///< Source Y coordinate of the center of the first destination pixel (fixed point)
+	int64_t du;			///< Change of the source X coordinate for each destination pixel (fixed point)
+	int64_t dv;			///< Change of the source Y coordinate for each destination pixel (fixed point)
+	int64_t half_u;		///< Half the width of a destination pixel in the source image (fixed point)
+	int64_t half_v;		///< Half the height of a destination pixel in the source image (fixed point)
+	double scale_u;		///< Destination pixels per source pixel (horizontally)
+	double scale_v;		///< Destination pixels per source pixel (vertically)
+};
+
+// Kernels for blending and resampling rows of pixels
+typedef void (*BlendRowFunction)(unsigned char* destination, const unsigned char* source, int pixels, int opacity);
+typedef void (*ResampleRowFunction)(unsigned char* destination, const SourceSpan& span, int pixels);
+
+struct CompositeKernels {
+	const char* name;
+	BlendRowFunction blend;
+	ResampleRowFunction bilinear;
+};
+
+// Divide by 255 (rounded to the nearest integer) for values up to 255 * 255
+static inline unsigned int Div255(unsigned int value) {
+	value += 128;
+	return (value + (value >> 8)) >> 8;
+}
+
+// Blend a row of pixels (Source Over)
+static void BlendRowScalar(unsigned char* destination, const unsigned char* source, int pixels, int opacity) {
+	for (int pixel = 0; pixel < pixels; pixel++, destination += 4, source += 4) {
+		unsigned int red = source[0];
+		unsigned int green = source[1];
+		unsigned int blue = source[2];
+		unsigned int alpha = source[3];
+		if (opacity < 255) {
+			red = Div255(red * opacity);
+			green = Div255(green * opacity);
+			blue = Div255(blue * opacity);
+			alpha = Div255(alpha * opacity);
+		}
+
+		if (alpha == 0)
+			continue;
+
+		unsigned int inverse_alpha = 255 - alpha;
+		destination[0] = red + Div255(destination[0] * inverse_alpha);
+		destination[1] = green + Div255(destination[1] * inverse_alpha);
+		destination[2] = blue + Div255(destination[2] * inverse_alpha);
+		destination[3] = alpha + Div255(destination[3] * inverse_alpha);
+	}
+}
+
+// Check if a destination pixel is fully covered by the source image, and all 4 bilinear source pixels are inside it
+static inline bool IsInterior(const SourceSpan& span, int64_t u, int64_t v) {
+	int64_t x = (u - FIXED_HALF) >> FIXED_BITS;
+	int64_t y = (v - FIXED_HALF) >> FIXED_BITS;
+	return x >= 0 && x + 1 < span.width && y >= 0 && y + 1 < span.height
+		&& u >= span.half_u && u <= span.width * FIXED_ONE - span.half_u
+		&& v >= span.half_v && v <= span.height * FIXED_ONE - span.half_v;
+}
+
+// Get the coverage (0 to 255) of a destination pixel by the source image (used to anti-alias the edges)
+static inline unsigned int Coverage(const SourceSpan& span, int64_t u, int64_t v) {
+	double distance_u = double(std::min(u, span.width * FIXED_ONE - u)) / FIXED_ONE;
+	double distance_v = double(std::min(v, span.height * FIXED_ONE - v)) / FIXED_ONE;
+	double coverage_u = std::min(std::max(distance_u * span.scale_u + 0.5, 0.0), 1.0);
+	double coverage_v = std::min(std::max(distance_v * span.scale_v + 0.5, 0.0), 1.0);
+	return (unsigned int) (coverage_u * coverage_v * 255.0 + 0.5);
+}
+
+// Get a source pixel (clamped to the edges of the source image)
+static inline const unsigned char* SourcePixel(const SourceSpan& span, int64_t x, int64_t y) {
+	x = std::min(std::max(x, int64_t(0)), int64_t(span.width - 1));
+	y = std::min(std::max(y, int64_t(0)), int64_t(span.height - 1));
+	return span.pixels + y * span.stride + x * 4;
+}
+
+// Scale a pixel by its coverage (for pixels on the edges of the source image)
+static inline void ApplyCoverage(unsigned char* destination, unsigned int coverage) {
+	if (coverage >= 255)
+		return;
+	for (int channel = 0; channel < 4; channel++)
+		destination[channel] = Div255(destination[channel] * coverage);
+}
+
+// Interpolate a pixel between the 4 nearest source pixels
+static inline void BilinearPixel(unsigned char* destination, const SourceSpan& span, int64_t u, int64_t v) {
+	int64_t x = (u - FIXED_HALF) >> FIXED_BITS;
+	int64_t y = (v - FIXED_HALF) >> FIXED_BITS;
+	int dx = int(((u - FIXED_HALF) >> (FIXED_BITS - WEIGHT_BITS)) & (WEIGHT_ONE - 1));
+	int dy = int(((v - FIXED_HALF) >> (FIXED_BITS - WEIGHT_BITS)) & (WEIGHT_ONE - 1));
+
+	const unsigned char* top_left = SourcePixel(span, x, y);
+	const unsigned char* top_right = SourcePixel(span, x + 1, y);
+	const unsigned char* bottom_left = SourcePixel(span, x, y + 1);
+	const unsigned char* bottom_right = SourcePixel(span, x + 1, y + 1);
+	for (int channel = 0; channel < 4; channel++) {
+		int left = top_left[channel] * (WEIGHT_ONE - dy) + bottom_left[channel] * dy;
+		int right = top_right[channel] * (WEIGHT_ONE - dy) + bottom_right[channel] * dy;
+		destination[channel] = (left * (WEIGHT_ONE - dx) + right * dx + (1 << (2 * WEIGHT_BITS - 1))) >> (2 * WEIGHT_BITS);
+	}
+}
+
+// Interpolate a pixel on the edge of the source image (or outside of it)
+static inline void BilinearEdgePixel(unsigned char* destination, const SourceSpan& span, int64_t u, int64_t v) {
+	unsigned int coverage = Coverage(span, u, v);
+	if (coverage == 0) {
+		destination[0] = destination[1] = destination[2] = destination[3] = 0;
+		return;
+	}
+	BilinearPixel(destination, span, u, v);
+	ApplyCoverage(destination, coverage);
+}
+
+// Resample a row of pixels (bilinear)
+static void BilinearRowScalar(unsigned char* destination, const SourceSpan& span, int pixels) {
+	int64_t u = span.u;
+	int64_t v = span.v;
+	for (int pixel = 0; pixel < pixels; pixel++, destination += 4, u += span.du, v += span.dv) {
+		if (IsInterior(span, u, v))
+			BilinearPixel(destination, span, u, v);
+		else
+			BilinearEdgePixel(destination, span, u, v);
+	}
+}
+
+// Get the Catmull-Rom weights of the 4 nearest source pixels
+static inline void CubicWeights(float t, float weights[4]) {
+	float t2 = t * t;
+	float t3 = t2 * t;
+	weights[0] = -0.5f * t3 + t2 - 0.5f * t;
+	weights[1] = 1.5f * t3 - 2.5f * t2 + 1.0f;
+	weights[2] = -1.5f * t3 + 2.0f * t2 + 0.5f * t;
+	weights[3] = 0.5f * t3 - 0.5f * t2;
+}
+
+// Resample a row of pixels (bicubic, which is the same for all kernels)
+static void BicubicRow(unsigned char* destination, const SourceSpan& span, int pixels) {
+	int64_t u = span.u;
+	int64_t v = span.v;
+	for (int pixel = 0; pixel < pixels; pixel++, destination += 4, u += span.du, v += span.dv) {
+		unsigned int coverage = Coverage(span, u, v);
+		if (coverage == 0) {
+			destination[0] = destination[1] = destination[2] = destination[3] = 0;
+			continue;
+		}
+
+		int64_t x = (u - FIXED_HALF) >> FIXED_BITS;
+		int64_t y = (v - FIXED_HALF) >> FIXED_BITS;
+		float weights_x[4];
+		float weights_y[4];
+		CubicWeights(float((u - FIXED_HALF) & (FIXED_ONE - 1)) / float(FIXED_ONE), weights_x);
+		CubicWeights(float((v - FIXED_HALF) & (FIXED_ONE - 1)) / float(FIXED_ONE), weights_y);
+
+		float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+		for (int row = 0; row < 4; row++) {
+			for (int column = 0; column < 4; column++) {
+				const unsigned char* source = SourcePixel(span, x + column - 1, y + row - 1);
+				float weight = weights_x[column] * weights_y[row];
+				for (int channel = 0; channel < 4; channel++)
+					sum[channel] += source[channel] * weight;
+			}
+		}
+
+		// Clamp the overshoot of the filter (colors can't exceed alpha, since pixels are premultiplied)
+		int alpha = std::min(std::max(int(sum[3] + 0.5f), 0), 255);
+		for (int channel = 0; channel < 3; channel++)
+			destination[channel] = std::min(std::max(int(sum[channel] + 0.5f), 0), alpha);
+		destination[3] = alpha;
+		ApplyCoverage(destination, coverage);
+	}
+}
+
+#ifdef OPENSHOT_COMPOSITOR_X86
+
+// Divide 16-bit lanes by 255 (rounded to the nearest integer)
+__attribute__((target("sse4.1")))
+static inline __m128i Div255SSE41(__m128i value) {
+	value = _mm_add_epi16(value, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(value, _mm_srli_epi16(value, 8)), 8);
+}
+
+// Blend a row of pixels (Source Over), 4 pixels at a time
+__attribute__((target("sse4.1")))
+static void BlendRowSSE41(unsigned char* destination, const unsigned char* source, int pixels, int opacity) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alpha_mask = _mm_set1_epi32(int(0xFF000000));
+	const __m128i max_value = _mm_set1_epi16(255);
+	const __m128i opacity_value = _mm_set1_epi16(short(opacity));
+
+	int pixel = 0;
+	for (; pixel + 4 <= pixels; pixel += 4) {
+		__m128i source_pixels = _mm_loadu_si128((const __m128i*) (source + pixel * 4));
+		__m128i source_low = _mm_unpacklo_epi8(source_pixels, zero);
+		__m128i source_high = _mm_unpackhi_epi8(source_pixels, zero);
+		if (opacity < 255) {
+			source_low = Div255SSE41(_mm_mullo_epi16(source_low, opacity_value));
+			source_high = Div255SSE41(_mm_mullo_epi16(source_high, opacity_value));
+			source_pixels = _mm_packus_epi16(source_low, source_high);
+		}
+
+		// Skip transparent pixels, and copy opaque pixels
+		__m128i alpha = _mm_and_si128(source_pixels, alpha_mask);
+		if (_mm_testz_si128(alpha, alpha))
+			continue;
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alpha_mask)) == 0xFFFF) {
+			_mm_storeu_si128((__m128i*) (destination + pixel * 4), source_pixels);
+			continue;
+		}
+
+		__m128i inverse_low = _mm_sub_epi16(max_value, _mm_shufflehi_epi16(_mm_shufflelo_epi16(source_low, 0xFF), 0xFF));
+		__m128i inverse_high = _mm_sub_epi16(max_value, _mm_shufflehi_epi16(_mm_shufflelo_epi16(source_high, 0xFF), 0xFF));
+		__m128i destination_pixels = _mm_loadu_si128((const __m128i*) (destination + pixel * 4));
+		__m128i destination_low = Div255SSE41(_mm_mullo_epi16(_mm_unpacklo_epi8(destination_pixels, zero), inverse_low));
+		__m128i destination_high = Div255SSE41(_mm_mullo_epi16(_mm_unpackhi_epi8(destination_pixels, zero), inverse_high));
+		_mm_storeu_si128((__m128i*) (destination + pixel * 4),
+			_mm_adds_epu8(source_pixels, _mm_packus_epi16(destination_low, destination_high)));
+	}
+
+	BlendRowScalar(destination + pixel * 4, source + pixel * 4, pixels - pixel, opacity);
+}
+
+// Resample a row of pixels (bilinear), interpolating all 4 channels of a pixel at a time
+__attribute__((target("sse4.1")))
+static void BilinearRowSSE41(unsigned char* destination, const SourceSpan& span, int pixels) {
+	// Interleave the 16-bit channels of the left and right pixels (l0 r0 l1 r1 l2 r2 l3 r3)
+	const __m128i interleave = _mm_setr_epi8(0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15);
+	const __m128i rounding = _mm_set1_epi32(1 << (2 * WEIGHT_BITS - 1));
+
+	int64_t u = span.u;
+	int64_t v = span.v;
+	for (int pixel = 0; pixel < pixels; pixel++, destination += 4, u += span.du, v += span.dv) {
+		if (!IsInterior(span, u, v)) {
+			BilinearEdgePixel(destination, span, u, v);
+			continue;
+		}
+
+		int64_t x = (u - FIXED_HALF) >> FIXED_BITS;
+		int64_t y = (v - FIXED_HALF) >> FIXED_BITS;
+		int dx = int(((u - FIXED_HALF) >> (FIXED_BITS - WEIGHT_BITS)) & (WEIGHT_ONE - 1));
+		int dy = int(((v - FIXED_HALF) >> (FIXED_BITS - WEIGHT_BITS)) & (WEIGHT_ONE - 1));
+
+		// Load the 2 top and 2 bottom pixels, and interpolate vertically
+		const unsigned char* top = span.pixels + y * span.stride + x * 4;
+		__m128i top_pixels = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*) top));
+		__m128i bottom_pixels = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*) (top + span.stride)));
+		__m128i column = _mm_add_epi16(_mm_mullo_epi16(top_pixels, _mm_set1_epi16(short(WEIGHT_ONE - dy))),
+			_mm_mullo_epi16(bottom_pixels, _mm_set1_epi16(short(dy))));
+
+		// Interpolate horizontally (left * (1 - dx) + right * dx)
+		__m128i sum = _mm_madd_epi16(_mm_shuffle_epi8(column, interleave), _mm_set1_epi32((dx << 16) | (WEIGHT_ONE - dx)));
+		sum = _mm_srai_epi32(_mm_add_epi32(sum, rounding), 2 * WEIGHT_BITS);
+		__m128i result = _mm_packus_epi16(_mm_packs_epi32(sum, sum), sum);
+		int value = _mm_cvtsi128_si32(result);
+		std::memcpy(destination, &value, 4);
+	}
+}
+
+// Divide 16-bit lanes by 255 (rounded to the nearest integer)
+__attribute__((target("avx2")))
+static inline __m256i Div255AVX2(__m256i value) {
+	value = _mm256_add_epi16(value, _mm256_set1_epi16(128));
+	return _mm256_srli_epi16(_mm256_add_epi16(value, _mm256_srli_epi16(value, 8)), 8);
+}
+
+// Blend a row of pixels (Source Over), 8 pixels at a time
+__attribute__((target("avx2")))
+static void BlendRowAVX2(unsigned char* destination, const unsigned char* source, int pixels, int opacity) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i alpha_mask = _mm256_set1_epi32(int(0xFF000000));
+	const __m256i max_value = _mm256_set1_epi16(255);
+	const __m256i opacity_value = _mm256_set1_epi16(short(opacity));
+
+	int pixel = 0;
+	for (; pixel + 8 <= pixels; pixel += 8) {
+		// Unpack and pack within each 128-bit lane (so the order of the pixels is unchanged)
+		__m256i source_pixels = _mm256_loadu_si256((const __m256i*) (source + pixel * 4));
+		__m256i source_low = _mm256_unpacklo_epi8(source_pixels, zero);
+		__m256i source_high = _mm256_unpackhi_epi8(source_pixels, zero);
+		if (opacity < 255) {
+			source_low = Div255AVX2(_mm256_mullo_epi16(source_low, opacity_value));
+			source_high = Div255AVX2(_mm256_mullo_epi16(source_high, opacity_value));
+			source_pixels = _mm256_packus_epi16(source_low, source_high);
+		}
+
+		// Skip transparent pixels, and copy opaque pixels
+		__m256i alpha = _mm256_and_si256(source_pixels, alpha_mask);
+		if (_mm256_testz_si256(alpha, alpha))
+			continue;
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(alpha, alpha_mask)) == -1) {
+			_mm256_storeu_si256((__m256i*) (destination + pixel * 4), source_pixels);
+			continue;
+		}
+
+		__m256i inverse_low = _mm256_sub_epi16(max_value, _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(source_low, 0xFF), 0xFF));
+		__m256i inverse_high = _mm256_sub_epi16(max_value, _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(source_high, 0xFF), 0xFF));
+		__m256i destination_pixels = _mm256_loadu_si256((const __m256i*) (destination + pixel * 4));
+		__m256i destination_low = Div255AVX2(_mm256_mullo_epi16(_mm256_unpacklo_epi8(destination_pixels, zero), inverse_low));
+		__m256i destination_high = Div255AVX2(_mm256_mullo_epi16(_mm256_unpackhi_epi8(destination_pixels, zero), inverse_high));
+		_mm256_storeu_si256((__m256i*) (destination + pixel * 4),
+			_mm256_adds_epu8(source_pixels, _mm256_packus_epi16(destination_low, destination_high)));
+	}
+
+	BlendRowSSE41(destination + pixel * 4, source + pixel * 4, pixels - pixel, opacity);
+}
+
+#endif // OPENSHOT_COMPOSITOR_X86
+
+#ifdef OPENSHOT_COMPOSITOR_NEON
+
+// Multiply 8-bit lanes, and divide by 255 (rounded to the nearest integer)
+static inline uint8x16_t MulDiv255NEON(uint8x16_t value, uint8x16_t factor) {
+	const uint16x8_t rounding = vdupq_n_u16(128);
+	uint16x8_t low = vaddq_u16(vmull_u8(vget_low_u8(value), vget_low_u8(factor)), rounding);
+	uint16x8_t high = vaddq_u16(vmull_u8(vget_high_u8(value), vget_high_u8(factor)), rounding);
+	return vcombine_u8(vshrn_n_u16(vaddq_u16(low, vshrq_n_u16(low, 8)), 8),
+		vshrn_n_u16(vaddq_u16(high, vshrq_n_u16(high, 8)), 8));
+}
+
+// Blend a row of pixels (Source Over), 16 pixels at a time (with each channel in a separate register)
+static void BlendRowNEON(unsigned char* destination, const unsigned char* source, int pixels, int opacity) {
+	const uint8x16_t opacity_value = vdupq_n_u8(uint8_t(opacity));
+
+	int pixel = 0;
+	for (; pixel + 16 <= pixels; pixel += 16) {
+		uint8x16x4_t source_pixels = vld4q_u8(source + pixel * 4);
+		if (opacity < 255) {
+			for (int channel = 0; channel < 4; channel++)
+				source_pixels.val[channel] = MulDiv255NEON(source_pixels.val[channel], opacity_value);
+		}
+
+		// Skip transparent pixels, and copy opaque pixels
+		uint8x16_t alpha = source_pixels.val[3];
+		if (vmaxvq_u8(alpha) == 0)
+			continue;
+		if (vminvq_u8(alpha) == 255) {
+			vst4q_u8(destination + pixel * 4, source_pixels);
+			continue;
+		}
+
+		uint8x16_t inverse_alpha = vmvnq_u8(alpha);
+		uint8x16x4_t destination_pixels = vld4q_u8(destination + pixel * 4);
+		for (int channel = 0; channel < 4; channel++)
+			destination_pixels.val[channel] = vqaddq_u8(source_pixels.val[channel],
+				MulDiv255NEON(destination_pixels.val[channel], inverse_alpha));
+		vst4q_u8(destination + pixel * 4, destination_pixels);
+	}
+
+	BlendRowScalar(destination + pixel * 4, source + pixel * 4, pixels - pixel, opacity);
+}
+
+// Resample a row of pixels (bilinear), interpolating all 4 channels of a pixel at a time
+static void BilinearRowNEON(unsigned char* destination, const SourceSpan& span, int pixels) {
+	const uint32x4_t rounding = vdupq_n_u32(1 << (2 * WEIGHT_BITS - 1));
+
+	int64_t u = span.u;
+	int64_t v = span.v;
+	for (int pixel = 0; pixel < pixels; pixel++, destination += 4, u += span.du, v += span.dv) {
+		if (!IsInterior(span, u, v)) {
+			BilinearEdgePixel(destination, span, u, v);
+			continue;
+		}
+
+		int64_t x = (u - FIXED_HALF) >> FIXED_BITS;
+		int64_t y = (v - FIXED_HALF) >> FIXED_BITS;
+		int dx = int(((u - FIXED_HALF) >> (FIXED_BITS - WEIGHT_BITS)) & (WEIGHT_ONE - 1));
+		int dy = int(((v - FIXED_HALF) >> (FIXED_BITS - WEIGHT_BITS)) & (WEIGHT_ONE - 1));
+
+		// Load the 2 top and 2 bottom pixels, and interpolate vertically
+		const unsigned char* top = span.pixels + y * span.stride + x * 4;
+		uint16x8_t column = vmlal_u8(vmull_u8(vld1_u8(top), vdup_n_u8(uint8_t(WEIGHT_ONE - dy))),
+			vld1_u8(top + span.stride), vdup_n_u8(uint8_t(dy)));
+
+		// Interpolate horizontally (left * (1 - dx) + right * dx)
+		uint32x4_t sum = vmlal_u16(vmull_u16(vget_low_u16(column), vdup_n_u16(uint16_t(WEIGHT_ONE - dx))),
+			vget_high_u16(column), vdup_n_u16(uint16_t(dx)));
+		uint16x4_t result = vshrn_n_u32(vaddq_u32(sum, rounding), 2 * WEIGHT_BITS);
+		vst1_lane_u32((uint32_t*) destination, vreinterpret_u32_u8(vmovn_u16(vcombine_u16(result, result))), 0);
+	}
+}
+
+#endif // OPENSHOT_COMPOSITOR_NEON
+
+// Kernels for each instruction set
+static const CompositeKernels scalar_kernels = {"scalar", BlendRowScalar, BilinearRowScalar};
+#ifdef OPENSHOT_COMPOSITOR_X86
+static const CompositeKernels sse41_kernels = {"sse4.1", BlendRowSSE41, BilinearRowSSE41};
+static const CompositeKernels avx2_kernels = {"avx2", BlendRowAVX2, BilinearRowSSE41};
+#endif
+#ifdef OPENSHOT_COMPOSITOR_NEON
+static const CompositeKernels neon_kernels = {"neon", BlendRowNEON, BilinearRowNEON};
+#endif
+
+// Get the kernels supported by this CPU (fastest first)
+static std::vector<const CompositeKernels*> GetSupportedKernels() {
+	std::vector<const CompositeKernels*> kernels;
+#ifdef OPENSHOT_COMPOSITOR_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		kernels.push_back(&avx2_kernels);
+	if (__builtin_cpu_supports("sse4.1"))
+		kernels.push_back(&sse41_kernels);
+#endif
+#ifdef OPENSHOT_COMPOSITOR_NEON
+	kernels.push_back(&neon_kernels);
+#endif
+	kernels.push_back(&scalar_kernels);
+	return kernels;
+}
+
+// Kernels in use (the fastest supported kernels, unless changed by SetKernel)
+static std::atomic<const CompositeKernels*> active_kernels(nullptr);
+
+static const CompositeKernels* GetKernels() {
+	const CompositeKernels* kernels = active_kernels.load();
+	if (!kernels) {
+		kernels = GetSupportedKernels().front();
+		active_kernels = kernels;
+	}
+	return kernels;
+}
+
+// Process the rows of a region in tiles (which are processed in parallel, for large regions)
+template <typename TileFunction>
+static void ForEachTile(int top, int bottom, int width, TileFunction tile_function) {
+	int tile_count = (bottom - top + COMPOSITE_TILE_ROWS - 1) / COMPOSITE_TILE_ROWS;
+	bool is_parallel = tile_count > 1 && int64_t(bottom - top) * width >= COMPOSITE_PARALLEL_PIXELS;
+
+	#pragma omp parallel for schedule(dynamic) if (is_parallel)
+	for (int tile = 0; tile < tile_count; tile++) {
+		int first_row = top + tile * COMPOSITE_TILE_ROWS;
+		tile_function(first_row, std::min(bottom, first_row + COMPOSITE_TILE_ROWS));
+	}
+}
+
+// Limit a range of columns to where (start + step * column) is between min and max (exclusive)
+static void ClipColumns(double start, double step, double min, double max, double& first, double& last) {
+	if (step == 0.0) {
+		if (start <= min || start >= max)
+			last = first - 1.0;
+		return;
+	}
+	double column_min = (min - start) / step;
+	double column_max = (max - start) / step;
+	if (step < 0.0)
+		std::swap(column_min, column_max);
+	first = std::max(first, column_min);
+	last = std::min(last, column_max);
+}
+
+// Composite an image on top of another image
+bool Compositor::Composite(QImage& destination, const QImage& source, const QTransform& transform,
+	float opacity, CompositeFilter filter) {
+	// Only premultiplied RGBA8888 images and affine transforms are supported
+	if (destination.format() != QImage::Format_RGBA8888_Premultiplied
+		|| source.format() != QImage::Format_RGBA8888_Premultiplied || transform.type() == QTransform::TxProject)
+		return false;
+
+	// Skip images which are empty or fully transparent
+	int alpha = int(std::round(std::min(std::max(opacity, 0.0f), 1.0f) * 255.0f));
+	if (alpha == 0 || source.isNull() || destination.isNull())
+		return true;
+
+	const CompositeKernels* kernels = GetKernels();
+	unsigned char* destination_pixels = destination.bits();
+	const unsigned char* source_pixels = source.constBits();
+	int64_t destination_stride = destination.bytesPerLine();
+	int64_t source_stride = source.bytesPerLine();
+
+	// Blend whole-pixel translations directly (no resampling needed)
+	if (transform.type() <= QTransform::TxTranslate) {
+		double offset_x = std::round(transform.dx());
+		double offset_y = std::round(transform.dy());
+		if (std::abs(transform.dx() - offset_x) < 0.001 && std::abs(transform.dy() - offset_y) < 0.001) {
+			double left = std::max(0.0, offset_x);
+			double right = std::min(double(destination.width()), offset_x + source.width());
+			double top = std::max(0.0, offset_y);
+			double bottom = std::min(double(destination.height()), offset_y + source.height());
+			if (left >= right || top >= bottom)
+				return true;
+
+			int x = int(left);
+			int width = int(right - left);
+			int source_x = int(left - offset_x);
+			int source_offset_y = int(-offset_y);
+			ForEachTile(int(top), int(bottom), width, [&](int first_row, int last_row) {
+				for (int row = first_row; row < last_row; row++)
+					kernels->blend(destination_pixels + row * destination_stride + x * 4,
+						source_pixels + (row + source_offset_y) * source_stride + source_x * 4, width, alpha);
+			});
+			return true;
+		}
+	}
+
+	// Map destination pixels back to the source image (a transform which can't be inverted draws nothing)
+	bool is_invertible = false;
+	QTransform inverse = transform.inverted(&is_invertible);
+	if (!is_invertible)
+		return true;
+
+	// Find the destination pixels covered by the source image
+	QRectF bounds = transform.mapRect(QRectF(0, 0, source.width(), source.height()));
+	int left = int(std::max(0.0, std::floor(bounds.left())));
+	int right = int(std::min(double(destination.width()), std::ceil(bounds.right())));
+	int top = int(std::max(0.0, std::floor(bounds.top())));
+	int bottom = int(std::min(double(destination.height()), std::ceil(bounds.bottom())));
+	if (left >= right || top >= bottom)
+		return true;
+
+	// Size of a destination pixel in the source image (edges are anti-aliased over this distance)
+	double footprint_u = std::abs(inverse.m11()) + std::abs(inverse.m21());
+	double footprint_v = std::abs(inverse.m12()) + std::abs(inverse.m22());
+
+	SourceSpan source_span = {};
+	source_span.pixels = source_pixels;
+	source_span.stride = source_stride;
+	source_span.width = source.width();
+	source_span.height = source.height();
+	source_span.du = std::llround(inverse.m11() * FIXED_ONE);
+	source_span.dv = std::llround(inverse.m12() * FIXED_ONE);
+	source_span.half_u = std::llround(footprint_u * 0.5 * FIXED_ONE);
+	source_span.half_v = std::llround(footprint_v * 0.5 * FIXED_ONE);
+	source_span.scale_u = 1.0 / footprint_u;
+	source_span.scale_v = 1.0 / footprint_v;
+
+	ResampleRowFunction resample = (filter == COMPOSITE_BICUBIC) ? BicubicRow : kernels->bilinear;
+	ForEachTile(top, bottom, right - left, [&](int first_row, int last_row) {
+		std::vector<unsigned char> row_pixels(size_t(right - left) * 4);
+		SourceSpan span = source_span;
+
+		for (int row = first_row; row < last_row; row++) {
+			// Map the center of the first pixel of this row back to the source image
+			double u = inverse.m11() * (left + 0.5) + inverse.m21() * (row + 0.5) + inverse.dx();
+			double v = inverse.m12() * (left + 0.5) + inverse.m22() * (row + 0.5) + inverse.dy();
+
+			// Skip the pixels of this row which are outside the source image (with 1 pixel of margin for rounding)
+			double first = 0.0;
+			double last = right - left - 1;
+			ClipColumns(u, inverse.m11(), -footprint_u * 0.5, source.width() + footprint_u * 0.5, first, last);
+			ClipColumns(v, inverse.m12(), -footprint_v * 0.5, source.height() + footprint_v * 0.5, first, last);
+			if (first > last)
+				continue;
+			int begin = std::max(0, int(std::floor(first)) - 1);
+			int end = std::min(right - left, int(std::ceil(last)) + 2);
+
+			span.u = std::llround((u + begin * inverse.m11()) * FIXED_ONE);
+			span.v = std::llround((v + begin * inverse.m12()) * FIXED_ONE);
+			resample(row_pixels.data(), span, end - begin);
+			kernels->blend(destination_pixels + row * destination_stride + (left + begin) * 4, row_pixels.data(), end - begin, alpha);
+		}
+	});
+
+	return true;
+}
+
+// Blend a row of pixels on top of another row
+void Compositor::BlendRow(unsigned char* destination, const unsigned char* source, int pixels, int opacity) {
+	GetKernels()->blend(destination, source, pixels, std::min(std::max(opacity, 0), 255));
+}
+
+// Get the name of the kernels in use
+std::string Compositor::Kernel() {
+	return GetKernels()->name;
+}
+
+// Get the names of all kernels supported by this CPU
+std::vector<std::string> Compositor::SupportedKernels() {
+	std::vector<std::string> names;
+	for (const CompositeKernels* kernels : GetSupportedKernels())
+		names.push_back(kernels->name);
+	return names;
+}
+
+// Change the kernels in use
+bool Compositor::SetKernel(const std::string& name) {
+	for (const CompositeKernels* kernels : GetSupportedKernels()) {
+		if (name == kernels->name) {
+			active_kernels = kernels;
+			return true;
+		}
+	}
+	return false;
+}
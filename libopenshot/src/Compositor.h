@@ -0,0 +1,96 @@
+/**
+ * @file
+ * @brief Header file for Compositor class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_COMPOSITOR_H
+#define OPENSHOT_COMPOSITOR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <QImage>
+#include <QTransform>
+
+namespace openshot {
+
+	/// This enumeration determines how a transformed image is resampled
+	enum CompositeFilter
+	{
+		COMPOSITE_BILINEAR,	///< Interpolate between the 4 nearest pixels (the same as QPainter::SmoothPixmapTransform)
+		COMPOSITE_BICUBIC	///< Interpolate between the 16 nearest pixels (sharper when scaling up, but slower)
+	};
+
+	/**
+	 * @brief This class composites (i.e. draws) one image on top of another, replacing QPainter for frame images
+	 *
+	 * Every layer of a timeline is composited onto the layer below it, which makes this the most expensive
+	 * step of rendering (after decoding). QPainter handles every image format and transform, one row at a
+	 * time on a single thread. This class only handles premultiplied RGBA8888 images (the format of all
+	 * openshot::Frame images) and affine transforms, which allows it to:
+	 *
+	 * - Blend with SIMD kernels (AVX2, SSE4.1 or NEON), chosen at runtime for the current CPU, with a scalar fallback
+	 * - Skip resampling for identity and whole-pixel translations (which are blended directly)
+	 * - Split the destination into tiles of rows, which are composited in parallel
+	 *
+	 * Images are blended with the Source Over composition mode (the same as QPainter, except for rounding), and
+	 * the edges of transformed images are anti-aliased. Composite() returns false for any image or
+	 * transform it does not handle, so the caller can fall back to QPainter.
+	 *
+	 * @code
+	 * QTransform transform;
+	 * transform.translate(100, 50);
+	 * transform.scale(0.5, 0.5);
+	 *
+	 * // Draw a frame image at half size (and 80% opacity) on top of a background image
+	 * if (!Compositor::Composite(*background->GetImage(), *frame->GetImage(), transform, 0.8)) {
+	 *     QPainter painter(background->GetImage().get());
+	 *     painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform, true);
+	 *     painter.setTransform(transform);
+	 *     painter.setOpacity(0.8);
+	 *     painter.drawImage(0, 0, *frame->GetImage());
+	 * }
+	 * @endcode
+	 */
+	class Compositor {
+	public:
+		/// @brief Composite an image on top of another image (using the Source Over composition mode)
+		/// @returns False if the images or transform are not supported (and nothing was drawn)
+		/// @param destination The image to draw on (Format_RGBA8888_Premultiplied)
+		/// @param source The image to draw (Format_RGBA8888_Premultiplied)
+		/// @param transform The transform of the source image (translate, scale, rotate and shear)
+		/// @param opacity The opacity of the source image (0.0 to 1.0)
+		/// @param filter The resampling of transformed images
+		static bool Composite(QImage& destination, const QImage& source, const QTransform& transform,
+			float opacity = 1.0, CompositeFilter filter = COMPOSITE_BILINEAR);
+
+		/// @brief Blend a row of premultiplied RGBA8888 pixels on top of another row (using the Source Over composition mode)
+		/// @param destination The pixels to draw on
+		/// @param source The pixels to draw
+		/// @param pixels The number of pixels in each row
+		/// @param opacity The opacity of the source pixels (0 to 255)
+		static void BlendRow(unsigned char* destination, const unsigned char* source, int pixels, int opacity = 255);
+
+		/// Get the name of the SIMD kernels in use ("avx2", "sse4.1", "neon" or "scalar")
+		static std::string Kernel();
+
+		/// Get the names of all kernels supported by this CPU (fastest first)
+		static std::vector<std::string> SupportedKernels();
+
+		/// @brief Change the kernels in use (which defaults to the fastest kernels supported by this CPU)
+		/// @returns False if the kernels are not supported by this CPU (and the kernels in use are unchanged)
+		/// @param name The name of the kernels ("avx2", "sse4.1", "neon" or "scalar")
+		static bool SetKernel(const std::string& name);
+	};
+
+}
+
+#endif // OPENSHOT_COMPOSITOR_H
@@ -0,0 +1,123 @@
+/**
+ * @file
+ * @brief Header file for DataFileCache class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_DATA_FILE_CACHE_H
+#define OPENSHOT_DATA_FILE_CACHE_H
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <QDateTime>
+#include <QFileInfo>
+
+namespace openshot {
+
+	/**
+	 * @brief This class shares the data loaded from a file by every object which loads the same file
+	 *
+	 * Effects which load data from a file (such as the protobuf data of openshot::Tracker,
+	 * openshot::ObjectDetection and openshot::Stabilizer, or the tables of openshot::ColorLut) load each file
+	 * once for the whole process (by path, size and modification time), so opening a project (or applying a
+	 * JSON diff) with many effects that use the same file only parses it once. The data is read-only once it's
+	 * loaded, so it's shared without locks. Invalid files are cached too, so they are not parsed again until
+	 * they change.
+	 *
+	 * @code
+	 * std::shared_ptr<const StabilizationData> data = DataFileCache<StabilizationData>::Load(path,
+	 *     [](const std::string& path, StabilizationData& data) {
+	 *         // Parse the file into data (and return false if it's invalid)
+	 *     });
+	 * @endcode
+	 *
+	 * @tparam Data The type of data loaded from each file
+	 * @tparam MaxFiles Max number of files which are cached at once (a new file replaces the file which was
+	 * cached first)
+	 */
+	template <typename Data, size_t MaxFiles = 64>
+	class DataFileCache {
+	private:
+		// The data loaded from a file (and the modification time and size of the file, and when it was cached)
+		struct CachedData {
+			qint64 modified;
+			qint64 bytes;
+			std::shared_ptr<const Data> data;
+			unsigned long long order;
+		};
+		inline static std::mutex mutex;
+		inline static std::map<std::string, CachedData> cached;
+		inline static unsigned long long cachedFiles = 0;
+
+	public:
+		/// @brief Create the data of a file (or get the cached data of the file, if it's unchanged)
+		/// @param path The path of the file
+		/// @param create Called with the path and the modification time of the file (in milliseconds since
+		/// the epoch), to parse the file (returns the data, or nullptr if the file is invalid)
+		/// @returns The data, or nullptr if the file doesn't exist or is invalid
+		template <typename Function>
+		static std::shared_ptr<const Data> Create(const std::string& path, Function create) {
+			QFileInfo info(QString::fromStdString(path));
+			if (path.empty() || !info.isFile())
+				return nullptr;
+			qint64 modified = info.lastModified().toMSecsSinceEpoch();
+			qint64 bytes = info.size();
+
+			{
+				const std::lock_guard<std::mutex> lock(mutex);
+				auto file = cached.find(path);
+				if (file != cached.end() && file->second.modified == modified && file->second.bytes == bytes)
+					return file->second.data;
+			}
+
+			// Parse the file (without holding the lock)
+			std::shared_ptr<const Data> data = create(path, modified);
+
+			// Remove the file which was cached first, if the cache is full
+			const std::lock_guard<std::mutex> lock(mutex);
+			if (cached.size() >= MaxFiles && cached.find(path) == cached.end()) {
+				auto oldest = cached.begin();
+				for (auto file = cached.begin(); file != cached.end(); ++file)
+					if (file->second.order < oldest->second.order)
+						oldest = file;
+				cached.erase(oldest);
+			}
+			cached[path] = {modified, bytes, data, cachedFiles++};
+			return data;
+		}
+
+		/// @brief Load the data of a file (or get the cached data of the file, if it's unchanged)
+		/// @param path The path of the file
+		/// @param load Called with the path and an empty Data object, to parse the file (returns false if the
+		/// file is invalid)
+		/// @returns The data, or nullptr if the file doesn't exist or is invalid
+		template <typename Function>
+		static std::shared_ptr<const Data> Load(const std::string& path, Function load) {
+			return Create(path, [&load](const std::string& path, qint64) -> std::shared_ptr<const Data> {
+				std::shared_ptr<Data> data = std::make_shared<Data>();
+				if (!load(path, *data))
+					return nullptr;
+				return data;
+			});
+		}
+
+		/// Remove all files from the cache (data which is still in use is not freed)
+		static void Clear() {
+			const std::lock_guard<std::mutex> lock(mutex);
+			cached.clear();
+		}
+	};
+
+}
+
+#endif // OPENSHOT_DATA_FILE_CACHE_H
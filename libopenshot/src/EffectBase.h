@@ -24,6 +24,8 @@
 
 namespace openshot
 {
+	class ColorTransform;
+
 	/**
 	 * @brief This struct contains info about an effect, such as the name, video or audio effect, etc...
 	 *
@@ -90,6 +92,13 @@ namespace openshot
 		/// Return the ID of this effect's parent clip
 		std::string ParentClipId() const;
 
+		/// @brief Get the per-pixel color transform of this effect (only for color effects, which change each
+		/// pixel based only on its own color). Adjacent color effects are fused into a single pass over the
+		/// image, by openshot::ColorPipeline.
+		/// @returns An empty pointer, if this is not a color effect
+		/// @param frame_number The frame number of the effect
+		virtual std::shared_ptr<openshot::ColorTransform> GetColorTransform(int64_t frame_number) { return nullptr; }
+
 		/// Get the indexes and IDs of all visible objects in the given frame
 		virtual std::string GetVisibleObjects(int64_t frame_number) const {return {}; };
 
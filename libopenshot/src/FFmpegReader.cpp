@@ -20,6 +20,7 @@
 #include "FFmpegUtilities.h"
 
 #include "FFmpegReader.h"
+#include "BufferPool.h"
 #include "Exceptions.h"
 #include "Timeline.h"
 #include "ZmqLogger.h"
@@ -75,7 +76,8 @@ FFmpegReader::FFmpegReader(const std::string &path, bool inspect_reader)
 		  current_video_frame(0), packet(NULL), max_concurrent_frames(OPEN_MP_NUM_PROCESSORS), audio_pts(0),
 		  video_pts(0), pFormatCtx(NULL), videoStream(-1), audioStream(-1), pCodecCtx(NULL), aCodecCtx(NULL),
 		pStream(NULL), aStream(NULL), pFrame(NULL), previous_packet_location{-1,0},
-		hold_packet(false) {
+		hold_packet(false), read_ahead_next(0), read_ahead_target(0), is_read_ahead_running(false),
+		is_seek_index_cancelled(false) {
 
 	// Initialize FFMpeg, and register all formats and codecs
 	AV_REGISTER_ALL
@@ -98,6 +100,12 @@ FFmpegReader::FFmpegReader(const std::string &path, bool inspect_reader)
 }
 
 FFmpegReader::~FFmpegReader() {
+	// Stop decoding ahead (the thread uses this reader)
+	StopReadAhead();
+
+	// Stop indexing keyframes
+	StopSeekIndex();
+
 	if (is_open)
 		// Auto close reader if not already done
 		Close();
@@ -619,6 +627,9 @@ void FFmpegReader::Open() {
 			CheckFPS();
 		}
 
+		// Load (or start building) the keyframe index for faster seeking
+		StartSeekIndex();
+
 		// Mark as "open"
 		is_open = true;
 
@@ -629,6 +640,22 @@ void FFmpegReader::Open() {
 	}
 }
 
+// Enable or disable audio-only mode
+void FFmpegReader::AudioOnly(bool enabled) {
+	const std::lock_guard<std::recursive_mutex> lock(getFrameMutex);
+	if (enabled == audio_only)
+		return;
+	ReaderBase::AudioOnly(enabled);
+
+	// Cached frames have no image (or an image which is no longer needed)
+	final_cache.Clear();
+	working_cache.Clear();
+
+	// Reset the decoders (video packets are skipped in audio-only mode, so decoding must restart from a keyframe)
+	if (is_open)
+		Seek(1);
+}
+
 void FFmpegReader::Close() {
 	// Close all objects, if reader is 'open'
 	if (is_open) {
@@ -682,6 +709,9 @@ void FFmpegReader::Close() {
 				sws_freeContext(img_convert_ctx);
 				img_convert_ctx = nullptr;
 			}
+			for (auto slice_ctx : slice_convert_ctxs)
+				sws_freeContext(slice_ctx);
+			slice_convert_ctxs.clear();
 			if (pFrameRGB_cached) {
 				AV_FREE_FRAME(&pFrameRGB_cached);
 			}
@@ -1000,6 +1030,9 @@ std::shared_ptr<Frame> FFmpegReader::GetFrame(int64_t requested_frame) {
 	// Debug output
 	ZmqLogger::Instance()->AppendDebugMethod("FFmpegReader::GetFrame", "requested_frame", requested_frame, "last_frame", last_frame);
 
+	// Decode the next few frames in the background (if enabled)
+	UpdateReadAhead(requested_frame);
+
 	// Check the cache for this frame
 	std::shared_ptr<Frame> frame = final_cache.GetFrame(requested_frame);
 	if (frame) {
@@ -1026,9 +1059,15 @@ std::shared_ptr<Frame> FFmpegReader::GetFrame(int64_t requested_frame) {
 
 			// Are we within X frames of the requested frame?
 			int64_t diff = requested_frame - last_frame;
+			SeekIndex::Entry keyframe;
 			if (diff >= 1 && diff <= 20) {
 				// Continue walking the stream
 				frame = ReadStream(requested_frame);
+			} else if (diff > 20 && last_frame > 0 && FindKeyframe(requested_frame - 1, keyframe)
+				&& keyframe.pts <= ConvertFrameToVideoPTS(last_frame)) {
+				// No keyframes between the last frame and the requested frame (so a seek would
+				// land before the last frame), continue walking the stream
+				frame = ReadStream(requested_frame);
 			} else {
 				// Greater than 30 frames away, or backwards, we need to seek to the nearest key frame
 				if (enable_seek) {
@@ -1049,6 +1088,131 @@ std::shared_ptr<Frame> FFmpegReader::GetFrame(int64_t requested_frame) {
 	}
 }
 
+// Move the read-ahead window after the requested frame
+void FFmpegReader::UpdateReadAhead(int64_t requested_frame) {
+	// Never decode further ahead than the final cache can hold
+	int read_ahead_frames = std::min(openshot::Settings::Instance()->READ_AHEAD_FRAMES, max_concurrent_frames);
+	if (read_ahead_frames <= 0)
+		return;
+
+	{
+		const std::lock_guard<std::mutex> lock(read_ahead_mutex);
+		if (!is_read_ahead_running) {
+			// Start read-ahead thread (on first use)
+			is_read_ahead_running = true;
+			read_ahead_thread = std::thread(&FFmpegReader::ReadAhead, this);
+		}
+		read_ahead_next = requested_frame + 1;
+		read_ahead_target = requested_frame + read_ahead_frames;
+	}
+	read_ahead_condition.notify_one();
+}
+
+// Stop the read-ahead thread (if running)
+void FFmpegReader::StopReadAhead() {
+	{
+		const std::lock_guard<std::mutex> lock(read_ahead_mutex);
+		if (!is_read_ahead_running)
+			return;
+		is_read_ahead_running = false;
+	}
+	read_ahead_condition.notify_all();
+	if (read_ahead_thread.joinable())
+		read_ahead_thread.join();
+}
+
+// Load the seek index for this file (or start building it on a background thread)
+void FFmpegReader::StartSeekIndex() {
+	if (!openshot::Settings::Instance()->ENABLE_SEEK_INDEX || !enable_seek || !info.has_video || HasAlbumArt())
+		return;
+
+	const std::lock_guard<std::mutex> lock(seek_index_mutex);
+	if (seek_index || seek_index_thread.joinable())
+		// Already loaded (or building)
+		return;
+
+	// Load a saved index (if the file has not changed since it was indexed)
+	std::shared_ptr<SeekIndex> index = std::make_shared<SeekIndex>();
+	if (index->Load(path, videoStream)) {
+		seek_index = index;
+		return;
+	}
+
+	// Build (and save) the index, using a separate format context
+	is_seek_index_cancelled = false;
+	std::string index_path = path;
+	int video_stream = videoStream;
+	seek_index_thread = std::thread([this, index, index_path, video_stream]() {
+		if (index->Build(index_path, video_stream, &is_seek_index_cancelled)) {
+			index->Save(index_path);
+
+			const std::lock_guard<std::mutex> lock(seek_index_mutex);
+			seek_index = index;
+		}
+	});
+}
+
+// Stop building the seek index (if still running)
+void FFmpegReader::StopSeekIndex() {
+	is_seek_index_cancelled = true;
+	if (seek_index_thread.joinable())
+		seek_index_thread.join();
+}
+
+// Find the nearest indexed keyframe at (or before) a frame number
+bool FFmpegReader::FindKeyframe(int64_t requested_frame, SeekIndex::Entry& keyframe) {
+	std::shared_ptr<SeekIndex> index;
+	{
+		const std::lock_guard<std::mutex> lock(seek_index_mutex);
+		index = seek_index;
+	}
+	return index && index->Find(ConvertFrameToVideoPTS(requested_frame), keyframe);
+}
+
+// Decode frames ahead of the last requested frame (runs on the read-ahead thread)
+void FFmpegReader::ReadAhead() {
+	while (true) {
+		// Wait for frames to decode
+		int64_t next_frame = 0;
+		{
+			std::unique_lock<std::mutex> lock(read_ahead_mutex);
+			read_ahead_condition.wait(lock, [this]() {
+				return !is_read_ahead_running || read_ahead_next <= read_ahead_target;
+			});
+			if (!is_read_ahead_running)
+				break;
+			next_frame = read_ahead_next++;
+		}
+
+		// Skip frames which are already decoded
+		if (final_cache.Contains(next_frame))
+			continue;
+
+		// Decode the frame (while GetFrame waits, just like any other caller)
+		const std::lock_guard<std::recursive_mutex> lock(getFrameMutex);
+		bool is_decoded = false;
+
+		// Only continue walking the stream (seeking is left to GetFrame)
+		int64_t diff = next_frame - last_frame;
+		if (is_open && !is_seeking && !packet_status.end_of_file && next_frame <= info.video_length
+			&& diff >= 1 && diff <= 20) {
+			try {
+				ReadStream(next_frame);
+				is_decoded = true;
+			} catch (...) {
+				ZmqLogger::Instance()->AppendDebugMethod("FFmpegReader::ReadAhead (failed)", "next_frame", next_frame);
+			}
+		}
+
+		if (!is_decoded) {
+			// Wait until the next frame is requested
+			const std::lock_guard<std::mutex> ahead_lock(read_ahead_mutex);
+			if (read_ahead_next == next_frame + 1)
+				read_ahead_target = 0;
+		}
+	}
+}
+
 // Read the stream until we find the requested Frame
 std::shared_ptr<Frame> FFmpegReader::ReadStream(int64_t requested_frame) {
 	// Allocate video frame
@@ -1098,9 +1262,9 @@ std::shared_ptr<Frame> FFmpegReader::ReadStream(int64_t requested_frame) {
 		}
 
 		// Video packet
-		if ((info.has_video && packet && packet->stream_index == videoStream) ||
-			(info.has_video && packet_status.video_decoded < packet_status.video_read) ||
-			(info.has_video && !packet && !packet_status.video_eof)) {
+		if ((IsVideoDecoded() && packet && packet->stream_index == videoStream) ||
+			(IsVideoDecoded() && packet_status.video_decoded < packet_status.video_read) ||
+			(IsVideoDecoded() && !packet && !packet_status.video_eof)) {
 			// Process Video Packet
 			ProcessVideoPacket(requested_frame);
 		}
@@ -1113,8 +1277,8 @@ std::shared_ptr<Frame> FFmpegReader::ReadStream(int64_t requested_frame) {
 		}
 
 		// Remove unused packets (sometimes we purposely ignore video or audio packets,
-		// if the has_video or has_audio properties are manually overridden)
-		if ((!info.has_video && packet && packet->stream_index == videoStream) ||
+		// if the has_video or has_audio properties are manually overridden, or in audio-only mode)
+		if ((!IsVideoDecoded() && packet && packet->stream_index == videoStream) ||
 			(!info.has_audio && packet && packet->stream_index == audioStream)) {
 			// Keep track of deleted packet counts
 			if (packet->stream_index == videoStream) {
@@ -1181,7 +1345,7 @@ std::shared_ptr<Frame> FFmpegReader::ReadStream(int64_t requested_frame) {
 			std::shared_ptr<Frame> f = CreateFrame(largest_frame_processed);
 
 			// Use solid color (if no image data found)
-			if (!frame->has_image_data) {
+			if (!frame->has_image_data && !audio_only) {
 				// Use solid black frame if no image data available
 				f->AddColor(info.width, info.height, "#000");
 			}
@@ -1192,7 +1356,8 @@ std::shared_ptr<Frame> FFmpegReader::ReadStream(int64_t requested_frame) {
 		} else {
 			// The largest processed frame is no longer in cache, return a blank frame
 			std::shared_ptr<Frame> f = CreateFrame(largest_frame_processed);
-			f->AddColor(info.width, info.height, "#000");
+			if (!audio_only)
+				f->AddColor(info.width, info.height, "#000");
 			f->AddAudioSilence(samples_in_frame);
 			return f;
 		}
@@ -1404,7 +1569,7 @@ bool FFmpegReader::CheckSeek(bool is_video) {
 			return false;
 
 		// Check for both streams
-		if ((info.has_video && !seek_video_frame_found) || (info.has_audio && !seek_audio_frame_found))
+		if ((IsVideoDecoded() && !seek_video_frame_found) || (info.has_audio && !seek_audio_frame_found))
 			return false;
 
 		// Determine max seeked frame
@@ -1566,14 +1731,15 @@ void FFmpegReader::ProcessVideoPacket(int64_t requested_frame) {
 		}
 	}
 
-	// Determine required buffer size and allocate buffer
-	const int bytes_per_pixel = 4;
-	int raw_buffer_size = (width * height * bytes_per_pixel) + 128;
+	// Images with no alpha channel are already premultiplied (speed optimization). Images with an
+	// alpha channel are converted to premultiplied when added to the frame (which is slower).
+	QImage::Format image_format = QImage::Format_RGBA8888_Premultiplied;
+	if (ffmpeg_has_alpha(AV_GET_CODEC_PIXEL_FORMAT(pStream, pCodecCtx)))
+		image_format = QImage::Format_RGBA8888;
 
-	// Aligned memory allocation (for speed)
-	constexpr size_t ALIGNMENT = 32;  // AVX2
-	int buffer_size = ((raw_buffer_size + ALIGNMENT - 1) / ALIGNMENT) * ALIGNMENT;
-	buffer = (unsigned char*) aligned_malloc(buffer_size, ALIGNMENT);
+	// Get an aligned image buffer from the pool (for speed)
+	std::shared_ptr<QImage> image = BufferPool::Instance()->CreateImage(width, height, image_format);
+	buffer = image->bits();
 
 	// Copy picture data from one AVFrame (or AVPicture) to another one.
 	AV_COPY_PICTURE_DATA(pFrameRGB, buffer, PIX_FMT_RGBA, width, height);
@@ -1582,25 +1748,23 @@ void FFmpegReader::ProcessVideoPacket(int64_t requested_frame) {
 	if (openshot::Settings::Instance()->HIGH_QUALITY_SCALING) {
 		scale_mode = SWS_BICUBIC;
 	}
-	img_convert_ctx = sws_getCachedContext(img_convert_ctx, info.width, info.height, AV_GET_CODEC_PIXEL_FORMAT(pStream, pCodecCtx), width, height, PIX_FMT_RGBA, scale_mode, NULL, NULL, NULL);
-	if (!img_convert_ctx)
-		throw OutOfMemory("Failed to initialize sws context", path);
 
-	// Resize / Convert to RGB
-	sws_scale(img_convert_ctx, pFrame->data, pFrame->linesize, 0,
-			  original_height, pFrameRGB->data, pFrameRGB->linesize);
+	// Convert to RGB in parallel slices (if possible)
+	if (!ConvertSlices(pFrame, pix_fmt, pFrameRGB, width, height, scale_mode)) {
+		img_convert_ctx = sws_getCachedContext(img_convert_ctx, info.width, info.height, pix_fmt, width, height, PIX_FMT_RGBA, scale_mode, NULL, NULL, NULL);
+		if (!img_convert_ctx)
+			throw OutOfMemory("Failed to initialize sws context", path);
+
+		// Resize / Convert to RGB
+		sws_scale(img_convert_ctx, pFrame->data, pFrame->linesize, 0,
+				  original_height, pFrameRGB->data, pFrameRGB->linesize);
+	}
 
 	// Create or get the existing frame object
 	std::shared_ptr<Frame> f = CreateFrame(current_frame);
 
 	// Add Image data to frame
-	if (!ffmpeg_has_alpha(AV_GET_CODEC_PIXEL_FORMAT(pStream, pCodecCtx))) {
-		// Add image with no alpha channel, Speed optimization
-		f->AddImage(width, height, bytes_per_pixel, QImage::Format_RGBA8888_Premultiplied, buffer);
-	} else {
-		// Add image with alpha channel (this will be converted to premultipled when needed, but is slower)
-		f->AddImage(width, height, bytes_per_pixel, QImage::Format_RGBA8888, buffer);
-	}
+	f->AddImage(image);
 
 	// Update working cache
 	working_cache.Add(f);
@@ -1621,6 +1785,57 @@ void FFmpegReader::ProcessVideoPacket(int64_t requested_frame) {
 	ZmqLogger::Instance()->AppendDebugMethod("FFmpegReader::ProcessVideoPacket (After)", "requested_frame", requested_frame, "current_frame", current_frame, "f->number", f->number, "video_pts_seconds", video_pts_seconds);
 }
 
+// Convert a decoded image to RGBA in parallel horizontal slices
+bool FFmpegReader::ConvertSlices(AVFrame *source, PixelFormat pix_fmt, AVFrame *dest, int width, int height, int scale_mode) {
+	// Only unscaled conversions are sliced (each output row then only depends on its own source rows)
+	if (width != info.width || height != info.height || height % 2 != 0)
+		return false;
+
+	// Skip formats which can't be split into rows (palettes, hardware frames, etc...), and formats
+	// whose chroma rows are interpolated (which would differ at the edges of each slice)
+	const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pix_fmt);
+	if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM)))
+		return false;
+	if (desc->log2_chroma_h != 0 && pix_fmt != AV_PIX_FMT_YUV420P && pix_fmt != AV_PIX_FMT_YUVJ420P)
+		return false;
+
+	// Split into slices of at least 64 rows (each starting on a multiple of 16 rows)
+	int slice_count = std::min(OPEN_MP_NUM_PROCESSORS, height / 64);
+	if (slice_count < 2)
+		return false;
+	int slice_height = ((height / slice_count) + 15) / 16 * 16;
+	slice_count = (height + slice_height - 1) / slice_height;
+
+	// Init a scaler context for each slice (these are reused, while the slice sizes are unchanged)
+	if (int(slice_convert_ctxs.size()) < slice_count)
+		slice_convert_ctxs.resize(slice_count, nullptr);
+	for (int slice = 0; slice < slice_count; slice++) {
+		int slice_rows = std::min(slice_height, height - slice * slice_height);
+		slice_convert_ctxs[slice] = sws_getCachedContext(slice_convert_ctxs[slice], width, slice_rows, pix_fmt,
+			width, slice_rows, PIX_FMT_RGBA, scale_mode, NULL, NULL, NULL);
+		if (!slice_convert_ctxs[slice])
+			return false;
+	}
+
+	#pragma omp parallel for num_threads(slice_count) schedule(static)
+	for (int slice = 0; slice < slice_count; slice++) {
+		int first_row = slice * slice_height;
+		int slice_rows = std::min(slice_height, height - first_row);
+
+		// Point at the first row of this slice in each plane (chroma planes may have fewer rows)
+		const uint8_t *source_data[4] = {};
+		for (int plane = 0; plane < 4 && source->data[plane]; plane++) {
+			int plane_row = (plane == 1 || plane == 2) ? (first_row >> desc->log2_chroma_h) : first_row;
+			source_data[plane] = source->data[plane] + int64_t(plane_row) * source->linesize[plane];
+		}
+		uint8_t *dest_data[4] = {dest->data[0] + int64_t(first_row) * dest->linesize[0], NULL, NULL, NULL};
+
+		sws_scale(slice_convert_ctxs[slice], source_data, source->linesize, 0, slice_rows, dest_data, dest->linesize);
+	}
+
+	return true;
+}
+
 // Process an audio packet
 void FFmpegReader::ProcessAudioPacket(int64_t requested_frame) {
 	AudioLocation location;
@@ -1922,8 +2137,21 @@ void FFmpegReader::Seek(int64_t requested_frame) {
 		bool seek_worked = false;
 		int64_t seek_target = 0;
 
-		// Seek video stream (if any), except album arts
-		if (!seek_worked && info.has_video && !HasAlbumArt()) {
+		// Seek video stream directly to the nearest indexed keyframe before the requested frame (if any)
+		SeekIndex::Entry keyframe;
+		if (!seek_worked && IsVideoDecoded() && !HasAlbumArt() && FindKeyframe(requested_frame - 1, keyframe)) {
+			seek_target = keyframe.pts;
+			if (av_seek_frame(pFormatCtx, info.video_stream_index, seek_target, AVSEEK_FLAG_BACKWARD) >= 0 ||
+				(keyframe.pos >= 0 && !(pFormatCtx->iformat->flags & AVFMT_NO_BYTE_SEEK) &&
+				 av_seek_frame(pFormatCtx, -1, keyframe.pos, AVSEEK_FLAG_BYTE) >= 0)) {
+				// VIDEO SEEK (to indexed keyframe)
+				is_video_seek = true;
+				seek_worked = true;
+			}
+		}
+
+		// Seek video stream (if any, and not in audio-only mode), except album arts
+		if (!seek_worked && IsVideoDecoded() && !HasAlbumArt()) {
 			seek_target = ConvertFrameToVideoPTS(requested_frame - buffer_amount);
 			if (av_seek_frame(pFormatCtx, info.video_stream_index, seek_target, AVSEEK_FLAG_BACKWARD) < 0) {
 				fprintf(stderr, "%s: error while seeking video stream\n", pFormatCtx->AV_FILENAME);
@@ -2226,7 +2454,7 @@ bool FFmpegReader::IsPartialFrame(int64_t requested_frame) {
 		max_seeked_frame = seek_video_frame_found;
 	}
 	if ((info.has_audio && seek_audio_frame_found && max_seeked_frame >= requested_frame) ||
-		(info.has_video && seek_video_frame_found && max_seeked_frame >= requested_frame)) {
+		(IsVideoDecoded() && seek_video_frame_found && max_seeked_frame >= requested_frame)) {
 		seek_trash = true;
 	}
 
@@ -2274,7 +2502,7 @@ void FFmpegReader::CheckWorkingFrames(int64_t requested_frame) {
 											"frame_pts_seconds", frame_pts_seconds, 
 											"video_pts_seconds", video_pts_seconds, 
 											"recent_pts_diff", recent_pts_diff);
-			if (info.has_video && !f->has_image_data) {
+			if (IsVideoDecoded() && !f->has_image_data) {
 				// Frame has no image data (copy from previous frame)
 				// Loop backwards through final frames (looking for the nearest, previous frame image)
 				for (int64_t previous_frame = requested_frame - 1; previous_frame > 0; previous_frame--) {
@@ -2313,7 +2541,7 @@ void FFmpegReader::CheckWorkingFrames(int64_t requested_frame) {
 		bool is_seek_trash = IsPartialFrame(f->number);
 
 		// Adjust for available streams
-		if (!info.has_video) is_video_ready = true;
+		if (!IsVideoDecoded()) is_video_ready = true;
 		if (!info.has_audio) is_audio_ready = true;
 
 		// Debug output
@@ -2490,8 +2718,16 @@ void FFmpegReader::SetJsonValue(const Json::Value root) {
 	ReaderBase::SetJsonValue(root);
 
 	// Set data from Json (if key is found)
-	if (!root["path"].isNull())
-		path = root["path"].asString();
+	if (!root["path"].isNull()) {
+		std::string new_path = root["path"].asString();
+		if (new_path != path) {
+			// Forget the seek index of the previous file
+			StopSeekIndex();
+			const std::lock_guard<std::mutex> lock(seek_index_mutex);
+			seek_index.reset();
+		}
+		path = new_path;
+	}
 
 	// Re-Open path, and re-init everything (if needed)
 	if (is_open) {
@@ -21,15 +21,21 @@
 // Include FFmpeg headers and macros
 #include "FFmpegUtilities.h"
 
+#include <atomic>
 #include <cmath>
+#include <condition_variable>
 #include <ctime>
 #include <iostream>
 #include <stdio.h>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "AudioLocation.h"
 #include "CacheMemory.h"
 #include "Clip.h"
 #include "OpenMPUtilities.h"
+#include "SeekIndex.h"
 #include "Settings.h"
 #include <cstdlib>
 
@@ -153,6 +159,21 @@ namespace openshot {
 		SwsContext *img_convert_ctx = nullptr;        ///< Cached video scaler context
 		SWRCONTEXT *avr_ctx = nullptr;                ///< Cached audio resample context
 		AVFrame *pFrameRGB_cached = nullptr;          ///< Temporary frame used for video conversion
+		std::vector<SwsContext *> slice_convert_ctxs; ///< Cached video scaler contexts (one per slice)
+
+		// Read-ahead (decodes frames after the last requested frame on a background thread)
+		std::thread read_ahead_thread;
+		std::mutex read_ahead_mutex;
+		std::condition_variable read_ahead_condition;
+		int64_t read_ahead_next;                      ///< Next frame number to decode ahead
+		int64_t read_ahead_target;                    ///< Decode ahead up to (and including) this frame number
+		bool is_read_ahead_running;
+
+		// Seek index (keyframe timestamps of the video stream, loaded from disk or built on a background thread)
+		std::shared_ptr<SeekIndex> seek_index;
+		std::mutex seek_index_mutex;
+		std::thread seek_index_thread;
+		std::atomic<bool> is_seek_index_cancelled;
 
 		int hw_de_supported = 0;	// Is set by FFmpegReader
 #if USE_HW_ACCEL
@@ -179,12 +200,18 @@ namespace openshot {
 		/// Convert Video PTS into Frame Number
 		int64_t ConvertVideoPTStoFrame(int64_t pts);
 
+		/// Convert a decoded image to RGBA in parallel horizontal slices (returns false if it can't be sliced exactly)
+		bool ConvertSlices(AVFrame *source, PixelFormat pix_fmt, AVFrame *dest, int width, int height, int scale_mode);
+
 		/// Create a new Frame (or return an existing one) and add it to the working queue.
 		std::shared_ptr<openshot::Frame> CreateFrame(int64_t requested_frame);
 
 		/// Calculate Starting video frame and sample # for an audio PTS
 		AudioLocation GetAudioPTSLocation(int64_t pts);
 
+		/// Find the nearest indexed keyframe at (or before) a frame number (returns false if there is no seek index)
+		bool FindKeyframe(int64_t requested_frame, SeekIndex::Entry& keyframe);
+
 		/// Get an AVFrame (if any)
 		bool GetAVFrame();
 
@@ -200,12 +227,18 @@ namespace openshot {
 		/// Remove partial frames due to seek
 		bool IsPartialFrame(int64_t requested_frame);
 
+		/// Determine if video packets are decoded (i.e. there is a video stream, and audio-only mode is disabled)
+		bool IsVideoDecoded() const { return info.has_video && !audio_only; }
+
 		/// Process a video packet
 		void ProcessVideoPacket(int64_t requested_frame);
 
 		/// Process an audio packet
 		void ProcessAudioPacket(int64_t requested_frame);
 
+		/// Decode frames ahead of the last requested frame (runs on the read-ahead thread)
+		void ReadAhead();
+
 		/// Read the stream until we find the requested Frame
 		std::shared_ptr<openshot::Frame> ReadStream(int64_t requested_frame);
 
@@ -218,6 +251,18 @@ namespace openshot {
 		/// Seek to a specific Frame.  This is not always frame accurate, it's more of an estimation on many codecs.
 		void Seek(int64_t requested_frame);
 
+		/// Load the seek index for this file (or start building it on a background thread)
+		void StartSeekIndex();
+
+		/// Stop the read-ahead thread (if running)
+		void StopReadAhead();
+
+		/// Stop building the seek index (if still running)
+		void StopSeekIndex();
+
+		/// Move the read-ahead window after the requested frame (and start the read-ahead thread, if needed)
+		void UpdateReadAhead(int64_t requested_frame);
+
 		/// Update PTS Offset (presentation time stamp). This shifts timestamps for all streams, so the first timestamp
 		/// is always zero. If one stream starts first, it will always be zero, and the other streams shifted
 		/// to maintain the correct relative time distance.
@@ -248,6 +293,10 @@ namespace openshot {
 		/// Destructor
 		virtual ~FFmpegReader();
 
+		/// Enable or disable audio-only mode (video packets are skipped, and frames have no image)
+		void AudioOnly(bool enabled) override;
+		using ReaderBase::AudioOnly;
+
 		/// Close File
 		void Close() override;
 
@@ -78,7 +78,8 @@ FFmpegWriter::FFmpegWriter(const std::string& path) :
 		initial_audio_input_frame_size(0), img_convert_ctx(NULL),
 		video_codec_ctx(NULL), audio_codec_ctx(NULL), is_writing(false), video_timestamp(0), audio_timestamp(0),
 		original_sample_rate(0), original_channels(0), avr(NULL), avr_planar(NULL), is_open(false), prepare_streams(false),
-		write_header(false), write_trailer(false), audio_encoder_buffer_size(0), audio_encoder_buffer(NULL) {
+		write_header(false), write_trailer(false), audio_encoder_buffer_size(0), audio_encoder_buffer(NULL),
+		is_async(false), is_pipeline_running(false) {
 
 	// Disable audio & video (so they can be independently enabled)
 	info.has_audio = false;
@@ -91,6 +92,12 @@ FFmpegWriter::FFmpegWriter(const std::string& path) :
 	auto_detect_format();
 }
 
+// Destructor
+FFmpegWriter::~FFmpegWriter() {
+	// Never leave pipeline threads running (they reference this writer)
+	stop_pipeline();
+}
+
 // Open the writer
 void FFmpegWriter::Open() {
 	if (!is_open) {
@@ -110,6 +117,9 @@ void FFmpegWriter::Open() {
 		// Write header (if needed)
 		if (!write_header)
 			WriteHeader();
+
+		// Start encoding threads (if needed)
+		start_pipeline();
 	}
 }
 
@@ -593,6 +603,24 @@ void FFmpegWriter::SetOption(StreamType stream, std::string name, std::string va
 
 }
 
+// Enable or disable asynchronous writing
+void FFmpegWriter::SetAsync(bool enabled, int queue_size) {
+	// The pipeline can't be re-configured while its threads are running
+	if (is_pipeline_running)
+		throw InvalidOptions("Async writing must be set before calling Open().", path);
+
+	is_async = enabled;
+	convert_queue.SetCapacity(queue_size);
+	audio_queue.SetCapacity(queue_size);
+	video_queue.SetCapacity(queue_size);
+	mux_queue.SetCapacity(queue_size);
+
+	ZmqLogger::Instance()->AppendDebugMethod(
+		"FFmpegWriter::SetAsync",
+		"enabled", enabled,
+		"queue_size", queue_size);
+}
+
 /// Determine if codec name is valid
 bool FFmpegWriter::IsValidCodec(std::string codec_name) {
 	// Initialize FFMpeg, and register all formats and codecs
@@ -672,8 +700,24 @@ void FFmpegWriter::WriteFrame(std::shared_ptr<openshot::Frame> frame) {
 		"frame->number", frame->number,
 		"is_writing", is_writing);
 
-	// Write frames to video file
-	write_frame(frame);
+	if (is_pipeline_running) {
+		// Raise any errors from the pipeline threads
+		check_pipeline_error();
+
+		// Queue frame (blocks while the pipeline is full)
+		bool is_queued = true;
+		if (info.has_video && video_st)
+			is_queued = convert_queue.Push(frame);
+		if (is_queued && info.has_audio && audio_st)
+			is_queued = audio_queue.Push(frame);
+
+		// Queues are only closed early when a pipeline thread fails
+		if (!is_queued)
+			check_pipeline_error();
+	} else {
+		// Write frames to video file
+		write_frame(frame);
+	}
 
 	// Keep track of the last frame added
 	last_frame = frame;
@@ -738,8 +782,188 @@ void FFmpegWriter::WriteFrame(ReaderBase *reader, int64_t start, int64_t length)
 	}
 }
 
+// Start the pipeline threads (if async writing is enabled)
+void FFmpegWriter::start_pipeline() {
+	if (!is_async || is_pipeline_running)
+		return;
+
+	// Clear any leftovers from a previous run
+	pipeline_error = nullptr;
+	convert_queue.Reset();
+	audio_queue.Reset();
+	video_queue.Reset();
+	mux_queue.Reset();
+
+	// Stage threads check this flag, so set it before they start
+	is_pipeline_running = true;
+
+	if (info.has_video && video_st) {
+		convert_thread = std::thread(&FFmpegWriter::run_convert_stage, this);
+		video_thread = std::thread(&FFmpegWriter::run_video_stage, this);
+	}
+	if (info.has_audio && audio_st)
+		audio_thread = std::thread(&FFmpegWriter::run_audio_stage, this);
+	mux_thread = std::thread(&FFmpegWriter::run_mux_stage, this);
+
+	ZmqLogger::Instance()->AppendDebugMethod("FFmpegWriter::start_pipeline");
+}
+
+// Drain all queued frames and packets, and join the pipeline threads
+void FFmpegWriter::stop_pipeline() {
+	if (!is_pipeline_running)
+		return;
+
+	// Close each stage in order, so every queued frame is encoded (and every packet muxed).
+	// The convert stage closes the video queue once it has converted its last frame.
+	convert_queue.Close();
+	audio_queue.Close();
+	if (convert_thread.joinable())
+		convert_thread.join();
+	if (video_thread.joinable())
+		video_thread.join();
+	if (audio_thread.joinable())
+		audio_thread.join();
+	mux_queue.Close();
+	if (mux_thread.joinable())
+		mux_thread.join();
+
+	// Free converted frames which were never encoded (only possible after an error)
+	std::pair<std::shared_ptr<Frame>, AVFrame *> converted;
+	video_queue.Close();
+	while (video_queue.Pop(converted)) {
+		av_freep(&(converted.second->data[0]));
+		AV_FREE_FRAME(&converted.second);
+	}
+	convert_queue.Reset();
+	audio_queue.Reset();
+	video_queue.Reset();
+	mux_queue.Reset();
+
+	is_pipeline_running = false;
+
+	ZmqLogger::Instance()->AppendDebugMethod("FFmpegWriter::stop_pipeline");
+}
+
+// Pipeline stage: convert queued frames from RGBA to the encoder's pixel format
+void FFmpegWriter::run_convert_stage() {
+	try {
+		std::shared_ptr<Frame> frame;
+		while (convert_queue.Pop(frame)) {
+			process_video_packet(frame);
+
+			// Empty frames are skipped (and have no AVFrame)
+			auto av_frame = av_frames.find(frame);
+			if (av_frame == av_frames.end())
+				continue;
+			AVFrame *frame_final = av_frame->second;
+			av_frames.erase(av_frame);
+
+			// Pass to video encoder (or free, if the pipeline has failed)
+			if (!video_queue.Push(std::make_pair(frame, frame_final))) {
+				av_freep(&(frame_final->data[0]));
+				AV_FREE_FRAME(&frame_final);
+			}
+		}
+	} catch (...) {
+		set_pipeline_error(std::current_exception());
+	}
+
+	// No more frames will be converted
+	video_queue.Close();
+}
+
+// Pipeline stage: encode converted video frames
+void FFmpegWriter::run_video_stage() {
+	try {
+		std::pair<std::shared_ptr<Frame>, AVFrame *> converted;
+		while (video_queue.Pop(converted)) {
+			AVFrame *frame_final = converted.second;
+			bool is_written = write_video_packet(converted.first, frame_final);
+
+			// Deallocate buffer and AVFrame
+			av_freep(&(frame_final->data[0]));
+			AV_FREE_FRAME(&frame_final);
+
+			if (!is_written)
+				throw ErrorEncodingVideo("Error while writing raw video frame", converted.first->number);
+		}
+	} catch (...) {
+		set_pipeline_error(std::current_exception());
+	}
+}
+
+// Pipeline stage: encode queued audio
+void FFmpegWriter::run_audio_stage() {
+	try {
+		std::shared_ptr<Frame> frame;
+		while (audio_queue.Pop(frame))
+			write_audio_packets(false, frame);
+	} catch (...) {
+		set_pipeline_error(std::current_exception());
+	}
+}
+
+// Pipeline stage: write encoded packets to the file
+void FFmpegWriter::run_mux_stage() {
+	AVPacket *pkt = NULL;
+	while (mux_queue.Pop(pkt)) {
+		int stream_index = pkt->stream_index;
+		int error_code = 0;
+		{
+			const std::lock_guard<std::mutex> lock(mux_mutex);
+			error_code = av_interleaved_write_frame(oc, pkt);
+		}
+		av_packet_free(&pkt);
+
+		if (error_code < 0) {
+			ZmqLogger::Instance()->AppendDebugMethod(
+				"FFmpegWriter::run_mux_stage ERROR ["
+					+ av_err2string(error_code) + "]",
+				"error_code", error_code,
+				"stream_index", stream_index);
+
+			// Video write errors are fatal (matching synchronous writing)
+			if (video_st && stream_index == video_st->index)
+				set_pipeline_error(std::make_exception_ptr(
+					ErrorEncodingVideo("Error while writing raw video frame", -1)));
+		}
+	}
+}
+
+// Record an exception raised by a pipeline thread
+void FFmpegWriter::set_pipeline_error(std::exception_ptr error) {
+	{
+		// Only keep the first error
+		const std::lock_guard<std::mutex> lock(error_mutex);
+		if (!pipeline_error)
+			pipeline_error = error;
+	}
+
+	// Unblock all stages (and the caller of WriteFrame)
+	convert_queue.Close();
+	audio_queue.Close();
+	video_queue.Close();
+	mux_queue.Close();
+}
+
+// Throw the first exception raised by a pipeline thread (if any)
+void FFmpegWriter::check_pipeline_error() {
+	std::exception_ptr error;
+	{
+		// Clear the error, so it is only raised once
+		const std::lock_guard<std::mutex> lock(error_mutex);
+		std::swap(error, pipeline_error);
+	}
+	if (error)
+		std::rethrow_exception(error);
+}
+
 // Write the file trailer (after all frames are written)
 void FFmpegWriter::WriteTrailer() {
+	// Wait for all queued frames to be encoded (if async)
+	stop_pipeline();
+	check_pipeline_error();
+
 	// Process final audio frame (if any)
 	if (info.has_audio && audio_st)
 		write_audio_packets(true, NULL);
@@ -957,6 +1181,9 @@ void FFmpegWriter::Close() {
 	if (!write_trailer)
 		WriteTrailer();
 
+	// Stop encoding threads (if WriteTrailer did not)
+	stop_pipeline();
+
 	// Close each codec
 	if (video_st)
 		close_video(oc, video_st);
@@ -1984,7 +2211,7 @@ void FFmpegWriter::write_audio_packets(bool is_final, std::shared_ptr<openshot::
 			pkt->flags |= AV_PKT_FLAG_KEY;
 
 			/* write the compressed frame in the media file */
-			error_code = av_interleaved_write_frame(oc, pkt);
+			error_code = write_packet(pkt);
 		}
 
 		if (error_code < 0) {
@@ -2213,8 +2440,9 @@ bool FFmpegWriter::write_video_packet(std::shared_ptr<Frame> frame, AVFrame *fra
 		// Set PTS (in frames and scaled to the codec's timebase)
 		pkt->pts = video_timestamp;
 
-		/* write the compressed frame in the media file */
-		int error_code = av_interleaved_write_frame(oc, pkt);
+		/* write the compressed frame in the media file (raw packets point at the
+		 * AVFrame's buffer, which is freed after this call, so they are never queued) */
+		int error_code = write_packet(pkt, false);
 		if (error_code < 0) {
 			ZmqLogger::Instance()->AppendDebugMethod(
 				"FFmpegWriter::write_video_packet ERROR ["
@@ -2322,7 +2550,7 @@ bool FFmpegWriter::write_video_packet(std::shared_ptr<Frame> frame, AVFrame *fra
 			pkt->stream_index = video_st->index;
 
 			/* write the compressed frame in the media file */
-			int result = av_interleaved_write_frame(oc, pkt);
+			int result = write_packet(pkt);
 			if (result < 0) {
 				ZmqLogger::Instance()->AppendDebugMethod(
 					"FFmpegWriter::write_video_packet ERROR ["
@@ -2351,6 +2579,28 @@ bool FFmpegWriter::write_video_packet(std::shared_ptr<Frame> frame, AVFrame *fra
 	return true;
 }
 
+// Write an encoded packet to the file (or queue it for the mux stage)
+int FFmpegWriter::write_packet(AVPacket *pkt, bool can_queue) {
+	if (is_pipeline_running && can_queue) {
+		// Hand a reference to the mux stage (and release ours, like av_interleaved_write_frame does)
+		AVPacket *queued_pkt = av_packet_clone(pkt);
+		if (!queued_pkt)
+			return AVERROR(ENOMEM);
+		av_packet_unref(pkt);
+
+		if (!mux_queue.Push(queued_pkt)) {
+			// Mux stage has failed
+			av_packet_free(&queued_pkt);
+			return AVERROR_EXIT;
+		}
+		return 0;
+	}
+
+	// Write directly (serialized with the mux stage)
+	const std::lock_guard<std::mutex> lock(mux_mutex);
+	return av_interleaved_write_frame(oc, pkt);
+}
+
 // Output the ffmpeg info about this format, streams, and codecs (i.e. dump format)
 void FFmpegWriter::OutputStreamInfo() {
 	// output debug info
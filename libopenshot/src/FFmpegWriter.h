@@ -16,6 +16,12 @@
 #ifndef OPENSHOT_FFMPEG_WRITER_H
 #define OPENSHOT_FFMPEG_WRITER_H
 
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "BlockingQueue.h"
 #include "ReaderBase.h"
 #include "WriterBase.h"
 
@@ -154,6 +160,21 @@ namespace openshot {
 		std::shared_ptr<openshot::Frame> last_frame;
 		std::map<std::shared_ptr<openshot::Frame>, AVFrame *> av_frames;
 
+		/* Async pipeline (colour conversion -> video encoding, audio encoding -> muxing) */
+		bool is_async;
+		bool is_pipeline_running;
+		BlockingQueue<std::shared_ptr<openshot::Frame>> convert_queue; ///< Frames waiting for colour conversion
+		BlockingQueue<std::shared_ptr<openshot::Frame>> audio_queue; ///< Frames waiting for audio encoding
+		BlockingQueue<std::pair<std::shared_ptr<openshot::Frame>, AVFrame *>> video_queue; ///< Converted frames waiting for video encoding
+		BlockingQueue<AVPacket *> mux_queue; ///< Encoded packets waiting to be written to the file
+		std::thread convert_thread;
+		std::thread video_thread;
+		std::thread audio_thread;
+		std::thread mux_thread;
+		std::mutex mux_mutex;
+		std::mutex error_mutex;
+		std::exception_ptr pipeline_error;
+
 		/// Add an AVFrame to the cache
 		void add_avframe(std::shared_ptr<openshot::Frame> frame, AVFrame *av_frame);
 
@@ -169,6 +190,9 @@ namespace openshot {
 		/// Auto detect format (from path)
 		void auto_detect_format();
 
+		/// Throw the first exception raised by a pipeline thread (if any)
+		void check_pipeline_error();
+
 		/// Close the audio codec
 		void close_audio(AVFormatContext *oc, AVStream *st);
 
@@ -190,12 +214,36 @@ namespace openshot {
 		/// process video frame
 		void process_video_packet(std::shared_ptr<openshot::Frame> frame);
 
+		/// Pipeline stage: convert queued frames from RGBA to the encoder's pixel format
+		void run_convert_stage();
+
+		/// Pipeline stage: encode converted video frames
+		void run_video_stage();
+
+		/// Pipeline stage: encode queued audio
+		void run_audio_stage();
+
+		/// Pipeline stage: write encoded packets to the file
+		void run_mux_stage();
+
+		/// Record an exception raised by a pipeline thread, and close all queues (so no stage blocks forever)
+		void set_pipeline_error(std::exception_ptr error);
+
+		/// Start the pipeline threads (if async writing is enabled)
+		void start_pipeline();
+
+		/// Drain all queued frames and packets, and join the pipeline threads
+		void stop_pipeline();
+
 		/// write all queued frames' audio to the video file
 		void write_audio_packets(bool is_final, std::shared_ptr<openshot::Frame> frame);
 
 		/// write video frame
 		bool write_video_packet(std::shared_ptr<openshot::Frame> frame, AVFrame *frame_final);
 
+		/// Write an encoded packet to the file (or queue it for the mux stage, if the pipeline is running)
+		int write_packet(AVPacket *pkt, bool can_queue = true);
+
 		/// write all queued frames
 		void write_frame(std::shared_ptr<Frame> frame);
 
@@ -207,6 +255,9 @@ namespace openshot {
 		/// @param path The file path of the video file you want to open and read
 		FFmpegWriter(const std::string& path);
 
+		/// Destructor (stops the async pipeline, if running)
+		virtual ~FFmpegWriter();
+
 		/// Close the writer
 		void Close();
 
@@ -231,6 +282,18 @@ namespace openshot {
 		/// @param channels The number of audio channels
 		void ResampleAudio(int sample_rate, int channels);
 
+		/// @brief Enable or disable asynchronous writing. This must be called before the Open() method.
+		///
+		/// When enabled, WriteFrame() returns as soon as the frame is queued. Colour conversion, video
+		/// encoding, audio encoding and muxing each run on their own thread, so encoding overlaps with
+		/// the caller (i.e. rendering the next timeline frame). WriteTrailer() drains all queued frames
+		/// before flushing the encoders, so the output is identical to synchronous writing. Errors raised
+		/// by a pipeline thread are re-thrown by the next call to WriteFrame() or WriteTrailer().
+		///
+		/// @param enabled Write frames on background threads
+		/// @param queue_size The max number of frames (or packets) waiting in each stage
+		void SetAsync(bool enabled, int queue_size = 8);
+
 		/// @brief Set audio export options
 		/// @param has_audio Does this file need an audio stream?
 		/// @param codec The codec used to encode the audio for this file
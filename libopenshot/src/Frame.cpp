@@ -15,6 +15,7 @@
 #include <iomanip>
 
 #include "Frame.h"
+#include "BufferPool.h"
 #include "AudioBufferSource.h"
 #include "AudioResampler.h"
 #include "QtUtilities.h"
@@ -97,6 +98,8 @@ void Frame::DeepCopy(const Frame& other)
 	color = other.color;
 	max_audio_sample = other.max_audio_sample;
 
+	// QImage shares its pixels until one of the copies is modified (i.e. bits() or scanLine() is
+	// called), so frames which are only read (or replaced) never duplicate their image data.
 	if (other.image)
 		image = std::make_shared<QImage>(*(other.image));
 	if (other.audio)
@@ -688,7 +691,7 @@ void Frame::AddColor(const QColor& new_color)
 {
 	// Create new image object, and fill with pixel data
 	const std::lock_guard<std::recursive_mutex> lock(addingImageMutex);
-	image = std::make_shared<QImage>(width, height, QImage::Format_RGBA8888_Premultiplied);
+	image = BufferPool::Instance()->CreateImage(width, height, QImage::Format_RGBA8888_Premultiplied);
 
 	// Fill with solid color
 	image->fill(new_color);
@@ -705,9 +708,11 @@ void Frame::AddImage(
 		image.reset();
 	}
 
-	// Create new image object from pixel data
+	// Create new image object from pixel data. The buffer is owned by the image (and freed by
+	// cleanUpBuffer), so it's wrapped as writable, which lets the last owner modify it in place
+	// (read-only pixel data is always copied on the first write).
 	auto new_image = std::make_shared<QImage>(
-		pixels_,
+		const_cast<unsigned char*>(pixels_),
 		new_width, new_height,
 		new_width * bytes_per_pixel,
 		type,
@@ -729,8 +734,14 @@ void Frame::AddImage(std::shared_ptr<QImage> new_image)
 	image = new_image;
 
 	// Always convert to Format_RGBA8888_Premultiplied (if different)
-	if (image->format() != QImage::Format_RGBA8888_Premultiplied)
+	if (image->format() != QImage::Format_RGBA8888_Premultiplied) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+		// Convert in place (if the pixels are not shared)
+		image->convertTo(QImage::Format_RGBA8888_Premultiplied);
+#else
 		*image = image->convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+#endif
+	}
 
 	// Update height and width
 	width = image->width();
@@ -130,7 +130,7 @@ namespace openshot
 		/// Constructor - image & audio
 		Frame(int64_t number, int width, int height, std::string color, int samples, int channels);
 
-		/// Copy constructor
+		/// Copy constructor (the image is shared with the other frame, until either frame modifies it)
 		Frame ( const Frame &other );
 
 		/// Assignment operator
@@ -145,7 +145,10 @@ namespace openshot
 		/// Add (or replace) pixel data (filled with new_color)
 		void AddColor(const QColor& new_color);
 
-		/// Add (or replace) pixel data to the frame
+		/// @brief Add (or replace) pixel data to the frame
+		///
+		/// The frame takes ownership of the pixel buffer (which must be allocated with aligned_malloc), and
+		/// uses it directly as the image's pixels (no copy). The buffer is freed with the last image using it.
 		void AddImage(int new_width, int new_height, int bytes_per_pixel, QImage::Format type, const unsigned char *pixels_);
 
 		/// Add (or replace) pixel data to the frame
@@ -173,7 +176,7 @@ namespace openshot
 		/// Clear the waveform image (and deallocate its memory)
 		void ClearWaveform();
 
-		/// Copy data and pointers from another Frame instance
+		/// Copy data and pointers from another Frame instance (images are implicitly shared, and copied on write)
 		void DeepCopy(const Frame& other);
 
 		/// Display the frame image to the screen (primarily used for debugging reasons)
@@ -70,6 +70,30 @@ ReaderBase* FrameMapper::Reader()
 		throw ReaderClosed("No Reader has been initialized for FrameMapper.  Call Reader(*reader) before calling this method.");
 }
 
+// Set the current reader
+void FrameMapper::Reader(ReaderBase *new_reader)
+{
+	reader = new_reader;
+
+	// Keep the new reader in the same mode as this mapper
+	if (reader && audio_only)
+		reader->AudioOnly(true);
+}
+
+// Enable or disable audio-only mode (of this mapper and its reader)
+void FrameMapper::AudioOnly(bool enabled)
+{
+	const std::lock_guard<std::recursive_mutex> lock(getFrameMutex);
+	if (enabled != audio_only) {
+		ReaderBase::AudioOnly(enabled);
+
+		// Cached frames have no image (or an image which is no longer needed)
+		final_cache.Clear();
+	}
+	if (reader)
+		reader->AudioOnly(enabled);
+}
+
 void FrameMapper::AddField(int64_t frame)
 {
 	// Add a field, and toggle the odd / even field
@@ -518,12 +542,12 @@ std::shared_ptr<Frame> FrameMapper::GetFrame(int64_t requested_frame)
 		frame->ChannelsLayout(mapped_frame->ChannelsLayout());
 
 
-		// Copy the image from the odd field
+		// Copy the image from the odd field (no image is needed in audio-only mode)
 		std::shared_ptr<Frame> odd_frame = mapped_frame;
 
-		if (odd_frame && odd_frame->has_image_data)
+		if (odd_frame && odd_frame->has_image_data && !audio_only)
 			frame->AddImage(std::make_shared<QImage>(*odd_frame->GetImage()), true);
-		if (mapped.Odd.Frame != mapped.Even.Frame) {
+		if (mapped.Odd.Frame != mapped.Even.Frame && !audio_only) {
 			// Add even lines (if different than the previous image)
 			std::shared_ptr<Frame> even_frame;
 			even_frame = GetOrCreateFrame(mapped.Even.Frame);
@@ -280,7 +280,11 @@ namespace openshot
 		ReaderBase* Reader();
 
 		/// Set the current reader
-		void Reader(ReaderBase *new_reader) { reader = new_reader; }
+		void Reader(ReaderBase *new_reader);
+
+		/// Enable or disable audio-only mode (of this mapper and its reader)
+		void AudioOnly(bool enabled) override;
+		using ReaderBase::AudioOnly;
 
 		/// Resample audio and map channels (if needed)
 		void ResampleMappedAudio(std::shared_ptr<Frame> frame, int64_t original_frame_number);
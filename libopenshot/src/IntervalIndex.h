@@ -0,0 +1,182 @@
+/**
+ * @file
+ * @brief Header file for IntervalIndex class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_INTERVAL_INDEX_H
+#define OPENSHOT_INTERVAL_INDEX_H
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <vector>
+
+namespace openshot {
+
+	/**
+	 * @brief This class indexes timeline items (clips or effects) by layer and frame range
+	 *
+	 * Each layer is stored as an implicit interval tree: an array of intervals sorted by start
+	 * frame, where each middle element also stores the max end frame of its sub-range. A query
+	 * for the items which overlap a frame (or range of frames) costs O(log N + k), instead of
+	 * scanning every item on the timeline.
+	 *
+	 * Items are returned in their original order (lowest layer first, and then in the order
+	 * they were passed to Update()), which is the order they need to be combined in.
+	 *
+	 * @code
+	 * IntervalIndex<Clip*> index;
+	 * index.Update({ {clip1, 0, 1, 30}, {clip2, 1, 10, 90} });
+	 *
+	 * std::vector<Clip*> visible;
+	 * index.Find(15, 15, visible); // clip1, clip2
+	 * @endcode
+	 */
+	template <typename T>
+	class IntervalIndex {
+	public:
+		/// An item on the timeline, and the frames (inclusive) it covers
+		struct Interval {
+			T item; ///< The indexed item
+			int layer; ///< The layer of the item
+			int64_t start; ///< The first frame of the item
+			int64_t end; ///< The last frame of the item
+		};
+
+	private:
+		/// An interval inside a layer (plus its order, and the max end frame of its sub-tree)
+		struct Node {
+			T item;
+			int64_t start;
+			int64_t end;
+			int64_t max_end;
+			size_t order;
+
+			bool operator==(const Node& other) const {
+				return item == other.item && start == other.start && end == other.end && order == other.order;
+			}
+		};
+
+		/// The sorted nodes of each layer
+		std::map<int, std::vector<Node>> layers;
+
+		/// Calculate the max end frame of each sub-tree (the middle node of each range stores it)
+		int64_t build(std::vector<Node>& nodes, size_t lo, size_t hi) {
+			if (lo >= hi)
+				return std::numeric_limits<int64_t>::min();
+			size_t mid = lo + (hi - lo) / 2;
+			int64_t max_end = std::max(nodes[mid].end,
+				std::max(build(nodes, lo, mid), build(nodes, mid + 1, hi)));
+			nodes[mid].max_end = max_end;
+			return max_end;
+		}
+
+		/// Collect all nodes in a sub-tree which overlap the frame range [min_frame, max_frame]
+		void find(const std::vector<Node>& nodes, size_t lo, size_t hi, int64_t min_frame, int64_t max_frame, std::vector<const Node*>& results) const {
+			if (lo >= hi)
+				return;
+			size_t mid = lo + (hi - lo) / 2;
+			const Node& node = nodes[mid];
+
+			// Nothing in this sub-tree ends after the requested range starts
+			if (node.max_end < min_frame)
+				return;
+
+			find(nodes, lo, mid, min_frame, max_frame, results);
+
+			// Everything to the right starts after this node (and after the requested range)
+			if (node.start > max_frame)
+				return;
+
+			if (node.end >= min_frame)
+				results.push_back(&node);
+
+			find(nodes, mid + 1, hi, min_frame, max_frame, results);
+		}
+
+		/// Find the overlapping nodes of a single layer, and append their items in order
+		void find_layer(const std::vector<Node>& nodes, int64_t min_frame, int64_t max_frame, std::vector<T>& results) const {
+			std::vector<const Node*> matches;
+			find(nodes, 0, nodes.size(), min_frame, max_frame, matches);
+			std::sort(matches.begin(), matches.end(), [](const Node* lhs, const Node* rhs) {
+				return lhs->order < rhs->order;
+			});
+			for (const auto node : matches)
+				results.push_back(node->item);
+		}
+
+	public:
+		/// Remove all items from the index
+		void Clear() { layers.clear(); }
+
+		/// @brief Update the index with the current intervals of all items
+		///
+		/// Only the layers which have changed (new, removed, moved or resized items) are
+		/// re-built, so small edits to a large timeline stay cheap.
+		///
+		/// @param intervals All items, sorted by layer and then by the order they should be returned in
+		void Update(const std::vector<Interval>& intervals) {
+			// Group intervals by layer
+			std::map<int, std::vector<Node>> new_layers;
+			for (const auto& interval : intervals) {
+				std::vector<Node>& nodes = new_layers[interval.layer];
+				nodes.push_back({interval.item, interval.start, interval.end, interval.end, nodes.size()});
+			}
+
+			// Remove layers which no longer have any items
+			for (auto layer = layers.begin(); layer != layers.end();) {
+				if (new_layers.count(layer->first) == 0)
+					layer = layers.erase(layer);
+				else
+					++layer;
+			}
+
+			for (auto& new_layer : new_layers) {
+				std::vector<Node>& nodes = new_layer.second;
+				std::sort(nodes.begin(), nodes.end(), [](const Node& lhs, const Node& rhs) {
+					return lhs.start < rhs.start || (lhs.start == rhs.start && lhs.order < rhs.order);
+				});
+
+				// Skip layers which have not changed
+				auto existing = layers.find(new_layer.first);
+				if (existing != layers.end() && existing->second == nodes)
+					continue;
+
+				build(nodes, 0, nodes.size());
+				layers[new_layer.first] = std::move(nodes);
+			}
+		}
+
+		/// Find all items (on any layer) which overlap the frame range [min_frame, max_frame]
+		void Find(int64_t min_frame, int64_t max_frame, std::vector<T>& results) const {
+			for (const auto& layer : layers)
+				find_layer(layer.second, min_frame, max_frame, results);
+		}
+
+		/// Find all items on a specific layer which overlap the frame range [min_frame, max_frame]
+		void Find(int layer, int64_t min_frame, int64_t max_frame, std::vector<T>& results) const {
+			auto nodes = layers.find(layer);
+			if (nodes != layers.end())
+				find_layer(nodes->second, min_frame, max_frame, results);
+		}
+
+		/// Get the number of indexed items
+		size_t Count() const {
+			size_t count = 0;
+			for (const auto& layer : layers)
+				count += layer.second.size();
+			return count;
+		}
+	};
+
+}
+
+#endif // OPENSHOT_INTERVAL_INDEX_H
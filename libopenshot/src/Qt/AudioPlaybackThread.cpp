@@ -198,6 +198,8 @@ namespace openshot
 	, is_playing(false)
 	, time_thread("audio-buffer")
 	, videoCache(cache)
+	, underruns(0)
+	, read_errors(0)
 	{
 	}
 
@@ -312,7 +314,9 @@ namespace openshot
 				player.setSource(NULL);
 				audioInstance->audioDeviceManager.removeAudioCallback(&player);
 
-				// Remove source
+				// Remove source (and keep its underrun and read error counts)
+				underruns += source->getUnderruns();
+				read_errors += source->getReadErrors();
 				delete source;
 				source = NULL;
 
@@ -88,6 +88,8 @@ public:
 		openshot::VideoCacheThread *videoCache; /// The cache thread (for pre-roll checking)
 		std::mutex transportMutex;
 		std::condition_variable transportCondition;
+		int64_t underruns; /// Audio underruns of previous sources
+		int64_t read_errors; /// Reader errors of previous sources
 
 		/// Constructor
 		AudioPlaybackThread(openshot::VideoCacheThread* cache);
@@ -121,6 +123,12 @@ public:
 		/// Get Speed (The speed and direction to playback a reader (1=normal, 2=fast, 3=faster, -1=rewind, etc...)
 		int getSpeed() const { if (source) return source->getSpeed(); else return 1; }
 
+		/// Get the number of audio blocks which were missing samples (during all playback)
+		int64_t getUnderruns() const { return underruns + (source ? source->getUnderruns() : 0); }
+
+		/// Get the number of times the reader failed to get a frame of audio (during all playback)
+		int64_t getReadErrors() const { return read_errors + (source ? source->getReadErrors() : 0); }
+
 		/// Get audio initialization errors (if any)
 		std::string getError()
 		{
@@ -82,6 +82,16 @@ namespace openshot
         return p->audioPlayback->getCurrentAudioDevice();
     }
 
+    // Get the number of audio underruns during playback
+    int64_t QtPlayer::GetAudioUnderruns() {
+        return p->audioPlayback->getUnderruns();
+    }
+
+    // Get the number of audio frames which the reader failed to get during playback
+    int64_t QtPlayer::GetAudioReadErrors() {
+        return p->audioPlayback->getReadErrors();
+    }
+
     // Set the source JSON of an openshot::Timelime
     void QtPlayer::SetTimelineSource(const std::string &json) {
         // Create timeline instance (720p, since we have no re-scaling in this player yet)
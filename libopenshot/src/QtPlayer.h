@@ -57,6 +57,12 @@ namespace openshot
 	/// Get current audio device or last attempted
 	AudioDeviceInfo GetCurrentAudioDevice();
 
+	/// Get the number of audio blocks which were missing samples (because frames were not mixed in time)
+	int64_t GetAudioUnderruns();
+
+	/// Get the number of times the reader failed to get a frame of audio (see AudioReaderSource::getReadErrors())
+	int64_t GetAudioReadErrors();
+
 	/// Play the video
 	void Play();
 
@@ -54,6 +54,7 @@ ReaderBase::ReaderBase()
 
 	// Init parent clip
 	clip = NULL;
+	audio_only = false;
 }
 
 // Display file information
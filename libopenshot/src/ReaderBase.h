@@ -78,6 +78,7 @@ namespace openshot
 		/// Mutex for multiple threads
 		std::recursive_mutex getFrameMutex;
 		openshot::ClipBase* clip; ///< Pointer to the parent clip instance (if any)
+		bool audio_only; ///< Only read audio (no video is decoded, and frames have no image)
 
 	public:
 
@@ -93,6 +94,16 @@ namespace openshot
 		/// Set parent clip object of this reader
 		void ParentClip(openshot::ClipBase* new_clip);
 
+		/// @brief Enable or disable audio-only mode
+		///
+		/// In audio-only mode, frames only contain audio: no video is decoded and no images are created, which
+		/// is much faster for audio export, loudness analysis and waveforms. Readers which contain other
+		/// readers (such as openshot::Timeline, openshot::Clip and openshot::FrameMapper) pass it on.
+		virtual void AudioOnly(bool enabled) { audio_only = enabled; }
+
+		/// Determine if audio-only mode is enabled
+		bool AudioOnly() const { return audio_only; }
+
 		/// Close the reader (and any resources it was consuming)
 		virtual void Close() = 0;
 
@@ -0,0 +1,135 @@
+/**
+ * @file
+ * @brief Source file for RemapTable class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "RemapTable.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+	#define OPENSHOT_REMAP_SSE2
+	#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	#define OPENSHOT_REMAP_NEON
+	#include <arm_neon.h>
+#endif
+
+using namespace openshot;
+
+// Create a table (mapping every target pixel to the top-left source pixel)
+RemapTable::RemapTable(int width, int height, int source_width, int source_height, int64_t source_bytes_per_line, bool bilinear) :
+	entries(size_t(std::max(width, 0)) * std::max(height, 0), Entry{0, 0, 0}), width(width), height(height),
+	source_width(source_width), source_height(source_height), source_bytes_per_line(source_bytes_per_line),
+	// Bilinear sampling needs at least 2 source pixels in each direction
+	bilinear(bilinear && source_width > 1 && source_height > 1)
+{
+}
+
+// Set the source position of a target pixel
+void RemapTable::Set(int x, int y, double source_x, double source_y) {
+	if (x < 0 || y < 0 || x >= width || y >= height || source_width <= 0 || source_height <= 0)
+		return;
+
+	// Clamp positions before converting them to integers (and sample the top-left pixel for invalid positions)
+	source_x = std::isfinite(source_x) ? std::clamp(source_x, 0.0, double(source_width)) : 0.0;
+	source_y = std::isfinite(source_y) ? std::clamp(source_y, 0.0, double(source_height)) : 0.0;
+
+	int x0 = std::clamp(int(std::floor(source_x)), 0, source_width - 1);
+	int y0 = std::clamp(int(std::floor(source_y)), 0, source_height - 1);
+	Entry& entry = entries[size_t(y) * width + x];
+
+	if (!bilinear) {
+		entry.offset = uint32_t(y0 * source_bytes_per_line + x0 * 4);
+		entry.weight_x = entry.weight_y = 0;
+		return;
+	}
+
+	int weight_x = int(std::min(source_x - x0, 1.0) * 256.0 + 0.5);
+	int weight_y = int(std::min(source_y - y0, 1.0) * 256.0 + 0.5);
+
+	// The last column (and row) has no pixels to its right (or below), so blend it from the previous pixel
+	if (x0 == source_width - 1) {
+		x0--;
+		weight_x = 256;
+	}
+	if (y0 == source_height - 1) {
+		y0--;
+		weight_y = 256;
+	}
+
+	entry.offset = uint32_t(y0 * source_bytes_per_line + x0 * 4);
+	entry.weight_x = uint16_t(weight_x);
+	entry.weight_y = uint16_t(weight_y);
+}
+
+// Sample the source image for every target pixel
+void RemapTable::Apply(const unsigned char* source, unsigned char* target, int64_t target_bytes_per_line) const {
+	const int64_t below = source_bytes_per_line;
+
+	#pragma omp parallel for schedule(static)
+	for (int y = 0; y < height; ++y) {
+		const Entry* row = entries.data() + size_t(y) * width;
+		unsigned char* output = target + y * target_bytes_per_line;
+
+		if (!bilinear) {
+			for (int x = 0; x < width; ++x)
+				std::memcpy(output + x * 4, source + row[x].offset, 4);
+			continue;
+		}
+
+		for (int x = 0; x < width; ++x) {
+			const Entry& entry = row[x];
+			const unsigned char* top = source + entry.offset;
+			const unsigned char* bottom = top + below;
+			const int weight_x = entry.weight_x;
+			const int weight_y = entry.weight_y;
+
+#if defined(OPENSHOT_REMAP_SSE2)
+			// Interleave the left and right pixels ([left, right] for each channel), and blend them horizontally
+			const __m128i zero = _mm_setzero_si128();
+			__m128i top_pixels = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) top), zero);
+			__m128i bottom_pixels = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) bottom), zero);
+			top_pixels = _mm_unpacklo_epi16(top_pixels, _mm_srli_si128(top_pixels, 8));
+			bottom_pixels = _mm_unpacklo_epi16(bottom_pixels, _mm_srli_si128(bottom_pixels, 8));
+			const __m128i weights = _mm_set1_epi32((weight_x << 16) | (256 - weight_x));
+			__m128 top_blend = _mm_cvtepi32_ps(_mm_madd_epi16(top_pixels, weights));
+			__m128 bottom_blend = _mm_cvtepi32_ps(_mm_madd_epi16(bottom_pixels, weights));
+
+			// Blend vertically (all sums are below 2^24, so float math is exact, and matches the scalar integer math)
+			__m128 blend = _mm_add_ps(_mm_mul_ps(top_blend, _mm_set1_ps(float(256 - weight_y))),
+									  _mm_mul_ps(bottom_blend, _mm_set1_ps(float(weight_y))));
+			__m128i color = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(blend, _mm_set1_ps(1.0f / 65536.0f)), _mm_set1_ps(0.5f)));
+			color = _mm_packs_epi32(color, color);
+			int32_t pixel = _mm_cvtsi128_si32(_mm_packus_epi16(color, color));
+			std::memcpy(output + x * 4, &pixel, 4);
+#elif defined(OPENSHOT_REMAP_NEON)
+			uint16x8_t top_pixels = vmovl_u8(vld1_u8(top));
+			uint16x8_t bottom_pixels = vmovl_u8(vld1_u8(bottom));
+			uint32x4_t top_blend = vmlal_n_u16(vmull_n_u16(vget_low_u16(top_pixels), uint16_t(256 - weight_x)),
+											   vget_high_u16(top_pixels), uint16_t(weight_x));
+			uint32x4_t bottom_blend = vmlal_n_u16(vmull_n_u16(vget_low_u16(bottom_pixels), uint16_t(256 - weight_x)),
+												  vget_high_u16(bottom_pixels), uint16_t(weight_x));
+			uint32x4_t blend = vmlaq_n_u32(vmulq_n_u32(top_blend, uint32_t(256 - weight_y)), bottom_blend, uint32_t(weight_y));
+			uint16x4_t color = vmovn_u32(vrshrq_n_u32(blend, 16));
+			uint32_t pixel = vget_lane_u32(vreinterpret_u32_u8(vmovn_u16(vcombine_u16(color, color))), 0);
+			std::memcpy(output + x * 4, &pixel, 4);
+#else
+			for (int channel = 0; channel < 4; ++channel) {
+				int top_blend = top[channel] * (256 - weight_x) + top[channel + 4] * weight_x;
+				int bottom_blend = bottom[channel] * (256 - weight_x) + bottom[channel + 4] * weight_x;
+				output[x * 4 + channel] = (unsigned char) ((top_blend * (256 - weight_y) + bottom_blend * weight_y + 32768) >> 16);
+			}
+#endif
+		}
+	}
+}
@@ -0,0 +1,87 @@
+/**
+ * @file
+ * @brief Header file for RemapTable class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_REMAP_TABLE_H
+#define OPENSHOT_REMAP_TABLE_H
+
+#include <cstdint>
+#include <vector>
+
+namespace openshot {
+
+	/**
+	 * @brief This class maps each pixel of a target image to a position in a source image, and samples it
+	 *
+	 * Effects which move pixels with expensive math (such as openshot::SphericalProjection, which needs
+	 * trigonometry for every pixel) only need to do that math again when their parameters (or the size of
+	 * the image) change. Each target pixel stores the offset of its source pixel, and 8-bit fixed-point
+	 * bilinear weights, so applying the table is a gather of 4 source pixels and a weighted sum, which
+	 * uses SIMD (SSE2 or NEON) for all 4 channels of a pixel at once. Rows are sampled in parallel.
+	 *
+	 * Source positions are in pixels. Nearest sampling uses the pixel at the position (rounded down), and
+	 * bilinear sampling blends that pixel with the pixels to its right and below, by the fractions of the
+	 * position. Positions outside the source image are clamped to its edges.
+	 *
+	 * @code
+	 * RemapTable table(width, height, source.width(), source.height(), source.bytesPerLine(), true);
+	 * for (int y = 0; y < height; y++)
+	 *     for (int x = 0; x < width; x++)
+	 *         table.Set(x, y, x * 0.5, y * 0.5); // Zoom in 2x
+	 * table.Apply(source.constBits(), target.bits(), target.bytesPerLine());
+	 * @endcode
+	 */
+	class RemapTable {
+	private:
+		/// The source of a target pixel
+		struct Entry {
+			uint32_t offset;	///< The byte offset of the top-left source pixel
+			uint16_t weight_x;	///< The weight of the right source pixels (0 to 256)
+			uint16_t weight_y;	///< The weight of the bottom source pixels (0 to 256)
+		};
+		std::vector<Entry> entries;
+		int width;
+		int height;
+		int source_width;
+		int source_height;
+		int64_t source_bytes_per_line;
+		bool bilinear;
+
+	public:
+		/// @brief Create a table (mapping every target pixel to the top-left source pixel)
+		/// @param width The width of the target image
+		/// @param height The height of the target image
+		/// @param source_width The width of the source image
+		/// @param source_height The height of the source image
+		/// @param source_bytes_per_line The number of bytes between the start of each row of the source image
+		/// @param bilinear Interpolate between the 4 nearest source pixels (or sample the nearest pixel)
+		RemapTable(int width, int height, int source_width, int source_height, int64_t source_bytes_per_line, bool bilinear);
+
+		/// @brief Set the source position of a target pixel (pixels may be set from multiple threads)
+		/// @param x The column of the target pixel
+		/// @param y The row of the target pixel
+		/// @param source_x The horizontal position in the source image (in pixels)
+		/// @param source_y The vertical position in the source image (in pixels)
+		void Set(int x, int y, double source_x, double source_y);
+
+		/// @brief Sample the source image for every target pixel
+		/// @param source The pixels of the source image (4 bytes per pixel)
+		/// @param target The pixels of the target image (4 bytes per pixel), which must not overlap the source
+		/// @param target_bytes_per_line The number of bytes between the start of each row of the target image
+		void Apply(const unsigned char* source, unsigned char* target, int64_t target_bytes_per_line) const;
+
+		/// Get the size of the table (in bytes)
+		int64_t Bytes() const { return int64_t(entries.size() * sizeof(Entry)); }
+	};
+
+}
+
+#endif // OPENSHOT_REMAP_TABLE_H
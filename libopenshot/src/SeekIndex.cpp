@@ -0,0 +1,199 @@
+/**
+ * @file
+ * @brief Source file for SeekIndex class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "SeekIndex.h"
+
+#include <algorithm>
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include "FFmpegUtilities.h"
+#include "Settings.h"
+#include "ZmqLogger.h"
+
+using namespace openshot;
+
+// Header of index files ("OSKI"), and the version of their layout
+static const quint32 SEEK_INDEX_MAGIC = 0x4F534B49;
+static const qint32 SEEK_INDEX_VERSION = 1;
+
+// Build the index by reading all packets of a video stream
+bool SeekIndex::Build(const std::string& path, int video_stream, const std::atomic<bool>* cancel) {
+	keyframes.clear();
+	stream_index = video_stream;
+
+	// Open a separate format context (so the index can be built while the file is being decoded)
+	AVFormatContext *format_ctx = NULL;
+	if (avformat_open_input(&format_ctx, path.c_str(), NULL, NULL) != 0)
+		return false;
+	if (video_stream < 0 || video_stream >= (int) format_ctx->nb_streams) {
+		avformat_close_input(&format_ctx);
+		return false;
+	}
+
+	// Only demux the indexed stream (packets are never decoded)
+	for (unsigned int i = 0; i < format_ctx->nb_streams; i++)
+		format_ctx->streams[i]->discard = ((int) i == video_stream) ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+
+	bool is_cancelled = false;
+	AVPacket *packet = new AVPacket();
+	while (av_read_frame(format_ctx, packet) >= 0) {
+		if (packet->stream_index == video_stream && (packet->flags & AV_PKT_FLAG_KEY)) {
+			int64_t pts = packet->pts;
+			if (pts == AV_NOPTS_VALUE)
+				pts = packet->dts;
+			if (pts != AV_NOPTS_VALUE)
+				keyframes.push_back({pts, packet->pos});
+		}
+		AV_FREE_PACKET(packet);
+
+		if (cancel && *cancel) {
+			is_cancelled = true;
+			break;
+		}
+	}
+	delete packet;
+	avformat_close_input(&format_ctx);
+
+	if (is_cancelled) {
+		keyframes.clear();
+		return false;
+	}
+
+	// Sort keyframes by timestamp (and remove duplicates)
+	std::sort(keyframes.begin(), keyframes.end(), [](const Entry& lhs, const Entry& rhs) {
+		return lhs.pts < rhs.pts;
+	});
+	keyframes.erase(std::unique(keyframes.begin(), keyframes.end(), [](const Entry& lhs, const Entry& rhs) {
+		return lhs.pts == rhs.pts;
+	}), keyframes.end());
+
+	// Debug output
+	ZmqLogger::Instance()->AppendDebugMethod("SeekIndex::Build", "video_stream", video_stream, "keyframes", keyframes.size());
+
+	return !keyframes.empty();
+}
+
+// Find the nearest keyframe at (or before) a timestamp
+bool SeekIndex::Find(int64_t pts, Entry& keyframe) const {
+	auto next = std::upper_bound(keyframes.begin(), keyframes.end(), pts, [](int64_t value, const Entry& entry) {
+		return value < entry.pts;
+	});
+	if (next == keyframes.begin())
+		return false;
+
+	keyframe = *(next - 1);
+	return true;
+}
+
+// Get the index file of a media file
+std::string SeekIndex::IndexPath(const std::string& path) {
+	QFileInfo media_info(QString::fromStdString(path));
+	if (!media_info.exists())
+		return "";
+
+	QString folder = QString::fromStdString(Settings::Instance()->SEEK_INDEX_PATH);
+	if (folder.isEmpty())
+		// Use a folder in the user's temp directory
+		folder = QDir::tempPath() + QString("/seek-index/");
+
+	// Name the index after the path, size, and modification time of the media file
+	QString key = media_info.absoluteFilePath() + "|" + QString::number(media_info.size()) + "|"
+		+ QString::number(media_info.lastModified().toMSecsSinceEpoch());
+	QString name = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex();
+
+	return QDir(folder).filePath(name + ".index").toStdString();
+}
+
+// Load a saved index for a media file
+bool SeekIndex::Load(const std::string& path, int video_stream) {
+	keyframes.clear();
+	stream_index = -1;
+
+	std::string index_path = IndexPath(path);
+	if (index_path.empty())
+		return false;
+	QFile file(QString::fromStdString(index_path));
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_0);
+	quint32 magic = 0;
+	qint32 version = 0;
+	QString saved_path;
+	qint64 saved_size = 0;
+	qint64 saved_modified = 0;
+	qint32 saved_stream = -1;
+	quint32 count = 0;
+	stream >> magic >> version >> saved_path >> saved_size >> saved_modified >> saved_stream >> count;
+
+	// Verify the index belongs to this (unchanged) media file
+	QFileInfo media_info(QString::fromStdString(path));
+	if (stream.status() != QDataStream::Ok || magic != SEEK_INDEX_MAGIC || version != SEEK_INDEX_VERSION
+		|| saved_path != media_info.absoluteFilePath() || saved_size != media_info.size()
+		|| saved_modified != media_info.lastModified().toMSecsSinceEpoch() || saved_stream != video_stream
+		|| qint64(count) * 2 * qint64(sizeof(qint64)) > file.size())
+		return false;
+
+	std::vector<Entry> entries;
+	entries.reserve(count);
+	for (quint32 i = 0; i < count; i++) {
+		qint64 pts = 0;
+		qint64 pos = 0;
+		stream >> pts >> pos;
+		entries.push_back({pts, pos});
+	}
+	if (stream.status() != QDataStream::Ok)
+		return false;
+
+	keyframes = std::move(entries);
+	stream_index = video_stream;
+	return !keyframes.empty();
+}
+
+// Save the index for a media file
+bool SeekIndex::Save(const std::string& path) const {
+	std::string index_path = IndexPath(path);
+	if (index_path.empty() || keyframes.empty())
+		return false;
+
+	// Create index folder (if needed)
+	QFileInfo index_info(QString::fromStdString(index_path));
+	if (!index_info.dir().exists())
+		index_info.dir().mkpath(".");
+
+	// Write to a temp file which replaces the index on commit (so a partial index is never loaded)
+	QSaveFile file(index_info.filePath());
+	if (!file.open(QIODevice::WriteOnly))
+		return false;
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_0);
+	QFileInfo media_info(QString::fromStdString(path));
+	stream << SEEK_INDEX_MAGIC << SEEK_INDEX_VERSION << media_info.absoluteFilePath() << qint64(media_info.size())
+		   << qint64(media_info.lastModified().toMSecsSinceEpoch()) << qint32(stream_index) << quint32(keyframes.size());
+	for (const auto& keyframe : keyframes)
+		stream << qint64(keyframe.pts) << qint64(keyframe.pos);
+
+	if (stream.status() != QDataStream::Ok) {
+		file.cancelWriting();
+		return false;
+	}
+	return file.commit();
+}
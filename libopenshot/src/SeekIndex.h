@@ -0,0 +1,92 @@
+/**
+ * @file
+ * @brief Header file for SeekIndex class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_SEEK_INDEX_H
+#define OPENSHOT_SEEK_INDEX_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace openshot {
+
+	/**
+	 * @brief This class indexes the keyframes (i.e. I-frames) of a video stream, for fast and accurate seeking
+	 *
+	 * The index is built by demuxing (but not decoding) every packet of a video stream, and recording the
+	 * timestamp and byte position of each keyframe. A seek can then jump directly to the nearest keyframe
+	 * before a requested timestamp, instead of relying on the container's own index (which is missing or
+	 * inaccurate in many files).
+	 *
+	 * Since building an index requires reading the entire file, it can be saved to (and loaded from) an
+	 * index file in openshot::Settings::SEEK_INDEX_PATH. Index files are named after the path, size and
+	 * modification time of the media file, so a changed file is automatically re-indexed.
+	 *
+	 * @code
+	 * SeekIndex index;
+	 * if (!index.Load("MyAwesomeVideo.mp4", 0) && index.Build("MyAwesomeVideo.mp4", 0))
+	 *     index.Save("MyAwesomeVideo.mp4");
+	 *
+	 * SeekIndex::Entry keyframe;
+	 * if (index.Find(pts, keyframe))
+	 *     av_seek_frame(format_ctx, 0, keyframe.pts, AVSEEK_FLAG_BACKWARD);
+	 * @endcode
+	 */
+	class SeekIndex {
+	public:
+		/// A keyframe of the indexed stream
+		struct Entry {
+			int64_t pts; ///< The timestamp of the keyframe (in the stream's timebase)
+			int64_t pos; ///< The byte position of the keyframe's packet in the file (-1 if unknown)
+		};
+
+	private:
+		std::vector<Entry> keyframes; ///< Keyframes, sorted by timestamp
+		int stream_index;
+
+	public:
+		/// Default constructor (empty index)
+		SeekIndex() : stream_index(-1) { }
+
+		/// @brief Build the index by reading all packets of a video stream
+		/// @returns True if any keyframes were found
+		/// @param path The media file to index
+		/// @param video_stream The index of the video stream (in the media file)
+		/// @param cancel Optional flag, which stops building the index (when set to true by another thread)
+		bool Build(const std::string& path, int video_stream, const std::atomic<bool>* cancel = nullptr);
+
+		/// Get the number of indexed keyframes
+		size_t Count() const { return keyframes.size(); }
+
+		/// @brief Find the nearest keyframe at (or before) a timestamp
+		/// @returns False if there are no keyframes at (or before) the timestamp
+		/// @param pts The timestamp (in the stream's timebase)
+		/// @param keyframe The keyframe which is found
+		bool Find(int64_t pts, Entry& keyframe) const;
+
+		/// Get the index file of a media file (or an empty string, if the media file does not exist)
+		static std::string IndexPath(const std::string& path);
+
+		/// Load a saved index for a media file (returns false if there is no saved index, or the file has changed)
+		bool Load(const std::string& path, int video_stream);
+
+		/// Save the index for a media file (returns false if the index file can't be written)
+		bool Save(const std::string& path) const;
+
+		/// Get the index of the indexed video stream
+		int StreamIndex() const { return stream_index; }
+	};
+
+}
+
+#endif // OPENSHOT_SEEK_INDEX_H
@@ -70,6 +70,18 @@ namespace openshot {
 		/// Number of threads that ffmpeg uses
 		int FF_THREADS = 16;
 
+		/// Number of frames each FFmpegReader decodes ahead of the last requested frame, on a background thread (0 = disabled)
+		int READ_AHEAD_FRAMES = 0;
+
+		/// Index the keyframes of each video opened by FFmpegReader (on a background thread), for faster and more accurate seeking
+		bool ENABLE_SEEK_INDEX = false;
+
+		/// The folder used to save FFmpegReader keyframe indexes (empty = a folder in the user's temp directory)
+		std::string SEEK_INDEX_PATH = "";
+
+		/// Size of the 3D lookup tables baked for 2 or more adjacent color effects with unchanged values (0 = disabled, 2 to 65)
+		int COLOR_LUT_SIZE = 0;
+
 		/// Maximum rows that hardware decode can handle
 		int DE_LIMIT_HEIGHT_MAX = 1100;
 
@@ -106,6 +118,9 @@ namespace openshot {
 		/// Size of playback buffer before audio playback starts
 		int PLAYBACK_AUDIO_BUFFER_SIZE = 512;
 
+		/// Number of frames of audio mixed ahead of the audio device during playback (on a separate thread)
+		int PLAYBACK_AUDIO_MIX_FRAMES = 8;
+
 		/// The current install path of OpenShot (needs to be set when using Timeline(path), since certain
 		/// paths depend on the location of OpenShot transitions and files)
 		std::string PATH_OPENSHOT_INSTALL = "";
@@ -15,6 +15,7 @@
 #include "CacheBase.h"
 #include "CacheDisk.h"
 #include "CacheMemory.h"
+#include "ColorPipeline.h"
 #include "CrashHandler.h"
 #include "FrameMapper.h"
 #include "Exceptions.h"
@@ -26,7 +27,7 @@ using namespace openshot;
 
 // Default Constructor for the timeline (which sets the canvas width and height)
 Timeline::Timeline(int width, int height, Fraction fps, int sample_rate, int channels, ChannelLayout channel_layout) :
-		is_open(false), auto_map_clips(true), managed_cache(true), path(""),
+		is_open(false), auto_map_clips(true), active_renders(0), managed_cache(true), path(""),
 		max_concurrent_frames(OPEN_MP_NUM_PROCESSORS), max_time(0.0)
 {
 	// Create CrashHandler and Attach (incase of errors)
@@ -77,7 +78,7 @@ Timeline::Timeline(const ReaderInfo info) : Timeline::Timeline(
 
 // Constructor for the timeline (which loads a JSON structure from a file path, and initializes a timeline)
 Timeline::Timeline(const std::string& projectPath, bool convert_absolute_paths) :
-		is_open(false), auto_map_clips(true), managed_cache(true), path(projectPath),
+		is_open(false), auto_map_clips(true), active_renders(0), managed_cache(true), path(projectPath),
 		max_concurrent_frames(OPEN_MP_NUM_PROCESSORS), max_time(0.0) {
 
 	// Create CrashHandler and Attach (incase of errors)
@@ -333,6 +334,7 @@ void Timeline::AddClip(Clip* clip)
 {
 	// Get lock (prevent getting frames while this happens)
 	const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
+	wait_for_active_renders();
 
 	// Assign timeline to clip
 	clip->ParentTimeline(this);
@@ -347,6 +349,10 @@ void Timeline::AddClip(Clip* clip)
 		apply_mapper_to_clip(clip);
 	}
 
+	// Keep the clip in the same mode as this timeline
+	if (audio_only)
+		clip->AudioOnly(true);
+
 	// Add clip to list
 	clips.push_back(clip);
 
@@ -357,6 +363,10 @@ void Timeline::AddClip(Clip* clip)
 // Add an effect to the timeline
 void Timeline::AddEffect(EffectBase* effect)
 {
+	// Get lock (prevent getting frames while this happens)
+	const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
+	wait_for_active_renders();
+
 	// Assign timeline to effect
 	effect->ParentTimeline(this);
 
@@ -370,6 +380,10 @@ void Timeline::AddEffect(EffectBase* effect)
 // Remove an effect from the timeline
 void Timeline::RemoveEffect(EffectBase* effect)
 {
+	// Get lock (prevent getting frames while this happens)
+	const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
+	wait_for_active_renders();
+
 	effects.remove(effect);
 
 	// Delete effect object (if timeline allocated it)
@@ -389,8 +403,15 @@ void Timeline::RemoveClip(Clip* clip)
 {
 	// Get lock (prevent getting frames while this happens)
 	const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
+	wait_for_active_renders();
 
 	clips.remove(clip);
+
+	{
+		// Stop tracking the clip as 'opened' (it might be deleted after this)
+		const std::lock_guard<std::mutex> open_guard(open_clips_mutex);
+		open_clips.erase(clip);
+	}
 	
 	// Delete clip object (if timeline allocated it)
 	bool allocated = allocated_clips.count(clip);
@@ -514,6 +535,10 @@ void Timeline::apply_mapper_to_clip(Clip* clip)
 // Apply the timeline's framerate and samplerate to all clips
 void Timeline::ApplyMapperToClips()
 {
+	// Get lock (prevent getting frames while this happens)
+	const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
+	wait_for_active_renders();
+
 	// Clear all cached frames
 	ClearAllCache();
 
@@ -523,6 +548,10 @@ void Timeline::ApplyMapperToClips()
 		// Apply framemapper (or update existing framemapper)
 		apply_mapper_to_clip(clip);
 	}
+
+	// Frame ranges depend on the timeline's framerate
+	index_clips();
+	index_effects();
 }
 
 // Calculate time of a frame number, based on a framerate
@@ -545,40 +574,45 @@ std::shared_ptr<Frame> Timeline::apply_effects(std::shared_ptr<Frame> frame, int
 		"timeline_frame_number", timeline_frame_number,
 		"layer", layer);
 
-	// Find Effects at this position and layer
-	for (auto effect : effects)
+	// Find Effects at this position and layer (in sorted order)
+	std::vector<EffectBase*> intersecting_effects;
+	effect_index.Find(layer, timeline_frame_number, timeline_frame_number, intersecting_effects);
+
+	// Adjacent color effects are applied together (in a single pass)
+	ColorPipeline color_pipeline;
+
+	for (auto effect : intersecting_effects)
 	{
-		// Does clip intersect the current requested time
+		// Determine the frame needed for this effect (based on the position on the timeline)
 		long effect_start_position = round(effect->Position() * info.fps.ToDouble()) + 1;
-		long effect_end_position = round((effect->Position() + (effect->Duration())) * info.fps.ToDouble());
-
-		bool does_effect_intersect = (effect_start_position <= timeline_frame_number && effect_end_position >= timeline_frame_number && effect->Layer() == layer);
+		long effect_start_frame = (effect->Start() * info.fps.ToDouble()) + 1;
+		long effect_frame_number = timeline_frame_number - effect_start_position + effect_start_frame;
 
-		// Clip is visible
-		if (does_effect_intersect)
-		{
-			// Determine the frame needed for this clip (based on the position on the timeline)
-			long effect_start_frame = (effect->Start() * info.fps.ToDouble()) + 1;
-			long effect_frame_number = timeline_frame_number - effect_start_position + effect_start_frame;
+		if (!options->is_top_clip)
+			continue; // skip effect, if overlapped/covered by another clip on same layer
 
-			if (!options->is_top_clip)
-				continue; // skip effect, if overlapped/covered by another clip on same layer
+		if (options->is_before_clip_keyframes != effect->info.apply_before_clip)
+			continue; // skip effect, if this filter does not match
 
-			if (options->is_before_clip_keyframes != effect->info.apply_before_clip)
-				continue; // skip effect, if this filter does not match
+		if (audio_only && !effect->info.has_audio)
+			continue; // skip video effects in audio-only mode
 
-			// Debug output
-			ZmqLogger::Instance()->AppendDebugMethod(
-				"Timeline::apply_effects (Process Effect)",
-				"effect_frame_number", effect_frame_number,
-				"does_effect_intersect", does_effect_intersect);
+		// Debug output
+		ZmqLogger::Instance()->AppendDebugMethod(
+			"Timeline::apply_effects (Process Effect)",
+			"effect_frame_number", effect_frame_number);
 
-			// Apply the effect to this frame
+		// Apply the effect to this frame (after any pending color effects)
+		if (!color_pipeline.Add(effect, effect_frame_number)) {
+			frame = color_pipeline.Apply(frame);
 			frame = effect->GetFrame(frame, effect_frame_number);
 		}
 
 	} // end effect loop
 
+	// Apply any remaining color effects
+	frame = color_pipeline.Apply(frame);
+
 	// Return modified frame
 	return frame;
 }
@@ -728,28 +762,39 @@ void Timeline::update_open_clips(Clip *clip, bool does_clip_intersect)
 	// Get lock (prevent getting frames while this happens)
 	const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
 
-	ZmqLogger::Instance()->AppendDebugMethod(
-		"Timeline::update_open_clips (before)",
-		"does_clip_intersect", does_clip_intersect,
-		"closing_clips.size()", closing_clips.size(),
-		"open_clips.size()", open_clips.size());
+	bool clip_found = false;
+	bool clip_in_use = false;
+	{
+		// Only hold the bookkeeping lock while reading / updating the map (opening or
+		// closing a clip can re-sort the timeline, which waits on active renders)
+		const std::lock_guard<std::mutex> open_guard(open_clips_mutex);
 
-	// is clip already in list?
-	bool clip_found = open_clips.count(clip);
+		ZmqLogger::Instance()->AppendDebugMethod(
+			"Timeline::update_open_clips (before)",
+			"does_clip_intersect", does_clip_intersect,
+			"closing_clips.size()", closing_clips.size(),
+			"open_clips.size()", open_clips.size());
+
+		// is clip already in list? (and is another frame still rendering it?)
+		auto open_clip = open_clips.find(clip);
+		clip_found = (open_clip != open_clips.end());
+		clip_in_use = clip_found && open_clip->second > 0;
+
+		if (clip_found && !does_clip_intersect && !clip_in_use)
+			// Remove clip from 'opened' list, because it's closed now
+			open_clips.erase(open_clip);
+		else if (!clip_found && does_clip_intersect)
+			// Add clip to 'opened' list, because it's missing
+			open_clips[clip] = 0;
+	}
 
-	if (clip_found && !does_clip_intersect)
+	if (clip_found && !does_clip_intersect && !clip_in_use)
 	{
-		// Remove clip from 'opened' list, because it's closed now
-		open_clips.erase(clip);
-
 		// Close clip
 		clip->Close();
 	}
 	else if (!clip_found && does_clip_intersect)
 	{
-		// Add clip to 'opened' list, because it's missing
-		open_clips[clip] = clip;
-
 		try {
 			// Open the clip
 			clip->Open();
@@ -764,8 +809,37 @@ void Timeline::update_open_clips(Clip *clip, bool does_clip_intersect)
 		"Timeline::update_open_clips (after)",
 		"does_clip_intersect", does_clip_intersect,
 		"clip_found", clip_found,
-		"closing_clips.size()", closing_clips.size(),
-		"open_clips.size()", open_clips.size());
+		"clip_in_use", clip_in_use);
+}
+
+// Block until no frames are being composited (caller must hold getFrameMutex)
+void Timeline::wait_for_active_renders()
+{
+	std::unique_lock<std::mutex> render_lock(render_mutex);
+	render_condition.wait(render_lock, [this] { return active_renders == 0; });
+}
+
+// Release the clips and frame number claimed by a frame render
+void Timeline::finish_render(int64_t requested_frame, const std::vector<Clip*>& nearby_clips, bool is_active)
+{
+	{
+		// Clips are no longer being rendered by this frame (they can be closed again)
+		const std::lock_guard<std::mutex> open_guard(open_clips_mutex);
+		for (auto clip : nearby_clips) {
+			auto open_clip = open_clips.find(clip);
+			if (open_clip != open_clips.end() && open_clip->second > 0)
+				open_clip->second--;
+		}
+	}
+	{
+		const std::lock_guard<std::mutex> render_lock(render_mutex);
+		rendering_frames.erase(requested_frame);
+		if (is_active)
+			active_renders--;
+	}
+
+	// Wake up threads waiting on this frame # (or waiting to modify the timeline)
+	render_condition.notify_all();
 }
 
 // Calculate the max and min duration (in seconds) of the timeline, based on all the clips, and cache the value
@@ -821,6 +895,7 @@ void Timeline::sort_clips()
 {
 	// Get lock (prevent getting frames while this happens)
 	const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
+	wait_for_active_renders();
 
 	// Debug output
 	ZmqLogger::Instance()->AppendDebugMethod(
@@ -830,6 +905,9 @@ void Timeline::sort_clips()
 	// sort clips
 	clips.sort(CompareClips());
 
+	// update index of clip frame ranges
+	index_clips();
+
 	// calculate max timeline duration
 	calculate_max_duration();
 }
@@ -839,14 +917,49 @@ void Timeline::sort_effects()
 {
 	// Get lock (prevent getting frames while this happens)
 	const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
+	wait_for_active_renders();
 
 	// sort clips
 	effects.sort(CompareEffects());
 
+	// update index of effect frame ranges
+	index_effects();
+
 	// calculate max timeline duration
 	calculate_max_duration();
 }
 
+// Update the interval index of clips
+void Timeline::index_clips()
+{
+	// Clips are already sorted by layer and position (the order they are composited in)
+	std::vector<IntervalIndex<Clip*>::Interval> intervals;
+	intervals.reserve(clips.size());
+	for (auto clip : clips)
+	{
+		// Clips are 'nearby' until 1 frame past their end
+		int64_t clip_start_position = round(clip->Position() * info.fps.ToDouble()) + 1;
+		int64_t clip_end_position = round((clip->Position() + clip->Duration()) * info.fps.ToDouble()) + 1;
+		intervals.push_back({clip, clip->Layer(), clip_start_position, clip_end_position});
+	}
+	clip_index.Update(intervals);
+}
+
+// Update the interval index of effects
+void Timeline::index_effects()
+{
+	// Effects are already sorted by layer, position and order (the order they are applied in)
+	std::vector<IntervalIndex<EffectBase*>::Interval> intervals;
+	intervals.reserve(effects.size());
+	for (auto effect : effects)
+	{
+		int64_t effect_start_position = round(effect->Position() * info.fps.ToDouble()) + 1;
+		int64_t effect_end_position = round((effect->Position() + effect->Duration()) * info.fps.ToDouble());
+		intervals.push_back({effect, effect->Layer(), effect_start_position, effect_end_position});
+	}
+	effect_index.Update(intervals);
+}
+
 // Clear all clips from timeline
 void Timeline::Clear()
 {
@@ -854,6 +967,7 @@ void Timeline::Clear()
 
 	// Get lock (prevent getting frames while this happens)
 	const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
+	wait_for_active_renders();
 
 	// Close all open clips
 	for (auto clip : clips)
@@ -869,6 +983,7 @@ void Timeline::Clear()
 	// Clear all clips
 	clips.clear();
 	allocated_clips.clear();
+	clip_index.Clear();
 
 	// Close all effects
 	for (auto effect : effects)
@@ -882,6 +997,7 @@ void Timeline::Clear()
 	// Clear all effects
 	effects.clear();
 	allocated_effects.clear();
+	effect_index.Clear();
 
 	// Delete all FrameMappers
 	for (auto mapper : allocated_frame_mappers)
@@ -893,6 +1009,23 @@ void Timeline::Clear()
 	allocated_frame_mappers.clear();
 }
 
+// Enable or disable audio-only mode (of the timeline and all clips)
+void Timeline::AudioOnly(bool enabled)
+{
+	// Get lock (prevent getting frames while this happens)
+	const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
+	wait_for_active_renders();
+
+	if (enabled != audio_only) {
+		ReaderBase::AudioOnly(enabled);
+
+		// Cached frames have no image (or an image which is no longer needed)
+		final_cache->Clear();
+	}
+	for (auto clip : clips)
+		clip->AudioOnly(enabled);
+}
+
 // Close the reader (and any resources it was consuming)
 void Timeline::Close()
 {
@@ -900,6 +1033,7 @@ void Timeline::Close()
 
 	// Get lock (prevent getting frames while this happens)
 	const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
+	wait_for_active_renders();
 
 	// Close all open clips
 	for (auto clip : clips)
@@ -918,6 +1052,10 @@ void Timeline::Close()
 // Open the reader (and start consuming resources)
 void Timeline::Open()
 {
+	// Get lock (prevent getting frames while this happens)
+	const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
+	wait_for_active_renders();
+
 	is_open = true;
 }
 
@@ -946,13 +1084,15 @@ std::shared_ptr<Frame> Timeline::GetFrame(int64_t requested_frame)
 		// Return cached frame
 		return frame;
 	}
-	else
+
 	{
-		// Prevent async calls to the following code
-		const std::lock_guard<std::recursive_mutex> lock(getFrameMutex);
+		// Wait for any other thread which is already rendering this frame #
+		std::unique_lock<std::mutex> render_lock(render_mutex);
+		render_condition.wait(render_lock, [this, requested_frame] {
+			return rendering_frames.count(requested_frame) == 0;
+		});
 
 		// Check cache 2nd time
-		std::shared_ptr<Frame> frame;
 		frame = final_cache->GetFrame(requested_frame);
 		if (frame) {
 			// Debug output
@@ -962,128 +1102,173 @@ std::shared_ptr<Frame> Timeline::GetFrame(int64_t requested_frame)
 
 			// Return cached frame
 			return frame;
-		} else {
-			// Get a list of clips that intersect with the requested section of timeline
-			// This also opens the readers for intersecting clips, and marks non-intersecting clips as 'needs closing'
-			std::vector<Clip *> nearby_clips;
-			nearby_clips = find_intersecting_clips(requested_frame, 1, true);
+		}
 
-			// Debug output
-			ZmqLogger::Instance()->AppendDebugMethod(
-					"Timeline::GetFrame (processing frame)",
-					"requested_frame", requested_frame,
-					"omp_get_thread_num()", omp_get_thread_num());
+		// Claim this frame # (other threads requesting it will wait for this render)
+		rendering_frames.insert(requested_frame);
+	}
 
-			// Init some basic properties about this frame
-			int samples_in_frame = Frame::GetSamplesPerFrame(requested_frame, info.fps, info.sample_rate, info.channels);
+	// Snapshot everything needed to composite this frame. Timeline changes (AddClip, ApplyJsonDiff, etc...)
+	// hold getFrameMutex and wait for all active renders, so this snapshot stays valid until the frame is done.
+	std::vector<Clip *> nearby_clips;
+	int frame_width = 0;
+	int frame_height = 0;
+	try {
+		// Prevent async calls to the following code
+		const std::lock_guard<std::recursive_mutex> lock(getFrameMutex);
 
-			// Create blank frame (which will become the requested frame)
-			std::shared_ptr<Frame> new_frame(std::make_shared<Frame>(requested_frame, preview_width, preview_height, "#000000", samples_in_frame, info.channels));
-			new_frame->AddAudioSilence(samples_in_frame);
-			new_frame->SampleRate(info.sample_rate);
-			new_frame->ChannelsLayout(info.channel_layout);
+		// Get a list of clips that intersect with the requested section of timeline
+		// This also opens the readers for intersecting clips, and marks non-intersecting clips as 'needs closing'
+		nearby_clips = find_intersecting_clips(requested_frame, 1, true);
+		frame_width = preview_width;
+		frame_height = preview_height;
 
-			// Debug output
-			ZmqLogger::Instance()->AppendDebugMethod(
-					"Timeline::GetFrame (Adding solid color)",
-					"requested_frame", requested_frame,
-					"info.width", info.width,
-					"info.height", info.height);
+		{
+			// Mark clips as in use (so other frames do not close them while we render)
+			const std::lock_guard<std::mutex> open_guard(open_clips_mutex);
+			for (auto clip : nearby_clips)
+				open_clips[clip]++;
+		}
+		{
+			const std::lock_guard<std::mutex> render_lock(render_mutex);
+			active_renders++;
+		}
+	} catch (...) {
+		// Release the claimed frame # (no clips were marked as in use)
+		finish_render(requested_frame, std::vector<Clip *>(), false);
+		throw;
+	}
 
-			// Add Background Color to 1st layer (if animated or not black)
-			if ((color.red.GetCount() > 1 || color.green.GetCount() > 1 || color.blue.GetCount() > 1) ||
-				(color.red.GetValue(requested_frame) != 0.0 || color.green.GetValue(requested_frame) != 0.0 ||
-				 color.blue.GetValue(requested_frame) != 0.0))
-				new_frame->AddColor(preview_width, preview_height, color.GetColorHex(requested_frame));
+	try {
+		// Debug output
+		ZmqLogger::Instance()->AppendDebugMethod(
+				"Timeline::GetFrame (processing frame)",
+				"requested_frame", requested_frame,
+				"omp_get_thread_num()", omp_get_thread_num());
+
+		// Init some basic properties about this frame
+		int samples_in_frame = Frame::GetSamplesPerFrame(requested_frame, info.fps, info.sample_rate, info.channels);
+
+		// Create blank frame (which will become the requested frame)
+		std::shared_ptr<Frame> new_frame(std::make_shared<Frame>(requested_frame, frame_width, frame_height, "#000000", samples_in_frame, info.channels));
+		new_frame->AddAudioSilence(samples_in_frame);
+		new_frame->SampleRate(info.sample_rate);
+		new_frame->ChannelsLayout(info.channel_layout);
+
+		// Debug output
+		ZmqLogger::Instance()->AppendDebugMethod(
+				"Timeline::GetFrame (Adding solid color)",
+				"requested_frame", requested_frame,
+				"info.width", info.width,
+				"info.height", info.height);
+
+		// Add Background Color to 1st layer (if animated or not black), except in audio-only mode
+		if (!audio_only && ((color.red.GetCount() > 1 || color.green.GetCount() > 1 || color.blue.GetCount() > 1) ||
+			(color.red.GetValue(requested_frame) != 0.0 || color.green.GetValue(requested_frame) != 0.0 ||
+			 color.blue.GetValue(requested_frame) != 0.0)))
+			new_frame->AddColor(frame_width, frame_height, color.GetColorHex(requested_frame));
+
+		// Debug output
+		ZmqLogger::Instance()->AppendDebugMethod(
+				"Timeline::GetFrame (Loop through clips)",
+				"requested_frame", requested_frame,
+				"nearby_clips.size()", nearby_clips.size());
+
+		// Determine the max volume of all overlapping clips, and the "top" clip position on each
+		// layer (the last clip to start, when multiple clips are overlapping) in a single pass
+		float max_volume = 0.0;
+		std::map<int, long> top_clip_positions;
+		for (auto nearby_clip : nearby_clips) {
+			long nearby_clip_start_position = round(nearby_clip->Position() * info.fps.ToDouble()) + 1;
+			long nearby_clip_start_frame = (nearby_clip->Start() * info.fps.ToDouble()) + 1;
+			long nearby_clip_frame_number = requested_frame - nearby_clip_start_position + nearby_clip_start_frame;
+
+			// Track the latest starting clip on each layer
+			auto top_clip_position = top_clip_positions.find(nearby_clip->Layer());
+			if (top_clip_position == top_clip_positions.end())
+				top_clip_positions[nearby_clip->Layer()] = nearby_clip_start_position;
+			else if (nearby_clip_start_position > top_clip_position->second)
+				top_clip_position->second = nearby_clip_start_position;
+
+			// Determine max volume of overlapping clips
+			if (nearby_clip->Reader() && nearby_clip->Reader()->info.has_audio &&
+				nearby_clip->has_audio.GetInt(nearby_clip_frame_number) != 0) {
+				max_volume += nearby_clip->volume.GetValue(nearby_clip_frame_number);
+			}
+		}
+
+		// Find Clips near this time
+		for (auto clip : nearby_clips) {
+			long clip_start_position = round(clip->Position() * info.fps.ToDouble()) + 1;
+			long clip_end_position = round((clip->Position() + clip->Duration()) * info.fps.ToDouble());
+			bool does_clip_intersect = (clip_start_position <= requested_frame && clip_end_position >= requested_frame);
+
+			// Audio-only mode skips clips without audio (or muted with the has_audio keyframe) on this frame
+			if (does_clip_intersect && audio_only) {
+				long clip_frame_number = requested_frame - clip_start_position + (long)(clip->Start() * info.fps.ToDouble()) + 1;
+				if (!clip->Reader() || !clip->Reader()->info.has_audio || clip->has_audio.GetInt(clip_frame_number) == 0)
+					does_clip_intersect = false;
+			}
 
 			// Debug output
 			ZmqLogger::Instance()->AppendDebugMethod(
-					"Timeline::GetFrame (Loop through clips)",
+					"Timeline::GetFrame (Does clip intersect)",
 					"requested_frame", requested_frame,
-					"clips.size()", clips.size(),
-					"nearby_clips.size()", nearby_clips.size());
+					"clip->Position()", clip->Position(),
+					"clip->Duration()", clip->Duration(),
+					"does_clip_intersect", does_clip_intersect);
 
-			// Find Clips near this time
-			for (auto clip : nearby_clips) {
-				long clip_start_position = round(clip->Position() * info.fps.ToDouble()) + 1;
-				long clip_end_position = round((clip->Position() + clip->Duration()) * info.fps.ToDouble());
-				bool does_clip_intersect = (clip_start_position <= requested_frame && clip_end_position >= requested_frame);
+			// Clip is visible
+			if (does_clip_intersect) {
+				// Determine if clip is "top" clip on this layer (only happens when multiple clips are overlapping)
+				bool is_top_clip = clip_start_position >= top_clip_positions[clip->Layer()];
+
+				// Determine the frame needed for this clip (based on the position on the timeline)
+				long clip_start_frame = (clip->Start() * info.fps.ToDouble()) + 1;
+				long clip_frame_number = requested_frame - clip_start_position + clip_start_frame;
 
 				// Debug output
 				ZmqLogger::Instance()->AppendDebugMethod(
-						"Timeline::GetFrame (Does clip intersect)",
-						"requested_frame", requested_frame,
+						"Timeline::GetFrame (Calculate clip's frame #)",
 						"clip->Position()", clip->Position(),
-						"clip->Duration()", clip->Duration(),
-						"does_clip_intersect", does_clip_intersect);
+						"clip->Start()", clip->Start(),
+						"info.fps.ToFloat()", info.fps.ToFloat(),
+						"clip_frame_number", clip_frame_number);
 
-				// Clip is visible
-				if (does_clip_intersect) {
-					// Determine if clip is "top" clip on this layer (only happens when multiple clips are overlapping)
-					bool is_top_clip = true;
-					float max_volume = 0.0;
-					for (auto nearby_clip : nearby_clips) {
-						long nearby_clip_start_position = round(nearby_clip->Position() * info.fps.ToDouble()) + 1;
-						long nearby_clip_end_position = round((nearby_clip->Position() + nearby_clip->Duration()) * info.fps.ToDouble()) + 1;
-						long nearby_clip_start_frame = (nearby_clip->Start() * info.fps.ToDouble()) + 1;
-						long nearby_clip_frame_number = requested_frame - nearby_clip_start_position + nearby_clip_start_frame;
-
-						// Determine if top clip
-						if (clip->Id() != nearby_clip->Id() && clip->Layer() == nearby_clip->Layer() &&
-							nearby_clip_start_position <= requested_frame && nearby_clip_end_position >= requested_frame &&
-							nearby_clip_start_position > clip_start_position && is_top_clip == true) {
-							is_top_clip = false;
-						}
-
-						// Determine max volume of overlapping clips
-						if (nearby_clip->Reader() && nearby_clip->Reader()->info.has_audio &&
-							nearby_clip->has_audio.GetInt(nearby_clip_frame_number) != 0 &&
-							nearby_clip_start_position <= requested_frame && nearby_clip_end_position >= requested_frame) {
-							max_volume += nearby_clip->volume.GetValue(nearby_clip_frame_number);
-						}
-					}
+				// Add clip's frame as layer
+				add_layer(new_frame, clip, clip_frame_number, is_top_clip, max_volume);
 
-					// Determine the frame needed for this clip (based on the position on the timeline)
-					long clip_start_frame = (clip->Start() * info.fps.ToDouble()) + 1;
-					long clip_frame_number = requested_frame - clip_start_position + clip_start_frame;
-
-					// Debug output
-					ZmqLogger::Instance()->AppendDebugMethod(
-							"Timeline::GetFrame (Calculate clip's frame #)",
-							"clip->Position()", clip->Position(),
-							"clip->Start()", clip->Start(),
-							"info.fps.ToFloat()", info.fps.ToFloat(),
-							"clip_frame_number", clip_frame_number);
-
-					// Add clip's frame as layer
-					add_layer(new_frame, clip, clip_frame_number, is_top_clip, max_volume);
-
-				} else {
-					// Debug output
-					ZmqLogger::Instance()->AppendDebugMethod(
-							"Timeline::GetFrame (clip does not intersect)",
-							"requested_frame", requested_frame,
-							"does_clip_intersect", does_clip_intersect);
-				}
+			} else {
+				// Debug output
+				ZmqLogger::Instance()->AppendDebugMethod(
+						"Timeline::GetFrame (clip does not intersect)",
+						"requested_frame", requested_frame,
+						"does_clip_intersect", does_clip_intersect);
+			}
 
-			} // end clip loop
+		} // end clip loop
 
-			// Debug output
-			ZmqLogger::Instance()->AppendDebugMethod(
-					"Timeline::GetFrame (Add frame to cache)",
-					"requested_frame", requested_frame,
-					"info.width", info.width,
-					"info.height", info.height);
+		// Debug output
+		ZmqLogger::Instance()->AppendDebugMethod(
+				"Timeline::GetFrame (Add frame to cache)",
+				"requested_frame", requested_frame,
+				"info.width", info.width,
+				"info.height", info.height);
 
-			// Set frame # on mapped frame
-			new_frame->SetFrameNumber(requested_frame);
+		// Set frame # on mapped frame
+		new_frame->SetFrameNumber(requested_frame);
 
-			// Add final frame to cache
-			final_cache->Add(new_frame);
+		// Add final frame to cache (before releasing this frame #, so waiting threads find it)
+		final_cache->Add(new_frame);
+		finish_render(requested_frame, nearby_clips, true);
 
-			// Return frame (or blank frame)
-			return new_frame;
-		}
+		// Return frame (or blank frame)
+		return new_frame;
+
+	} catch (...) {
+		// Release the claimed frame # and clips (so other threads are not blocked forever)
+		finish_render(requested_frame, nearby_clips, true);
+		throw;
 	}
 }
 
@@ -1091,46 +1276,50 @@ std::shared_ptr<Frame> Timeline::GetFrame(int64_t requested_frame)
 // Find intersecting clips (or non intersecting clips)
 std::vector<Clip*> Timeline::find_intersecting_clips(int64_t requested_frame, int number_of_frames, bool include)
 {
-	// Find matching clips
-	std::vector<Clip*> matching_clips;
-
 	// Calculate time of frame
-	float min_requested_frame = requested_frame;
-	float max_requested_frame = requested_frame + (number_of_frames - 1);
+	int64_t min_requested_frame = requested_frame;
+	int64_t max_requested_frame = requested_frame + (number_of_frames - 1);
 
-	// Find Clips at this time
-	for (auto clip : clips)
+	// Find Clips at this time (using the interval index, in sorted order)
+	std::vector<Clip*> intersecting_clips;
+	clip_index.Find(min_requested_frame, max_requested_frame, intersecting_clips);
+	std::set<Clip*> intersecting_set(intersecting_clips.begin(), intersecting_clips.end());
+
+	// Debug output
+	ZmqLogger::Instance()->AppendDebugMethod(
+		"Timeline::find_intersecting_clips",
+		"requested_frame", requested_frame,
+		"min_requested_frame", min_requested_frame,
+		"max_requested_frame", max_requested_frame,
+		"intersecting_clips.size()", intersecting_clips.size());
+
+	// Find opened clips which are no longer intersecting
+	std::vector<Clip*> closing;
 	{
-		// Does clip intersect the current requested time
-		long clip_start_position = round(clip->Position() * info.fps.ToDouble()) + 1;
-		long clip_end_position = round((clip->Position() + clip->Duration()) * info.fps.ToDouble()) + 1;
+		const std::lock_guard<std::mutex> open_guard(open_clips_mutex);
+		for (const auto& open_clip : open_clips) {
+			if (intersecting_set.count(open_clip.first) == 0)
+				closing.push_back(open_clip.first);
+		}
+	}
 
-		bool does_clip_intersect =
-				(clip_start_position <= min_requested_frame || clip_start_position <= max_requested_frame) &&
-				(clip_end_position >= min_requested_frame || clip_end_position >= max_requested_frame);
+	// Close (or schedule for closing) the non-intersecting clips, and open the intersecting clips
+	for (auto clip : closing)
+		update_open_clips(clip, false);
+	for (auto clip : intersecting_clips)
+		update_open_clips(clip, true);
 
-		// Debug output
-		ZmqLogger::Instance()->AppendDebugMethod(
-			"Timeline::find_intersecting_clips (Is clip near or intersecting)",
-			"requested_frame", requested_frame,
-			"min_requested_frame", min_requested_frame,
-			"max_requested_frame", max_requested_frame,
-			"clip->Position()", clip->Position(),
-			"does_clip_intersect", does_clip_intersect);
-
-		// Open (or schedule for closing) this clip, based on if it's intersecting or not
-		update_open_clips(clip, does_clip_intersect);
-
-		// Clip is visible
-		if (does_clip_intersect && include)
-			// Add the intersecting clip
-			matching_clips.push_back(clip);
+	// Return the intersecting clips
+	if (include)
+		return intersecting_clips;
 
-		else if (!does_clip_intersect && !include)
-			// Add the non-intersecting clip
+	// Find the non-intersecting clips
+	std::vector<Clip*> matching_clips;
+	for (auto clip : clips)
+	{
+		if (intersecting_set.count(clip) == 0)
 			matching_clips.push_back(clip);
-
-	} // end clip loop
+	}
 
 	// return list
 	return matching_clips;
@@ -1140,6 +1329,7 @@ std::vector<Clip*> Timeline::find_intersecting_clips(int64_t requested_frame, in
 void Timeline::SetCache(CacheBase* new_cache) {
 	// Get lock (prevent getting frames while this happens)
 	const std::lock_guard<std::recursive_mutex> lock(getFrameMutex);
+	wait_for_active_renders();
 
 	// Destroy previous cache (if managed by timeline)
 	if (managed_cache && final_cache) {
@@ -1198,6 +1388,7 @@ void Timeline::SetJson(const std::string value) {
 
 	// Get lock (prevent getting frames while this happens)
 	const std::lock_guard<std::recursive_mutex> lock(getFrameMutex);
+	wait_for_active_renders();
 
 	// Parse JSON string into JSON objects
 	try
@@ -1218,6 +1409,7 @@ void Timeline::SetJsonValue(const Json::Value root) {
 
 	// Get lock (prevent getting frames while this happens)
 	const std::lock_guard<std::recursive_mutex> lock(getFrameMutex);
+	wait_for_active_renders();
 
 	// Close timeline before we do anything (this closes all clips)
 	bool was_open = is_open;
@@ -1317,6 +1509,7 @@ void Timeline::ApplyJsonDiff(std::string value) {
 
 	// Get lock (prevent getting frames while this happens)
 	const std::lock_guard<std::recursive_mutex> lock(getFrameMutex);
+	wait_for_active_renders();
 
 	// Parse JSON string into JSON objects
 	try
@@ -1703,6 +1896,12 @@ void Timeline::apply_json_to_timeline(Json::Value change) {
 
 	}
 
+	if (root_key == "fps") {
+		// Frame ranges of clips and effects depend on the framerate
+		index_clips();
+		index_effects();
+	}
+
 	if (cache_dirty) {
 		// Clear entire cache
 		ClearAllCache();
@@ -1712,6 +1911,9 @@ void Timeline::apply_json_to_timeline(Json::Value change) {
 // Clear all caches
 void Timeline::ClearAllCache(bool deep) {
 
+	// Get lock (prevent clips from being added or removed while this happens)
+	const std::lock_guard<std::recursive_mutex> lock(getFrameMutex);
+
 	// Clear primary cache
 	if (final_cache) {
 		final_cache->Clear();
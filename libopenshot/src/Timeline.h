@@ -13,6 +13,7 @@
 #ifndef OPENSHOT_TIMELINE_H
 #define OPENSHOT_TIMELINE_H
 
+#include <condition_variable>
 #include <list>
 #include <memory>
 #include <mutex>
@@ -29,6 +30,7 @@
 #include "EffectBase.h"
 #include "Fraction.h"
 #include "Frame.h"
+#include "IntervalIndex.h"
 #include "KeyFrame.h"
 #ifdef USE_OPENCV
 #include "TrackedObjectBBox.h"
@@ -151,10 +153,17 @@ namespace openshot {
 		bool auto_map_clips; ///< Auto map framerates and sample rates to all clips
 		std::list<openshot::Clip*> clips; ///<List of clips on this timeline
 		std::list<openshot::Clip*> closing_clips; ///<List of clips that need to be closed
-		std::map<openshot::Clip*, openshot::Clip*> open_clips; ///<List of 'opened' clips on this timeline
+		std::map<openshot::Clip*, int> open_clips; ///<List of 'opened' clips on this timeline (and the # of frames currently rendering each one)
+		std::mutex open_clips_mutex; ///< Mutex protecting open_clips (clip open/close bookkeeping)
+		std::mutex render_mutex; ///< Mutex protecting rendering_frames and active_renders
+		std::condition_variable render_condition; ///< Notified each time a frame finishes rendering
+		std::set<int64_t> rendering_frames; ///< Frame numbers currently being rendered (by any thread)
+		int active_renders; ///< Number of frames currently being composited (outside of getFrameMutex)
 		std::set<openshot::Clip*> allocated_clips; ///<List of clips that were allocated by this timeline
 		std::list<openshot::EffectBase*> effects; ///<List of clips on this timeline
 		std::set<openshot::EffectBase*> allocated_effects; ///<List of effects that were allocated by this timeline
+		openshot::IntervalIndex<openshot::Clip*> clip_index; ///< Index of clips by layer and frame range (for fast intersection queries)
+		openshot::IntervalIndex<openshot::EffectBase*> effect_index; ///< Index of effects by layer and frame range (for fast intersection queries)
 		openshot::CacheBase *final_cache; ///<Final cache of timeline frames
 		std::set<openshot::FrameMapper*> allocated_frame_mappers; ///< all the frame mappers we allocated and must free
 		bool managed_cache; ///< Does this timeline instance manage the cache object
@@ -191,12 +200,21 @@ namespace openshot {
 		/// @param include Include or Exclude intersecting clips
 		std::vector<openshot::Clip*> find_intersecting_clips(int64_t requested_frame, int number_of_frames, bool include);
 
+		/// Release the clips and frame number claimed by a frame render (and wake up any waiting threads)
+		void finish_render(int64_t requested_frame, const std::vector<openshot::Clip*>& nearby_clips, bool is_active);
+
 		/// Get a clip's frame or generate a blank frame
 		std::shared_ptr<openshot::Frame> GetOrCreateFrame(std::shared_ptr<Frame> background_frame, openshot::Clip* clip, int64_t number, openshot::TimelineInfoStruct* options);
 
 		/// Compare 2 floating point numbers for equality
 		bool isEqual(double a, double b);
 
+		/// Update the interval index of clips (only layers which changed are re-built)
+		void index_clips();
+
+		/// Update the interval index of effects (only layers which changed are re-built)
+		void index_effects();
+
 		/// Sort clips by position on the timeline
 		void sort_clips();
 
@@ -206,6 +224,11 @@ namespace openshot {
 		/// Update the list of 'opened' clips
 		void update_open_clips(openshot::Clip *clip, bool does_clip_intersect);
 
+		/// Block until no frames are being composited. Must be called while holding getFrameMutex,
+		/// which prevents new renders from starting, so changes to clips and effects are never
+		/// visible to a frame which is already being rendered.
+		void wait_for_active_renders();
+
 	public:
 
 		/// @brief Constructor for the timeline (which configures the default frame properties)
@@ -260,6 +283,14 @@ namespace openshot {
 		/// Determine if clips are automatically mapped to the timeline's framerate and samplerate
 		bool AutoMapClips() { return auto_map_clips; };
 
+		/// @brief Enable or disable audio-only mode (of the timeline and all clips)
+		///
+		/// In audio-only mode, frames only contain the mixed audio of all clips (with volume, channel keyframes
+		/// and audio effects applied). No video is decoded, no images are created, and clips without audio are
+		/// skipped, which makes audio export, loudness analysis and waveforms much faster.
+		void AudioOnly(bool enabled) override;
+		using ReaderBase::AudioOnly;
+
 		/// @brief Automatically map all clips to the timeline's framerate and samplerate
 		void AutoMapClips(bool auto_map) { auto_map_clips = auto_map; };
 
@@ -310,6 +341,10 @@ namespace openshot {
 
 		/// Get an openshot::Frame object for a specific frame number of this timeline.
 		///
+		/// This method is re-entrant: different frame numbers can be composited by many threads
+		/// at the same time, while concurrent requests for the same frame number wait for a
+		/// single render of that frame.
+		///
 		/// @returns The requested frame (containing the image)
 		/// @param requested_frame The frame number that is requested.
 		std::shared_ptr<openshot::Frame> GetFrame(int64_t requested_frame) override;
@@ -16,6 +16,7 @@
 #include "TrackedObjectBBox.h"
 
 #include "Clip.h"
+#include "DataFileCache.h"
 
 #include "trackerdata.pb.h"
 #include <google/protobuf/util/time_util.h>
@@ -234,29 +235,60 @@ void TrackedObjectBBox::ScalePoints(double time_scale){
 // Load the bounding-boxes information from the protobuf file
 bool TrackedObjectBBox::LoadBoxData(std::string inputFilePath)
 {
-	using std::ios;
-
 	// Variable to hold the loaded data
-	pb_tracker::Tracker bboxMessage;
-
-	// Read the existing tracker message.
-	std::fstream input(inputFilePath, ios::in | ios::binary);
+	std::shared_ptr<const pb_tracker::Tracker> bboxMessage = LoadTrackerMessage(inputFilePath);
 
 	// Check if it was able to read the protobuf data
-	if (!bboxMessage.ParseFromIstream(&input))
+	if (!bboxMessage)
 	{
 		std::cerr << "Failed to parse protobuf message." << std::endl;
 		return false;
 	}
 
-	this->clear();
+	// Load the first object of the message
+	LoadBoxData(*bboxMessage, 0);
+
+	// Show the time stamp from the last update in tracker data file
+	if (bboxMessage->has_last_updated())
+	{
+		std::cout << " Loaded Data. Saved Time Stamp: "
+				  << TimeUtil::ToString(bboxMessage->last_updated()) << std::endl;
+	}
+
+	return true;
+}
+
+// Load a tracker protobuf file (or get the cached message of the file)
+std::shared_ptr<const pb_tracker::Tracker> TrackedObjectBBox::LoadTrackerMessage(const std::string& inputFilePath)
+{
+	return DataFileCache<pb_tracker::Tracker>::Load(inputFilePath,
+		[](const std::string& path, pb_tracker::Tracker& bboxMessage) {
+			// Read the existing tracker message.
+			std::fstream input(path, std::ios::in | std::ios::binary);
+			return bboxMessage.ParseFromIstream(&input);
+		});
+}
 
-	// Iterate over all frames of the saved message
-	for (size_t i = 0; i < bboxMessage.frame_size(); i++)
+// Load the bounding-boxes information of an object from a protobuf message
+bool TrackedObjectBBox::LoadBoxData(const pb_tracker::Tracker& bboxMessage, int objectIndex)
+{
+	// The first object is saved in the frames of the message, and the other objects in its objects
+	const google::protobuf::RepeatedPtrField<pb_tracker::Frame>* frames = nullptr;
+	if (objectIndex == 0)
+		frames = &bboxMessage.frame();
+	for (const pb_tracker::Object &pbObject : bboxMessage.object())
 	{
-		// Get data of the i-th frame
-		const pb_tracker::Frame &pbFrameData = bboxMessage.frame(i);
+		if (objectIndex != 0 && pbObject.id() == objectIndex)
+			frames = &pbObject.frame();
+	}
+	if (!frames)
+		return false;
 
+	this->clear();
+
+	// Iterate over all frames of the object
+	for (const pb_tracker::Frame &pbFrameData : *frames)
+	{
 		// Get frame number
 		size_t frame_number = pbFrameData.id();
 
@@ -272,21 +304,14 @@ bool TrackedObjectBBox::LoadBoxData(std::string inputFilePath)
 
 		if ( (cx >= 0.0) && (cy >= 0.0) && (width >= 0.0) && (height >= 0.0) )
 		{
-			// The bounding-box properties are valid, so add it to the BoxVec map
-			this->AddBox(frame_number, cx, cy, width, height, angle);
+			// The bounding-box properties are valid, so add it to the BoxVec map (frames are saved in
+			// order, so each box is inserted at the end of the map)
+			BBox newBBox(cx, cy, width, height, angle);
+			auto BBoxIterator = BoxVec.emplace_hint(BoxVec.end(), this->FrameNToTime(frame_number, 1.0), newBBox);
+			BBoxIterator->second = newBBox;
 		}
 	}
 
-	// Show the time stamp from the last update in tracker data file
-	if (bboxMessage.has_last_updated())
-	{
-		std::cout << " Loaded Data. Saved Time Stamp: "
-				  << TimeUtil::ToString(bboxMessage.last_updated()) << std::endl;
-	}
-
-	// Delete all global objects allocated by libprotobuf.
-	google::protobuf::ShutdownProtobufLibrary();
-
 	return true;
 }
 
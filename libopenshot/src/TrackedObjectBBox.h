@@ -14,6 +14,8 @@
 #ifndef OPENSHOT_TRACKEDOBJECTBBOX_H
 #define OPENSHOT_TRACKEDOBJECTBBOX_H
 
+#include <memory>
+
 #include "TrackedObjectBase.h"
 
 #include "Color.h"
@@ -22,6 +24,11 @@
 #include "Json.h"
 #include "KeyFrame.h"
 
+// Forward decl
+namespace pb_tracker {
+	class Tracker;
+}
+
 namespace openshot
 {
 	/**
@@ -187,6 +194,16 @@ namespace openshot
 		/// Load the bounding-boxes information from the protobuf file
 		bool LoadBoxData(std::string inputFilePath);
 
+		/// @brief Load a tracker protobuf file (which is parsed once, and shared by every object which loads the same file)
+		/// @returns The tracker message, or nullptr if the file can't be parsed
+		static std::shared_ptr<const pb_tracker::Tracker> LoadTrackerMessage(const std::string& inputFilePath);
+
+		/// @brief Load the bounding-boxes information of an object from a protobuf message
+		/// @param bboxMessage The tracker message
+		/// @param objectIndex The index of the object (0 is the first object, which is saved in the frames of the message)
+		/// @returns False if the message has no object with that index
+		bool LoadBoxData(const pb_tracker::Tracker& bboxMessage, int objectIndex);
+
 		/// Get the time of the given frame
 		double FrameNToTime(int64_t frame_number, double time_scale) const;
 
@@ -22,8 +22,7 @@ Compressor::Compressor(Keyframe threshold, Keyframe ratio, Keyframe attack,
 					   Keyframe release, Keyframe makeup_gain,
 					   Keyframe bypass):
 	threshold(threshold), ratio(ratio), attack(attack),
-	release(release), makeup_gain(makeup_gain), bypass(bypass),
-	input_level(0.0), yl_prev(0.0)
+	release(release), makeup_gain(makeup_gain), bypass(bypass)
 {
 	// Init effect properties
 	init_effect_details();
@@ -47,65 +46,65 @@ void Compressor::init_effect_details()
 // modified openshot::Frame object
 std::shared_ptr<openshot::Frame> Compressor::GetFrame(std::shared_ptr<openshot::Frame> frame, int64_t frame_number)
 {
-	// Adding Compressor
-	const int num_input_channels = frame->audio->getNumChannels();
-	const int num_output_channels = frame->audio->getNumChannels();
-	const int num_samples = frame->audio->getNumSamples();
+	const float sample_rate = frame->SampleRate();
 
-	mixed_down_input.setSize(1, num_samples);
-	inverse_sample_rate = 1.0f / frame->SampleRate();
-	inverseE = 1.0f / M_E;
+	states.Process(frame_number, *frame->audio, [&](State& state, juce::AudioBuffer<float>& audio, int64_t number) {
+		if ((bool)bypass.GetValue(number))
+			return;
 
-	if ((bool)bypass.GetValue(frame_number))
-		return frame;
+		// Adding Compressor
+		const int num_input_channels = audio.getNumChannels();
+		const int num_samples = audio.getNumSamples();
 
-	mixed_down_input.clear();
+		juce::AudioBuffer<float> mixed_down_input(1, num_samples);
+		mixed_down_input.clear();
 
-	for (int channel = 0; channel < num_input_channels; ++channel)
-		mixed_down_input.addFrom(0, 0, *frame->audio, channel, 0, num_samples, 1.0f / num_input_channels);
+		for (int channel = 0; channel < num_input_channels; ++channel)
+			mixed_down_input.addFrom(0, 0, audio, channel, 0, num_samples, 1.0f / num_input_channels);
 
-	for (int sample = 0; sample < num_samples; ++sample) {
-		float T = threshold.GetValue(frame_number);
-		float R = ratio.GetValue(frame_number);
-		float alphaA = calculateAttackOrRelease(attack.GetValue(frame_number));
-		float alphaR = calculateAttackOrRelease(release.GetValue(frame_number));
-		float gain = makeup_gain.GetValue(frame_number);
-		float input_squared = powf(mixed_down_input.getSample(0, sample), 2.0f);
+		// Keyframes are only evaluated once per frame
+		const float T = threshold.GetValue(number);
+		const float R = ratio.GetValue(number);
+		const float alphaA = calculateAttackOrRelease(attack.GetValue(number), sample_rate);
+		const float alphaR = calculateAttackOrRelease(release.GetValue(number), sample_rate);
+		const float gain = makeup_gain.GetValue(number);
 
-		input_level = input_squared;
+		for (int sample = 0; sample < num_samples; ++sample) {
+			const float input_level = powf(mixed_down_input.getSample(0, sample), 2.0f);
 
-		xg = (input_level <= 1e-6f) ? -60.0f : 10.0f * log10f(input_level);
+			const float xg = (input_level <= 1e-6f) ? -60.0f : 10.0f * log10f(input_level);
 
-		if (xg < T)
-			yg = xg;
-		else
-			yg = T + (xg - T) / R;
+			float yg;
+			if (xg < T)
+				yg = xg;
+			else
+				yg = T + (xg - T) / R;
 
-		xl = xg - yg;
+			const float xl = xg - yg;
 
-		if (xl > yl_prev)
-			yl = alphaA * yl_prev + (1.0f - alphaA) * xl;
-		else
-			yl = alphaR * yl_prev + (1.0f - alphaR) * xl;
+			float yl;
+			if (xl > state.yl_prev)
+				yl = alphaA * state.yl_prev + (1.0f - alphaA) * xl;
+			else
+				yl = alphaR * state.yl_prev + (1.0f - alphaR) * xl;
 
-		control = powf (10.0f, (gain - yl) * 0.05f);
-		yl_prev = yl;
+			const float control = powf (10.0f, (gain - yl) * 0.05f);
+			state.yl_prev = yl;
 
-		for (int channel = 0; channel < num_input_channels; ++channel) {
-			float new_value = frame->audio->getSample(channel, sample)*control;
-			frame->audio->setSample(channel, sample, new_value);
+			for (int channel = 0; channel < num_input_channels; ++channel)
+				audio.getWritePointer(channel)[sample] *= control;
 		}
-	}
-
-	for (int channel = num_input_channels; channel < num_output_channels; ++channel)
-		frame->audio->clear(channel, 0, num_samples);
+	});
 
 	// return the modified frame
 	return frame;
 }
 
-float Compressor::calculateAttackOrRelease(float value)
+float Compressor::calculateAttackOrRelease(float value, float sample_rate) const
 {
+	const float inverse_sample_rate = 1.0f / sample_rate;
+	const float inverseE = 1.0f / M_E;
+
 	if (value == 0.0f)
 		return 0.0f;
 	else
@@ -159,6 +158,9 @@ void Compressor::SetJsonValue(const Json::Value root) {
 	// Set parent data
 	EffectBase::SetJsonValue(root);
 
+	// States of the previous properties are no longer valid
+	states.Clear();
+
 	// Set data from Json (if key is found)
 	if (!root["threshold"].isNull())
 		threshold.SetJsonValue(root["threshold"]);
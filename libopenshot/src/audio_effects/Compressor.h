@@ -13,6 +13,7 @@
 #ifndef OPENSHOT_COMPRESSOR_AUDIO_EFFECT_H
 #define OPENSHOT_COMPRESSOR_AUDIO_EFFECT_H
 
+#include "AudioStateCache.h"
 #include "EffectBase.h"
 
 #include "Json.h"
@@ -31,10 +32,18 @@ namespace openshot
 	/**
 	 * @brief This class adds a compressor into the audio
 	 *
+	 * The gain reduction continues from the previous frame (see openshot::AudioStateCache), so frames can be
+	 * requested in any order.
 	 */
 	class Compressor : public EffectBase
 	{
 	private:
+		/// The level of the gain reduction (after a frame)
+		struct State {
+			float yl_prev = 0.0f;
+		};
+		AudioStateCache<State> states;
+
 		/// Init effect settings
 		void init_effect_details();
 
@@ -47,19 +56,6 @@ namespace openshot
 		Keyframe makeup_gain;
 		Keyframe bypass;
 
-		juce::AudioBuffer<float> mixed_down_input;
-		float xl;
-		float yl;
-		float xg;
-		float yg;
-		float control;
-
-		float input_level;
-		float yl_prev;
-
-		float inverse_sample_rate;
-		float inverseE;
-
 		/// Default constructor
 		Compressor();
 
@@ -67,7 +63,7 @@ namespace openshot
 		Compressor(Keyframe threshold, Keyframe ratio, Keyframe attack,
 		           Keyframe release, Keyframe makeup_gain, Keyframe bypass);
 
-		float calculateAttackOrRelease(float value);
+		float calculateAttackOrRelease(float value, float sample_rate) const;
 
 		std::shared_ptr<openshot::Frame> GetFrame(int64_t frame_number) override {
 			return GetFrame(std::make_shared<openshot::Frame>(), frame_number);
@@ -14,6 +14,9 @@
 #include "Exceptions.h"
 #include "Frame.h"
 
+#include <algorithm>
+#include <cmath>
+
 using namespace openshot;
 
 Delay::Delay() : Delay::Delay(1) { }
@@ -35,67 +38,59 @@ void Delay::init_effect_details()
 	info.description = "Adjust the synchronism between the audio and video track.";
 	info.has_audio = true;
 	info.has_video = false;
-	initialized = false;
-}
-
-void Delay::setup(std::shared_ptr<openshot::Frame> frame)
-{
-	if (!initialized)
-	{
-		const float max_delay_time = 5;
-		delay_buffer_samples = (int)(max_delay_time * (float)frame->SampleRate()) + 1;
-
-		if (delay_buffer_samples < 1)
-			delay_buffer_samples = 1;
-
-		delay_buffer_channels = frame->audio->getNumChannels();
-		delay_buffer.setSize(delay_buffer_channels, delay_buffer_samples);
-		delay_buffer.clear();
-		delay_write_position = 0;
-		initialized = true;
-	}
 }
 
 // This method is required for all derived classes of EffectBase, and returns a
 // modified openshot::Frame object
 std::shared_ptr<openshot::Frame> Delay::GetFrame(std::shared_ptr<openshot::Frame> frame, int64_t frame_number)
 {
-	const float delay_time_value = (float)delay_time.GetValue(frame_number)*(float)frame->SampleRate();
-	int local_write_position;
-
-	setup(frame);
+	const int sample_rate = frame->SampleRate();
 
-	for (int channel = 0; channel < frame->audio->getNumChannels(); channel++)
-	{
-		float *channel_data = frame->audio->getWritePointer(channel);
-		float *delay_data = delay_buffer.getWritePointer(channel);
-		local_write_position = delay_write_position;
+	states.Process(frame_number, *frame->audio, [&](State& state, juce::AudioBuffer<float>& audio, int64_t number) {
+		const float delay_time_value = (float)delay_time.GetValue(number)*(float)sample_rate;
 
-		for (auto sample = 0; sample < frame->audio->getNumSamples(); ++sample)
+		// Create an empty delay buffer (for the first frame, or if the number of channels changed)
+		const float max_delay_time = 5;
+		const int delay_buffer_samples = std::max((int)(max_delay_time * (float)sample_rate) + 1, 1);
+		if (state.delay_buffer.Channels() != audio.getNumChannels() || state.delay_buffer.Samples() != delay_buffer_samples)
 		{
-			const float in = (float)(channel_data[sample]);
-			float out = 0.0f;
+			state.delay_buffer.SetSize(audio.getNumChannels(), delay_buffer_samples);
+			state.delay_write_position = 0;
+		}
+		int local_write_position = state.delay_write_position;
 
-			float read_position = fmodf((float)local_write_position - delay_time_value + (float)delay_buffer_samples, delay_buffer_samples);
-			int local_read_position = floorf(read_position);
+		for (int channel = 0; channel < audio.getNumChannels(); channel++)
+		{
+			float *channel_data = audio.getWritePointer(channel);
+			AudioStateBuffer::Channel delay_data = state.delay_buffer.GetChannel(channel, state.delay_write_position, audio.getNumSamples());
+			local_write_position = state.delay_write_position;
 
-			if (local_read_position != local_write_position)
+			for (auto sample = 0; sample < audio.getNumSamples(); ++sample)
 			{
-				float fraction = read_position - (float)local_read_position;
-				float delayed1 = delay_data[(local_read_position + 0)];
-				float delayed2 = delay_data[(local_read_position + 1) % delay_buffer_samples];
-				out = (float)(delayed1 + fraction * (delayed2 - delayed1));
+				const float in = (float)(channel_data[sample]);
+				float out = 0.0f;
 
-				channel_data[sample] = in + (out - in);
-				delay_data[local_write_position] = in;
-			}
+				float read_position = fmodf((float)local_write_position - delay_time_value + (float)delay_buffer_samples, delay_buffer_samples);
+				int local_read_position = floorf(read_position);
 
-			if (++local_write_position >= delay_buffer_samples)
-				local_write_position -= delay_buffer_samples;
+				if (local_read_position != local_write_position)
+				{
+					float fraction = read_position - (float)local_read_position;
+					float delayed1 = delay_data[(local_read_position + 0)];
+					float delayed2 = delay_data[(local_read_position + 1) % delay_buffer_samples];
+					out = (float)(delayed1 + fraction * (delayed2 - delayed1));
+
+					channel_data[sample] = in + (out - in);
+					delay_data[local_write_position] = in;
+				}
+
+				if (++local_write_position >= delay_buffer_samples)
+					local_write_position -= delay_buffer_samples;
+			}
 		}
-	}
 
-	delay_write_position = local_write_position;
+		state.delay_write_position = local_write_position;
+	});
 
 	// return the modified frame
 	return frame;
@@ -143,6 +138,9 @@ void Delay::SetJsonValue(const Json::Value root) {
 	// Set parent data
 	EffectBase::SetJsonValue(root);
 
+	// States of the previous properties are no longer valid
+	states.Clear();
+
 	// Set data from Json (if key is found)
 	if (!root["delay_time"].isNull())
 		delay_time.SetJsonValue(root["delay_time"]);
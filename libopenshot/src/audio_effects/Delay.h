@@ -13,6 +13,7 @@
 #ifndef OPENSHOT_DELAY_AUDIO_EFFECT_H
 #define OPENSHOT_DELAY_AUDIO_EFFECT_H
 
+#include "AudioStateCache.h"
 #include "EffectBase.h"
 
 #include "Json.h"
@@ -31,22 +32,25 @@ namespace openshot
 	/**
 	 * @brief This class adds a delay into the audio
 	 *
+	 * The delay buffer continues from the previous frame (see openshot::AudioStateCache), so frames can be
+	 * requested in any order.
 	 */
 	class Delay : public EffectBase
 	{
 	private:
+		/// The delay buffer (after a frame, which shares its unchanged blocks with the snapshots of earlier frames)
+		struct State {
+			AudioStateBuffer delay_buffer;
+			int delay_write_position = 0;
+		};
+		AudioStateCache<State> states;
+
 		/// Init effect settings
 		void init_effect_details();
 
 	public:
 		Keyframe delay_time;
 
-		juce::AudioBuffer<float> delay_buffer;
-		int delay_buffer_samples;
-		int delay_buffer_channels;
-		int delay_write_position;
-		bool initialized;
-
 		/// Default constructor
 		Delay();
 
@@ -57,8 +61,6 @@ namespace openshot
 			return GetFrame(std::make_shared<openshot::Frame>(), frame_number);
 		}
 
-		void setup(std::shared_ptr<openshot::Frame> frame);
-
 		std::shared_ptr<openshot::Frame>
 		GetFrame(std::shared_ptr<openshot::Frame> frame, int64_t frame_number) override;
 
@@ -14,6 +14,9 @@
 #include "Exceptions.h"
 #include "Frame.h"
 
+#include <algorithm>
+#include <cmath>
+
 using namespace openshot;
 
 Echo::Echo() : Echo::Echo(0.1, 0.5, 0.5) { }
@@ -37,68 +40,60 @@ void Echo::init_effect_details()
 	info.description = "Reflection of sound with a delay after the direct sound.";
 	info.has_audio = true;
 	info.has_video = false;
-	initialized = false;
-}
-
-void Echo::setup(std::shared_ptr<openshot::Frame> frame)
-{
-	if (!initialized)
-	{
-		const float max_echo_time = 5;
-		echo_buffer_samples = (int)(max_echo_time * (float)frame->SampleRate()) + 1;
-
-		if (echo_buffer_samples < 1)
-			echo_buffer_samples = 1;
-
-		echo_buffer_channels = frame->audio->getNumChannels();
-		echo_buffer.setSize(echo_buffer_channels, echo_buffer_samples);
-		echo_buffer.clear();
-		echo_write_position = 0;
-		initialized = true;
-	}
 }
 
 // This method is required for all derived classes of EffectBase, and returns a
 // modified openshot::Frame object
 std::shared_ptr<openshot::Frame> Echo::GetFrame(std::shared_ptr<openshot::Frame> frame, int64_t frame_number)
 {
-	const float echo_time_value = (float)echo_time.GetValue(frame_number)*(float)frame->SampleRate();
-	const float feedback_value = feedback.GetValue(frame_number);
-	const float mix_value = mix.GetValue(frame_number);
-	int local_write_position;
+	const int sample_rate = frame->SampleRate();
 
-	setup(frame);
+	states.Process(frame_number, *frame->audio, [&](State& state, juce::AudioBuffer<float>& audio, int64_t number) {
+		const float echo_time_value = (float)echo_time.GetValue(number)*(float)sample_rate;
+		const float feedback_value = feedback.GetValue(number);
+		const float mix_value = mix.GetValue(number);
 
-	for (int channel = 0; channel < frame->audio->getNumChannels(); channel++)
-	{
-		float *channel_data = frame->audio->getWritePointer(channel);
-		float *echo_data = echo_buffer.getWritePointer(channel);
-		local_write_position = echo_write_position;
-
-		for (auto sample = 0; sample < frame->audio->getNumSamples(); ++sample)
+		// Create an empty echo buffer (for the first frame, or if the number of channels changed)
+		const float max_echo_time = 5;
+		const int echo_buffer_samples = std::max((int)(max_echo_time * (float)sample_rate) + 1, 1);
+		if (state.echo_buffer.Channels() != audio.getNumChannels() || state.echo_buffer.Samples() != echo_buffer_samples)
 		{
-			const float in = (float)(channel_data[sample]);
-			float out = 0.0f;
+			state.echo_buffer.SetSize(audio.getNumChannels(), echo_buffer_samples);
+			state.echo_write_position = 0;
+		}
+		int local_write_position = state.echo_write_position;
 
-			float read_position = fmodf((float)local_write_position - echo_time_value + (float)echo_buffer_samples, echo_buffer_samples);
-			int local_read_position = floorf(read_position);
+		for (int channel = 0; channel < audio.getNumChannels(); channel++)
+		{
+			float *channel_data = audio.getWritePointer(channel);
+			AudioStateBuffer::Channel echo_data = state.echo_buffer.GetChannel(channel, state.echo_write_position, audio.getNumSamples());
+			local_write_position = state.echo_write_position;
 
-			if (local_read_position != local_write_position)
+			for (auto sample = 0; sample < audio.getNumSamples(); ++sample)
 			{
-				float fraction = read_position - (float)local_read_position;
-				float echoed1 = echo_data[(local_read_position + 0)];
-				float echoed2 = echo_data[(local_read_position + 1) % echo_buffer_samples];
-				out = (float)(echoed1 + fraction * (echoed2 - echoed1));
-				channel_data[sample] = in + mix_value*(out - in);
-				echo_data[local_write_position] = in + out*feedback_value;
+				const float in = (float)(channel_data[sample]);
+				float out = 0.0f;
+
+				float read_position = fmodf((float)local_write_position - echo_time_value + (float)echo_buffer_samples, echo_buffer_samples);
+				int local_read_position = floorf(read_position);
+
+				if (local_read_position != local_write_position)
+				{
+					float fraction = read_position - (float)local_read_position;
+					float echoed1 = echo_data[(local_read_position + 0)];
+					float echoed2 = echo_data[(local_read_position + 1) % echo_buffer_samples];
+					out = (float)(echoed1 + fraction * (echoed2 - echoed1));
+					channel_data[sample] = in + mix_value*(out - in);
+					echo_data[local_write_position] = in + out*feedback_value;
+				}
+
+				if (++local_write_position >= echo_buffer_samples)
+					local_write_position -= echo_buffer_samples;
 			}
-
-			if (++local_write_position >= echo_buffer_samples)
-				local_write_position -= echo_buffer_samples;
 		}
-	}
 
-	echo_write_position = local_write_position;
+		state.echo_write_position = local_write_position;
+	});
 
 	// return the modified frame
 	return frame;
@@ -148,6 +143,9 @@ void Echo::SetJsonValue(const Json::Value root) {
 	// Set parent data
 	EffectBase::SetJsonValue(root);
 
+	// States of the previous properties are no longer valid
+	states.Clear();
+
 	// Set data from Json (if key is found)
 	if (!root["echo_time"].isNull())
 		echo_time.SetJsonValue(root["echo_time"]);
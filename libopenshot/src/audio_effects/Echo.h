@@ -13,6 +13,7 @@
 #ifndef OPENSHOT_ECHO_AUDIO_EFFECT_H
 #define OPENSHOT_ECHO_AUDIO_EFFECT_H
 
+#include "AudioStateCache.h"
 #include "EffectBase.h"
 
 #include "Json.h"
@@ -31,10 +32,19 @@ namespace openshot
 	/**
 	 * @brief This class adds a echo into the audio
 	 *
+	 * The echo buffer continues from the previous frame (see openshot::AudioStateCache), so frames can be
+	 * requested in any order.
 	 */
 	class Echo : public EffectBase
 	{
 	private:
+		/// The echo buffer (after a frame, which shares its unchanged blocks with the snapshots of earlier frames)
+		struct State {
+			AudioStateBuffer echo_buffer;
+			int echo_write_position = 0;
+		};
+		AudioStateCache<State> states;
+
 		/// Init effect settings
 		void init_effect_details();
 
@@ -43,12 +53,6 @@ namespace openshot
 		Keyframe feedback;
 		Keyframe mix;
 
-		juce::AudioBuffer<float> echo_buffer;
-		int echo_buffer_samples;
-		int echo_buffer_channels;
-		int echo_write_position;
-		bool initialized;
-
 		/// Default constructor
 		Echo();
 
@@ -59,8 +63,6 @@ namespace openshot
 			return GetFrame(std::make_shared<openshot::Frame>(), frame_number);
 		}
 
-		void setup(std::shared_ptr<openshot::Frame> frame);
-
 		std::shared_ptr<openshot::Frame>
 		GetFrame(std::shared_ptr<openshot::Frame> frame, int64_t frame_number) override;
 
@@ -40,78 +40,74 @@ void Expander::init_effect_details()
 	info.description = "Louder parts of audio becomes relatively louder and quieter parts becomes quieter.";
 	info.has_audio = true;
 	info.has_video = false;
-
-	input_level = 0.0f;
-	yl_prev = 0.0f;
-
-
 }
 
 // This method is required for all derived classes of EffectBase, and returns a
 // modified openshot::Frame object
 std::shared_ptr<openshot::Frame> Expander::GetFrame(std::shared_ptr<openshot::Frame> frame, int64_t frame_number)
 {
-	// Adding Expander
-	const int num_input_channels = frame->audio->getNumChannels();
-	const int num_output_channels = frame->audio->getNumChannels();
-	const int num_samples = frame->audio->getNumSamples();
+	const float sample_rate = frame->SampleRate();
 
-	mixed_down_input.setSize(1, num_samples);
-	inverse_sample_rate = 1.0f / frame->SampleRate();
-	inverseE = 1.0f / M_E;
+	states.Process(frame_number, *frame->audio, [&](State& state, juce::AudioBuffer<float>& audio, int64_t number) {
+		if ((bool)bypass.GetValue(number))
+			return;
 
-	if ((bool)bypass.GetValue(frame_number))
-		return frame;
+		// Adding Expander
+		const int num_input_channels = audio.getNumChannels();
+		const int num_samples = audio.getNumSamples();
 
-	mixed_down_input.clear();
+		juce::AudioBuffer<float> mixed_down_input(1, num_samples);
+		mixed_down_input.clear();
 
-	for (int channel = 0; channel < num_input_channels; ++channel)
-		mixed_down_input.addFrom(0, 0, *frame->audio, channel, 0, num_samples, 1.0f / num_input_channels);
+		for (int channel = 0; channel < num_input_channels; ++channel)
+			mixed_down_input.addFrom(0, 0, audio, channel, 0, num_samples, 1.0f / num_input_channels);
 
-	for (int sample = 0; sample < num_samples; ++sample) {
-		float T = threshold.GetValue(frame_number);
-		float R = ratio.GetValue(frame_number);
-		float alphaA = calculateAttackOrRelease(attack.GetValue(frame_number));
-		float alphaR = calculateAttackOrRelease(release.GetValue(frame_number));
-		float gain = makeup_gain.GetValue(frame_number);
-		float input_squared = powf(mixed_down_input.getSample(0, sample), 2.0f);
+		// Keyframes are only evaluated once per frame
+		const float T = threshold.GetValue(number);
+		const float R = ratio.GetValue(number);
+		const float alphaA = calculateAttackOrRelease(attack.GetValue(number), sample_rate);
+		const float alphaR = calculateAttackOrRelease(release.GetValue(number), sample_rate);
+		const float gain = makeup_gain.GetValue(number);
 
-		const float average_factor = 0.9999f;
-		input_level = average_factor * input_level + (1.0f - average_factor) * input_squared;
+		for (int sample = 0; sample < num_samples; ++sample) {
+			const float input_squared = powf(mixed_down_input.getSample(0, sample), 2.0f);
 
-		xg = (input_level <= 1e-6f) ? -60.0f : 10.0f * log10f(input_level);
+			const float average_factor = 0.9999f;
+			state.input_level = average_factor * state.input_level + (1.0f - average_factor) * input_squared;
 
-		if (xg > T)
-			yg = xg;
-		else
-			yg = T + (xg - T) * R;
+			const float xg = (state.input_level <= 1e-6f) ? -60.0f : 10.0f * log10f(state.input_level);
 
-		xl = xg - yg;
+			float yg;
+			if (xg > T)
+				yg = xg;
+			else
+				yg = T + (xg - T) * R;
 
-		if (xl < yl_prev)
-			yl = alphaA * yl_prev + (1.0f - alphaA) * xl;
-		else
-			yl = alphaR * yl_prev + (1.0f - alphaR) * xl;
+			const float xl = xg - yg;
 
+			float yl;
+			if (xl < state.yl_prev)
+				yl = alphaA * state.yl_prev + (1.0f - alphaA) * xl;
+			else
+				yl = alphaR * state.yl_prev + (1.0f - alphaR) * xl;
 
-		control = powf (10.0f, (gain - yl) * 0.05f);
-		yl_prev = yl;
+			const float control = powf (10.0f, (gain - yl) * 0.05f);
+			state.yl_prev = yl;
 
-		for (int channel = 0; channel < num_input_channels; ++channel) {
-			float new_value = frame->audio->getSample(channel, sample)*control;
-			frame->audio->setSample(channel, sample, new_value);
+			for (int channel = 0; channel < num_input_channels; ++channel)
+				audio.getWritePointer(channel)[sample] *= control;
 		}
-	}
-
-	for (int channel = num_input_channels; channel < num_output_channels; ++channel)
-		frame->audio->clear(channel, 0, num_samples);
+	});
 
 	// return the modified frame
 	return frame;
 }
 
-float Expander::calculateAttackOrRelease(float value)
+float Expander::calculateAttackOrRelease(float value, float sample_rate) const
 {
+	const float inverse_sample_rate = 1.0f / sample_rate;
+	const float inverseE = 1.0f / M_E;
+
 	if (value == 0.0f)
 		return 0.0f;
 	else
@@ -165,6 +161,9 @@ void Expander::SetJsonValue(const Json::Value root) {
 	// Set parent data
 	EffectBase::SetJsonValue(root);
 
+	// States of the previous properties are no longer valid
+	states.Clear();
+
 	// Set data from Json (if key is found)
 	if (!root["threshold"].isNull())
 		threshold.SetJsonValue(root["threshold"]);
@@ -13,6 +13,7 @@
 #ifndef OPENSHOT_EXPANDER_AUDIO_EFFECT_H
 #define OPENSHOT_EXPANDER_AUDIO_EFFECT_H
 
+#include "AudioStateCache.h"
 #include "EffectBase.h"
 
 #include "Json.h"
@@ -32,10 +33,19 @@ namespace openshot
 	/**
 	 * @brief This class adds a expander (or noise gate) into the audio
 	 *
+	 * The input level and gain reduction continue from the previous frame (see openshot::AudioStateCache),
+	 * so frames can be requested in any order.
 	 */
 	class Expander : public EffectBase
 	{
 	private:
+		/// The average input level, and the level of the gain reduction (after a frame)
+		struct State {
+			float input_level = 0.0f;
+			float yl_prev = 0.0f;
+		};
+		AudioStateCache<State> states;
+
 		/// Init effect settings
 		void init_effect_details();
 
@@ -48,19 +58,6 @@ namespace openshot
 		Keyframe makeup_gain;
 		Keyframe bypass;
 
-		juce::AudioBuffer<float> mixed_down_input;
-		float xl;
-		float yl;
-		float xg;
-		float yg;
-		float control;
-
-		float input_level;
-		float yl_prev;
-
-		float inverse_sample_rate;
-		float inverseE;
-
 		/// Default constructor
 		Expander();
 
@@ -68,7 +65,7 @@ namespace openshot
 		Expander(Keyframe threshold, Keyframe ratio, Keyframe attack,
 		         Keyframe release, Keyframe makeup_gain, Keyframe bypass);
 
-		float calculateAttackOrRelease(float value);
+		float calculateAttackOrRelease(float value, float sample_rate) const;
 
 		std::shared_ptr<openshot::Frame> GetFrame(int64_t frame_number) override {
 			return GetFrame(std::make_shared<openshot::Frame>(), frame_number);
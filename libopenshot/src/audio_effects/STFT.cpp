@@ -4,8 +4,25 @@
 
 #include "STFT.h"
 
+#include <algorithm>
+#include <map>
+#include <mutex>
+
 using namespace openshot;
 
+// FFT plans (by order), which are shared by every STFT
+static std::mutex fft_plans_mutex;
+static std::map<int, std::shared_ptr<const juce::dsp::FFT>> fft_plans;
+
+std::shared_ptr<const juce::dsp::FFT> STFT::GetFFT(const int order)
+{
+    const std::lock_guard<std::mutex> lock(fft_plans_mutex);
+    std::shared_ptr<const juce::dsp::FFT>& plan = fft_plans[order];
+    if (!plan)
+        plan = std::make_shared<const juce::dsp::FFT>(order);
+    return plan;
+}
+
 void STFT::setup(const int num_input_channels)
 {
     num_channels = (num_input_channels > 0) ? num_input_channels : 1;
@@ -13,80 +30,108 @@ void STFT::setup(const int num_input_channels)
 
 void STFT::updateParameters(const int new_fft_size, const int new_overlap, const int new_window_type)
 {
+    // The window only changes with the parameters (or the number of channels, which clears it)
+    const bool changed = new_fft_size != fft_size || new_overlap != overlap || new_window_type != window_type ||
+                         num_channels != input_buffer.getNumChannels();
+
     updateFftSize(new_fft_size);
     updateHopSize(new_overlap);
-    updateWindow(new_window_type);
+    if (changed)
+        updateWindow(new_window_type);
 }
 
 void STFT::process(juce::AudioBuffer<float> &block)
 {
     num_samples = block.getNumSamples();
+    const int channels = std::min(num_channels, block.getNumChannels());
+    if (hop_size <= 0 || input_buffer_length <= 0)
+        return;
+
+    for (int sample = 0; sample < num_samples; ) {
+        // Copy samples up to the next hop (in pieces which don't wrap around the buffers)
+        const int count = std::min({num_samples - sample, hop_size - samples_since_last_FFT,
+                                    input_buffer_length - input_buffer_write_position,
+                                    output_buffer_length - output_buffer_read_position});
+
+        for (int channel = 0; channel < channels; ++channel) {
+            float *channel_data = block.getWritePointer(channel, sample);
+            float *output_data = output_buffer.getWritePointer(channel, output_buffer_read_position);
+
+            input_buffer.copyFrom(channel, input_buffer_write_position, channel_data, count);
+            juce::FloatVectorOperations::copy(channel_data, output_data, count);
+            juce::FloatVectorOperations::clear(output_data, count);
+        }
 
-    for (int channel = 0; channel < num_channels; ++channel) {
-        float *channel_data = block.getWritePointer(channel);
-
-        current_input_buffer_write_position = input_buffer_write_position;
-        current_output_buffer_write_position = output_buffer_write_position;
-        current_output_buffer_read_position = output_buffer_read_position;
-        current_samples_since_last_FFT = samples_since_last_FFT;
-
-        for (int sample = 0; sample < num_samples; ++sample) {
-            const float input_sample = channel_data[sample];
-
-            input_buffer.setSample(channel, current_input_buffer_write_position, input_sample);
-            if (++current_input_buffer_write_position >= input_buffer_length)
-                current_input_buffer_write_position = 0;
-            // diff
-            channel_data[sample] = output_buffer.getSample(channel, current_output_buffer_read_position);
+        sample += count;
+        input_buffer_write_position = (input_buffer_write_position + count) % input_buffer_length;
+        output_buffer_read_position = (output_buffer_read_position + count) % output_buffer_length;
+        samples_since_last_FFT += count;
 
-            output_buffer.setSample(channel, current_output_buffer_read_position, 0.0f);
-            if (++current_output_buffer_read_position >= output_buffer_length)
-                current_output_buffer_read_position = 0;
+        // Transform every channel at each hop
+        if (samples_since_last_FFT >= hop_size) {
+            samples_since_last_FFT = 0;
+            current_input_buffer_write_position = input_buffer_write_position;
+            current_output_buffer_write_position = output_buffer_write_position;
+            current_output_buffer_read_position = output_buffer_read_position;
+            current_samples_since_last_FFT = samples_since_last_FFT;
 
-            if (++current_samples_since_last_FFT >= hop_size) {
-                current_samples_since_last_FFT = 0;
+            for (int channel = 0; channel < channels; ++channel) {
                 analysis(channel);
                 modification(channel);
                 synthesis(channel);
             }
+
+            output_buffer_write_position += hop_size;
+            if (output_buffer_write_position >= output_buffer_length)
+                output_buffer_write_position = 0;
         }
     }
-
-    input_buffer_write_position = current_input_buffer_write_position;
-    output_buffer_write_position = current_output_buffer_write_position;
-    output_buffer_read_position = current_output_buffer_read_position;
-    samples_since_last_FFT = current_samples_since_last_FFT;
 }
 
 
 void STFT::updateFftSize(const int new_fft_size)
 {
-    if (new_fft_size != fft_size)
+    if (new_fft_size != fft_size || num_channels != input_buffer.getNumChannels())
     {
         fft_size = new_fft_size;
-        fft = std::make_unique<juce::dsp::FFT>(log2(fft_size));
+        fft = GetFFT((int) log2(fft_size));
 
         input_buffer_length = fft_size;
-        input_buffer.clear();
         input_buffer.setSize(num_channels, input_buffer_length);
+        input_buffer.clear();
 
         output_buffer_length = fft_size;
-        output_buffer.clear();
         output_buffer.setSize(num_channels, output_buffer_length);
+        output_buffer.clear();
 
         fft_window.realloc(fft_size);
         fft_window.clear(fft_size);
 
+        windowed_buffer.realloc(fft_size);
+        windowed_buffer.clear(fft_size);
+
         time_domain_buffer.realloc(fft_size);
         time_domain_buffer.clear(fft_size);
 
         frequency_domain_buffer.realloc(fft_size);
         frequency_domain_buffer.clear(fft_size);
 
+        magnitude_buffer.realloc(fft_size / 2 + 1);
+        magnitude_buffer.clear(fft_size / 2 + 1);
+
+        phase_buffer.realloc(fft_size / 2 + 1);
+        phase_buffer.clear(fft_size / 2 + 1);
+
         input_buffer_write_position = 0;
         output_buffer_write_position = 0;
         output_buffer_read_position = 0;
         samples_since_last_FFT = 0;
+
+        // The hop size depends on the FFT size
+        if (overlap != 0) {
+            hop_size = fft_size / overlap;
+            output_buffer_write_position = hop_size % output_buffer_length;
+        }
     }
 }
 
@@ -144,23 +189,51 @@ void STFT::updateWindow(const int new_window_type)
 
 void STFT::analysis(const int channel)
 {
-    int input_buffer_index = current_input_buffer_write_position;
-    for (int index = 0; index < fft_size; ++index) {
-        time_domain_buffer[index].real(fft_window[index] * input_buffer.getSample(channel, input_buffer_index));
-        time_domain_buffer[index].imag(0.0f);
-
-        if (++input_buffer_index >= input_buffer_length)
-            input_buffer_index = 0;
-    }
+    // Window the last fft_size samples (the oldest sample is at the write position)
+    const float *input_data = input_buffer.getReadPointer(channel);
+    const int first_part = input_buffer_length - current_input_buffer_write_position;
+    juce::FloatVectorOperations::multiply(windowed_buffer, fft_window, input_data + current_input_buffer_write_position, first_part);
+    juce::FloatVectorOperations::multiply(windowed_buffer + first_part, fft_window + first_part, input_data, fft_size - first_part);
+
+    for (int index = 0; index < fft_size; ++index)
+        time_domain_buffer[index] = juce::dsp::Complex<float>(windowed_buffer[index], 0.0f);
 }
 
 void STFT::modification(const int channel)
 {
     fft->perform(time_domain_buffer, frequency_domain_buffer, false);
 
+    toPolar();
+    fromPolar();
+
+    fft->perform(frequency_domain_buffer, time_domain_buffer, true);
+}
+
+void STFT::synthesis(const int channel)
+{
+    // Overlap-add the real part of the transformed samples
+    for (int index = 0; index < fft_size; ++index)
+        windowed_buffer[index] = time_domain_buffer[index].real();
+
+    float *output_data = output_buffer.getWritePointer(channel);
+    const int first_part = output_buffer_length - current_output_buffer_write_position;
+    juce::FloatVectorOperations::addWithMultiply(output_data + current_output_buffer_write_position, windowed_buffer, window_scale_factor, first_part);
+    juce::FloatVectorOperations::addWithMultiply(output_data, windowed_buffer + first_part, window_scale_factor, fft_size - first_part);
+}
+
+void STFT::toPolar()
+{
+    for (int index = 0; index < fft_size / 2 + 1; ++index) {
+        magnitude_buffer[index] = abs(frequency_domain_buffer[index]);
+        phase_buffer[index] = arg(frequency_domain_buffer[index]);
+    }
+}
+
+void STFT::fromPolar()
+{
     for (int index = 0; index < fft_size / 2 + 1; ++index) {
-        float magnitude = abs(frequency_domain_buffer[index]);
-        float phase = arg(frequency_domain_buffer[index]);
+        const float magnitude = magnitude_buffer[index];
+        const float phase = phase_buffer[index];
 
         frequency_domain_buffer[index].real(magnitude * cosf (phase));
         frequency_domain_buffer[index].imag(magnitude * sinf (phase));
@@ -170,23 +243,4 @@ void STFT::modification(const int channel)
             frequency_domain_buffer[fft_size - index].imag(magnitude * sinf (-phase));
         }
     }
-
-    fft->perform(frequency_domain_buffer, time_domain_buffer, true);
-}
-
-void STFT::synthesis(const int channel)
-{
-    int output_buffer_index = current_output_buffer_write_position;
-    for (int index = 0; index < fft_size; ++index) {
-        float output_sample = output_buffer.getSample(channel, output_buffer_index);
-        output_sample += time_domain_buffer[index].real() * window_scale_factor;
-        output_buffer.setSample(channel, output_buffer_index, output_sample);
-
-        if (++output_buffer_index >= output_buffer_length)
-            output_buffer_index = 0;
-    }
-
-    current_output_buffer_write_position += hop_size;
-    if (current_output_buffer_write_position >= output_buffer_length)
-        current_output_buffer_write_position = 0;
 }
@@ -11,6 +11,8 @@
 #include "EffectBase.h"
 #include "Enums.h"
 
+#include <memory>
+
 #include <AppConfig.h>
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <juce_dsp/juce_dsp.h>
@@ -18,10 +20,26 @@
 namespace openshot
 {
 
+    /**
+     * @brief Short-time Fourier transform (with overlap-add), used by spectral audio effects
+     *
+     * Audio is copied into a ring buffer in blocks (up to the next hop), and at each hop the last fft_size
+     * samples of every channel are windowed, transformed, modified (by the modification() method of the
+     * effect), transformed back and added to the output. Windowing and overlap-add use SIMD (with
+     * juce::FloatVectorOperations), and FFT plans are shared by every STFT with the same size.
+     *
+     * Effects which only change the magnitude or phase of each bin can call toPolar() and fromPolar() in
+     * modification(), and change magnitude_buffer and phase_buffer.
+     */
     class STFT
     {
     public:
-        STFT() : num_channels (1) { }
+        STFT() : num_channels (1), num_samples (0), fft_size (0), input_buffer_length (0), output_buffer_length (0),
+                 overlap (0), hop_size (0), window_type (-1), window_scale_factor (0.0f),
+                 input_buffer_write_position (0), output_buffer_write_position (0), output_buffer_read_position (0),
+                 samples_since_last_FFT (0), current_input_buffer_write_position (0),
+                 current_output_buffer_write_position (0), current_output_buffer_read_position (0),
+                 current_samples_since_last_FFT (0) { }
 
         virtual ~STFT() { }
 
@@ -37,6 +55,9 @@ namespace openshot
 
         virtual void updateWindow(const int new_window_type);
 
+        /// Get the shared FFT plan of a size (2 ^ order), which is thread-safe
+        static std::shared_ptr<const juce::dsp::FFT> GetFFT(const int order);
+
     private:
 
         virtual void modification(const int channel);
@@ -46,11 +67,18 @@ namespace openshot
         virtual void synthesis(const int channel);
 
     protected:
+        /// Convert the spectrum (of frequency_domain_buffer) to the magnitude and phase of each bin
+        /// (0 to fft_size / 2, since the spectrum of real audio is symmetric)
+        void toPolar();
+
+        /// Convert the magnitude and phase of each bin back to the spectrum (mirroring the bins above fft_size / 2)
+        void fromPolar();
+
         int num_channels;
         int num_samples;
 
         int fft_size;
-        std::unique_ptr<juce::dsp::FFT> fft;
+        std::shared_ptr<const juce::dsp::FFT> fft;
 
         int input_buffer_length;
         juce::AudioBuffer<float> input_buffer;
@@ -59,8 +87,11 @@ namespace openshot
         juce::AudioBuffer<float> output_buffer;
 
         juce::HeapBlock<float> fft_window;
+        juce::HeapBlock<float> windowed_buffer;
         juce::HeapBlock<juce::dsp::Complex<float>> time_domain_buffer;
         juce::HeapBlock<juce::dsp::Complex<float>> frequency_domain_buffer;
+        juce::HeapBlock<float> magnitude_buffer;
+        juce::HeapBlock<float> phase_buffer;
 
         int overlap;
         int hop_size;
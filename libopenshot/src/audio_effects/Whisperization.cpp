@@ -72,18 +72,11 @@ void Whisperization::WhisperizationEffect::modification(const int channel)
 {
 	fft->perform(time_domain_buffer, frequency_domain_buffer, false);
 
-	for (int index = 0; index < fft_size / 2 + 1; ++index) {
-		float magnitude = abs(frequency_domain_buffer[index]);
-		float phase = 2.0f * M_PI * (float)rand() / (float)RAND_MAX;
-
-		frequency_domain_buffer[index].real(magnitude * cosf(phase));
-		frequency_domain_buffer[index].imag(magnitude * sinf(phase));
-
-		if (index > 0 && index < fft_size / 2) {
-			frequency_domain_buffer[fft_size - index].real(magnitude * cosf (phase));
-			frequency_domain_buffer[fft_size - index].imag(magnitude * sinf (-phase));
-		}
-	}
+	// Randomize the phase of every bin
+	toPolar();
+	for (int index = 0; index < fft_size / 2 + 1; ++index)
+		phase_buffer[index] = 2.0f * M_PI * (float)rand() / (float)RAND_MAX;
+	fromPolar();
 
 	fft->perform(frequency_domain_buffer, time_domain_buffer, true);
 }
@@ -39,11 +39,6 @@ namespace openshot
 		/// Init effect settings
 		void init_effect_details();
 
-		// Internal blur methods (inspired and credited to http://blog.ivank.net/fastest-gaussian-blur.html)
-		void boxBlurH(unsigned char *scl, unsigned char *tcl, int w, int h, int r);
-		void boxBlurT(unsigned char *scl, unsigned char *tcl, int w, int h, int r);
-
-
 	public:
 		Keyframe horizontal_radius;	///< Horizontal blur radius keyframe. The size of the horizontal blur operation in pixels.
 		Keyframe vertical_radius;	///< Vertical blur radius keyframe. The size of the vertical blur operation in pixels.
@@ -12,6 +12,10 @@
 
 #include "Brightness.h"
 #include "Exceptions.h"
+#include "ColorPipeline.h"
+
+#include <iomanip>
+#include <sstream>
 
 using namespace openshot;
 
@@ -42,52 +46,58 @@ void Brightness::init_effect_details()
 	info.has_video = true;
 }
 
-// This method is required for all derived classes of EffectBase, and returns a
-// modified openshot::Frame object
-std::shared_ptr<openshot::Frame> Brightness::GetFrame(std::shared_ptr<openshot::Frame> frame, int64_t frame_number)
-{
-	// Get the frame's image
-	std::shared_ptr<QImage> frame_image = frame->GetImage();
+// Adjusts the contrast, and then the brightness of each pixel
+class BrightnessTransform : public ColorTransform {
+private:
+	float brightness_value;
+	float contrast_value;
+	float table[256]; ///< New value of each color (the same for every channel)
 
-	// Get keyframe values for this frame
-	float brightness_value = brightness.GetValue(frame_number);
-	float contrast_value = contrast.GetValue(frame_number);
-
-	// Loop through pixels
-	unsigned char *pixels = (unsigned char *) frame_image->bits();
-	int pixel_count = frame_image->width() * frame_image->height();
-
-	#pragma omp parallel for
-	for (int pixel = 0; pixel < pixel_count; ++pixel)
+public:
+	BrightnessTransform(float brightness_value, float contrast_value) :
+		brightness_value(brightness_value), contrast_value(contrast_value)
 	{
 		// Compute contrast adjustment factor
 		float factor = (259 * (contrast_value + 255)) / (255 * (259 - contrast_value));
 
-		// Calculate alpha % (to be used for removing pre-multiplied alpha value)
-		int A = pixels[pixel * 4 + 3];
-		float alpha_percent = A / 255.0;
-
-		// Get RGB values, and remove pre-multiplied alpha
-		unsigned char R = pixels[pixel * 4 + 0] / alpha_percent;
-		unsigned char G = pixels[pixel * 4 + 1] / alpha_percent;
-		unsigned char B = pixels[pixel * 4 + 2] / alpha_percent;
-
-		// Apply constrained contrast adjustment
-		R = constrain((factor * (R - 128)) + 128);
-		G = constrain((factor * (G - 128)) + 128);
-		B = constrain((factor * (B - 128)) + 128);
-
-		// Adjust brightness and write constrained values back to image
-		pixels[pixel * 4 + 0] = constrain(R + (255 * brightness_value));
-		pixels[pixel * 4 + 1] = constrain(G + (255 * brightness_value));
-		pixels[pixel * 4 + 2] = constrain(B + (255 * brightness_value));
-
-		// Pre-multiply the alpha back into the color channels
-		pixels[pixel * 4 + 0] *= alpha_percent;
-		pixels[pixel * 4 + 1] *= alpha_percent;
-		pixels[pixel * 4 + 2] *= alpha_percent;
+		for (int color = 0; color < 256; ++color)
+		{
+			// Apply constrained contrast adjustment
+			unsigned char value = color;
+			value = constrain((factor * (value - 128)) + 128);
+
+			// Adjust brightness and constrain the value
+			table[color] = constrain(value + (255 * brightness_value));
+		}
+	}
+
+	std::string Key() const override {
+		std::stringstream key;
+		key << std::setprecision(9) << "Brightness:" << brightness_value << ":" << contrast_value;
+		return key.str();
 	}
 
+	void TransformRow(float* red, float* green, float* blue, int pixels) const override {
+		LookupRow(red, pixels, table);
+		LookupRow(green, pixels, table);
+		LookupRow(blue, pixels, table);
+	}
+};
+
+// Get the color transform of this effect (for a specific frame)
+std::shared_ptr<ColorTransform> Brightness::GetColorTransform(int64_t frame_number)
+{
+	// Get keyframe values for this frame
+	return std::make_shared<BrightnessTransform>(brightness.GetValue(frame_number), contrast.GetValue(frame_number));
+}
+
+// This method is required for all derived classes of EffectBase, and returns a
+// modified openshot::Frame object
+std::shared_ptr<openshot::Frame> Brightness::GetFrame(std::shared_ptr<openshot::Frame> frame, int64_t frame_number)
+{
+	// Adjust the pixels of the frame's image
+	ColorPipeline::Apply(*frame->GetImage(), {GetColorTransform(frame_number)});
+
 	// return the modified frame
 	return frame;
 }
@@ -16,13 +16,440 @@
 #if USE_BABL
 #include <babl/babl.h>
 #endif
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <vector>
 #include <cmath>
 
+#if defined(__SSE2__)
+	#define OPENSHOT_CHROMAKEY_SSE2
+	#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	#define OPENSHOT_CHROMAKEY_NEON
+	#include <arm_neon.h>
+#endif
+
 using namespace openshot;
 
+// Distances in the table are fixed-point (rounded up, so comparing them with whole thresholds is exact)
+static const float DISTANCE_SCALE = 128.0f;
+static const uint16_t DISTANCE_MAX = 0xfffe;
+static const uint16_t DISTANCE_UNKNOWN = 0xffff;
+
+// The babl keying methods only depend on the color of a pixel, so the distance of every color (which
+// babl has converted) from the key color is cached, in a table of all 2^24 RGB colors. The table is
+// filled as colors are found in frames. Tables are shared by every ChromaKey with the same method and key
+// color, and only the most recently used tables are kept.
+struct ChromaKey::DistanceTable
+{
+	ChromaKeyMethod method;
+	long key[3];
+	std::unique_ptr<std::atomic<uint16_t>[]> distances;
+
+	DistanceTable(ChromaKeyMethod method, long red, long green, long blue) :
+		method(method), key{red, green, blue}, distances(new std::atomic<uint16_t>[1 << 24])
+	{
+		#pragma omp parallel for
+		for (int color = 0; color < (1 << 24); ++color)
+			distances[color].store(DISTANCE_UNKNOWN, std::memory_order_relaxed);
+	}
+};
+
+// Max number of distance tables which are kept (each one is 32 MB)
+static const size_t MAX_DISTANCE_TABLES = 4;
+
+// Get the shared distance table of a key color (or start a new table)
+std::shared_ptr<ChromaKey::DistanceTable> ChromaKey::GetDistanceTable(ChromaKeyMethod method, long red, long green, long blue)
+{
+	static std::mutex tables_mutex;
+	static std::vector<std::shared_ptr<DistanceTable>> tables; // The most recently used table is last
+
+	// Tables are started while holding the lock, so effects keying the same color at once only start one table
+	const std::lock_guard<std::mutex> lock(tables_mutex);
+	for (auto table = tables.begin(); table != tables.end(); ++table)
+	{
+		if ((*table)->method == method && (*table)->key[0] == red && (*table)->key[1] == green && (*table)->key[2] == blue)
+		{
+			std::rotate(table, table + 1, tables.end());
+			return tables.back();
+		}
+	}
+
+	// Tables which are dropped are freed once no effect is using them
+	if (tables.size() >= MAX_DISTANCE_TABLES)
+		tables.erase(tables.begin());
+	tables.push_back(std::make_shared<DistanceTable>(method, red, green, blue));
+	return tables.back();
+}
+
+// Remove (or fade) the pixels of a row, by their distance from the key color
+static void key_row(unsigned char *pixels, const float *distances, int width, int threshold, int halothreshold)
+{
+	int x = 0;
+
+#if defined(OPENSHOT_CHROMAKEY_SSE2)
+	const __m128 fuzz = _mm_set1_ps(threshold);
+	const __m128 limit = _mm_set1_ps(threshold + halothreshold);
+	const __m128 halo = _mm_set1_ps(halothreshold);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; x + 4 <= width; x += 4)
+	{
+		__m128 distance = _mm_loadu_ps(distances + x);
+		__m128 keyed = _mm_cmple_ps(distance, fuzz);
+		__m128 faded = _mm_andnot_ps(keyed, _mm_cmple_ps(distance, limit));
+		__m128 changed = _mm_or_ps(keyed, faded);
+		if (_mm_movemask_ps(changed) == 0)
+			continue;
+
+		// Keyed pixels are multiplied by 0, and foreground pixels by 1
+		__m128 alphamult = _mm_or_ps(_mm_and_ps(faded, _mm_div_ps(_mm_sub_ps(distance, fuzz), halo)),
+									 _mm_andnot_ps(changed, one));
+
+		__m128i color = _mm_loadu_si128((const __m128i *) (pixels + x * 4));
+		__m128i low = _mm_unpacklo_epi8(color, zero);
+		__m128i high = _mm_unpackhi_epi8(color, zero);
+		__m128i p0 = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)), _mm_shuffle_ps(alphamult, alphamult, 0x00)));
+		__m128i p1 = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)), _mm_shuffle_ps(alphamult, alphamult, 0x55)));
+		__m128i p2 = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)), _mm_shuffle_ps(alphamult, alphamult, 0xaa)));
+		__m128i p3 = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)), _mm_shuffle_ps(alphamult, alphamult, 0xff)));
+		color = _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+		_mm_storeu_si128((__m128i *) (pixels + x * 4), color);
+	}
+#elif defined(OPENSHOT_CHROMAKEY_NEON)
+	const float32x4_t fuzz = vdupq_n_f32(threshold);
+	const float32x4_t limit = vdupq_n_f32(threshold + halothreshold);
+	const float32x4_t halo = vdupq_n_f32(halothreshold);
+
+	for (; x + 4 <= width; x += 4)
+	{
+		float32x4_t distance = vld1q_f32(distances + x);
+		uint32x4_t keyed = vcleq_f32(distance, fuzz);
+		uint32x4_t faded = vbicq_u32(vcleq_f32(distance, limit), keyed);
+		if (vmaxvq_u32(vorrq_u32(keyed, faded)) == 0)
+			continue;
+
+		// Keyed pixels are multiplied by 0, and foreground pixels by 1
+		float32x4_t alphamult = vbslq_f32(faded, vdivq_f32(vsubq_f32(distance, fuzz), halo), vdupq_n_f32(1.0f));
+		alphamult = vbslq_f32(keyed, vdupq_n_f32(0.0f), alphamult);
+
+		uint8x16_t color = vld1q_u8(pixels + x * 4);
+		uint16x8_t low = vmovl_u8(vget_low_u8(color));
+		uint16x8_t high = vmovl_u8(vget_high_u8(color));
+		uint32x4_t p0 = vcvtq_u32_f32(vmulq_laneq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(low))), alphamult, 0));
+		uint32x4_t p1 = vcvtq_u32_f32(vmulq_laneq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(low))), alphamult, 1));
+		uint32x4_t p2 = vcvtq_u32_f32(vmulq_laneq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(high))), alphamult, 2));
+		uint32x4_t p3 = vcvtq_u32_f32(vmulq_laneq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(high))), alphamult, 3));
+		uint16x8_t low_out = vcombine_u16(vmovn_u32(p0), vmovn_u32(p1));
+		uint16x8_t high_out = vcombine_u16(vmovn_u32(p2), vmovn_u32(p3));
+		vst1q_u8(pixels + x * 4, vcombine_u8(vmovn_u16(low_out), vmovn_u16(high_out)));
+	}
+#endif
+
+	for (; x < width; ++x)
+	{
+		unsigned char *pixel = pixels + x * 4;
+		float tmp = distances[x];
+
+		if (tmp <= threshold)
+		{
+			pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
+		}
+		else if (tmp <= threshold + halothreshold)
+		{
+			float alphamult = (tmp - threshold) / halothreshold;
+
+			pixel[0] *= alphamult;
+			pixel[1] *= alphamult;
+			pixel[2] *= alphamult;
+			pixel[3] *= alphamult;
+		}
+	}
+}
+
+#if defined(OPENSHOT_CHROMAKEY_SSE2)
+// Undo the premultiplication of alpha for one channel of 4 pixels (exactly like the scalar math)
+static inline __m128i unpremultiply(__m128i channel, __m128 alpha)
+{
+	const __m128d scale = _mm_set1_pd(255.0);
+	__m128 quotient = _mm_div_ps(_mm_cvtepi32_ps(channel), alpha);
+	__m128i low = _mm_cvttpd_epi32(_mm_min_pd(_mm_mul_pd(_mm_cvtps_pd(quotient), scale), scale));
+	__m128i high = _mm_cvttpd_epi32(_mm_min_pd(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(quotient, quotient)), scale), scale));
+	return _mm_unpacklo_epi64(low, high);
+}
+
+// Get the distance of 2 pixels (in the low lanes of the channels) from the key color (see Color::GetDistance)
+static inline __m128d basic_distance(__m128i r, __m128i g, __m128i b, __m128i rmean)
+{
+	__m128d rd = _mm_cvtepi32_pd(r);
+	__m128d gd = _mm_cvtepi32_pd(g);
+	__m128d bd = _mm_cvtepi32_pd(b);
+	__m128d meand = _mm_cvtepi32_pd(rmean);
+
+	// The products are exact (and not negative), so truncating them is the same as shifting them
+	const __m128d shift = _mm_set1_pd(1.0 / 256.0);
+	__m128d red = _mm_cvtepi32_pd(_mm_cvttpd_epi32(_mm_mul_pd(_mm_mul_pd(_mm_add_pd(_mm_set1_pd(512.0), meand), _mm_mul_pd(rd, rd)), shift)));
+	__m128d blue = _mm_cvtepi32_pd(_mm_cvttpd_epi32(_mm_mul_pd(_mm_mul_pd(_mm_sub_pd(_mm_set1_pd(767.0), meand), _mm_mul_pd(bd, bd)), shift)));
+	__m128d green = _mm_mul_pd(_mm_set1_pd(4.0), _mm_mul_pd(gd, gd));
+	return _mm_sqrt_pd(_mm_add_pd(_mm_add_pd(red, green), blue));
+}
+#elif defined(OPENSHOT_CHROMAKEY_NEON)
+// Undo the premultiplication of alpha for one channel of 4 pixels (exactly like the scalar math)
+static inline int32x4_t unpremultiply(uint32x4_t channel, float32x4_t alpha)
+{
+	const float64x2_t scale = vdupq_n_f64(255.0);
+	float32x4_t quotient = vdivq_f32(vcvtq_f32_u32(channel), alpha);
+	float64x2_t low = vminq_f64(vmulq_f64(vcvt_f64_f32(vget_low_f32(quotient)), scale), scale);
+	float64x2_t high = vminq_f64(vmulq_f64(vcvt_high_f64_f32(quotient), scale), scale);
+	return vcombine_s32(vmovn_s64(vcvtq_s64_f64(low)), vmovn_s64(vcvtq_s64_f64(high)));
+}
+
+// Get the distance of 2 pixels from the key color (see Color::GetDistance)
+static inline int32x2_t basic_distance(int32x2_t r, int32x2_t g, int32x2_t b, int32x2_t rmean)
+{
+	float64x2_t rd = vcvtq_f64_s64(vmovl_s32(r));
+	float64x2_t gd = vcvtq_f64_s64(vmovl_s32(g));
+	float64x2_t bd = vcvtq_f64_s64(vmovl_s32(b));
+	float64x2_t meand = vcvtq_f64_s64(vmovl_s32(rmean));
+
+	// The products are exact (and not negative), so truncating them is the same as shifting them
+	const float64x2_t shift = vdupq_n_f64(1.0 / 256.0);
+	float64x2_t red = vrndq_f64(vmulq_f64(vmulq_f64(vaddq_f64(vdupq_n_f64(512.0), meand), vmulq_f64(rd, rd)), shift));
+	float64x2_t blue = vrndq_f64(vmulq_f64(vmulq_f64(vsubq_f64(vdupq_n_f64(767.0), meand), vmulq_f64(bd, bd)), shift));
+	float64x2_t green = vmulq_f64(vdupq_n_f64(4.0), vmulq_f64(gd, gd));
+	return vmovn_s64(vcvtq_s64_f64(vsqrtq_f64(vaddq_f64(vaddq_f64(red, green), blue))));
+}
+#endif
+
+// Get the distance of each pixel of a row from the key color (after undoing the premultiplication of alpha)
+static void basic_distances(const unsigned char *pixels, float *distances, int width, long mask_R, long mask_G, long mask_B)
+{
+	int x = 0;
+
+#if defined(OPENSHOT_CHROMAKEY_SSE2) || defined(OPENSHOT_CHROMAKEY_NEON)
+	// Key colors outside of 0-255 could make the shifted products negative, so they use the scalar loop
+	if (mask_R >= 0 && mask_R <= 255 && mask_G >= 0 && mask_G <= 255 && mask_B >= 0 && mask_B <= 255)
+	{
+#if defined(OPENSHOT_CHROMAKEY_SSE2)
+		const __m128i channel = _mm_set1_epi32(0xff);
+		const __m128i key_R = _mm_set1_epi32(mask_R);
+		const __m128i key_G = _mm_set1_epi32(mask_G);
+		const __m128i key_B = _mm_set1_epi32(mask_B);
+
+		for (; x + 4 <= width; x += 4)
+		{
+			__m128i color = _mm_loadu_si128((const __m128i *) (pixels + x * 4));
+			__m128 alpha = _mm_cvtepi32_ps(_mm_srli_epi32(color, 24));
+
+			// Transparent pixels are black
+			__m128i visible = _mm_castps_si128(_mm_cmpgt_ps(alpha, _mm_setzero_ps()));
+			__m128i R = _mm_and_si128(unpremultiply(_mm_and_si128(color, channel), alpha), visible);
+			__m128i G = _mm_and_si128(unpremultiply(_mm_and_si128(_mm_srli_epi32(color, 8), channel), alpha), visible);
+			__m128i B = _mm_and_si128(unpremultiply(_mm_and_si128(_mm_srli_epi32(color, 16), channel), alpha), visible);
+
+			__m128i rmean = _mm_srai_epi32(_mm_add_epi32(R, key_R), 1);
+			__m128i r = _mm_sub_epi32(R, key_R);
+			__m128i g = _mm_sub_epi32(G, key_G);
+			__m128i b = _mm_sub_epi32(B, key_B);
+
+			__m128i low = _mm_cvttpd_epi32(basic_distance(r, g, b, rmean));
+			__m128i high = _mm_cvttpd_epi32(basic_distance(_mm_srli_si128(r, 8), _mm_srli_si128(g, 8),
+														   _mm_srli_si128(b, 8), _mm_srli_si128(rmean, 8)));
+			_mm_storeu_ps(distances + x, _mm_cvtepi32_ps(_mm_unpacklo_epi64(low, high)));
+		}
+#elif defined(OPENSHOT_CHROMAKEY_NEON)
+		const uint32x4_t channel = vdupq_n_u32(0xff);
+		const int32x4_t key_R = vdupq_n_s32(mask_R);
+		const int32x4_t key_G = vdupq_n_s32(mask_G);
+		const int32x4_t key_B = vdupq_n_s32(mask_B);
+
+		for (; x + 4 <= width; x += 4)
+		{
+			uint32x4_t color = vreinterpretq_u32_u8(vld1q_u8(pixels + x * 4));
+			float32x4_t alpha = vcvtq_f32_u32(vshrq_n_u32(color, 24));
+
+			// Transparent pixels are black
+			int32x4_t visible = vreinterpretq_s32_u32(vcgtq_f32(alpha, vdupq_n_f32(0.0f)));
+			int32x4_t R = vandq_s32(unpremultiply(vandq_u32(color, channel), alpha), visible);
+			int32x4_t G = vandq_s32(unpremultiply(vandq_u32(vshrq_n_u32(color, 8), channel), alpha), visible);
+			int32x4_t B = vandq_s32(unpremultiply(vandq_u32(vshrq_n_u32(color, 16), channel), alpha), visible);
+
+			int32x4_t rmean = vshrq_n_s32(vaddq_s32(R, key_R), 1);
+			int32x4_t r = vsubq_s32(R, key_R);
+			int32x4_t g = vsubq_s32(G, key_G);
+			int32x4_t b = vsubq_s32(B, key_B);
+
+			int32x2_t low = basic_distance(vget_low_s32(r), vget_low_s32(g), vget_low_s32(b), vget_low_s32(rmean));
+			int32x2_t high = basic_distance(vget_high_s32(r), vget_high_s32(g), vget_high_s32(b), vget_high_s32(rmean));
+			vst1q_f32(distances + x, vcvtq_f32_s32(vcombine_s32(low, high)));
+		}
+#endif
+	}
+#endif
+
+	for (const unsigned char *pixel = pixels + x * 4; x < width; ++x, pixel += 4)
+	{
+		// Transparent pixels are black
+		float A = pixel[3];
+		unsigned char R = 0, G = 0, B = 0;
+		if (A > 0)
+		{
+			R = std::min((pixel[0] / A) * 255.0, 255.0);
+			G = std::min((pixel[1] / A) * 255.0, 255.0);
+			B = std::min((pixel[2] / A) * 255.0, 255.0);
+		}
+
+		// Get distance between mask color and pixel color
+		distances[x] = Color::GetDistance((long)R, (long)G, (long)B, mask_R, mask_G, mask_B);
+	}
+}
+
+#if USE_BABL
+// Get the CIEDE2000 distance between 2 colors (in CIE Lab u8)
+static float cie_distance(unsigned char const *mask, unsigned char const *pc)
+{
+	float KL = 1.0;
+	float KC = 1.0;
+	float KH = 1.0;
+	float pi = 4 * std::atan(1);
+
+	float L1 = ((float) mask[0]) / 2.55;
+	float a1 = mask[1] - 127;
+	float b1 = mask[2] - 127;
+	float C1 = std::sqrt(a1 * a1 + b1 * b1);
+
+	float L2 = ((float) pc[0]) / 2.55;
+	int   a2 = pc[1] - 127;
+	int   b2 = pc[2] - 127;
+	float C2 = std::sqrt(a2 * a2 + b2 * b2);
+
+	float delta_L_prime = L2 - L1;
+	float L_bar = (L1 + L2) / 2;
+	float C_bar = (C1 + C2) / 2;
+
+	float a_prime_multiplier = 1 + 0.5 * (1 - std::sqrt(C_bar / (C_bar + 25)));
+	float a1_prime = a1 * a_prime_multiplier;
+	float a2_prime = a2 * a_prime_multiplier;
+
+	float C1_prime = std::sqrt(a1_prime * a1_prime + b1 * b1);
+	float C2_prime = std::sqrt(a2_prime * a2_prime + b2 * b2);
+	float C_prime_bar = (C1_prime + C2_prime) / 2;
+	float delta_C_prime = C2_prime - C1_prime;
+
+	float h1_prime = std::atan2(b1, a1_prime) * 180 / pi;
+	float h2_prime = std::atan2(b2, a2_prime) * 180 / pi;
+
+	float delta_h_prime = h2_prime - h1_prime;
+	double H_prime_bar = (C1_prime != 0 && C2_prime != 0) ? (h1_prime + h2_prime) / 2 : (h1_prime + h2_prime);
+
+	if (delta_h_prime < -180)
+	{
+		delta_h_prime += 360;
+		if (H_prime_bar < 180)
+			H_prime_bar += 180;
+		else
+			H_prime_bar -= 180;
+	}
+	else if (delta_h_prime > 180)
+	{
+		delta_h_prime -= 360;
+		if (H_prime_bar < 180)
+			H_prime_bar += 180;
+		else
+			H_prime_bar -= 180;
+	}
+
+	float delta_H_prime = 2 * std::sqrt(C1_prime * C2_prime) * std::sin(delta_h_prime * pi / 360);
+
+	float T = 1
+		- 0.17 * std::cos((H_prime_bar - 30) * pi / 180)
+		+ 0.24 * std::cos(H_prime_bar * pi / 90)
+		+ 0.32 * std::cos((3 * H_prime_bar + 6) * pi / 180)
+		- 0.20 * std::cos((4 * H_prime_bar - 64) * pi / 180);
+
+	float SL = 1 + 0.015 * std::pow(L_bar - 50, 2) / std::sqrt(20 + std::pow(L_bar - 50, 2));
+	float SC = 1 + 0.045 * C_prime_bar;
+	float SH = 1 + 0.015 * C_prime_bar * T;
+	float RT = -2 * std::sqrt(C_prime_bar / (C_prime_bar + 25)) * std::sin(pi / 3 * std::exp(-std::pow((H_prime_bar - 275) / 25, 2)));
+	float delta_E = std::sqrt(std::pow(delta_L_prime / KL / SL, 2)
+				+ std::pow(delta_C_prime / KC / SC, 2)
+				+ std::pow(delta_h_prime / KH / SH, 2)
+				+ RT * delta_C_prime / KC / SC * delta_H_prime / KH / SH);
+	return delta_E;
+}
+
+// Get the distance of a color (converted by babl) from the key color, for a keying method
+static float color_distance(ChromaKeyMethod method, unsigned char const *pc, float const *mask_f, unsigned char const *mask_u)
+{
+	float const *pf = (float const *) pc;
+	float tmp = 0.0;
+
+	switch(method)
+	{
+	case CHROMAKEY_HSVL_H:
+		tmp = fabs(pf[0] - mask_f[0]);
+		if (tmp > 0.5)
+			tmp = 1.0 - tmp;
+		tmp *= 500;
+		break;
+
+	case CHROMAKEY_HSV_S:
+	case CHROMAKEY_HSL_S:
+		tmp = fabs(pf[1] - mask_f[1]) * 255;
+		break;
+
+	case CHROMAKEY_HSV_V:
+	case CHROMAKEY_HSL_L:
+		tmp = fabs(pf[2] - mask_f[2]) * 255;
+		break;
+
+	case CHROMAKEY_YCBCR:
+		{
+			int db = (int) pc[1] - mask_u[1];
+			int dr = (int) pc[2] - mask_u[2];
+			tmp = sqrt(db * db + dr * dr);
+		}
+		break;
+
+	case CHROMAKEY_CIE_LCH_L:
+		tmp = fabs(pf[0] - mask_f[0]);
+		break;
+
+	case CHROMAKEY_CIE_LCH_C:
+		tmp = fabs(pf[1] - mask_f[1]);
+		break;
+
+	case CHROMAKEY_CIE_LCH_H:
+		// Hues in LCH(ab) are an angle on a color wheel.
+		// We are tring to find the angular distance
+		// between the two angles. It can never be more
+		// than 180 degrees - if it is, there is a closer
+		// angle that can be calculated by going in the
+		// other diretion, which  can be found by
+		// subtracting the angle we have from 360.
+		tmp = fabs(pf[2] - mask_f[2]);
+		if (tmp > 180.0)
+			tmp = 360.0 - tmp;
+		break;
+
+	case CHROMAKEY_CIE_DISTANCE:
+		tmp = cie_distance(mask_u, pc);
+		break;
+
+	case CHROMAKEY_BASIC:
+		break;
+	}
+
+	return tmp;
+}
+#endif
+
 /// Blank constructor, useful when using Json to load the effect properties
-ChromaKey::ChromaKey() : fuzz(5.0), halo(0), method(CHROMAKEY_BASIC) {
+ChromaKey::ChromaKey() :
+	fuzz(5.0), halo(0), method(CHROMAKEY_BASIC), previous_method(CHROMAKEY_BASIC), previous_key{-1, -1, -1}
+{
 	// Init default color
 	color = Color();
 
@@ -33,7 +460,7 @@ ChromaKey::ChromaKey() : fuzz(5.0), halo(0), method(CHROMAKEY_BASIC) {
 // Standard constructor, which takes an openshot::Color object, a 'fuzz' factor,
 // an optional halo distance and an optional keying method.
 ChromaKey::ChromaKey(Color color, Keyframe fuzz, Keyframe halo, ChromaKeyMethod method) :
-	color(color), fuzz(fuzz), halo(halo), method(method)
+	color(color), fuzz(fuzz), halo(halo), method(method), previous_method(CHROMAKEY_BASIC), previous_key{-1, -1, -1}
 {
 	// Init effect properties
 	init_effect_details();
@@ -111,8 +538,6 @@ std::shared_ptr<openshot::Frame> ChromaKey::GetFrame(std::shared_ptr<openshot::F
 	int width = image->width();
 	int height = image->height();
 
-	int pixelcount = width * height;
-
 #if USE_BABL
 	if (method > CHROMAKEY_BASIC && method <= CHROMAKEY_LAST_METHOD)
 	{
@@ -127,8 +552,7 @@ std::shared_ptr<openshot::Frame> ChromaKey::GetFrame(std::shared_ptr<openshot::F
 		Babl const *rgb = babl_format("R'G'B'A u8");
 		Babl const *format = 0;
 		Babl const *fish = 0;
-		std::vector<unsigned char> pixelbuf;
-		int rowwidth = 0;
+		int pixelsize = 0;
 
 		switch(method)
 		{
@@ -136,348 +560,139 @@ std::shared_ptr<openshot::Frame> ChromaKey::GetFrame(std::shared_ptr<openshot::F
 		case CHROMAKEY_HSV_S:
 		case CHROMAKEY_HSV_V:
 			format = babl_format("HSV float");
-			rowwidth = width * sizeof(float) * 3;
+			pixelsize = sizeof(float) * 3;
 			break;
 
 		case CHROMAKEY_HSL_S:
 		case CHROMAKEY_HSL_L:
 			format = babl_format("HSL float");
-			rowwidth = width * sizeof(float) * 3;
+			pixelsize = sizeof(float) * 3;
 			break;
 
 		case CHROMAKEY_CIE_LCH_L:
 		case CHROMAKEY_CIE_LCH_C:
 		case CHROMAKEY_CIE_LCH_H:
 			format = babl_format("CIE LCH(ab) float");
-			rowwidth = width * sizeof(float) * 3;
+			pixelsize = sizeof(float) * 3;
 			break;
 
 		case CHROMAKEY_CIE_DISTANCE:
 			format = babl_format("CIE Lab u8");
-			rowwidth = width * 3;
+			pixelsize = 3;
 			break;
 
 		case CHROMAKEY_YCBCR:
 			format = babl_format("Y'CbCr u8");
-			rowwidth = width * 3;
+			pixelsize = 3;
 			break;
 
 		case CHROMAKEY_BASIC:
 			break;
 		}
 
-		pixelbuf.resize(rowwidth * height);
-
 		if (rgb && format && (fish = babl_fish(rgb, format)) != 0)
 		{
-			int		idx = 0;
-			unsigned char	mask_in[4];
-			union { float f[4]; unsigned char u[4]; } mask;
-			float const *pf = (float *) pixelbuf.data();
-			unsigned char const *pc = pixelbuf.data();
-
+			// Convert the key color
+			union { float f[4]; unsigned char u[4]; } mask{};
+			unsigned char mask_in[4];
 			mask_in[0] = mask_R;
 			mask_in[1] = mask_G;
 			mask_in[2] = mask_B;
 			mask_in[3] = 255;
 			babl_process(fish, mask_in, &mask, 1);
 
-			if (0) //image->bytesPerLine() == width * 4)
+			// Get the cached distances for this key color. Distances are only cached once the key color is the
+			// same as the previous frame's, so an animated key color doesn't start a table for every frame (its
+			// distances are just calculated).
+			std::shared_ptr<DistanceTable> table;
 			{
-				// Because babl_process is expensive to call, but efficient
-				// with long sequences of pixels, attempt to convert the
-				// entire buffer at once if we can
-				babl_process(fish, image->bits(), pixelbuf.data(), pixelcount);
+				const std::lock_guard<std::mutex> lock(distance_mutex);
+				if (distance_table && distance_table->method == method && distance_table->key[0] == mask_R &&
+					distance_table->key[1] == mask_G && distance_table->key[2] == mask_B)
+					table = distance_table;
+				else if (previous_method == method && previous_key[0] == mask_R && previous_key[1] == mask_G &&
+						 previous_key[2] == mask_B)
+					table = distance_table = GetDistanceTable(method, mask_R, mask_G, mask_B);
+				else
+					distance_table = nullptr;
+
+				previous_method = method;
+				previous_key[0] = mask_R;
+				previous_key[1] = mask_G;
+				previous_key[2] = mask_B;
 			}
-			else
-			{
-				unsigned char *rowdata = pixelbuf.data();
-
-				for (int y = 0; y < height; ++y, rowdata += rowwidth)
-					babl_process(fish, image->scanLine(y), rowdata, width);
-			}
-
-			switch(method)
-			{
-			case CHROMAKEY_HSVL_H:
-				for (int y = 0; y < height; ++y)
-				{
-					unsigned char *pixel = image->scanLine(y);
-
-					for (int x = 0; x < width; ++x, pixel += 4, pf += 3)
-					{
-						float tmp = fabs(pf[0] - mask.f[0]);
-
-						if (tmp > 0.5)
-							tmp = 1.0 - tmp;
-						tmp *= 500;
-						if (tmp <= threshold)
-						{
-							pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
-						}
-						else if (tmp <= threshold + halothreshold)
-						{
-							float alphamult = (tmp - threshold) / halothreshold;
 
-							pixel[0] *= alphamult;
-							pixel[1] *= alphamult;
-							pixel[2] *= alphamult;
-							pixel[3] *= alphamult;
-						}
-					}
-				}
-				break;
-
-			case CHROMAKEY_HSV_S:
-			case CHROMAKEY_HSL_S:
-				for (int y = 0; y < height; ++y)
-				{
-					unsigned char *pixel = image->scanLine(y);
+			// The LCH hue method has never had a halo
+			if (method == CHROMAKEY_CIE_LCH_H)
+				halothreshold = 0;
 
-					for (int x = 0; x < width; ++x, pixel += 4, pf += 3)
-					{
-						float tmp = fabs(pf[1] - mask.f[1]) * 255;
-
-						if (tmp <= threshold)
-						{
-							pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
-						}
-						else if (tmp <= threshold + halothreshold)
-						{
-							float alphamult = (tmp - threshold) / halothreshold;
+			unsigned char *bits = image->bits();
+			int64_t bytes_per_line = image->bytesPerLine();
 
-							pixel[0] *= alphamult;
-							pixel[1] *= alphamult;
-							pixel[2] *= alphamult;
-							pixel[3] *= alphamult;
-						}
-					}
-				}
-				break;
-
-			case CHROMAKEY_HSV_V:
-			case CHROMAKEY_HSL_L:
-				for (int y = 0; y < height; ++y)
-				{
-					unsigned char *pixel = image->scanLine(y);
-
-					for (int x = 0; x < width; ++x, pixel += 4, pf += 3)
-					{
-						float tmp = fabs(pf[2] - mask.f[2]) * 255;
-
-						if (tmp <= threshold)
-						{
-							pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
-						}
-						else if (tmp <= threshold + halothreshold)
-						{
-							float alphamult = (tmp - threshold) / halothreshold;
-
-							pixel[0] *= alphamult;
-							pixel[1] *= alphamult;
-							pixel[2] *= alphamult;
-							pixel[3] *= alphamult;
-						}
-					}
-				}
-				break;
+			#pragma omp parallel
+			{
+				std::vector<float> distances(width);
+				std::vector<int> slots(width);
+				std::vector<unsigned char> colors;
+				std::vector<unsigned char> converted;
+				std::vector<float> found;
 
-			case CHROMAKEY_YCBCR:
+				#pragma omp for schedule(dynamic, 8)
 				for (int y = 0; y < height; ++y)
 				{
-					unsigned char *pixel = image->scanLine(y);
+					unsigned char *pixels = bits + y * bytes_per_line;
 
-					for (int x = 0; x < width; ++x, pixel += 4, pc += 3)
+					// Look up the distance of each color, and collect the colors which are not in the table yet (or all
+					// colors, without a table). babl is expensive to call, but efficient with long sequences of pixels.
+					colors.clear();
+					for (int x = 0; x < width; ++x)
 					{
-						int db = (int) pc[1] - mask.u[1];
-						int dr = (int) pc[2] - mask.u[2];
-						float tmp = sqrt(db * db + dr * dr);
-
-						if (tmp <= threshold)
+						unsigned char const *pixel = pixels + x * 4;
+						uint16_t distance = DISTANCE_UNKNOWN;
+						if (table)
+							distance = table->distances[(pixel[0] << 16) | (pixel[1] << 8) | pixel[2]].load(std::memory_order_relaxed);
+						slots[x] = -1;
+
+						if (distance != DISTANCE_UNKNOWN)
+							distances[x] = distance / DISTANCE_SCALE;
+						else if (!colors.empty() && std::equal(pixel, pixel + 3, colors.end() - 4))
+							slots[x] = colors.size() / 4 - 1;
+						else
 						{
-							pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
-						}
-						else if (tmp <= threshold + halothreshold)
-						{
-							float alphamult = (tmp - threshold) / halothreshold;
-
-							pixel[0] *= alphamult;
-							pixel[1] *= alphamult;
-							pixel[2] *= alphamult;
-							pixel[3] *= alphamult;
+							slots[x] = colors.size() / 4;
+							colors.insert(colors.end(), {pixel[0], pixel[1], pixel[2], 255});
 						}
 					}
-				}
-				break;
 
-			case CHROMAKEY_CIE_LCH_L:
-				for (int y = 0; y < height; ++y)
-				{
-					unsigned char *pixel = image->scanLine(y);
-
-					for (int x = 0; x < width; ++x, pixel += 4, pf += 3)
+					if (!colors.empty())
 					{
-						float tmp = fabs(pf[0] - mask.f[0]);
+						int count = colors.size() / 4;
+						converted.resize(size_t(count) * pixelsize);
+						found.resize(count);
+						babl_process(fish, colors.data(), converted.data(), count);
 
-						if (tmp <= threshold)
-						{
-							pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
-						}
-						else if (tmp <= threshold + halothreshold)
+						for (int i = 0; i < count; ++i)
 						{
-							float alphamult = (tmp - threshold) / halothreshold;
+							float tmp = color_distance(method, &converted[size_t(i) * pixelsize], mask.f, mask.u);
 
-							pixel[0] *= alphamult;
-							pixel[1] *= alphamult;
-							pixel[2] *= alphamult;
-							pixel[3] *= alphamult;
-						}
-					}
-				}
-				break;
-
-			case CHROMAKEY_CIE_LCH_C:
-				for (int y = 0; y < height; ++y)
-				{
-					unsigned char *pixel = image->scanLine(y);
-
-					for (int x = 0; x < width; ++x, pixel += 4, pf += 3)
-					{
-						float tmp = fabs(pf[1] - mask.f[1]);
+							// Round up, so a distance is only within a whole threshold if it was before
+							uint16_t distance = DISTANCE_MAX;
+							if (tmp <= DISTANCE_MAX / DISTANCE_SCALE)
+								distance = std::ceil(std::max(tmp, 0.0f) * DISTANCE_SCALE);
 
-						if (tmp <= threshold)
-						{
-							pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
+							unsigned char const *color = &colors[size_t(i) * 4];
+							if (table)
+								table->distances[(color[0] << 16) | (color[1] << 8) | color[2]].store(distance, std::memory_order_relaxed);
+							found[i] = distance / DISTANCE_SCALE;
 						}
-						else if (tmp <= threshold + halothreshold)
-						{
-							float alphamult = (tmp - threshold) / halothreshold;
 
-							pixel[0] *= alphamult;
-							pixel[1] *= alphamult;
-							pixel[2] *= alphamult;
-							pixel[3] *= alphamult;
-						}
+						for (int x = 0; x < width; ++x)
+							if (slots[x] >= 0)
+								distances[x] = found[slots[x]];
 					}
-				}
-				break;
-
-			case CHROMAKEY_CIE_LCH_H:
-				for (int y = 0; y < height; ++y)
-				{
-					unsigned char *pixel = image->scanLine(y);
-
-					for (int x = 0; x < width; ++x, pixel += 4, pf += 3)
-					{
-						// Hues in LCH(ab) are an angle on a color wheel.
-						// We are tring to find the angular distance
-						// between the two angles. It can never be more
-						// than 180 degrees - if it is, there is a closer
-						// angle that can be calculated by going in the
-						// other diretion, which  can be found by
-						// subtracting the angle we have from 360.
-						float tmp = fabs(pf[2] - mask.f[2]);
-
-						if (tmp > 180.0)
-							tmp = 360.0 - tmp;
-						if (tmp <= threshold)
-							pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
-					}
-				}
-				break;
 
-			case CHROMAKEY_CIE_DISTANCE:
-				{
-					float KL = 1.0;
-					float KC = 1.0;
-					float KH = 1.0;
-					float pi = 4 * std::atan(1);
-
-					float L1 = ((float) mask.u[0]) / 2.55;
-					float a1 = mask.u[1] - 127;
-					float b1 = mask.u[2] - 127;
-					float C1 = std::sqrt(a1 * a1 + b1 * b1);
-
-					for (int y = 0; y < height; ++y)
-					{
-						unsigned char *pixel = image->scanLine(y);
-
-						for (int x = 0; x < width; ++x, pixel += 4, pc += 3)
-						{
-							float L2 = ((float) pc[0]) / 2.55;
-							int   a2 = pc[1] - 127;
-							int   b2 = pc[2] - 127;
-							float C2 = std::sqrt(a2 * a2 + b2 * b2);
-
-							float delta_L_prime = L2 - L1;
-							float L_bar = (L1 + L2) / 2;
-							float C_bar = (C1 + C2) / 2;
-
-							float a_prime_multiplier = 1 + 0.5 * (1 - std::sqrt(C_bar / (C_bar + 25)));
-							float a1_prime = a1 * a_prime_multiplier;
-							float a2_prime = a2 * a_prime_multiplier;
-
-							float C1_prime = std::sqrt(a1_prime * a1_prime + b1 * b1);
-							float C2_prime = std::sqrt(a2_prime * a2_prime + b2 * b2);
-							float C_prime_bar = (C1_prime + C2_prime) / 2;
-							float delta_C_prime = C2_prime - C1_prime;
-
-							float h1_prime = std::atan2(b1, a1_prime) * 180 / pi;
-							float h2_prime = std::atan2(b2, a2_prime) * 180 / pi;
-
-							float delta_h_prime = h2_prime - h1_prime;
-							double H_prime_bar = (C1_prime != 0 && C2_prime != 0) ? (h1_prime + h2_prime) / 2 : (h1_prime + h2_prime);
-
-							if (delta_h_prime < -180)
-							{
-								delta_h_prime += 360;
-								if (H_prime_bar < 180)
-									H_prime_bar += 180;
-								else
-									H_prime_bar -= 180;
-							}
-							else if (delta_h_prime > 180)
-							{
-								delta_h_prime -= 360;
-								if (H_prime_bar < 180)
-									H_prime_bar += 180;
-								else
-									H_prime_bar -= 180;
-							}
-
-							float delta_H_prime = 2 * std::sqrt(C1_prime * C2_prime) * std::sin(delta_h_prime * pi / 360);
-
-							float T = 1
-								- 0.17 * std::cos((H_prime_bar - 30) * pi / 180)
-								+ 0.24 * std::cos(H_prime_bar * pi / 90)
-								+ 0.32 * std::cos((3 * H_prime_bar + 6) * pi / 180)
-								- 0.20 * std::cos((4 * H_prime_bar - 64) * pi / 180);
-
-							float SL = 1 + 0.015 * std::pow(L_bar - 50, 2) / std::sqrt(20 + std::pow(L_bar - 50, 2));
-							float SC = 1 + 0.045 * C_prime_bar;
-							float SH = 1 + 0.015 * C_prime_bar * T;
-							float RT = -2 * std::sqrt(C_prime_bar / (C_prime_bar + 25)) * std::sin(pi / 3 * std::exp(-std::pow((H_prime_bar - 275) / 25, 2)));
-							float delta_E = std::sqrt(std::pow(delta_L_prime / KL / SL, 2)
-										+ std::pow(delta_C_prime / KC / SC, 2)
-										+ std::pow(delta_h_prime / KH / SH, 2)
-										+ RT * delta_C_prime / KC / SC * delta_H_prime / KH / SH);
-							if (delta_E <= threshold)
-							{
-								pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
-							}
-							else if (delta_E <= threshold + halothreshold)
-							{
-								float alphamult = (delta_E - threshold) / halothreshold;
-
-								pixel[0] *= alphamult;
-								pixel[1] *= alphamult;
-								pixel[2] *= alphamult;
-								pixel[3] *= alphamult;
-							}
-						}
-					}
+					key_row(pixels, distances.data(), width, threshold, halothreshold);
 				}
-				break;
 			}
 
 			return frame;
@@ -485,27 +700,23 @@ std::shared_ptr<openshot::Frame> ChromaKey::GetFrame(std::shared_ptr<openshot::F
 	}
 #endif
 
-	// Loop through pixels
-	for (int y = 0; y < height; ++y)
+	unsigned char *bits = image->bits();
+	int64_t bytes_per_line = image->bytesPerLine();
+
+	// Basic keying has no halo
+	#pragma omp parallel
 	{
-		unsigned char * pixel = image->scanLine(y);
+		std::vector<float> distances(width);
 
-		for (int x = 0; x < width; ++x, pixel += 4)
+		#pragma omp for
+		for (int y = 0; y < height; ++y)
 		{
-			float A = pixel[3];
-			unsigned char R = (pixel[0] / A) * 255.0;
-			unsigned char G = (pixel[1] / A) * 255.0;
-			unsigned char B = (pixel[2] / A) * 255.0;
-
-			// Get distance between mask color and pixel color
-			long distance = Color::GetDistance((long)R, (long)G, (long)B, mask_R, mask_G, mask_B);
-
-			if (distance <= threshold) {
-				// MATCHED - Make pixel transparent
-				// Due to premultiplied alpha, we must also zero out
-				// the individual color channels (or else artifacts are left behind)
-				pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
-			}
+			unsigned char *pixels = bits + y * bytes_per_line;
+			basic_distances(pixels, distances.data(), width, mask_R, mask_G, mask_B);
+
+			// Matched pixels are made transparent. Due to premultiplied alpha, we must also zero out
+			// the individual color channels (or else artifacts are left behind)
+			key_row(pixels, distances.data(), width, threshold, 0);
 		}
 	}
 
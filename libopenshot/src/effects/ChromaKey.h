@@ -22,6 +22,7 @@
 #include "../Enums.h"
 
 #include <memory>
+#include <mutex>
 #include <string>
 
 namespace openshot
@@ -41,6 +42,16 @@ namespace openshot
 		Keyframe halo;
 		ChromaKeyMethod method;
 
+		/// The distance of every color from the key color (cached for the babl keying methods)
+		struct DistanceTable;
+		std::shared_ptr<DistanceTable> distance_table;
+		ChromaKeyMethod previous_method; ///< The keying method of the previous frame
+		long previous_key[3];            ///< The key color of the previous frame
+		std::mutex distance_mutex;
+
+		/// Get the distance table of a key color, which is shared by every ChromaKey keying the same color
+		static std::shared_ptr<DistanceTable> GetDistanceTable(ChromaKeyMethod method, long red, long green, long blue);
+
 		/// Init effect settings
 		void init_effect_details();
 
@@ -12,81 +12,19 @@
 
 #include "ColorMap.h"
 #include "Exceptions.h"
-#include <omp.h>
-#include <QRegularExpression>
+#include "ColorPipeline.h"
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
 
 using namespace openshot;
 
 void ColorMap::load_cube_file()
 {
-    if (lut_path.empty()) {
-        lut_data.clear();
-        lut_size = 0;
-        needs_refresh = false;
-        return;
-    }
-
-    int parsed_size = 0;
-    std::vector<float> parsed_data;
-
-    #pragma omp critical(load_lut)
-    {
-        QFile file(QString::fromStdString(lut_path));
-        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            // leave parsed_size == 0
-        } else {
-            QTextStream in(&file);
-            QString line;
-            QRegularExpression ws_re("\\s+");
-
-            // 1) Find LUT_3D_SIZE
-            while (!in.atEnd()) {
-                line = in.readLine().trimmed();
-                if (line.startsWith("LUT_3D_SIZE")) {
-                    auto parts = line.split(ws_re);
-                    if (parts.size() >= 2) {
-                        parsed_size = parts[1].toInt();
-                    }
-                    break;
-                }
-            }
-
-            // 2) Read N³ lines of R G B floats
-            if (parsed_size > 0) {
-                int total = parsed_size * parsed_size * parsed_size;
-                parsed_data.reserve(size_t(total * 3));
-                while (!in.atEnd() && int(parsed_data.size()) < total * 3) {
-                    line = in.readLine().trimmed();
-                    if (line.isEmpty() ||
-                        line.startsWith("#") ||
-                        line.startsWith("TITLE") ||
-                        line.startsWith("DOMAIN"))
-                    {
-                        continue;
-                    }
-                    auto vals = line.split(ws_re);
-                    if (vals.size() >= 3) {
-                        // .cube file is R G B
-                        parsed_data.push_back(vals[0].toFloat());
-                        parsed_data.push_back(vals[1].toFloat());
-                        parsed_data.push_back(vals[2].toFloat());
-                    }
-                }
-                if (int(parsed_data.size()) != total * 3) {
-                    parsed_data.clear();
-                    parsed_size = 0;
-                }
-            }
-        }
-    }
-
-    if (parsed_size > 0) {
-        lut_size = parsed_size;
-        lut_data.swap(parsed_data);
-    } else {
-        lut_data.clear();
-        lut_size = 0;
-    }
+    // Tables are parsed once per file (and shared with other effects using the same file)
+    std::atomic_store(&lut, ColorLut::Load(lut_path));
     needs_refresh = false;
 }
 
@@ -101,7 +39,7 @@ void ColorMap::init_effect_details()
 }
 
 ColorMap::ColorMap()
-    : lut_path(""), lut_size(0), needs_refresh(true),
+    : lut_path(""), needs_refresh(true),
       intensity(1.0), intensity_r(1.0), intensity_g(1.0), intensity_b(1.0)
 {
     init_effect_details();
@@ -114,7 +52,6 @@ ColorMap::ColorMap(const std::string &path,
                    const Keyframe &iG,
                    const Keyframe &iB)
     : lut_path(path),
-      lut_size(0),
       needs_refresh(true),
       intensity(i),
       intensity_r(iR),
@@ -125,107 +62,79 @@ ColorMap::ColorMap(const std::string &path,
     load_cube_file();
 }
 
-std::shared_ptr<openshot::Frame>
-ColorMap::GetFrame(std::shared_ptr<openshot::Frame> frame, int64_t frame_number)
+// Maps each pixel through a 3D LUT (tetrahedral), blended by per-channel intensity
+class ColorMapTransform : public ColorTransform
 {
-    // Reload LUT when its path changed; no locking here
-    if (needs_refresh) {
-        load_cube_file();
-        needs_refresh = false;
+private:
+    std::shared_ptr<const ColorLut> lut;
+    float tR, tG, tB;
+
+public:
+    ColorMapTransform(std::shared_ptr<const ColorLut> lut, float tR, float tG, float tB)
+        : lut(lut), tR(tR), tG(tG), tB(tB) {}
+
+    std::string Key() const override
+    {
+        std::stringstream key;
+        key << std::setprecision(9) << "ColorMap:" << (lut ? lut->Key() : "") << ":" << tR << ":" << tG << ":" << tB;
+        return key.str();
     }
 
-    if (lut_data.empty())
-        return frame;
+    void TransformRow(float *red, float *green, float *blue, int pixels) const override
+    {
+        // No LUT loaded (colors are unchanged)
+        if (!lut)
+            return;
+
+        const int block_pixels = 256;
+        float lut_red[block_pixels];
+        float lut_green[block_pixels];
+        float lut_blue[block_pixels];
+        for (int first = 0; first < pixels; first += block_pixels) {
+            int count = std::min(block_pixels, pixels - first);
+            float *R = red + first;
+            float *G = green + first;
+            float *B = blue + first;
+            lut->Lookup(R, G, B, lut_red, lut_green, lut_blue, count);
+
+            // blend per-channel (alpha is re-premultiplied by the pipeline)
+            for (int i = 0; i < count; ++i) {
+                R[i] = std::min(std::max(lut_red[i] * tR + R[i] * (1 - tR), 0.0f), 255.0f);
+                G[i] = std::min(std::max(lut_green[i] * tG + G[i] * (1 - tG), 0.0f), 255.0f);
+                B[i] = std::min(std::max(lut_blue[i] * tB + B[i] * (1 - tB), 0.0f), 255.0f);
+            }
+        }
+    }
+};
 
-    auto image = frame->GetImage();
-    int w = image->width(), h = image->height();
-    unsigned char *pixels = image->bits();
+std::shared_ptr<ColorTransform>
+ColorMap::GetColorTransform(int64_t frame_number)
+{
+    // Reload LUT when its path changed (frames are rendered in parallel, so only one thread loads it)
+    {
+        const std::lock_guard<std::mutex> lock(lut_mutex);
+        if (needs_refresh)
+            load_cube_file();
+    }
 
     float overall = float(intensity.GetValue(frame_number));
     float tR = float(intensity_r.GetValue(frame_number)) * overall;
     float tG = float(intensity_g.GetValue(frame_number)) * overall;
     float tB = float(intensity_b.GetValue(frame_number)) * overall;
 
-    int pixel_count = w * h;
-    #pragma omp parallel for
-    for (int i = 0; i < pixel_count; ++i) {
-        int idx = i * 4;
-        int A = pixels[idx + 3];
-        float alpha = A / 255.0f;
-        if (alpha == 0.0f) continue;
-
-        // demultiply premultiplied RGBA
-        float R = pixels[idx + 0] / alpha;
-        float G = pixels[idx + 1] / alpha;
-        float B = pixels[idx + 2] / alpha;
-
-        // normalize to [0,1]
-        float Rn = R * (1.0f / 255.0f);
-        float Gn = G * (1.0f / 255.0f);
-        float Bn = B * (1.0f / 255.0f);
-
-        // map into LUT space [0 .. size-1]
-        float rf = Rn * (lut_size - 1);
-        float gf = Gn * (lut_size - 1);
-        float bf = Bn * (lut_size - 1);
-
-        int r0 = int(floor(rf)), r1 = std::min(r0 + 1, lut_size - 1);
-        int g0 = int(floor(gf)), g1 = std::min(g0 + 1, lut_size - 1);
-        int b0 = int(floor(bf)), b1 = std::min(b0 + 1, lut_size - 1);
-
-        float dr = rf - r0;
-        float dg = gf - g0;
-        float db = bf - b0;
-
-        // compute base offsets with red fastest, then green, then blue
-        int base000 = ((b0 * lut_size + g0) * lut_size + r0) * 3;
-        int base100 = ((b0 * lut_size + g0) * lut_size + r1) * 3;
-        int base010 = ((b0 * lut_size + g1) * lut_size + r0) * 3;
-        int base110 = ((b0 * lut_size + g1) * lut_size + r1) * 3;
-        int base001 = ((b1 * lut_size + g0) * lut_size + r0) * 3;
-        int base101 = ((b1 * lut_size + g0) * lut_size + r1) * 3;
-        int base011 = ((b1 * lut_size + g1) * lut_size + r0) * 3;
-        int base111 = ((b1 * lut_size + g1) * lut_size + r1) * 3;
-
-        // trilinear interpolation
-        // red
-        float c00 = lut_data[base000 + 0] * (1 - dr) + lut_data[base100 + 0] * dr;
-        float c01 = lut_data[base001 + 0] * (1 - dr) + lut_data[base101 + 0] * dr;
-        float c10 = lut_data[base010 + 0] * (1 - dr) + lut_data[base110 + 0] * dr;
-        float c11 = lut_data[base011 + 0] * (1 - dr) + lut_data[base111 + 0] * dr;
-        float c0  = c00 * (1 - dg) + c10 * dg;
-        float c1  = c01 * (1 - dg) + c11 * dg;
-        float lr = c0 * (1 - db) + c1 * db;
-
-        // green
-        c00 = lut_data[base000 + 1] * (1 - dr) + lut_data[base100 + 1] * dr;
-        c01 = lut_data[base001 + 1] * (1 - dr) + lut_data[base101 + 1] * dr;
-        c10 = lut_data[base010 + 1] * (1 - dr) + lut_data[base110 + 1] * dr;
-        c11 = lut_data[base011 + 1] * (1 - dr) + lut_data[base111 + 1] * dr;
-        c0  = c00 * (1 - dg) + c10 * dg;
-        c1  = c01 * (1 - dg) + c11 * dg;
-        float lg = c0 * (1 - db) + c1 * db;
-
-        // blue
-        c00 = lut_data[base000 + 2] * (1 - dr) + lut_data[base100 + 2] * dr;
-        c01 = lut_data[base001 + 2] * (1 - dr) + lut_data[base101 + 2] * dr;
-        c10 = lut_data[base010 + 2] * (1 - dr) + lut_data[base110 + 2] * dr;
-        c11 = lut_data[base011 + 2] * (1 - dr) + lut_data[base111 + 2] * dr;
-        c0  = c00 * (1 - dg) + c10 * dg;
-        c1  = c01 * (1 - dg) + c11 * dg;
-        float lb = c0 * (1 - db) + c1 * db;
+    return std::make_shared<ColorMapTransform>(std::atomic_load(&lut), tR, tG, tB);
+}
 
-        // blend per-channel, re-premultiply alpha
-        float outR = (lr * tR + Rn * (1 - tR)) * alpha;
-        float outG = (lg * tG + Gn * (1 - tG)) * alpha;
-        float outB = (lb * tB + Bn * (1 - tB)) * alpha;
+std::shared_ptr<openshot::Frame>
+ColorMap::GetFrame(std::shared_ptr<openshot::Frame> frame, int64_t frame_number)
+{
+    std::shared_ptr<ColorTransform> transform = GetColorTransform(frame_number);
 
-        pixels[idx + 0] = constrain(outR * 255.0f);
-        pixels[idx + 1] = constrain(outG * 255.0f);
-        pixels[idx + 2] = constrain(outB * 255.0f);
-        // alpha left unchanged
-    }
+    // Without a LUT, leave the frame untouched
+    if (!std::atomic_load(&lut))
+        return frame;
 
+    ColorPipeline::Apply(*frame->GetImage(), {transform});
     return frame;
 }
 
@@ -263,6 +172,7 @@ void ColorMap::SetJsonValue(const Json::Value root)
     EffectBase::SetJsonValue(root);
     if (!root["lut_path"].isNull())
     {
+        const std::lock_guard<std::mutex> lock(lut_mutex);
         lut_path = root["lut_path"].asString();
         needs_refresh = true;
     }
@@ -13,12 +13,15 @@
 #ifndef OPENSHOT_COLORMAP_EFFECT_H
 #define OPENSHOT_COLORMAP_EFFECT_H
 
+#include "../ColorLut.h"
 #include "../EffectBase.h"
 #include "../Json.h"
 #include "../KeyFrame.h"
 #include <QString>
 #include <QFile>
 #include <QTextStream>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
 
@@ -28,21 +31,22 @@ namespace openshot
     /**
      * @brief Applies a 3D LUT (.cube) color transform to each frame.
      *
-     * Loads a .cube file (LUT_3D_SIZE N × N × N) into memory, then for each pixel
-     * uses nearest‐neighbor lookup and blends the result by keyframable per‐channel intensities.
+     * Loads a .cube file (LUT_3D_SIZE N × N × N) into memory (shared by every effect using the
+     * same file, see openshot::ColorLut), then for each pixel uses tetrahedral interpolation
+     * and blends the result by keyframable per‐channel intensities.
      */
     class ColorMap : public EffectBase
     {
     private:
         std::string lut_path;             ///< Filesystem path to .cube LUT file
-        int lut_size;                     ///< Dimension N of the cube (LUT_3D_SIZE)
-        std::vector<float> lut_data;      ///< Flat array [N³ × 3] RGB lookup table
+        std::shared_ptr<const ColorLut> lut; ///< Lookup table of the .cube file (nullptr if not loaded)
         bool needs_refresh;               ///< Reload LUT on next frame
+        std::mutex lut_mutex;             ///< Guards lut_path and needs_refresh (frames are rendered in parallel)
 
         /// Populate info fields (class_name, name, description)
         void init_effect_details();
 
-        /// Parse the .cube file into lut_size & lut_data
+        /// Load the .cube file into lut (parsing it only if it's not cached)
         void load_cube_file();
 
     public:
@@ -79,6 +83,10 @@ namespace openshot
         GetFrame(std::shared_ptr<openshot::Frame> frame,
                  int64_t frame_number) override;
 
+        /// Get the color transform of this effect (adjacent color effects are fused into a single pass)
+        std::shared_ptr<openshot::ColorTransform>
+        GetColorTransform(int64_t frame_number) override;
+
         // JSON serialization
         std::string Json() const override;
         Json::Value JsonValue() const override;
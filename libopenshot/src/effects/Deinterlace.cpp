@@ -54,7 +54,7 @@ std::shared_ptr<openshot::Frame> Deinterlace::GetFrame(std::shared_ptr<openshot:
 
 	// Access the current QImage and its raw pixel data
 	auto image           = frame->GetImage();
-	const unsigned char* pixels = image->bits();
+	const unsigned char* pixels = image->constBits();
 	int line_bytes       = image->bytesPerLine();
 
 	// Decide whether to copy even lines (start = 0) or odd lines (start = 1)
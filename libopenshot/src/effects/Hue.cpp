@@ -12,6 +12,10 @@
 
 #include "Hue.h"
 #include "Exceptions.h"
+#include "ColorPipeline.h"
+
+#include <iomanip>
+#include <sstream>
 
 using namespace openshot;
 
@@ -42,52 +46,55 @@ void Hue::init_effect_details()
 	info.has_video = true;
 }
 
-// This method is required for all derived classes of EffectBase, and returns a
-// modified openshot::Frame object
-std::shared_ptr<openshot::Frame> Hue::GetFrame(std::shared_ptr<openshot::Frame> frame, int64_t frame_number)
-{
-	// Get the frame's image
-	std::shared_ptr<QImage> frame_image = frame->GetImage();
-
-	int pixel_count = frame_image->width() * frame_image->height();
-
-	// Get the current hue percentage shift amount, and convert to degrees
-	double degrees = 360.0 * hue.GetValue(frame_number);
-	float cosA = cos(degrees*3.14159265f/180);
-	float sinA = sin(degrees*3.14159265f/180);
-
-	// Calculate a rotation matrix for the RGB colorspace (based on the current hue shift keyframe value)
-	float matrix[3] = {
-		cosA + (1.0f - cosA) / 3.0f,
-		1.0f/3.0f * (1.0f - cosA) - sqrtf(1.0f/3.0f) * sinA,
-		1.0f/3.0f * (1.0f - cosA) + sqrtf(1.0f/3.0f) * sinA
-	};
-
-	// Loop through pixels
-	unsigned char *pixels = (unsigned char *) frame_image->bits();
-
-	#pragma omp parallel for shared (pixels)
-	for (int pixel = 0; pixel < pixel_count; ++pixel)
-	{
-		// Calculate alpha % (to be used for removing pre-multiplied alpha value)
-		int A = pixels[pixel * 4 + 3];
-		float alpha_percent = A / 255.0;
+// Rotates the hue of each pixel
+class HueTransform : public ColorTransform {
+private:
+	float matrix[9];
+	double degrees;
+
+public:
+	HueTransform(double degrees) : degrees(degrees) {
+		float cosA = cos(degrees*3.14159265f/180);
+		float sinA = sin(degrees*3.14159265f/180);
+
+		// Calculate a rotation matrix for the RGB colorspace (based on the current hue shift keyframe value)
+		float rotation[3] = {
+			cosA + (1.0f - cosA) / 3.0f,
+			1.0f/3.0f * (1.0f - cosA) - sqrtf(1.0f/3.0f) * sinA,
+			1.0f/3.0f * (1.0f - cosA) + sqrtf(1.0f/3.0f) * sinA
+		};
+
+		// Each channel uses the same coefficients, in a rotated order
+		for (int row = 0; row < 3; ++row)
+			for (int column = 0; column < 3; ++column)
+				matrix[row * 3 + column] = rotation[(column - row + 3) % 3];
+	}
 
-		// Get RGB values, and remove pre-multiplied alpha
-		int R = pixels[pixel * 4 + 0] / alpha_percent;
-		int G = pixels[pixel * 4 + 1] / alpha_percent;
-		int B = pixels[pixel * 4 + 2] / alpha_percent;
+	std::string Key() const override {
+		std::stringstream key;
+		key << std::setprecision(17) << "Hue:" << degrees;
+		return key.str();
+	}
 
+	void TransformRow(float* red, float* green, float* blue, int pixels) const override {
 		// Multiply each color by the hue rotation matrix
-		pixels[pixel * 4] = constrain(R * matrix[0] + G * matrix[1] + B * matrix[2]);
-		pixels[pixel * 4 + 1] = constrain(R * matrix[2] + G * matrix[0] + B * matrix[1]);
-		pixels[pixel * 4 + 2] = constrain(R * matrix[1] + G * matrix[2] + B * matrix[0]);
-
-		// Pre-multiply the alpha back into the color channels
-		pixels[pixel * 4 + 0] *= alpha_percent;
-		pixels[pixel * 4 + 1] *= alpha_percent;
-		pixels[pixel * 4 + 2] *= alpha_percent;
+		MatrixRow(red, green, blue, pixels, matrix);
 	}
+};
+
+// Get the color transform of this effect (for a specific frame)
+std::shared_ptr<ColorTransform> Hue::GetColorTransform(int64_t frame_number)
+{
+	// Get the current hue percentage shift amount, and convert to degrees
+	return std::make_shared<HueTransform>(360.0 * hue.GetValue(frame_number));
+}
+
+// This method is required for all derived classes of EffectBase, and returns a
+// modified openshot::Frame object
+std::shared_ptr<openshot::Frame> Hue::GetFrame(std::shared_ptr<openshot::Frame> frame, int64_t frame_number)
+{
+	// Adjust the pixels of the frame's image
+	ColorPipeline::Apply(*frame->GetImage(), {GetColorTransform(frame_number)});
 
 	// return the modified frame
 	return frame;
@@ -39,6 +39,7 @@
 #include <cmath>
 #include <vector>
 #include <algorithm>
+#include <mutex>
 #include <omp.h>
 
 using namespace openshot;
@@ -87,6 +88,12 @@ struct Reflect {
     int type; // 1..4
 };
 
+// A reflector which reaches a row, and the columns it reaches
+struct RowReflector {
+    const Reflect *ref;
+    float x_min, x_max;
+};
+
 // Blend a color onto a pixel using additive blending
 static inline QRgb blendAdd(QRgb dst, const QColor &c, float p)
 {
@@ -213,36 +220,10 @@ static void apply_reflector(QRgb &pxl, const Reflect &r, int cx, int cy)
     }
 }
 
-// Render lens flare onto the frame
-std::shared_ptr<openshot::Frame>
-LensFlare::GetFrame(std::shared_ptr<openshot::Frame> frame, int64_t f)
+// Render the flare (without the brightness) onto a transparent, un-premultiplied overlay
+static QImage render_overlay(int w, int h, float px, float py, float DX, float DY,
+                             float S, const QColor &tint)
 {
-    auto img = frame->GetImage();
-    int w = img->width();
-    int h = img->height();
-
-    // Fetch keyframe values
-    float X  = x.GetValue(f),
-          Y  = y.GetValue(f),
-          I  = brightness.GetValue(f),
-          S  = size.GetValue(f),
-          SP = spread.GetValue(f);
-
-    // Compute lens center + spread
-    float halfW = w * 0.5f, halfH = h * 0.5f;
-    float px    = (X * 0.5f + 0.5f) * w;
-    float py    = (Y * 0.5f + 0.5f) * h;
-    float DX    = (halfW - px) * SP;
-    float DY    = (halfH - py) * SP;
-
-    // Tint color
-    QColor tint = QColor::fromRgbF(
-        color.red.GetValue(f)   / 255.0f,
-        color.green.GetValue(f) / 255.0f,
-        color.blue.GetValue(f)  / 255.0f,
-        color.alpha.GetValue(f) / 255.0f
-    );
-
     // Calculate radii for rings
     float matt   = w;
     float scolor = matt * 0.0375f * S;
@@ -275,9 +256,25 @@ LensFlare::GetFrame(std::shared_ptr<openshot::Frame> frame, int64_t f)
     QImage overlay(w, h, QImage::Format_ARGB32);
     overlay.fill(Qt::transparent);
 
-    #pragma omp parallel for schedule(dynamic)
+    #pragma omp parallel for schedule(dynamic, 16)
     for (int yy = 0; yy < h; ++yy) {
         QRgb *scan = reinterpret_cast<QRgb*>(overlay.scanLine(yy));
+
+        // Reflectors which reach this row (and the columns they reach)
+        std::vector<RowReflector> row_refs;
+        for (auto &rf : refs) {
+            float reach = rf.size * 1.04f + 1.0f;
+            float dy = std::abs(rf.yp - yy);
+            if (!(rf.size > 0.0f)) {
+                // Reflectors without a positive size can reach any pixel
+                row_refs.push_back({&rf, -INFINITY, INFINITY});
+            }
+            else if (dy < reach) {
+                float dx = std::sqrt(reach * reach - dy * dy);
+                row_refs.push_back({&rf, rf.xp - dx, rf.xp + dx});
+            }
+        }
+
         for (int xx = 0; xx < w; ++xx) {
             // start fully transparent
             int r=0, g=0, b=0;
@@ -316,9 +313,11 @@ LensFlare::GetFrame(std::shared_ptr<openshot::Frame> frame, int64_t f)
                 }
             }
             // little reflectors
-            for (auto &rf : refs) {
+            for (auto &rr : row_refs) {
+                if (xx < rr.x_min || xx > rr.x_max)
+                    continue;
                 QRgb tmp = qRgba(r,g,b,0);
-                apply_reflector(tmp, rf, xx, yy);
+                apply_reflector(tmp, *rr.ref, xx, yy);
                 r = qRed(tmp); g = qGreen(tmp); b = qBlue(tmp);
             }
 
@@ -328,6 +327,56 @@ LensFlare::GetFrame(std::shared_ptr<openshot::Frame> frame, int64_t f)
         }
     }
 
+    return overlay;
+}
+
+// Render lens flare onto the frame
+std::shared_ptr<openshot::Frame>
+LensFlare::GetFrame(std::shared_ptr<openshot::Frame> frame, int64_t f)
+{
+    auto img = frame->GetImage();
+    int w = img->width();
+    int h = img->height();
+
+    // Fetch keyframe values
+    float X  = x.GetValue(f),
+          Y  = y.GetValue(f),
+          I  = brightness.GetValue(f),
+          S  = size.GetValue(f),
+          SP = spread.GetValue(f);
+
+    // Compute lens center + spread
+    float halfW = w * 0.5f, halfH = h * 0.5f;
+    float px    = (X * 0.5f + 0.5f) * w;
+    float py    = (Y * 0.5f + 0.5f) * h;
+    float DX    = (halfW - px) * SP;
+    float DY    = (halfH - py) * SP;
+
+    // Tint color
+    QColor tint = QColor::fromRgbF(
+        color.red.GetValue(f)   / 255.0f,
+        color.green.GetValue(f) / 255.0f,
+        color.blue.GetValue(f)  / 255.0f,
+        color.alpha.GetValue(f) / 255.0f
+    );
+
+    // Reuse the overlay, unless the frame size or any flare parameter changed
+    std::vector<double> key = { double(w), double(h), X, Y, S, SP,
+                                tint.redF(), tint.greenF(), tint.blueF(), tint.alphaF() };
+    QImage overlay;
+    {
+        const std::lock_guard<std::mutex> lock(overlay_mutex);
+        if (overlay_key == key)
+            overlay = cached_overlay;
+    }
+    if (overlay.isNull()) {
+        overlay = render_overlay(w, h, px, py, DX, DY, S, tint);
+
+        const std::lock_guard<std::mutex> lock(overlay_mutex);
+        cached_overlay = overlay;
+        overlay_key = key;
+    }
+
     // Get original alpha
     QImage origAlpha = img->convertToFormat(QImage::Format_Alpha8);
 
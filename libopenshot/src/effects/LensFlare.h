@@ -18,6 +18,8 @@
 #include "../Color.h"
 #include <QImage>
 #include <QColor>
+#include <mutex>
+#include <vector>
 
 namespace openshot
 {
@@ -26,6 +28,10 @@ namespace openshot
     private:
         void init_effect_details();
 
+        QImage cached_overlay;              ///< Flare overlay (for the last frame size and parameters)
+        std::vector<double> overlay_key;    ///< Frame size and parameters of the cached overlay
+        std::mutex overlay_mutex;           ///< Guards the cached overlay (frames are rendered in parallel)
+
     public:
         Keyframe x;
         Keyframe y;
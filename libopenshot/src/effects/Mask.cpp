@@ -94,7 +94,7 @@ std::shared_ptr<openshot::Frame> Mask::GetFrame(std::shared_ptr<openshot::Frame>
 
 	// Grab raw pointers and dimensions one time
 	unsigned char* pixels      = reinterpret_cast<unsigned char*>(frame_image->bits());
-	unsigned char* mask_pixels = reinterpret_cast<unsigned char*>(original_mask->bits());
+	const unsigned char* mask_pixels = original_mask->constBits();
 	int width                   = original_mask->width();
 	int height                  = original_mask->height();
 	int num_pixels              = width * height;  // total pixel count
@@ -12,6 +12,7 @@
 
 #include "Negate.h"
 #include "Exceptions.h"
+#include "ColorPipeline.h"
 
 using namespace openshot;
 
@@ -29,6 +30,26 @@ Negate::Negate()
 	info.has_video = true;
 }
 
+// Inverts the color of each pixel
+class NegateTransform : public ColorTransform {
+public:
+	std::string Key() const override { return "Negate"; }
+
+	void TransformRow(float* red, float* green, float* blue, int pixels) const override {
+		for (int pixel = 0; pixel < pixels; ++pixel) {
+			red[pixel] = 255.0f - red[pixel];
+			green[pixel] = 255.0f - green[pixel];
+			blue[pixel] = 255.0f - blue[pixel];
+		}
+	}
+};
+
+// Get the color transform of this effect (only used when fused with other color effects)
+std::shared_ptr<ColorTransform> Negate::GetColorTransform(int64_t frame_number)
+{
+	return std::make_shared<NegateTransform>();
+}
+
 // This method is required for all derived classes of EffectBase, and returns a
 // modified openshot::Frame object
 std::shared_ptr<openshot::Frame> Negate::GetFrame(std::shared_ptr<openshot::Frame> frame, int64_t frame_number)
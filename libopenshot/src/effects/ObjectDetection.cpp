@@ -11,11 +11,13 @@
 //
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
 #include "effects/ObjectDetection.h"
 #include "effects/Tracker.h"
+#include "DataFileCache.h"
 #include "Exceptions.h"
 #include "Timeline.h"
 #include "objdetectdata.pb.h"
@@ -83,8 +85,9 @@ std::shared_ptr<Frame> ObjectDetection::GetFrame(std::shared_ptr<Frame> frame, i
     QPainter painter(frame_image.get());
     painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform);
 
-    if (detectionsData.find(frame_number) != detectionsData.end()) {
-        DetectionData detections = detectionsData[frame_number];
+    const DetectionData* frameDetections = detectionsData ? detectionsData->Detections(frame_number) : nullptr;
+    if (frameDetections) {
+        const DetectionData& detections = *frameDetections;
         for (int i = 0; i < detections.boxes.size(); i++) {
             if (detections.confidences.at(i) < confidence_threshold ||
                 (!display_classes.empty() &&
@@ -166,65 +169,114 @@ std::shared_ptr<Frame> ObjectDetection::GetFrame(std::shared_ptr<Frame> frame, i
     return frame;
 }
 
-// Load protobuf data file
-bool ObjectDetection::LoadObjDetectdData(std::string inputFilePath){
+// Parse a protobuf data file into the detections of each frame
+static bool ParseObjDetectData(const std::string& inputFilePath, ObjectDetectionData& data){
 	// Create tracker message
 	pb_objdetect::ObjDetect objMessage;
 
 	// Read the existing tracker message.
 	std::fstream input(inputFilePath, std::ios::in | std::ios::binary);
 	if (!objMessage.ParseFromIstream(&input)) {
-		std::cerr << "Failed to parse protobuf message." << std::endl;
 		return false;
 	}
 
-	// Make sure classNames, detectionsData and trackedObjects are empty
-	classNames.clear();
-	detectionsData.clear();
-	trackedObjects.clear();
-
 	// Seed to generate same random numbers
 	std::srand(1);
 	// Get all classes names and assign a color to them
 	for(int i = 0; i < objMessage.classnames_size(); i++)
 	{
-		classNames.push_back(objMessage.classnames(i));
-		classesColor.push_back(cv::Scalar(std::rand()%205 + 50, std::rand()%205 + 50, std::rand()%205 + 50));
+		data.classNames.push_back(objMessage.classnames(i));
+		data.classesColor.push_back(cv::Scalar(std::rand()%205 + 50, std::rand()%205 + 50, std::rand()%205 + 50));
 	}
 
-	// Iterate over all frames of the saved message
-	for (size_t i = 0; i < objMessage.frame_size(); i++)
+	// Index the detections by frame number, in the range of frames (or by the sorted frame numbers, if they
+	// are sparse, so a file with corrupt frame numbers can't allocate a huge range)
+	std::vector<int64_t> frame_numbers;
+	frame_numbers.reserve(objMessage.frame_size());
+	for (const pb_objdetect::Frame& pbFrameData : objMessage.frame())
+		frame_numbers.push_back(pbFrameData.id());
+	std::sort(frame_numbers.begin(), frame_numbers.end());
+	frame_numbers.erase(std::unique(frame_numbers.begin(), frame_numbers.end()), frame_numbers.end());
+	if (!frame_numbers.empty())
 	{
-		// Create protobuf message reader
-		const pb_objdetect::Frame& pbFrameData = objMessage.frame(i);
+		data.first_frame = frame_numbers.front();
+		int64_t frames = frame_numbers.back() - frame_numbers.front() + 1;
+		if (frames > 4 * (int64_t) frame_numbers.size())
+		{
+			frames = frame_numbers.size();
+			data.frame_numbers = frame_numbers;
+		}
+		data.detections.resize(frames);
+		data.has_detections.resize(frames, false);
+	}
 
+	// Iterate over all frames of the saved message
+	for (const pb_objdetect::Frame& pbFrameData : objMessage.frame())
+	{
 		// Get frame Id
 		size_t id = pbFrameData.id();
-
-		// Load bounding box data
-		const google::protobuf::RepeatedPtrField<pb_objdetect::Frame_Box > &pBox = pbFrameData.bounding_box();
+		int64_t index = data.Index(pbFrameData.id());
 
 		// Construct data vectors related to detections in the current frame
-		std::vector<int> classIds;
-		std::vector<float> confidences;
-		std::vector<cv::Rect_<float>> boxes;
-		std::vector<int> objectIds;
+		DetectionData& detections = data.detections[index];
+		detections = DetectionData();
+		detections.frameId = id;
+		detections.classIds.reserve(pbFrameData.bounding_box_size());
+		detections.confidences.reserve(pbFrameData.bounding_box_size());
+		detections.boxes.reserve(pbFrameData.bounding_box_size());
+		detections.objectIds.reserve(pbFrameData.bounding_box_size());
 
 		// Iterate through the detected objects
-		for(int i = 0; i < pbFrameData.bounding_box_size(); i++)
+		for (const pb_objdetect::Frame_Box& pbBox : pbFrameData.bounding_box())
+		{
+			// Push back bounding box, class Id, prediction confidence and object Id
+			detections.boxes.push_back(cv::Rect_<float>(pbBox.x(), pbBox.y(), pbBox.w(), pbBox.h()));
+			detections.classIds.push_back(pbBox.classid());
+			detections.confidences.push_back(pbBox.confidence());
+			detections.objectIds.push_back(pbBox.objectid());
+		}
+		data.has_detections[index] = true;
+	}
+
+	return true;
+}
+
+// Load protobuf data file
+bool ObjectDetection::LoadObjDetectdData(std::string inputFilePath){
+	// Files are parsed once, and shared by every effect which loads the same file
+	std::shared_ptr<const ObjectDetectionData> data = DataFileCache<ObjectDetectionData>::Load(inputFilePath, ParseObjDetectData);
+	if (!data) {
+		std::cerr << "Failed to parse protobuf message." << std::endl;
+		return false;
+	}
+
+	// Replace the classNames, detectionsData and trackedObjects
+	detectionsData = data;
+	classNames = data->classNames;
+	classesColor = data->classesColor;
+	trackedObjects.clear();
+
+	// Iterate over all frames with detections
+	for (size_t index = 0; index < data->detections.size(); index++)
+	{
+		if (!data->has_detections[index])
+			continue;
+		const DetectionData& detections = data->detections[index];
+		size_t id = detections.frameId;
+
+		// Iterate through the detected objects
+		for (size_t i = 0; i < detections.boxes.size(); i++)
 		{
 			// Get bounding box coordinates
-			float x = pBox.Get(i).x();
-			float y = pBox.Get(i).y();
-			float w = pBox.Get(i).w();
-			float h = pBox.Get(i).h();
+			float x = detections.boxes[i].x;
+			float y = detections.boxes[i].y;
+			float w = detections.boxes[i].width;
+			float h = detections.boxes[i].height;
 			// Get class Id (which will be assign to a class name)
-			int classId = pBox.Get(i).classid();
-			// Get prediction confidence
-			float confidence = pBox.Get(i).confidence();
+			int classId = detections.classIds[i];
 
 			// Get the object Id
-			int objectId = pBox.Get(i).objectid();
+			int objectId = detections.objectIds[i];
 
 			// Search for the object id on trackedObjects map
 			auto trackedObject = trackedObjects.find(objectId);
@@ -250,24 +302,9 @@ bool ObjectDetection::LoadObjDetectdData(std::string inputFilePath){
 				trackedObjPtr->Id(std::to_string(objectId));
 				trackedObjects.insert({objectId, trackedObjPtr});
 			}
-
-			// Create OpenCV rectangle with the bouding box info
-			cv::Rect_<float> box(x, y, w, h);
-
-			// Push back data into vectors
-			boxes.push_back(box);
-			classIds.push_back(classId);
-			confidences.push_back(confidence);
-			objectIds.push_back(objectId);
 		}
-
-		// Assign data to object detector map
-		detectionsData[id] = DetectionData(classIds, confidences, boxes, id, objectIds);
 	}
 
-	// Delete all global objects allocated by libprotobuf.
-	google::protobuf::ShutdownProtobufLibrary();
-
 	return true;
 }
 
@@ -281,10 +318,11 @@ std::string ObjectDetection::GetVisibleObjects(int64_t frame_number) const{
     root["visible_class_names"] = Json::Value(Json::arrayValue);
 
 	// Check if track data exists for the requested frame
-	if (detectionsData.find(frame_number) == detectionsData.end()){
+	const DetectionData* frameDetections = detectionsData ? detectionsData->Detections(frame_number) : nullptr;
+	if (!frameDetections){
 		return root.toStyledString();
 	}
-	DetectionData detections = detectionsData.at(frame_number);
+	const DetectionData& detections = *frameDetections;
 
 	// Iterate through the tracked objects
 	for(int i = 0; i<detections.boxes.size(); i++){
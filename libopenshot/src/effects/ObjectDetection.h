@@ -16,7 +16,10 @@
 
 #include "EffectBase.h"
 
+#include <algorithm>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "OpenCVUtilities.h"
 
@@ -51,6 +54,33 @@ namespace openshot
     // Forward decls
     class Frame;
 
+    /// The detections of a clip, which are shared by every effect that loads the same file
+    struct ObjectDetectionData
+    {
+        std::vector<std::string> classNames; ///< Name of each class
+        std::vector<cv::Scalar> classesColor; ///< Color of each class
+        int64_t first_frame = 0; ///< The frame number of the first detections
+        std::vector<int64_t> frame_numbers; ///< Sorted frame numbers of the detections (only if they are sparse)
+        std::vector<DetectionData> detections; ///< Detections of each frame (from first_frame, or in the order of frame_numbers)
+        std::vector<bool> has_detections; ///< The frame has detections (from first_frame, or in the order of frame_numbers)
+
+        /// Get the index of a frame in detections (or -1, if the frame is not indexed)
+        int64_t Index(int64_t frame_number) const {
+            int64_t index = frame_number - first_frame;
+            if (!frame_numbers.empty()) {
+                auto found = std::lower_bound(frame_numbers.begin(), frame_numbers.end(), frame_number);
+                index = (found != frame_numbers.end() && *found == frame_number) ? found - frame_numbers.begin() : -1;
+            }
+            return (index >= 0 && index < (int64_t) detections.size()) ? index : -1;
+        }
+
+        /// Get the detections of a frame (or nullptr, if the frame has no detections)
+        const DetectionData* Detections(int64_t frame_number) const {
+            int64_t index = Index(frame_number);
+            return (index < 0 || !has_detections[index]) ? nullptr : &detections[index];
+        }
+    };
+
     /**
      * @brief This effect displays all the detected objects on a clip.
      */
@@ -58,7 +88,7 @@ namespace openshot
     {
     private:
         std::string protobuf_data_path;
-        std::map<size_t, DetectionData> detectionsData;
+        std::shared_ptr<const ObjectDetectionData> detectionsData;
         std::vector<std::string> classNames;
         std::vector<cv::Scalar> classesColor;
 
@@ -11,6 +11,7 @@
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
 #include "Outline.h"
+#include "BoxBlur.h"
 #include "Exceptions.h"
 
 using namespace openshot;
@@ -44,6 +45,16 @@ void Outline::init_effect_details()
 	info.has_video = true;
 }
 
+// Blur a mask with 3 box blurs, which reach as far as a Gaussian kernel of OpenCV, and reflect the mask at
+// its edges (as the default border of OpenCV does). So the outline is as wide as with cv::GaussianBlur, but
+// the weights of the box blurs only approximate a Gaussian, so the pixels at the edge of the outline (and its
+// antialiasing) can differ.
+static void blur_mask(cv::Mat& mask, double sigma)
+{
+	std::vector<int> radii = BoxBlur::KernelRadii(sigma);
+	BoxBlur::Blur(mask.data, mask.cols, mask.rows, mask.step, 1, radii, radii, BoxBlur::EDGE_REFLECT);
+}
+
 // This method is required for all derived classes of EffectBase, and returns a
 // modified openshot::Frame object
 std::shared_ptr<openshot::Frame> Outline::GetFrame(std::shared_ptr<openshot::Frame> frame, int64_t frame_number)
@@ -68,13 +79,12 @@ std::shared_ptr<openshot::Frame> Outline::GetFrame(std::shared_ptr<openshot::Fra
 	cv::Mat cv_image = QImageToBGRACvMat(frame_image);
 
 	// Extract alpha channel for the mask
-	std::vector<cv::Mat> channels(4);
-	cv::split(cv_image, channels);
-	cv::Mat alpha_mask = channels[3].clone();
+	cv::Mat alpha_mask;
+	cv::extractChannel(cv_image, alpha_mask, 3);
 
 	// Create the outline mask
-	cv::Mat outline_mask;
-	cv::GaussianBlur(alpha_mask, outline_mask, cv::Size(0, 0), sigmaValue, sigmaValue, cv::BorderTypes::BORDER_DEFAULT);
+	cv::Mat outline_mask = alpha_mask.clone();
+	blur_mask(outline_mask, sigmaValue);
 	cv::threshold(outline_mask, outline_mask, 0, 255, cv::ThresholdTypes::THRESH_BINARY);
 
 	// Antialias the outline edge & apply Canny edge detection
@@ -82,8 +92,8 @@ std::shared_ptr<openshot::Frame> Outline::GetFrame(std::shared_ptr<openshot::Fra
 	cv::Canny(outline_mask, edge_mask, 250, 255);
 
 	// Apply Gaussian blur only to the edge mask
-	cv::Mat blurred_edge_mask;
-	cv::GaussianBlur(edge_mask, blurred_edge_mask, cv::Size(0, 0), 0.8, 0.8, cv::BorderTypes::BORDER_DEFAULT);
+	cv::Mat blurred_edge_mask = edge_mask.clone();
+	blur_mask(blurred_edge_mask, 0.8);
 	cv::bitwise_or(outline_mask, blurred_edge_mask, outline_mask);
 
 	cv::Mat final_image;
@@ -12,6 +12,10 @@
 
 #include "Saturation.h"
 #include "Exceptions.h"
+#include "ColorPipeline.h"
+
+#include <iomanip>
+#include <sstream>
 
 using namespace openshot;
 
@@ -43,6 +47,40 @@ void Saturation::init_effect_details()
 	info.has_video = true;
 }
 
+// Adjusts the saturation of each pixel (overall, and for each color channel)
+class SaturationTransform : public ColorTransform {
+private:
+	float saturation_value;
+	float saturation_value_R;
+	float saturation_value_G;
+	float saturation_value_B;
+
+public:
+	SaturationTransform(float saturation_value, float saturation_value_R, float saturation_value_G, float saturation_value_B) :
+		saturation_value(saturation_value), saturation_value_R(saturation_value_R),
+		saturation_value_G(saturation_value_G), saturation_value_B(saturation_value_B) { }
+
+	std::string Key() const override {
+		std::stringstream key;
+		key << std::setprecision(9) << "Saturation:" << saturation_value << ":" << saturation_value_R
+			<< ":" << saturation_value_G << ":" << saturation_value_B;
+		return key.str();
+	}
+
+	void TransformRow(float* red, float* green, float* blue, int pixels) const override {
+		const double values[4] = {saturation_value, saturation_value_R, saturation_value_G, saturation_value_B};
+		SaturateRow(red, green, blue, pixels, values);
+	}
+};
+
+// Get the color transform of this effect (for a specific frame)
+std::shared_ptr<ColorTransform> Saturation::GetColorTransform(int64_t frame_number)
+{
+	// Get keyframe values for this frame
+	return std::make_shared<SaturationTransform>(saturation.GetValue(frame_number), saturation_R.GetValue(frame_number),
+		saturation_G.GetValue(frame_number), saturation_B.GetValue(frame_number));
+}
+
 // This method is required for all derived classes of EffectBase, and returns a
 // modified openshot::Frame object
 std::shared_ptr<openshot::Frame> Saturation::GetFrame(std::shared_ptr<openshot::Frame> frame, int64_t frame_number)
@@ -53,95 +91,8 @@ std::shared_ptr<openshot::Frame> Saturation::GetFrame(std::shared_ptr<openshot::
 	if (!frame_image)
 		return frame;
 
-	int pixel_count = frame_image->width() * frame_image->height();
-
-	// Get keyframe values for this frame
-	float saturation_value = saturation.GetValue(frame_number);
-	float saturation_value_R = saturation_R.GetValue(frame_number);
-	float saturation_value_G = saturation_G.GetValue(frame_number);
-	float saturation_value_B = saturation_B.GetValue(frame_number);
-
-	// Constants used for color saturation formula
-	const double pR = .299;
-	const double pG = .587;
-	const double pB = .114;
-
-	// Loop through pixels
-	unsigned char *pixels = (unsigned char *) frame_image->bits();
-
-	#pragma omp parallel for shared (pixels)
-	for (int pixel = 0; pixel < pixel_count; ++pixel)
-	{
-		// Calculate alpha % (to be used for removing pre-multiplied alpha value)
-		int A = pixels[pixel * 4 + 3];
-		float alpha_percent = A / 255.0;
-
-		// Get RGB values, and remove pre-multiplied alpha
-		int R = pixels[pixel * 4 + 0] / alpha_percent;
-		int G = pixels[pixel * 4 + 1] / alpha_percent;
-		int B = pixels[pixel * 4 + 2] / alpha_percent;
-
-		/*
-		 * Common saturation adjustment
-		 */
-
-		// Calculate the saturation multiplier
-		double p = sqrt( (R * R * pR) +
-						 (G * G * pG) +
-						 (B * B * pB) );
-
-		// Adjust the saturation
-		R = constrain(p + (R - p) * saturation_value);
-		G = constrain(p + (G - p) * saturation_value);
-		B = constrain(p + (B - p) * saturation_value);
-
-		/*
-		 * Color-separated saturation adjustment
-		 *
-		 * Splitting each of the three subpixels (R, G and B) into three distincs sub-subpixels (R, G and B in turn)
-		 * which in their optical sum reproduce the original subpixel's color OR produce white light in the brightness
-		 * of the original subpixel (dependening on the color channel's slider value).
-		 */
-
-		// Compute the brightness ("saturation multiplier") of the replaced subpixels
-		// Actually mathematical no-ops mostly, verbosity is kept just for clarification
-		const double p_r = sqrt(R * R * pR);
-		const double p_g = sqrt(G * G * pG);
-		const double p_b = sqrt(B * B * pB);
-
-		// Adjust the saturation
-		const int Rr = p_r + (R - p_r) * saturation_value_R;
-		const int Gr = p_r + (0 - p_r) * saturation_value_R;
-		const int Br = p_r + (0 - p_r) * saturation_value_R;
-
-		const int Rg = p_g + (0 - p_g) * saturation_value_G;
-		const int Gg = p_g + (G - p_g) * saturation_value_G;
-		const int Bg = p_g + (0 - p_g) * saturation_value_G;
-
-		const int Rb = p_b + (0 - p_b) * saturation_value_B;
-		const int Gb = p_b + (0 - p_b) * saturation_value_B;
-		const int Bb = p_b + (B - p_b) * saturation_value_B;
-
-		// Recombine brightness of sub-subpixels (Rx, Gx and Bx) into sub-pixels (R, G and B) again
-		R = Rr + Rg + Rb;
-		G = Gr + Gg + Gb;
-		B = Br + Bg + Bb;
-
-		// Constrain the value from 0 to 255
-		R = constrain(R);
-		G = constrain(G);
-		B = constrain(B);
-
-		// Set all pixels to new value
-		pixels[pixel * 4 + 0] = R;
-		pixels[pixel * 4 + 1] = G;
-		pixels[pixel * 4 + 2] = B;
-
-		// Pre-multiply the alpha back into the color channels
-		pixels[pixel * 4 + 0] *= alpha_percent;
-		pixels[pixel * 4 + 1] *= alpha_percent;
-		pixels[pixel * 4 + 2] *= alpha_percent;
-	}
+	// Adjust the pixels of the frame's image
+	ColorPipeline::Apply(*frame_image, {GetColorTransform(frame_number)});
 
 	// return the modified frame
 	return frame;
@@ -12,10 +12,10 @@
 
 
 #include "Sharpen.h"
+#include "BoxBlur.h"
 #include "Exceptions.h"
 #include <algorithm>
 #include <cmath>
-#include <vector>
 #include <omp.h>
 
 using namespace openshot;
@@ -53,143 +53,6 @@ void Sharpen::init_effect_details()
   info.has_video   = true;
 }
 
-// Compute three box sizes to approximate a Gaussian of sigma
-static void boxes_for_gauss(double sigma, int b[3])
-{
-  const int n = 3;
-  double wi = std::sqrt((12.0 * sigma * sigma / n) + 1.0);
-  int wl = int(std::floor(wi));
-  if (!(wl & 1)) --wl;
-  int wu = wl + 2;
-  double mi = (12.0 * sigma * sigma - n*wl*wl - 4.0*n*wl - 3.0*n)
-              / (-4.0*wl - 4.0);
-  int m = int(std::round(mi));
-  for (int i = 0; i < n; ++i)
-    b[i] = i < m ? wl : wu;
-}
-
-// Blur one axis with an edge-replicate sliding window
-static void blur_axis(const QImage& src, QImage& dst, int r, bool vertical)
-{
-  if (r <= 0) {
-    dst = src.copy();
-    return;
-  }
-
-  int W   = src.width();
-  int H   = src.height();
-  int bpl = src.bytesPerLine();
-  const uchar* in  = src.bits();
-  uchar*       out = dst.bits();
-  int window = 2*r + 1;
-
-  if (!vertical) {
-    #pragma omp parallel for
-    for (int y = 0; y < H; ++y) {
-      const uchar* rowIn  = in  + y*bpl;
-      uchar*       rowOut = out + y*bpl;
-      double sB = rowIn[0]*(r+1), sG = rowIn[1]*(r+1),
-             sR = rowIn[2]*(r+1), sA = rowIn[3]*(r+1);
-      for (int x = 1; x <= r; ++x) {
-        const uchar* p = rowIn + std::min(x, W-1)*4;
-        sB += p[0]; sG += p[1]; sR += p[2]; sA += p[3];
-      }
-      for (int x = 0; x < W; ++x) {
-        uchar* o = rowOut + x*4;
-        o[0] = uchar(sB / window + 0.5);
-        o[1] = uchar(sG / window + 0.5);
-        o[2] = uchar(sR / window + 0.5);
-        o[3] = uchar(sA / window + 0.5);
-
-        const uchar* addP = rowIn + std::min(x+r+1, W-1)*4;
-        const uchar* subP = rowIn + std::max(x-r,     0)*4;
-        sB += addP[0] - subP[0];
-        sG += addP[1] - subP[1];
-        sR += addP[2] - subP[2];
-        sA += addP[3] - subP[3];
-      }
-    }
-  }
-  else {
-    #pragma omp parallel for
-    for (int x = 0; x < W; ++x) {
-      double sB = 0, sG = 0, sR = 0, sA = 0;
-      const uchar* p0 = in + x*4;
-      sB = p0[0]*(r+1); sG = p0[1]*(r+1);
-      sR = p0[2]*(r+1); sA = p0[3]*(r+1);
-      for (int y = 1; y <= r; ++y) {
-        const uchar* p = in + std::min(y, H-1)*bpl + x*4;
-        sB += p[0]; sG += p[1]; sR += p[2]; sA += p[3];
-      }
-      for (int y = 0; y < H; ++y) {
-        uchar* o = out + y*bpl + x*4;
-        o[0] = uchar(sB / window + 0.5);
-        o[1] = uchar(sG / window + 0.5);
-        o[2] = uchar(sR / window + 0.5);
-        o[3] = uchar(sA / window + 0.5);
-
-        const uchar* addP = in + std::min(y+r+1, H-1)*bpl + x*4;
-        const uchar* subP = in + std::max(y-r,     0)*bpl + x*4;
-        sB += addP[0] - subP[0];
-        sG += addP[1] - subP[1];
-        sR += addP[2] - subP[2];
-        sA += addP[3] - subP[3];
-      }
-    }
-  }
-}
-
-// Wrapper to handle fractional radius by blending two integer passes
-static void box_blur(const QImage& src, QImage& dst, double rf, bool vertical)
-{
-  int r0 = int(std::floor(rf));
-  int r1 = r0 + 1;
-  double f = rf - r0;
-  if (f < 1e-4) {
-    blur_axis(src, dst, r0, vertical);
-  }
-  else {
-    QImage a(src.size(), QImage::Format_ARGB32);
-    QImage b(src.size(), QImage::Format_ARGB32);
-    blur_axis(src, a, r0, vertical);
-    blur_axis(src, b, r1, vertical);
-
-    int pixels = src.width() * src.height();
-    const uchar* pa = a.bits();
-    const uchar* pb = b.bits();
-    uchar*       pd = dst.bits();
-    #pragma omp parallel for
-    for (int i = 0; i < pixels; ++i) {
-      for (int c = 0; c < 4; ++c) {
-        pd[i*4+c] = uchar((1.0 - f) * pa[i*4+c]
-                        + f         * pb[i*4+c]
-                        + 0.5);
-      }
-    }
-  }
-}
-
-// Apply three sequential box blurs to approximate Gaussian
-static void gauss_blur(const QImage& src, QImage& dst, double sigma)
-{
-  int b[3];
-  boxes_for_gauss(sigma, b);
-  QImage t1(src.size(), QImage::Format_ARGB32);
-  QImage t2(src.size(), QImage::Format_ARGB32);
-
-  double r = 0.5 * (b[0] - 1);
-  box_blur(src , t1, r, false);
-  box_blur(t1, t2, r, true);
-
-  r = 0.5 * (b[1] - 1);
-  box_blur(t2, t1, r, false);
-  box_blur(t1, t2, r, true);
-
-  r = 0.5 * (b[2] - 1);
-  box_blur(t2, t1, r, false);
-  box_blur(t1, dst, r, true);
-}
-
 // Main frame processing
 std::shared_ptr<Frame> Sharpen::GetFrame(
   std::shared_ptr<Frame> frame, int64_t frame_number)
@@ -214,8 +77,8 @@ std::shared_ptr<Frame> Sharpen::GetFrame(
   double sigma = std::max(0.1, rpx * H / 720.0);
 
   // Generate blurred image
-  QImage blur(W, H, QImage::Format_ARGB32);
-  gauss_blur(*img, blur, sigma);
+  QImage blur = img->copy();
+  BoxBlur::GaussianBlur(blur, sigma);
 
   // Precompute maximum luma difference for adaptive threshold
   int bplS = img->bytesPerLine();
@@ -11,7 +11,9 @@
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
 #include "SphericalProjection.h"
+#include "BufferPool.h"
 #include "Exceptions.h"
+#include "RemapTable.h"
 
 #include <cmath>
 #include <algorithm>
@@ -61,12 +63,6 @@ std::shared_ptr<openshot::Frame> SphericalProjection::GetFrame(
 
     int W = img->width(), H = img->height();
     int bpl = img->bytesPerLine();
-    uchar* src = img->bits();
-
-    QImage output(W, H, QImage::Format_ARGB32);
-    output.fill(Qt::black);
-    uchar* dst = output.bits();
-    int dst_bpl = output.bytesPerLine();
 
     // Evaluate keyframes (note roll is inverted + offset 180°)
     double yaw_r   = yaw.GetValue(frame_number)   * M_PI/180.0;
@@ -74,95 +70,92 @@ std::shared_ptr<openshot::Frame> SphericalProjection::GetFrame(
     double roll_r  = -roll.GetValue(frame_number) * M_PI/180.0 + M_PI;
     double fov_r   = fov.GetValue(frame_number)   * M_PI/180.0;
 
-    // Build composite rotation matrix R = Ry * Rx * Rz
-    double sy = sin(yaw_r),  cy = cos(yaw_r);
-    double sp = sin(pitch_r), cp = cos(pitch_r);
-    double sr = sin(roll_r), cr = cos(roll_r);
+    // Reuse the remap table, unless the frame size or any parameter changed
+    std::vector<double> key = { double(W), double(H), double(bpl), yaw_r, pitch_r, roll_r, fov_r,
+                                double(projection_mode), double(invert), double(interpolation) };
+    std::shared_ptr<RemapTable> table;
+    {
+        const std::lock_guard<std::mutex> lock(remap_mutex);
+        if (remap_key == key)
+            table = remap_table;
+    }
 
-    double r00 = cy*cr + sy*sp*sr, r01 = -cy*sr + sy*sp*cr, r02 = sy*cp;
-    double r10 = cp*sr,            r11 = cp*cr,            r12 = -sp;
-    double r20 = -sy*cr + cy*sp*sr, r21 = sy*sr + cy*sp*cr, r22 = cy*cp;
+    if (!table) {
+        table = std::make_shared<RemapTable>(W, H, W, H, bpl, interpolation != 0);
 
-    // Precompute perspective scalars
-    double hx = tan(fov_r*0.5);
-    double vy = hx * double(H)/W;
+        // Build composite rotation matrix R = Ry * Rx * Rz
+        double sy = sin(yaw_r),  cy = cos(yaw_r);
+        double sp = sin(pitch_r), cp = cos(pitch_r);
+        double sr = sin(roll_r), cr = cos(roll_r);
 
-#pragma omp parallel for schedule(static)
-    for (int yy = 0; yy < H; yy++) {
-        uchar* dst_row = dst + yy * dst_bpl;
-        double ndc_y = (2.0*(yy + 0.5)/H - 1.0) * vy;
-
-        for (int xx = 0; xx < W; xx++) {
-            // Generate ray in camera space
-            double ndc_x = (2.0*(xx + 0.5)/W - 1.0) * hx;
-            double vx = ndc_x, vy2 = -ndc_y, vz = -1.0;
-            double inv = 1.0/sqrt(vx*vx + vy2*vy2 + vz*vz);
-            vx *= inv; vy2 *= inv; vz *= inv;
-
-            // Rotate ray into world coordinates
-            double dx = r00*vx + r01*vy2 + r02*vz;
-            double dy = r10*vx + r11*vy2 + r12*vz;
-            double dz = r20*vx + r21*vy2 + r22*vz;
-
-            // For sphere/hemisphere, optionally invert view by 180°
-            if (projection_mode < 2 && invert) {
-                dx = -dx;
-                dz = -dz;
-            }
+        double r00 = cy*cr + sy*sp*sr, r01 = -cy*sr + sy*sp*cr, r02 = sy*cp;
+        double r10 = cp*sr,            r11 = cp*cr,            r12 = -sp;
+        double r20 = -sy*cr + cy*sp*sr, r21 = sy*sr + cy*sp*cr, r22 = cy*cp;
 
-            double uf, vf;
-
-            if (projection_mode == 2) {
-                // Fisheye mode: invert circular fisheye
-                double ax = 0.0, ay = 0.0, az = invert ? -1.0 : 1.0;
-                double cos_t = dx*ax + dy*ay + dz*az;
-                double theta = acos(cos_t);
-                double rpx = (theta / fov_r) * (W/2.0);
-                double phi = atan2(dy, dx);
-                uf = W*0.5 + rpx*cos(phi);
-                vf = H*0.5 + rpx*sin(phi);
-            }
-            else {
-                // Sphere or hemisphere: equirectangular sampling
-                double lon = atan2(dx, dz);
-                double lat = asin(dy);
-                if (projection_mode == 1) // hemisphere
-                    lon = std::clamp(lon, -M_PI/2.0, M_PI/2.0);
-                uf = ((lon + (projection_mode? M_PI/2.0 : M_PI))
-                      / (projection_mode? M_PI : 2.0*M_PI)) * W;
-                vf = (lat + M_PI/2.0)/M_PI * H;
-            }
+        // Precompute perspective scalars
+        double hx = tan(fov_r*0.5);
+        double vy = hx * double(H)/W;
 
-            uchar* d = dst_row + xx*4;
+#pragma omp parallel for schedule(static)
+        for (int yy = 0; yy < H; yy++) {
+            double ndc_y = (2.0*(yy + 0.5)/H - 1.0) * vy;
+
+            for (int xx = 0; xx < W; xx++) {
+                // Generate ray in camera space
+                double ndc_x = (2.0*(xx + 0.5)/W - 1.0) * hx;
+                double vx = ndc_x, vy2 = -ndc_y, vz = -1.0;
+                double inv = 1.0/sqrt(vx*vx + vy2*vy2 + vz*vz);
+                vx *= inv; vy2 *= inv; vz *= inv;
+
+                // Rotate ray into world coordinates
+                double dx = r00*vx + r01*vy2 + r02*vz;
+                double dy = r10*vx + r11*vy2 + r12*vz;
+                double dz = r20*vx + r21*vy2 + r22*vz;
+
+                // For sphere/hemisphere, optionally invert view by 180°
+                if (projection_mode < 2 && invert) {
+                    dx = -dx;
+                    dz = -dz;
+                }
 
-            if (interpolation == 0) {
-                // Nearest-neighbor sampling
-                int x0 = std::clamp(int(std::floor(uf)), 0, W-1);
-                int y0 = std::clamp(int(std::floor(vf)), 0, H-1);
-                uchar* s = src + y0*bpl + x0*4;
-                d[0] = s[0]; d[1] = s[1]; d[2] = s[2]; d[3] = s[3];
-            }
-            else {
-                // Bilinear sampling
-                int x0 = std::clamp(int(std::floor(uf)), 0, W-1);
-                int y0 = std::clamp(int(std::floor(vf)), 0, H-1);
-                int x1 = std::clamp(x0 + 1, 0, W-1);
-                int y1 = std::clamp(y0 + 1, 0, H-1);
-                double dxr = uf - x0, dyr = vf - y0;
-                uchar* p00 = src + y0*bpl + x0*4;
-                uchar* p10 = src + y0*bpl + x1*4;
-                uchar* p01 = src + y1*bpl + x0*4;
-                uchar* p11 = src + y1*bpl + x1*4;
-                for (int c = 0; c < 4; c++) {
-                    double v0 = p00[c]*(1-dxr) + p10[c]*dxr;
-                    double v1 = p01[c]*(1-dxr) + p11[c]*dxr;
-                    d[c] = uchar(v0*(1-dyr) + v1*dyr + 0.5);
+                double uf, vf;
+
+                if (projection_mode == 2) {
+                    // Fisheye mode: invert circular fisheye
+                    double ax = 0.0, ay = 0.0, az = invert ? -1.0 : 1.0;
+                    double cos_t = dx*ax + dy*ay + dz*az;
+                    double theta = acos(cos_t);
+                    double rpx = (theta / fov_r) * (W/2.0);
+                    double phi = atan2(dy, dx);
+                    uf = W*0.5 + rpx*cos(phi);
+                    vf = H*0.5 + rpx*sin(phi);
+                }
+                else {
+                    // Sphere or hemisphere: equirectangular sampling
+                    double lon = atan2(dx, dz);
+                    double lat = asin(dy);
+                    if (projection_mode == 1) // hemisphere
+                        lon = std::clamp(lon, -M_PI/2.0, M_PI/2.0);
+                    uf = ((lon + (projection_mode? M_PI/2.0 : M_PI))
+                          / (projection_mode? M_PI : 2.0*M_PI)) * W;
+                    vf = (lat + M_PI/2.0)/M_PI * H;
                 }
+
+                // Nearest-neighbor or bilinear sampling (clamped to the edges)
+                table->Set(xx, yy, uf, vf);
             }
         }
+
+        const std::lock_guard<std::mutex> lock(remap_mutex);
+        remap_table = table;
+        remap_key = key;
     }
 
-    *img = output;
+    // Sample every output pixel from the table
+    auto output = BufferPool::Instance()->CreateImage(W, H, QImage::Format_ARGB32);
+    table->Apply(img->constBits(), output->bits(), output->bytesPerLine());
+
+    *img = *output;
     return frame;
 }
 
@@ -19,11 +19,15 @@
 #include "../KeyFrame.h"
 
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace openshot
 {
 
+class RemapTable;
+
 /**
  * @brief Projects 360° or fisheye video through a virtual camera.
  * Supports yaw, pitch, roll, FOV, sphere/hemisphere/fisheye modes,
@@ -34,6 +38,10 @@ class SphericalProjection : public EffectBase
 private:
     void init_effect_details();
 
+    std::shared_ptr<RemapTable> remap_table;  ///< Source pixel of each output pixel (for the last parameters)
+    std::vector<double> remap_key;            ///< Frame size and parameters of the remap table
+    std::mutex remap_mutex;                   ///< Guards the remap table (frames are rendered in parallel)
+
 public:
     Keyframe yaw;           ///< Yaw around up-axis (degrees)
     Keyframe pitch;         ///< Pitch around right-axis (degrees)
@@ -11,11 +11,13 @@
 //
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
+#include <algorithm>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 
 #include "effects/Stabilizer.h"
+#include "DataFileCache.h"
 #include "Exceptions.h"
 #include "stabilizedata.pb.h"
 
@@ -25,6 +27,53 @@ using namespace std;
 using namespace openshot;
 using google::protobuf::util::TimeUtil;
 
+// Parse a protobuf data file into the transformation of each frame
+static bool ParseStabilizedData(const std::string& inputFilePath, StabilizationData& data){
+	using std::ios;
+	// Create stabilization message
+	pb_stabilize::Stabilization stabilizationMessage;
+
+	// Read the existing tracker message.
+	std::fstream input(inputFilePath, ios::in | ios::binary);
+	if (!stabilizationMessage.ParseFromIstream(&input)) {
+		return false;
+	}
+
+	// Index the transformations by frame number, in the range of frames (or by the sorted frame numbers, if
+	// they are sparse, so a file with corrupt frame numbers can't allocate a huge range)
+	std::vector<int64_t> frame_numbers;
+	frame_numbers.reserve(stabilizationMessage.frame_size());
+	for (const pb_stabilize::Frame& pbFrameData : stabilizationMessage.frame())
+		frame_numbers.push_back(pbFrameData.id());
+	std::sort(frame_numbers.begin(), frame_numbers.end());
+	frame_numbers.erase(std::unique(frame_numbers.begin(), frame_numbers.end()), frame_numbers.end());
+	if (!frame_numbers.empty()) {
+		data.first_frame = frame_numbers.front();
+		int64_t frames = frame_numbers.back() - frame_numbers.front() + 1;
+		if (frames > 4 * (int64_t) frame_numbers.size()) {
+			frames = frame_numbers.size();
+			data.frame_numbers = frame_numbers;
+		}
+		data.transformations.resize(frames);
+		data.has_transformation.resize(frames, false);
+	}
+	data.trajectory.reserve(stabilizationMessage.frame_size());
+
+	// Iterate over all frames of the saved message and assign to the data arrays
+	for (const pb_stabilize::Frame& pbFrameData : stabilizationMessage.frame()) {
+
+		// Assign camera trajectory data
+		data.trajectory.push_back(EffectCamTrajectory(pbFrameData.x(), pbFrameData.y(), pbFrameData.a()));
+
+		// Assign transformation data
+		int64_t index = data.Index(pbFrameData.id());
+		data.transformations[index] = EffectTransformParam(pbFrameData.dx(), pbFrameData.dy(), pbFrameData.da());
+		data.has_transformation[index] = true;
+	}
+
+	return true;
+}
+
 /// Blank constructor, useful when using Json to load the effect properties
 Stabilizer::Stabilizer(std::string clipStabilizedDataPath):protobuf_data_path(clipStabilizedDataPath)
 {
@@ -70,7 +119,8 @@ std::shared_ptr<Frame> Stabilizer::GetFrame(std::shared_ptr<Frame> frame, int64_
 	if(!frame_image.empty()){
 
 		// Check if track data exists for the requested frame
-		if(transformationData.find(frame_number) != transformationData.end()){
+		const EffectTransformParam* transformation = stabilizationData ? stabilizationData->Transformation(frame_number) : nullptr;
+		if(transformation){
 
 			float zoom_value = zoom.GetValue(frame_number);
 
@@ -78,13 +128,13 @@ std::shared_ptr<Frame> Stabilizer::GetFrame(std::shared_ptr<Frame> frame, int64_
 			cv::Mat T(2,3,CV_64F);
 
 			// Set rotation matrix values
-			T.at<double>(0,0) = cos(transformationData[frame_number].da);
-			T.at<double>(0,1) = -sin(transformationData[frame_number].da);
-			T.at<double>(1,0) = sin(transformationData[frame_number].da);
-			T.at<double>(1,1) = cos(transformationData[frame_number].da);
+			T.at<double>(0,0) = cos(transformation->da);
+			T.at<double>(0,1) = -sin(transformation->da);
+			T.at<double>(1,0) = sin(transformation->da);
+			T.at<double>(1,1) = cos(transformation->da);
 
-			T.at<double>(0,2) = transformationData[frame_number].dx * frame_image.size().width;
-			T.at<double>(1,2) = transformationData[frame_number].dy * frame_image.size().height;
+			T.at<double>(0,2) = transformation->dx * frame_image.size().width;
+			T.at<double>(1,2) = transformation->dy * frame_image.size().height;
 
 			// Apply rotation matrix to image
 			cv::Mat frame_stabilized;
@@ -104,51 +154,37 @@ std::shared_ptr<Frame> Stabilizer::GetFrame(std::shared_ptr<Frame> frame, int64_
 
 // Load protobuf data file
 bool Stabilizer::LoadStabilizedData(std::string inputFilePath){
-	using std::ios;
-	// Create stabilization message
-	pb_stabilize::Stabilization stabilizationMessage;
-
-	// Read the existing tracker message.
-	std::fstream input(inputFilePath, ios::in | ios::binary);
-	if (!stabilizationMessage.ParseFromIstream(&input)) {
+	// Files are parsed once, and shared by every effect which loads the same file
+	std::shared_ptr<const StabilizationData> data = DataFileCache<StabilizationData>::Load(inputFilePath, ParseStabilizedData);
+	if (!data) {
 		std::cerr << "Failed to parse protobuf message." << std::endl;
 		return false;
 	}
 
-	// Make sure the data maps are empty
-	transformationData.clear();
-	trajectoryData.clear();
-
-	// Iterate over all frames of the saved message and assign to the data maps
-	for (size_t i = 0; i < stabilizationMessage.frame_size(); i++) {
-
-		// Create stabilization message
-		const pb_stabilize::Frame& pbFrameData = stabilizationMessage.frame(i);
-
-		// Load frame number
-		size_t id = pbFrameData.id();
-
-		// Load camera trajectory data
-		float x = pbFrameData.x();
-		float y = pbFrameData.y();
-		float a = pbFrameData.a();
-
-		// Assign data to trajectory map
-		trajectoryData[i] = EffectCamTrajectory(x,y,a);
-
-		// Load transformation data
-		float dx = pbFrameData.dx();
-		float dy = pbFrameData.dy();
-		float da = pbFrameData.da();
+	stabilizationData = data;
+	return true;
+}
 
-		// Assing data to transformation map
-		transformationData[id] = EffectTransformParam(dx,dy,da);
+// Get the camera trajectory of each saved frame
+std::map<size_t, EffectCamTrajectory> Stabilizer::TrajectoryData() const {
+	std::map<size_t, EffectCamTrajectory> trajectoryData;
+	if (stabilizationData) {
+		for (size_t i = 0; i < stabilizationData->trajectory.size(); i++)
+			trajectoryData.emplace_hint(trajectoryData.end(), i, stabilizationData->trajectory[i]);
 	}
+	return trajectoryData;
+}
 
-	// Delete all global objects allocated by libprotobuf.
-	google::protobuf::ShutdownProtobufLibrary();
-
-	return true;
+// Get the transformation of each saved frame
+std::map<size_t, EffectTransformParam> Stabilizer::TransformationData() const {
+	std::map<size_t, EffectTransformParam> transformationData;
+	if (stabilizationData) {
+		for (size_t i = 0; i < stabilizationData->transformations.size(); i++) {
+			if (stabilizationData->has_transformation[i])
+				transformationData.emplace_hint(transformationData.end(), stabilizationData->FrameNumber(i), stabilizationData->transformations[i]);
+		}
+	}
+	return transformationData;
 }
 
 
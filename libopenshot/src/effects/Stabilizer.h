@@ -16,7 +16,10 @@
 
 #include "EffectBase.h"
 
+#include <algorithm>
+#include <map>
 #include <memory>
+#include <vector>
 
 #include "Json.h"
 #include "KeyFrame.h"
@@ -57,6 +60,37 @@ namespace openshot
     // Forwward decls
     class Frame;
 
+    /// The stabilization data of a clip, which is shared by every effect that loads the same file
+    struct StabilizationData
+    {
+        int64_t first_frame = 0; ///< The frame number of the first transformation
+        std::vector<int64_t> frame_numbers; ///< Sorted frame numbers of the transformations (only if they are sparse)
+        std::vector<EffectTransformParam> transformations; ///< Transformation of each frame (from first_frame, or in the order of frame_numbers)
+        std::vector<bool> has_transformation; ///< The frame has a transformation (from first_frame, or in the order of frame_numbers)
+        std::vector<EffectCamTrajectory> trajectory; ///< Camera trajectory (in the order of the saved frames)
+
+        /// Get the index of a frame in transformations (or -1, if the frame is not indexed)
+        int64_t Index(int64_t frame_number) const {
+            int64_t index = frame_number - first_frame;
+            if (!frame_numbers.empty()) {
+                auto found = std::lower_bound(frame_numbers.begin(), frame_numbers.end(), frame_number);
+                index = (found != frame_numbers.end() && *found == frame_number) ? found - frame_numbers.begin() : -1;
+            }
+            return (index >= 0 && index < (int64_t) transformations.size()) ? index : -1;
+        }
+
+        /// Get the frame number of an index in transformations
+        int64_t FrameNumber(size_t index) const {
+            return frame_numbers.empty() ? first_frame + (int64_t) index : frame_numbers[index];
+        }
+
+        /// Get the transformation of a frame (or nullptr, if the frame has no transformation)
+        const EffectTransformParam* Transformation(int64_t frame_number) const {
+            int64_t index = Index(frame_number);
+            return (index < 0 || !has_transformation[index]) ? nullptr : &transformations[index];
+        }
+    };
+
     /**
      * @brief This class stabilizes a video clip to remove undesired shaking and jitter.
      *
@@ -73,8 +107,7 @@ namespace openshot
 
     public:
         std::string teste;
-        std::map <size_t,EffectCamTrajectory> trajectoryData; // Save camera trajectory data
-        std::map <size_t,EffectTransformParam> transformationData; // Save transormation data
+        std::shared_ptr<const StabilizationData> stabilizationData; // Camera trajectory and transformation data
 
         Stabilizer();
 
@@ -98,6 +131,18 @@ namespace openshot
         /// Load protobuf data file
         bool LoadStabilizedData(std::string inputFilePath);
 
+        /// @brief Get the camera trajectory of each saved frame (by the order of the frames in the file)
+        ///
+        /// This replaces the public trajectoryData map (the loaded data is now shared by every effect
+        /// which loads the same file, see stabilizationData), so the map is built on each call.
+        std::map<size_t, EffectCamTrajectory> TrajectoryData() const;
+
+        /// @brief Get the transformation of each saved frame (by frame number)
+        ///
+        /// This replaces the public transformationData map (the loaded data is now shared by every effect
+        /// which loads the same file, see stabilizationData), so the map is built on each call.
+        std::map<size_t, EffectTransformParam> TransformationData() const;
+
         // Get and Set JSON methods
         std::string Json() const override; ///< Generate JSON string of this object
         void SetJson(const std::string value) override; ///< Load JSON string into this object
@@ -40,13 +40,13 @@ Tracker::Tracker(std::string clipTrackerDataPath)
 	// Instantiate a TrackedObjectBBox object and point to it
 	TrackedObjectBBox trackedDataObject;
 	trackedData = std::make_shared<TrackedObjectBBox>(trackedDataObject);
-	// Tries to load the tracked object's data from protobuf file
-	trackedData->LoadBoxData(clipTrackerDataPath);
 	ClipBase* parentClip = this->ParentClip();
 	trackedData->ParentClip(parentClip);
 	trackedData->Id(std::to_string(0));
 	// Insert TrackedObject with index 0 to the trackedObjects map
 	trackedObjects.insert({0, trackedData});
+	// Tries to load the tracked objects' data from protobuf file
+	LoadTrackedData(clipTrackerDataPath);
 }
 
 // Default constructor
@@ -89,13 +89,20 @@ std::shared_ptr<Frame> Tracker::GetFrame(std::shared_ptr<Frame> frame, int64_t f
     std::shared_ptr<QImage> frame_image = frame->GetImage();
 
     // Check if frame isn't NULL
-    if(frame_image && !frame_image->isNull() &&
-       trackedData->Contains(frame_number) &&
-       trackedData->visible.GetValue(frame_number) == 1) {
+    if(!frame_image || frame_image->isNull())
+        return frame;
+
+    // Draw the box of each tracked object
+    for (const auto& trackedObject : trackedObjects) {
+        std::shared_ptr<TrackedObjectBBox> trackedBox = std::static_pointer_cast<TrackedObjectBBox>(trackedObject.second);
+        if(!trackedBox->Contains(frame_number) ||
+           trackedBox->visible.GetValue(frame_number) != 1)
+            continue;
+
         QPainter painter(frame_image.get());
 
         // Get the bounding-box of the given frame
-        BBox fd = trackedData->GetBox(frame_number);
+        BBox fd = trackedBox->GetBox(frame_number);
 
         // Create a QRectF for the bounding box
         QRectF boxRect((fd.cx - fd.width / 2) * frame_image->width(),
@@ -104,16 +111,16 @@ std::shared_ptr<Frame> Tracker::GetFrame(std::shared_ptr<Frame> frame, int64_t f
                        fd.height * frame_image->height());
 
         // Check if track data exists for the requested frame
-        if (trackedData->draw_box.GetValue(frame_number) == 1) {
+        if (trackedBox->draw_box.GetValue(frame_number) == 1) {
             painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform);
 
             // Get trackedObjectBox keyframes
-            std::vector<int> stroke_rgba = trackedData->stroke.GetColorRGBA(frame_number);
-            int stroke_width = trackedData->stroke_width.GetValue(frame_number);
-            float stroke_alpha = trackedData->stroke_alpha.GetValue(frame_number);
-            std::vector<int> bg_rgba = trackedData->background.GetColorRGBA(frame_number);
-            float bg_alpha = trackedData->background_alpha.GetValue(frame_number);
-            float bg_corner = trackedData->background_corner.GetValue(frame_number);
+            std::vector<int> stroke_rgba = trackedBox->stroke.GetColorRGBA(frame_number);
+            int stroke_width = trackedBox->stroke_width.GetValue(frame_number);
+            float stroke_alpha = trackedBox->stroke_alpha.GetValue(frame_number);
+            std::vector<int> bg_rgba = trackedBox->background.GetColorRGBA(frame_number);
+            float bg_alpha = trackedBox->background_alpha.GetValue(frame_number);
+            float bg_corner = trackedBox->background_corner.GetValue(frame_number);
 
             // Set the pen for the border
             QPen pen(QColor(stroke_rgba[0], stroke_rgba[1], stroke_rgba[2], 255 * stroke_alpha));
@@ -135,6 +142,35 @@ std::shared_ptr<Frame> Tracker::GetFrame(std::shared_ptr<Frame> frame, int64_t f
     return frame;
 }
 
+// Load the bounding-boxes of every tracked object from the protobuf file
+bool Tracker::LoadTrackedData(std::string inputFilePath)
+{
+	// Read the existing tracker message (or get the message shared by other effects)
+	std::shared_ptr<const pb_tracker::Tracker> message = TrackedObjectBBox::LoadTrackerMessage(inputFilePath);
+	if (!message) {
+		std::cerr << "Failed to parse protobuf message." << std::endl;
+		return false;
+	}
+	const pb_tracker::Tracker& trackerMessage = *message;
+
+	// The first object is saved in the frames of the message
+	trackedData->LoadBoxData(trackerMessage, 0);
+
+	// Remove the other objects, and add the other objects of the message
+	for (auto it = trackedObjects.begin(); it != trackedObjects.end(); )
+		it = (it->first == 0) ? std::next(it) : trackedObjects.erase(it);
+
+	for (const pb_tracker::Object& pbObject : trackerMessage.object()) {
+		std::shared_ptr<TrackedObjectBBox> trackedObj = std::make_shared<TrackedObjectBBox>();
+		trackedObj->LoadBoxData(trackerMessage, pbObject.id());
+		trackedObj->ParentClip(this->ParentClip());
+		trackedObj->Id(std::to_string(pbObject.id()));
+		trackedObjects.insert({pbObject.id(), trackedObj});
+	}
+
+	return true;
+}
+
 // Get the indexes and IDs of all visible objects in the given frame
 std::string Tracker::GetVisibleObjects(int64_t frame_number) const{
 
@@ -233,7 +269,7 @@ void Tracker::SetJsonValue(const Json::Value root) {
 	if (!root["protobuf_data_path"].isNull() && protobuf_data_path.size() <= 1)
 	{
 		protobuf_data_path = root["protobuf_data_path"].asString();
-		if(!trackedData->LoadBoxData(protobuf_data_path))
+		if(!LoadTrackedData(protobuf_data_path))
 		{
 			std::clog << "Invalid protobuf data path " << protobuf_data_path << '\n';
 			protobuf_data_path = "";
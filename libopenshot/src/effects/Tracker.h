@@ -36,7 +36,8 @@ namespace openshot
      * the user to attach another clip (image or video) to the tracked object.
      *
      * Tracking is useful to better visualize, follow the movement of an object through video
-     * and attach an image or video to it.
+     * and attach an image or video to it. Several objects can be tracked in one pass (by
+     * openshot::CVTracker), in which case each object has its own openshot::TrackedObjectBBox.
      */
     class Tracker : public EffectBase
     {
@@ -44,6 +45,9 @@ namespace openshot
         /// Init effect settings
         void init_effect_details();
 
+        /// Load the bounding-boxes of every tracked object from the protobuf file
+        bool LoadTrackedData(std::string inputFilePath);
+
         Fraction BaseFPS;
         double TimeScale;
 
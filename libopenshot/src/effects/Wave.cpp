@@ -13,6 +13,10 @@
 #include "Wave.h"
 #include "Exceptions.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
 using namespace openshot;
 
 /// Blank constructor, useful when using Json to load the effect properties
@@ -51,10 +55,15 @@ std::shared_ptr<openshot::Frame> Wave::GetFrame(std::shared_ptr<openshot::Frame>
 	// Get the frame's image
 	std::shared_ptr<QImage> frame_image = frame->GetImage();
 
-	// Get original pixels for frame image, and also make a copy for editing
-	const unsigned char *original_pixels = (unsigned char *) frame_image->constBits();
+	// Keep the original pixels (editing the frame's image detaches it from this copy)
+	const QImage original_image = *frame_image;
+	const unsigned char *original_pixels = original_image.constBits();
 	unsigned char *pixels = (unsigned char *) frame_image->bits();
-	int pixel_count = frame_image->width() * frame_image->height();
+	int width = frame_image->width();
+	int height = frame_image->height();
+	int64_t pixel_count = int64_t(width) * height;
+	if (pixel_count == 0)
+		return frame;
 
 	// Get current keyframe values
 	double time = frame_number;
@@ -64,27 +73,30 @@ std::shared_ptr<openshot::Frame> Wave::GetFrame(std::shared_ptr<openshot::Frame>
 	double shift_x_value = shift_x.GetValue(frame_number);
 	double speed_y_value = speed_y.GetValue(frame_number);
 
-	// Loop through pixels
+	// Loop through rows (every pixel of a row is shifted by the same amount)
 	#pragma omp parallel for
-	for (int pixel = 0; pixel < pixel_count; ++pixel)
+	for (int Y = 0; Y < height; ++Y)
 	{
-		// Calculate pixel Y value
-		int Y = pixel / frame_image->width();
-
 		// Calculate wave pixel offsets
 		float noiseVal = (100 + Y * 0.001) * multiplier_value;  // Time and time multiplier (to make the wave move)
 		float noiseAmp = noiseVal * amplitude_value;  // Apply amplitude / height of the wave
 		float waveformVal = sin((Y * wavelength_value) + (time * speed_y_value));  // Waveform algorithm on y-axis
 		float waveVal = (waveformVal + shift_x_value) * noiseAmp;  // Shifts pixels on the x-axis
 
-		long unsigned int source_px = round(pixel + waveVal);
-		if (source_px < 0)
-			source_px = 0;
-		if (source_px >= pixel_count)
-			source_px = pixel_count - 1;
-
-		// Calculate source array location, and target array location, and copy the 4 color values
-		memcpy(&pixels[pixel * 4], &original_pixels[source_px * 4], sizeof(char) * 4);
+		// Source pixels are shifted by a whole number of pixels (rounded), and are limited to the image
+		int64_t first_pixel = int64_t(Y) * width;
+		int64_t first_source = first_pixel + int64_t(floor(waveVal + 0.5));
+		int64_t copy_start = std::min(std::max(-first_source, int64_t(0)), int64_t(width));
+		int64_t copy_end = std::max(std::min(pixel_count - first_source, int64_t(width)), copy_start);
+
+		// Copy the 4 color values of each pixel
+		unsigned char *row = pixels + first_pixel * 4;
+		for (int64_t X = 0; X < copy_start; ++X)
+			memcpy(&row[X * 4], &original_pixels[0], sizeof(char) * 4);
+		if (copy_end > copy_start)
+			memcpy(&row[copy_start * 4], &original_pixels[(first_source + copy_start) * 4], sizeof(char) * 4 * (copy_end - copy_start));
+		for (int64_t X = copy_end; X < width; ++X)
+			memcpy(&row[X * 4], &original_pixels[(pixel_count - 1) * 4], sizeof(char) * 4);
 	}
 
 	// return the modified frame
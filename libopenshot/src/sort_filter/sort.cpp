@@ -42,6 +42,27 @@ double SortTracker::GetCentroidsDistance(
 	return distance;
 }
 
+// Predict the position of the tracked objects on a frame without detections (i.e. between detected frames).
+// Trackers are moved forward by one frame, without counting the frame as a missed detection.
+void SortTracker::predict(int frame_count)
+{
+	frameTrackingResult.clear();
+	for (unsigned int i = 0; i < trackers.size(); i++)
+	{
+		cv::Rect_<float> pBox = trackers[i].predict2();
+		if ((trackers[i].m_time_since_update < 1 && trackers[i].m_hit_streak >= _min_hits) || frame_count <= _min_hits)
+		{
+			TrackingBox res;
+			res.box = pBox;
+			res.id = trackers[i].m_id;
+			res.frame = frame_count;
+			res.classId = trackers[i].classId;
+			res.confidence = trackers[i].confidence;
+			frameTrackingResult.push_back(res);
+		}
+	}
+}
+
 void SortTracker::update(vector<cv::Rect> detections_cv, int frame_count, double image_diagonal, std::vector<float> confidences, std::vector<int> classIds)
 {
 	vector<TrackingBox> detections;
@@ -38,6 +38,8 @@ public:
 
 	// Update position based on the new frame
 	void update(std::vector<cv::Rect> detection, int frame_count, double image_diagonal, std::vector<float> confidences, std::vector<int> classIds);
+	// Predict the position of the tracked objects on a frame without detections (i.e. between detected frames)
+	void predict(int frame_count);
 	double GetIOU(cv::Rect_<float> bb_test, cv::Rect_<float> bb_gt);
 	double GetCentroidsDistance(cv::Rect_<float> bb_test, cv::Rect_<float> bb_gt);
 	std::vector<KalmanTracker> trackers;
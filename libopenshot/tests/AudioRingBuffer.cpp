@@ -0,0 +1,220 @@
+/**
+ * @file
+ * @brief Unit tests for openshot::AudioRingBuffer and openshot::AudioReaderSource
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "AudioReaderSource.h"
+#include "AudioRingBuffer.h"
+#include "CacheMemory.h"
+#include "DummyReader.h"
+#include "Frame.h"
+#include "openshot_catch.h"
+
+using namespace openshot;
+
+// Create audio with incrementing samples (channel 2 is negative)
+static juce::AudioBuffer<float> Ramp(int samples, float first) {
+	juce::AudioBuffer<float> audio(2, samples);
+	for (int sample = 0; sample < samples; sample++) {
+		audio.setSample(0, sample, first + sample);
+		audio.setSample(1, sample, -(first + sample));
+	}
+	return audio;
+}
+
+TEST_CASE( "Write and read around the end of the ring", "[libopenshot][audioringbuffer]" )
+{
+	AudioRingBuffer ring(2, 100);
+	CHECK(ring.Capacity() == 100);
+	CHECK(ring.Channels() == 2);
+	CHECK(ring.Available() == 0);
+	CHECK(ring.Space() == 100);
+
+	// Only the free space is written
+	juce::AudioBuffer<float> input = Ramp(300, 0.0f);
+	CHECK(ring.Write(input, 0, 70) == 70);
+	CHECK(ring.Write(input, 70, 50) == 30);
+	CHECK(ring.Available() == 100);
+	CHECK(ring.Space() == 0);
+
+	juce::AudioBuffer<float> output(2, 200);
+	output.clear();
+	CHECK(ring.Read(output, 0, 60) == 60);
+
+	// Samples wrap around the end of the ring, in order
+	CHECK(ring.Write(input, 100, 60) == 60);
+	CHECK(ring.Read(output, 60, 200 - 60) == 100);
+	for (int sample = 0; sample < 160; sample++) {
+		CHECK(output.getSample(0, sample) == float(sample));
+		CHECK(output.getSample(1, sample) == -float(sample));
+	}
+
+	// Reading an empty ring does not change the destination
+	CHECK(ring.Read(output, 0, 10) == 0);
+	CHECK(output.getSample(0, 5) == 5.0f);
+
+	// Skipped samples are not read
+	CHECK(ring.Write(input, 0, 20) == 20);
+	CHECK(ring.Discard(15) == 15);
+	CHECK(ring.Read(output, 0, 10) == 5);
+	CHECK(output.getSample(0, 0) == 15.0f);
+	CHECK(ring.Write(input, 0, 20) == 20);
+	ring.Clear();
+	CHECK(ring.Available() == 0);
+}
+
+TEST_CASE( "Missing channels are silent", "[libopenshot][audioringbuffer]" )
+{
+	AudioRingBuffer ring(2, 10);
+	juce::AudioBuffer<float> mono(1, 4);
+	for (int sample = 0; sample < 4; sample++)
+		mono.setSample(0, sample, 1.0f);
+	CHECK(ring.Write(mono, 0, 4) == 4);
+
+	juce::AudioBuffer<float> output(3, 4);
+	for (int channel = 0; channel < 3; channel++)
+		for (int sample = 0; sample < 4; sample++)
+			output.setSample(channel, sample, 9.0f);
+	CHECK(ring.Read(output, 0, 4) == 4);
+	CHECK(output.getSample(0, 3) == 1.0f);
+	CHECK(output.getSample(1, 3) == 0.0f);
+	CHECK(output.getSample(2, 3) == 0.0f);
+}
+
+TEST_CASE( "Write and read on different threads", "[libopenshot][audioringbuffer]" )
+{
+	const int total = 200000;
+	AudioRingBuffer ring(2, 1000);
+	juce::AudioBuffer<float> input = Ramp(total, 0.0f);
+
+	std::thread writer([&]() {
+		int written = 0;
+		while (written < total) {
+			written += ring.Write(input, written, std::min(333, total - written));
+			std::this_thread::yield();
+		}
+	});
+
+	// Every sample is read once, in order
+	juce::AudioBuffer<float> block(2, 256);
+	int read = 0;
+	bool is_ordered = true;
+	while (read < total) {
+		const int samples = ring.Read(block, 0, 256);
+		for (int sample = 0; sample < samples; sample++)
+			is_ordered = is_ordered && block.getSample(0, sample) == float(read + sample)
+				&& block.getSample(1, sample) == -float(read + sample);
+		read += samples;
+	}
+	writer.join();
+
+	CHECK(is_ordered);
+	CHECK(read == total);
+	CHECK(ring.Available() == 0);
+}
+
+// Get blocks of audio from a source until a block is not silent
+static bool WaitForAudio(AudioReaderSource& source, juce::AudioBuffer<float>& block) {
+	const juce::AudioSourceChannelInfo info(block);
+	for (int attempt = 0; attempt < 2000; attempt++) {
+		source.getNextAudioBlock(info);
+		if (block.getMagnitude(0, 0, block.getNumSamples()) > 0.0f)
+			return true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return false;
+}
+
+TEST_CASE( "Play the mixed audio of a reader", "[libopenshot][audioringbuffer][audioreadersource]" )
+{
+	// Frames with incrementing samples (frame number + position in frame)
+	CacheMemory cache;
+	const int sample_count = 1470;
+	for (int64_t frame_number = 1; frame_number <= 30; frame_number++) {
+		auto frame = std::make_shared<Frame>(frame_number, sample_count, 2);
+		std::vector<float> samples(sample_count);
+		for (int sample = 0; sample < sample_count; sample++)
+			samples[sample] = float(frame_number) + float(sample) / float(sample_count);
+		frame->AddAudio(true, 0, 0, samples.data(), sample_count, 1.0);
+		frame->AddAudio(true, 1, 0, samples.data(), sample_count, 1.0);
+		cache.Add(frame);
+	}
+	DummyReader reader(Fraction(30, 1), 1920, 1080, 44100, 2, 1.0, &cache);
+	reader.Open();
+
+	AudioReaderSource source(&reader, 1);
+	source.prepareToPlay(512, 44100.0);
+
+	// Audio starts at the first frame, and continues between frames
+	juce::AudioBuffer<float> block(2, 512);
+	REQUIRE(WaitForAudio(source, block));
+	CHECK(block.getSample(0, 0) == 1.0f);
+	CHECK(block.getSample(1, 0) == 1.0f);
+
+	const juce::AudioSourceChannelInfo info(block);
+	float previous = block.getSample(0, 511);
+	bool is_ordered = true;
+	for (int blocks = 0; blocks < 20; blocks++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		source.getNextAudioBlock(info);
+		for (int sample = 0; sample < 512; sample++) {
+			is_ordered = is_ordered && block.getSample(0, sample) > previous;
+			previous = block.getSample(0, sample);
+		}
+	}
+	CHECK(is_ordered);
+	CHECK(previous > 7.0f);
+	CHECK(source.getFrame());
+
+	// Paused sources are silent
+	source.setSpeed(0);
+	source.getNextAudioBlock(info);
+	CHECK(block.getMagnitude(0, 0, 512) == 0.0f);
+
+	// Seeking skips the audio mixed ahead
+	source.setSpeed(1);
+	source.Seek(20);
+	REQUIRE(WaitForAudio(source, block));
+	CHECK(block.getSample(0, 0) == 20.0f);
+
+	source.releaseResources();
+	reader.Close();
+	cache.Clear();
+	CHECK(source.getReadErrors() == 0);
+}
+
+TEST_CASE( "Count the frames a reader fails to get", "[libopenshot][audioringbuffer][audioreadersource]" )
+{
+	// A reader with no frames (which throws for every frame)
+	CacheMemory cache;
+	DummyReader reader(Fraction(30, 1), 1920, 1080, 44100, 2, 1.0, &cache);
+	reader.Open();
+
+	AudioReaderSource source(&reader, 1);
+	source.prepareToPlay(512, 44100.0);
+
+	// The frame is retried (and each failure is counted), and the audio is silent
+	for (int attempt = 0; attempt < 2000 && source.getReadErrors() < 2; attempt++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	CHECK(source.getReadErrors() >= 2);
+	CHECK_FALSE(source.getFrame());
+
+	juce::AudioBuffer<float> block(2, 512);
+	source.getNextAudioBlock(juce::AudioSourceChannelInfo(block));
+	CHECK(block.getMagnitude(0, 0, 512) == 0.0f);
+
+	source.releaseResources();
+	reader.Close();
+}
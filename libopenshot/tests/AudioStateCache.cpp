@@ -0,0 +1,226 @@
+/**
+ * @file
+ * @brief Unit tests for openshot::AudioStateCache
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "AudioStateCache.h"
+#include "Frame.h"
+#include "audio_effects/Compressor.h"
+#include "audio_effects/Echo.h"
+#include "openshot_catch.h"
+#include "test_utils.h"
+
+using namespace openshot;
+
+// Create a frame of audio (a different tone for each frame, so every frame changes the state of an effect)
+static std::shared_ptr<Frame> ToneFrame(int64_t number) {
+	const int samples = 1470;
+	auto frame = std::make_shared<Frame>(number, samples, 2);
+	frame->SampleRate(44100);
+	for (int channel = 0; channel < 2; channel++) {
+		float* data = frame->audio->getWritePointer(channel);
+		for (int sample = 0; sample < samples; sample++)
+			data[sample] = 0.8f * std::sin(0.01f * (number + channel + 1) * sample) * (number % 3 == 0 ? 1.0f : 0.1f);
+	}
+	return frame;
+}
+
+// Sum every sample (and add the previous sum to each sample)
+struct SumState { double sum = 0.0; };
+static void Sum(SumState& state, juce::AudioBuffer<float>& audio, int64_t) {
+	for (int sample = 0; sample < audio.getNumSamples(); sample++) {
+		state.sum += audio.getSample(0, sample);
+		audio.setSample(0, sample, float(state.sum));
+	}
+}
+
+static juce::AudioBuffer<float> Samples(float value) {
+	juce::AudioBuffer<float> audio(1, 4);
+	for (int sample = 0; sample < 4; sample++)
+		audio.setSample(0, sample, value);
+	return audio;
+}
+
+TEST_CASE( "Continue from the state of the previous frame", "[libopenshot][audiostatecache]" )
+{
+	AudioStateCache<SumState> states(10, 5, 4);
+
+	// Frames in order continue from each other
+	for (int64_t number = 1; number <= 20; number++) {
+		juce::AudioBuffer<float> audio = Samples(1.0f);
+		states.Process(number, audio, Sum);
+		CHECK(audio.getSample(0, 3) == Approx(number * 4.0));
+	}
+
+	// Frames requested again are rebuilt from the nearest snapshot (and the cached audio of later frames)
+	for (int64_t number : {17, 12, 19, 20, 16}) {
+		juce::AudioBuffer<float> audio = Samples(1.0f);
+		states.Process(number, audio, Sum);
+		CHECK(audio.getSample(0, 3) == Approx(number * 4.0));
+	}
+
+	// Playback continues from where it was (after frames requested out of order)
+	juce::AudioBuffer<float> audio = Samples(1.0f);
+	states.Process(21, audio, Sum);
+	CHECK(audio.getSample(0, 3) == Approx(84.0));
+
+	// Frames without any cached audio before them start from an empty state
+	audio = Samples(1.0f);
+	states.Process(100, audio, Sum);
+	CHECK(audio.getSample(0, 3) == Approx(4.0));
+	audio = Samples(1.0f);
+	states.Process(101, audio, Sum);
+	CHECK(audio.getSample(0, 3) == Approx(8.0));
+
+	// Unless the frames before them were processed (up to the max pre-roll)
+	audio = Samples(1.0f);
+	states.Process(22, audio, Sum);
+	CHECK(audio.getSample(0, 3) == Approx(88.0));
+
+	states.Clear();
+	audio = Samples(1.0f);
+	states.Process(23, audio, Sum);
+	CHECK(audio.getSample(0, 3) == Approx(4.0));
+}
+
+TEST_CASE( "Rebuild the frames after a frame which was processed late", "[libopenshot][audiostatecache]" )
+{
+	AudioStateCache<SumState> states;
+
+	// Frame 3 is processed before frame 2 (so it starts from an empty state)
+	for (int64_t number : {1, 3, 2}) {
+		juce::AudioBuffer<float> audio = Samples(1.0f);
+		states.Process(number, audio, Sum);
+	}
+
+	// The following frames continue from frame 2 (and replay frame 3), as if every frame was in order
+	for (int64_t number : {4, 5, 3}) {
+		juce::AudioBuffer<float> audio = Samples(1.0f);
+		states.Process(number, audio, Sum);
+		CHECK(audio.getSample(0, 3) == Approx(number * 4.0));
+	}
+}
+
+TEST_CASE( "Share the unchanged blocks of a buffer", "[libopenshot][audiostatecache]" )
+{
+	AudioStateBuffer buffer;
+	buffer.SetSize(2, 10000);
+	CHECK(buffer.GetChannel(1, 0, 0)[9999] == 0.0f);
+
+	// Write across the end of the buffer (wrapping around to the start)
+	AudioStateBuffer::Channel samples = buffer.GetChannel(1, 9990, 20);
+	for (int sample = 0; sample < 20; sample++)
+		samples[(9990 + sample) % 10000] = float(sample + 1);
+
+	// A copy keeps its samples when the buffer is written again
+	AudioStateBuffer copy = buffer;
+	samples = buffer.GetChannel(1, 9995, 10);
+	for (int sample = 0; sample < 10; sample++)
+		samples[(9995 + sample) % 10000] = -1.0f;
+	AudioStateBuffer::Channel copied = copy.GetChannel(1, 0, 0);
+	CHECK(copied[9990] == 1.0f);
+	CHECK(copied[9999] == 10.0f);
+	CHECK(copied[4] == 15.0f);
+	CHECK(copied[10] == 0.0f);
+	samples = buffer.GetChannel(1, 0, 0);
+	CHECK(samples[9990] == 1.0f);
+	CHECK(samples[9999] == -1.0f);
+	CHECK(samples[4] == -1.0f);
+	CHECK(samples[5] == 16.0f);
+	CHECK(buffer.GetChannel(0, 0, 0)[9999] == 0.0f);
+}
+
+TEST_CASE( "Wait for the previous frame on other threads", "[libopenshot][audiostatecache]" )
+{
+	AudioStateCache<SumState> states;
+	juce::AudioBuffer<float> first = Samples(1.0f);
+	states.Process(1, first, Sum);
+
+	// Frame 3 can't start until frame 2 is processed (on another thread)
+	std::vector<juce::AudioBuffer<float>> audio = {Samples(1.0f), Samples(1.0f)};
+	std::promise<void> started;
+	std::thread second([&] {
+		states.Process(2, audio[0], [&](SumState& state, juce::AudioBuffer<float>& samples, int64_t number) {
+			started.set_value();
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			Sum(state, samples, number);
+		});
+	});
+	started.get_future().wait();
+	states.Process(3, audio[1], Sum);
+	second.join();
+
+	CHECK(audio[0].getSample(0, 3) == Approx(8.0));
+	CHECK(audio[1].getSample(0, 3) == Approx(12.0));
+}
+
+TEST_CASE( "Echo frames out of order", "[libopenshot][audiostatecache][effect]" )
+{
+	// Process frames in order
+	Echo sequential(0.1, 0.5, 0.5);
+	std::vector<std::shared_ptr<Frame>> expected;
+	for (int64_t number = 1; number <= 40; number++)
+		expected.push_back(sequential.GetFrame(ToneFrame(number), number));
+
+	// The same frames (requested again, in any order) match
+	for (int64_t number : {35, 12, 20, 40, 1, 36}) {
+		auto frame = sequential.GetFrame(ToneFrame(number), number);
+		CHECK(MaxSampleDifference(frame, expected[number - 1]) == 0.0f);
+	}
+
+	// The echo continues between frames
+	Echo single(0.1, 0.5, 0.5);
+	auto frame = single.GetFrame(ToneFrame(12), 12);
+	CHECK(MaxSampleDifference(frame, expected[11]) > 0.0f);
+}
+
+TEST_CASE( "Echo frames after a frame which was processed late", "[libopenshot][audiostatecache][effect]" )
+{
+	Echo sequential(0.1, 0.5, 0.5);
+	std::vector<std::shared_ptr<Frame>> expected;
+	for (int64_t number = 1; number <= 5; number++)
+		expected.push_back(sequential.GetFrame(ToneFrame(number), number));
+
+	// Frame 3 is rendered before frame 2, and the following frames match the frames rendered in order
+	Echo parallel(0.1, 0.5, 0.5);
+	for (int64_t number : {1, 3, 2})
+		parallel.GetFrame(ToneFrame(number), number);
+	for (int64_t number : {4, 5}) {
+		auto frame = parallel.GetFrame(ToneFrame(number), number);
+		CHECK(MaxSampleDifference(frame, expected[number - 1]) == 0.0f);
+	}
+}
+
+TEST_CASE( "Compressor frames out of order", "[libopenshot][audiostatecache][effect]" )
+{
+	Compressor sequential(-30, 10, 0.01, 0.1, 0, false);
+	std::vector<std::shared_ptr<Frame>> expected;
+	for (int64_t number = 1; number <= 40; number++)
+		expected.push_back(sequential.GetFrame(ToneFrame(number), number));
+
+	for (int64_t number : {33, 7, 40, 2}) {
+		auto frame = sequential.GetFrame(ToneFrame(number), number);
+		CHECK(MaxSampleDifference(frame, expected[number - 1]) == 0.0f);
+	}
+
+	// Changing the properties starts from an empty state (without any cached audio)
+	sequential.SetJson("{\"ratio\": {\"Points\": [{\"co\": {\"X\": 1.0, \"Y\": 10.0}, \"interpolation\": 2}]}}");
+	auto frame = sequential.GetFrame(ToneFrame(7), 7);
+	Compressor single(-30, 10, 0.01, 0.1, 0, false);
+	CHECK(MaxSampleDifference(frame, single.GetFrame(ToneFrame(7), 7)) == 0.0f);
+	CHECK(MaxSampleDifference(frame, expected[6]) > 0.0f);
+}
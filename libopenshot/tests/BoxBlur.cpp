@@ -0,0 +1,253 @@
+/**
+ * @file
+ * @brief Unit tests for openshot::BoxBlur
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <QImage>
+
+#include "BoxBlur.h"
+#include "Frame.h"
+#include "effects/Blur.h"
+#include "openshot_catch.h"
+#include "test_utils.h"
+
+using namespace openshot;
+
+// The horizontal box blur of the Blur effect (before it used BoxBlur), which requires r < w
+static void OriginalBoxBlurH(unsigned char *scl, unsigned char *tcl, int w, int h, int r) {
+	float iarr = 1.0 / (r + r + 1);
+	for (int i = 0; i < h; ++i) {
+		for (int ch = 0; ch < 4; ++ch) {
+			int ti = i * w, li = ti, ri = ti + r;
+			int fv = scl[ti * 4 + ch], lv = scl[(ti + w - 1) * 4 + ch], val = (r + 1) * fv;
+			for (int j = 0; j < r; ++j) val += scl[(ti + j) * 4 + ch];
+			for (int j = 0; j <= r; ++j) {
+				val += scl[ri++ * 4 + ch] - fv;
+				tcl[ti++ * 4 + ch] = round(val * iarr);
+			}
+			for (int j = r + 1; j < w - r; ++j) {
+				val += scl[ri++ * 4 + ch] - scl[li++ * 4 + ch];
+				tcl[ti++ * 4 + ch] = round(val * iarr);
+			}
+			for (int j = w - r; j < w; ++j) {
+				val += lv - scl[li++ * 4 + ch];
+				tcl[ti++ * 4 + ch] = round(val * iarr);
+			}
+		}
+	}
+}
+
+// The vertical box blur of the Blur effect (before it used BoxBlur), which requires r < h
+static void OriginalBoxBlurT(unsigned char *scl, unsigned char *tcl, int w, int h, int r) {
+	float iarr = 1.0 / (r + r + 1);
+	for (int i = 0; i < w; i++) {
+		for (int ch = 0; ch < 4; ++ch) {
+			int ti = i, li = ti, ri = ti + r * w;
+			int fv = scl[ti * 4 + ch], lv = scl[(ti + w * (h - 1)) * 4 + ch], val = (r + 1) * fv;
+			for (int j = 0; j < r; j++) val += scl[(ti + j * w) * 4 + ch];
+			for (int j = 0; j <= r; j++) {
+				val += scl[ri * 4 + ch] - fv;
+				tcl[ti * 4 + ch] = round(val * iarr);
+				ri += w;
+				ti += w;
+			}
+			for (int j = r + 1; j < h - r; j++) {
+				val += scl[ri * 4 + ch] - scl[li * 4 + ch];
+				tcl[ti * 4 + ch] = round(val * iarr);
+				li += w;
+				ri += w;
+				ti += w;
+			}
+			for (int j = h - r; j < h; j++) {
+				val += lv - scl[li * 4 + ch];
+				tcl[ti * 4 + ch] = round(val * iarr);
+				li += w;
+				ti += w;
+			}
+		}
+	}
+}
+
+// Get the index of a pixel beyond the edges of a row or column (repeating the edge pixel, or reflecting the
+// pixels before it, one reflection at a time)
+static int NaiveEdgeIndex(int index, int last, BoxBlur::EdgeMode edges) {
+	if (edges == BoxBlur::EDGE_REPEAT || last == 0)
+		return std::clamp(index, 0, last);
+	while (index < 0 || index > last)
+		index = index < 0 ? -index : 2 * last - index;
+	return index;
+}
+
+// Average the pixels within a radius of each pixel, one axis at a time
+static QImage NaiveBoxBlur(const QImage& image, int horizontal_radius, int vertical_radius,
+						   BoxBlur::EdgeMode edges = BoxBlur::EDGE_REPEAT) {
+	const int channels = image.depth() / 8;
+	const int width = image.width();
+	const int height = image.height();
+	QImage horizontal = image.copy();
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width * channels && horizontal_radius > 0; x++) {
+			int sum = 0;
+			for (int i = -horizontal_radius; i <= horizontal_radius; i++)
+				sum += image.constScanLine(y)[NaiveEdgeIndex(x / channels + i, width - 1, edges) * channels + x % channels];
+			horizontal.scanLine(y)[x] = (unsigned char) std::floor(double(sum) / (2 * horizontal_radius + 1) + 0.5);
+		}
+	}
+	QImage vertical = horizontal.copy();
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width * channels && vertical_radius > 0; x++) {
+			int sum = 0;
+			for (int i = -vertical_radius; i <= vertical_radius; i++)
+				sum += horizontal.constScanLine(NaiveEdgeIndex(y + i, height - 1, edges))[x];
+			vertical.scanLine(y)[x] = (unsigned char) std::floor(double(sum) / (2 * vertical_radius + 1) + 0.5);
+		}
+	}
+	return vertical;
+}
+
+TEST_CASE( "Match the original box blur", "[libopenshot][boxblur]" )
+{
+	const int width = 301;
+	const int height = 173;
+	QImage image = RandomBytes(width, height, QImage::Format_RGBA8888_Premultiplied, 1);
+
+	for (int horizontal_radius : {1, 6, 40}) {
+		for (int vertical_radius : {1, 9, 86}) {
+			// Blur with the original loops (horizontally, then vertically, 3 times)
+			QImage expected = image.copy();
+			std::vector<unsigned char> blurred(size_t(width) * height * 4);
+			for (int iteration = 0; iteration < 3; iteration++) {
+				OriginalBoxBlurH(expected.bits(), blurred.data(), width, height, horizontal_radius);
+				OriginalBoxBlurT(blurred.data(), expected.bits(), width, height, vertical_radius);
+			}
+
+			QImage actual = image.copy();
+			BoxBlur::Blur(actual, horizontal_radius, vertical_radius, 3);
+			CHECK(MaxDifference(expected, actual) == 0);
+		}
+	}
+}
+
+TEST_CASE( "Radii larger than the image", "[libopenshot][boxblur]" )
+{
+	for (QImage::Format format : {QImage::Format_RGBA8888_Premultiplied, QImage::Format_Grayscale8}) {
+		// Odd widths leave unaligned rows (and SIMD tails) for single channel images
+		QImage image = RandomBytes(45, 23, format, 2);
+
+		for (int horizontal_radius : {0, 3, 44, 100}) {
+			for (int vertical_radius : {0, 2, 22, 70}) {
+				QImage expected = NaiveBoxBlur(image, horizontal_radius, vertical_radius);
+				QImage actual = image.copy();
+				BoxBlur::Blur(actual, horizontal_radius, vertical_radius);
+				CHECK(MaxDifference(expected, actual) == 0);
+			}
+		}
+	}
+
+	// A 1 pixel image is unchanged
+	QImage pixel = RandomBytes(1, 1, QImage::Format_RGBA8888_Premultiplied, 3);
+	QImage actual = pixel.copy();
+	BoxBlur::Blur(actual, 5, 5, 2);
+	CHECK(MaxDifference(pixel, actual) == 0);
+}
+
+TEST_CASE( "Reflect the pixels beyond the edges", "[libopenshot][boxblur]" )
+{
+	for (QImage::Format format : {QImage::Format_RGBA8888_Premultiplied, QImage::Format_Grayscale8}) {
+		QImage image = RandomBytes(45, 23, format, 5);
+
+		// Radii larger than the image reflect more than once
+		for (int horizontal_radius : {0, 3, 44, 100}) {
+			for (int vertical_radius : {0, 2, 22, 70}) {
+				QImage expected = NaiveBoxBlur(image, horizontal_radius, vertical_radius, BoxBlur::EDGE_REFLECT);
+				QImage actual = image.copy();
+				std::vector<int> horizontal_radii = {horizontal_radius};
+				std::vector<int> vertical_radii = {vertical_radius};
+				BoxBlur::Blur(actual.bits(), actual.width(), actual.height(), actual.bytesPerLine(), actual.depth() / 8,
+							  horizontal_radii, vertical_radii, BoxBlur::EDGE_REFLECT);
+				CHECK(MaxDifference(expected, actual) == 0);
+			}
+		}
+	}
+
+	// A single row or column has nothing to reflect
+	QImage row = RandomBytes(17, 1, QImage::Format_Grayscale8, 6);
+	QImage actual = row.copy();
+	BoxBlur::Blur(actual.bits(), actual.width(), actual.height(), actual.bytesPerLine(), 1, {0}, {5}, BoxBlur::EDGE_REFLECT);
+	CHECK(MaxDifference(row, actual) == 0);
+}
+
+TEST_CASE( "Kernel radii", "[libopenshot][boxblur]" )
+{
+	// The boxes reach as far as OpenCV's Gaussian kernel (6 sigma + 1 pixels wide, rounded to an odd width)
+	CHECK(BoxBlur::KernelRadii(0.8) == std::vector<int>({1, 1, 1}));
+	CHECK(BoxBlur::KernelRadii(1.0) == std::vector<int>({1, 1, 1}));
+	CHECK(BoxBlur::KernelRadii(1.5) == std::vector<int>({2, 2, 1}));
+	CHECK(BoxBlur::KernelRadii(3.0) == std::vector<int>({3, 3, 3}));
+	CHECK(BoxBlur::KernelRadii(0.01) == std::vector<int>({0, 0, 0}));
+
+	// A blurred mask reaches as far as the sum of the radii (at the edges too)
+	QImage mask(20, 9, QImage::Format_Grayscale8);
+	mask.fill(0);
+	for (int y = 0; y < 9; y++)
+		mask.scanLine(y)[0] = 255;
+	std::vector<int> radii = BoxBlur::KernelRadii(1.0);
+	BoxBlur::Blur(mask.bits(), mask.width(), mask.height(), mask.bytesPerLine(), 1, radii, radii, BoxBlur::EDGE_REFLECT);
+	for (int y : {0, 4, 8}) {
+		CHECK(mask.constScanLine(y)[3] > 0);
+		CHECK(mask.constScanLine(y)[4] == 0);
+	}
+}
+
+TEST_CASE( "Gaussian radii", "[libopenshot][boxblur]" )
+{
+	CHECK(BoxBlur::GaussianRadii(3.0) == std::vector<int>({2, 2, 3}));
+	CHECK(BoxBlur::GaussianRadii(10.0) == std::vector<int>({9, 9, 10}));
+	CHECK(BoxBlur::GaussianRadii(0.1) == std::vector<int>({0, 0, 0}));
+	CHECK(BoxBlur::GaussianRadii(0.0) == std::vector<int>({0, 0, 0}));
+
+	// A Gaussian blur spreads a single white pixel evenly, as far as the sum of its radii
+	QImage image(41, 41, QImage::Format_Grayscale8);
+	image.fill(0);
+	image.scanLine(20)[20] = 255;
+	BoxBlur::GaussianBlur(image, 3.0);
+	CHECK(image.constScanLine(20)[20] > 0);
+	CHECK(image.constScanLine(20)[20] < 255);
+	CHECK(image.constScanLine(16)[20] == image.constScanLine(24)[20]);
+	CHECK(image.constScanLine(20)[16] == image.constScanLine(20)[24]);
+	CHECK(image.constScanLine(20)[12] == 0);
+	CHECK(image.constScanLine(28)[20] == 0);
+}
+
+TEST_CASE( "Blur in a single direction", "[libopenshot][boxblur][effect]" )
+{
+	auto image = std::make_shared<QImage>(RandomBytes(64, 48, QImage::Format_RGBA8888_Premultiplied, 4));
+	QImage expected = NaiveBoxBlur(*image, 5, 0);
+
+	// Horizontal only (each iteration must build on the previous iteration)
+	auto frame = std::make_shared<Frame>(1, 64, 48, "#000000");
+	frame->AddImage(std::make_shared<QImage>(image->copy()));
+	Blur effect(Keyframe(5.0), Keyframe(0.0), Keyframe(3.0), Keyframe(1.0));
+	frame = effect.GetFrame(frame, 1);
+	CHECK(MaxDifference(expected, *frame->GetImage()) == 0);
+
+	expected = NaiveBoxBlur(NaiveBoxBlur(*image, 0, 4), 0, 4);
+	frame->AddImage(std::make_shared<QImage>(image->copy()));
+	Blur vertical(Keyframe(0.0), Keyframe(4.0), Keyframe(3.0), Keyframe(2.0));
+	frame = vertical.GetFrame(frame, 1);
+	CHECK(MaxDifference(expected, *frame->GetImage()) == 0);
+}
@@ -0,0 +1,132 @@
+/**
+ * @file
+ * @brief Unit tests for openshot::BufferPool
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <cstdint>
+#include <memory>
+
+#include <QColor>
+#include <QImage>
+
+#include "openshot_catch.h"
+
+#include "BufferPool.h"
+#include "CacheMemory.h"
+
+using namespace openshot;
+
+TEST_CASE( "Max bytes from cache", "[libopenshot][bufferpool]" )
+{
+	BufferPool *pool = BufferPool::Instance();
+
+	// The limit follows the largest cache
+	CacheMemory cache(INT64_C(800) * 1024 * 1024);
+	CHECK(pool->GetStats().max_bytes == INT64_C(100) * 1024 * 1024);
+	cache.SetMaxBytes(INT64_C(1600) * 1024 * 1024);
+	CHECK(pool->GetStats().max_bytes == INT64_C(200) * 1024 * 1024);
+
+	// Until it's set explicitly
+	pool->SetMaxBytes(1024);
+	cache.SetMaxBytes(INT64_C(3200) * 1024 * 1024);
+	CHECK(pool->GetStats().max_bytes == 1024);
+}
+
+TEST_CASE( "Re-use buffers", "[libopenshot][bufferpool]" )
+{
+	BufferPool *pool = BufferPool::Instance();
+	pool->SetMaxBytes(64 * 1024 * 1024);
+	pool->Clear();
+	pool->ResetStats();
+
+	// Buffers are aligned
+	void* buffer = pool->Allocate(100000);
+	CHECK(reinterpret_cast<uintptr_t>(buffer) % 64 == 0);
+	CHECK(pool->GetStats().misses == 1);
+	CHECK(pool->GetStats().hits == 0);
+
+	// Released buffers are re-used for the same size
+	pool->Release(buffer);
+	CHECK(pool->GetStats().buffers_retained == 1);
+	CHECK(pool->GetStats().bytes_retained >= 100000);
+	void* buffer2 = pool->Allocate(100000);
+	CHECK(buffer2 == buffer);
+	CHECK(pool->GetStats().hits == 1);
+	CHECK(pool->GetStats().buffers_retained == 0);
+	CHECK(pool->GetStats().bytes_retained == 0);
+
+	// But not for a different size
+	pool->Release(buffer2);
+	void* buffer3 = pool->Allocate(200000);
+	CHECK(pool->GetStats().misses == 2);
+	pool->Release(buffer3);
+	CHECK(pool->GetStats().buffers_retained == 2);
+
+	pool->Clear();
+	CHECK(pool->GetStats().buffers_retained == 0);
+	CHECK(pool->GetStats().bytes_retained == 0);
+}
+
+TEST_CASE( "Max bytes", "[libopenshot][bufferpool]" )
+{
+	BufferPool *pool = BufferPool::Instance();
+	pool->SetMaxBytes(300000);
+	pool->Clear();
+
+	// Free buffers over the limit are not retained
+	void* buffer1 = pool->Allocate(200000);
+	void* buffer2 = pool->Allocate(200000);
+	pool->Release(buffer1);
+	pool->Release(buffer2);
+	CHECK(pool->GetStats().buffers_retained == 1);
+	CHECK(pool->GetStats().bytes_retained <= 300000);
+	CHECK(pool->GetStats().max_bytes == 300000);
+
+	// Nothing is retained without a limit
+	pool->SetMaxBytes(0);
+	pool->Clear();
+	pool->Release(pool->Allocate(1000));
+	CHECK(pool->GetStats().buffers_retained == 0);
+}
+
+TEST_CASE( "Pooled images", "[libopenshot][bufferpool]" )
+{
+	BufferPool *pool = BufferPool::Instance();
+	pool->SetMaxBytes(64 * 1024 * 1024);
+	pool->Clear();
+	pool->ResetStats();
+
+	const uchar* pixels = nullptr;
+	{
+		std::shared_ptr<QImage> image = pool->CreateImage(640, 480, QImage::Format_RGBA8888_Premultiplied);
+		CHECK(image->width() == 640);
+		CHECK(image->height() == 480);
+		CHECK(image->format() == QImage::Format_RGBA8888_Premultiplied);
+		image->fill(QColor(Qt::red));
+		CHECK(image->pixelColor(639, 479) == QColor(Qt::red));
+		pixels = image->constBits();
+
+		// Copies share the pooled buffer
+		QImage copy = *image;
+		image.reset();
+		CHECK(pool->GetStats().buffers_retained == 0);
+		CHECK(copy.constBits() == pixels);
+	}
+
+	// The buffer is returned with the last image using it (and re-used by the next image)
+	CHECK(pool->GetStats().buffers_retained == 1);
+	std::shared_ptr<QImage> image = pool->CreateImage(640, 480, QImage::Format_RGBA8888_Premultiplied);
+	CHECK(image->constBits() == pixels);
+	CHECK(pool->GetStats().hits == 1);
+	CHECK(pool->GetStats().misses == 1);
+
+	image.reset();
+	pool->Clear();
+}
@@ -11,9 +11,12 @@
 //
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
+#include <cstdlib>
 #include <sstream>
 #include <memory>
 
+#include <QFileInfo>
+
 #include "openshot_catch.h"
 
 #include "Clip.h"
@@ -23,27 +26,175 @@
 
 using namespace openshot;
 
-std::string effectInfo =(" {\"protobuf_data_path\": \"objdetector.data\", "
-                         "  \"processing_device\": \"GPU\", "
-                         "  \"model_configuration\": \"~/yolo/yolov3.cfg\", "
-                         "  \"model_weights\": \"~/yolo/yolov3.weights\", "
-                         "  \"classes_file\": \"~/yolo/obj.names\"} ");
+// The YOLOv3 model (and the video) are not part of the test media, so the tests which run the network are
+// hidden (tagged [.yolo]). Run them with the model in ~/yolo and the video in the test media, for example:
+// openshot-CVObjectDetection-test "[yolo]"
+static std::string ModelPath(const std::string& file) {
+    const char* home = std::getenv("HOME");
+    return std::string(home ? home : "") + "/yolo/" + file;
+}
+
+static bool HasDetectionMedia() {
+    std::stringstream path;
+    path << TEST_MEDIA_PATH << "run.mp4";
+    for (const std::string& file : {path.str(), ModelPath("yolov3.cfg"), ModelPath("yolov3.weights"), ModelPath("obj.names")})
+        if (!QFileInfo(QString::fromStdString(file)).isFile())
+            return false;
+    return true;
+}
+
+static std::string EffectInfo(int batchSize = 4, int detectionInterval = 1) {
+    Json::Value root;
+    root["protobuf_data_path"] = "objdetector.data";
+    root["processing-device"] = "CPU";
+    root["model-config"] = ModelPath("yolov3.cfg");
+    root["model-weights"] = ModelPath("yolov3.weights");
+    root["class-names"] = ModelPath("obj.names");
+    root["batch-size"] = batchSize;
+    root["detection-interval"] = detectionInterval;
+    return root.toStyledString();
+}
 
 // Just for the stabilizer constructor, it won't be used
 ProcessingController processingController;
 
-TEST_CASE( "DetectObject_Video", "[libopenshot][opencv][objectdetection]" )
+TEST_CASE( "Split the outputs of a batch", "[libopenshot][opencv][objectdetection]" )
+{
+    // 2 output layers (with a different number of boxes), for a batch of 3 frames (each value is the frame
+    // number * 1000 + the box number * 100 + the column)
+    const int batchFrames = 3;
+    const int cols = 85;
+    std::vector<cv::Mat> outs;
+    for (int boxes : {5, 2}) {
+        cv::Mat out(batchFrames * boxes, cols, CV_32F);
+        for (int row = 0; row < out.rows; row++)
+            for (int col = 0; col < cols; col++)
+                out.at<float>(row, col) = (row / boxes) * 1000 + (row % boxes) * 100 + col;
+        outs.push_back(out);
+    }
+
+    // 3D outputs (frames x boxes x columns) are split the same way
+    int sizes[] = {batchFrames, 4, cols};
+    cv::Mat out3d(3, sizes, CV_32F);
+    for (int frame = 0; frame < batchFrames; frame++)
+        for (int box = 0; box < 4; box++)
+            for (int col = 0; col < cols; col++)
+                out3d.at<float>(frame, box, col) = frame * 1000 + box * 100 + col;
+    outs.push_back(out3d);
+
+    std::vector<std::vector<cv::Mat>> frameOuts = CVObjectDetection::splitBatchOutputs(outs, batchFrames);
+    REQUIRE(frameOuts.size() == batchFrames);
+    for (int frame = 0; frame < batchFrames; frame++) {
+        REQUIRE(frameOuts[frame].size() == 3);
+        int layer = 0;
+        for (int boxes : {5, 2, 4}) {
+            const cv::Mat& frameOut = frameOuts[frame][layer++];
+            CHECK(frameOut.rows == boxes);
+            CHECK(frameOut.cols == cols);
+            for (int box = 0; box < frameOut.rows; box++) {
+                CHECK(frameOut.at<float>(box, 0) == frame * 1000 + box * 100);
+                CHECK(frameOut.at<float>(box, cols - 1) == frame * 1000 + box * 100 + cols - 1);
+            }
+        }
+    }
+
+    // A batch of 1 frame keeps every row
+    frameOuts = CVObjectDetection::splitBatchOutputs({outs[0]}, 1);
+    REQUIRE(frameOuts.size() == 1);
+    CHECK(frameOuts[0][0].rows == batchFrames * 5);
+}
+
+TEST_CASE( "Predict the tracked objects between detections", "[libopenshot][opencv][objectdetection]" )
+{
+    // An object moving right by 10 pixels on each frame
+    SortTracker sort;
+    auto box = [](int frame) { return cv::Rect(100 + 10 * frame, 200, 80, 120); };
+    for (int frame = 1; frame <= 4; frame++)
+        sort.update({box(frame)}, frame, 1000.0, {0.9f}, {0});
+    REQUIRE(sort.trackers.size() == 1);
+    const int hitStreak = sort.trackers[0].m_hit_streak;
+    REQUIRE(hitStreak >= 2);
+
+    // Predicted frames move the tracker along, without counting as frames where the object was missed
+    for (int frame = 5; frame <= 6; frame++) {
+        sort.predict(frame);
+        REQUIRE(sort.frameTrackingResult.size() == 1);
+        CHECK(sort.frameTrackingResult[0].frame == frame);
+        CHECK(sort.frameTrackingResult[0].id == sort.trackers[0].m_id);
+        CHECK(sort.frameTrackingResult[0].box.x > box(frame - 1).x);
+        CHECK(sort.trackers[0].m_time_since_update == 0);
+        CHECK(sort.trackers[0].m_hit_streak == hitStreak);
+    }
+
+    // The next detection matches the predicted object
+    sort.update({box(7)}, 7, 1000.0, {0.9f}, {0});
+    CHECK(sort.trackers.size() == 1);
+    CHECK(sort.matchedPairs.size() == 1);
+    CHECK(sort.unmatchedDetections.empty());
+    REQUIRE(sort.frameTrackingResult.size() == 1);
+    CHECK(sort.frameTrackingResult[0].frame == 7);
+}
+
+// The network outputs of a frame, with an object (of class 0, and 90% confidence) centered at each x
+static std::vector<cv::Mat> DetectionOutputs(const std::vector<float>& centers) {
+    cv::Mat out((int) centers.size(), 7, CV_32F, cv::Scalar(0));
+    for (int row = 0; row < out.rows; row++) {
+        out.at<float>(row, 0) = centers[row];
+        out.at<float>(row, 1) = 0.5f;
+        out.at<float>(row, 2) = 0.1f;
+        out.at<float>(row, 3) = 0.2f;
+        out.at<float>(row, 4) = 0.9f;
+        out.at<float>(row, 5) = 0.9f;
+    }
+    return {out};
+}
+
+TEST_CASE( "Detect less often while the tracker is reliable", "[libopenshot][opencv][objectdetection]" )
+{
+    CVObjectDetection objectDetector(R"({"detection-interval": 8})", processingController);
+    const cv::Size frameSize(640, 360);
+
+    // Each reliable detection of a still object doubles the number of frames to the next detection (up to 8)
+    size_t frame = 1;
+    for (int expectedStep : {1, 2, 4, 8, 8}) {
+        CHECK(objectDetector._PostprocessFrame(frame, frameSize, DetectionOutputs({0.3f})) == expectedStep);
+        frame += expectedStep;
+    }
+    REQUIRE(frame == 24);
+
+    // A new object makes the tracker unreliable, so the next frame is detected again
+    CHECK(objectDetector._PostprocessFrame(24, frameSize, DetectionOutputs({0.3f, 0.7f})) == 1);
+    CHECK(objectDetector._PostprocessFrame(25, frameSize, DetectionOutputs({0.3f, 0.7f})) == 2);
+
+    // Every frame between detections is filled with the position predicted by the tracker (which only
+    // reports an object once it was detected twice in a row, after the first 2 frames)
+    REQUIRE(objectDetector.detectionsData.size() == 25);
+    REQUIRE(objectDetector.detectionsData.at(4).objectIds.size() == 1);
+    const int objectId = objectDetector.detectionsData.at(4).objectIds[0];
+    for (size_t frameId = 1; frameId <= 25; frameId++) {
+        const CVDetectionData& data = objectDetector.detectionsData.at(frameId);
+        CHECK(data.frameId == frameId);
+        if (frameId < 4)
+            continue;
+        REQUIRE(data.boxes.size() == 1);
+        CHECK(data.objectIds[0] == objectId);
+        CHECK(data.boxes[0].x + data.boxes[0].width / 2 == Approx(0.3).margin(0.01));
+    }
+}
+
+TEST_CASE( "DetectObject_Video", "[libopenshot][opencv][objectdetection][.yolo]" )
 {
     // Create a video clip
     std::stringstream path;
     path << TEST_MEDIA_PATH << "run.mp4";
 
+    REQUIRE(HasDetectionMedia());
+
     // Open clip
     openshot::Clip c1(path.str());
     c1.Open();
 
-    //TODO remove hardcoded path
-    CVObjectDetection objectDetector(effectInfo, processingController);
+    CVObjectDetection objectDetector(EffectInfo(), processingController);
 
     objectDetector.detectObjectsClip(c1, 1, 20, true);
 
@@ -66,19 +217,20 @@ TEST_CASE( "DetectObject_Video", "[libopenshot][opencv][objectdetection]" )
 }
 
 
-TEST_CASE( "SaveLoad_Protobuf", "[libopenshot][opencv][objectdetection]" )
+TEST_CASE( "SaveLoad_Protobuf", "[libopenshot][opencv][objectdetection][.yolo]" )
 {
 
     // Create a video clip
     std::stringstream path;
     path << TEST_MEDIA_PATH << "run.mp4";
 
+    REQUIRE(HasDetectionMedia());
+
     // Open clip
     openshot::Clip c1(path.str());
     c1.Open();
 
-    //TODO remove hardcoded path
-    CVObjectDetection objectDetector_1(effectInfo ,processingController);
+    CVObjectDetection objectDetector_1(EffectInfo(), processingController);
 
     objectDetector_1.detectObjectsClip(c1, 1, 20, true);
 
@@ -93,7 +245,7 @@ TEST_CASE( "SaveLoad_Protobuf", "[libopenshot][opencv][objectdetection]" )
 
     objectDetector_1.SaveObjDetectedData();
 
-    CVObjectDetection objectDetector_2(effectInfo, processingController);
+    CVObjectDetection objectDetector_2(EffectInfo(), processingController);
 
     objectDetector_2._LoadObjDetectdData();
 
@@ -113,3 +265,57 @@ TEST_CASE( "SaveLoad_Protobuf", "[libopenshot][opencv][objectdetection]" )
     CHECK((int) (confidence_1 * 1000) == (int) (confidence_2 * 1000));
     CHECK(classId_1 == classId_2);
 }
+
+TEST_CASE( "Batches detect the same objects as single frames", "[libopenshot][opencv][objectdetection][.yolo]" )
+{
+    std::stringstream path;
+    path << TEST_MEDIA_PATH << "run.mp4";
+
+    REQUIRE(HasDetectionMedia());
+
+    openshot::Clip c1(path.str());
+    c1.Open();
+
+    CVObjectDetection single(EffectInfo(1), processingController);
+    single.detectObjectsClip(c1, 1, 20, true);
+    CVObjectDetection batched(EffectInfo(4), processingController);
+    batched.detectObjectsClip(c1, 1, 20, true);
+
+    REQUIRE(single.detectionsData.size() == 20);
+    REQUIRE(batched.detectionsData.size() == single.detectionsData.size());
+    for (const auto& frame : single.detectionsData) {
+        const CVDetectionData& expected = frame.second;
+        const CVDetectionData& actual = batched.detectionsData.at(frame.first);
+        CHECK(actual.classIds == expected.classIds);
+        CHECK(actual.objectIds == expected.objectIds);
+        REQUIRE(actual.boxes.size() == expected.boxes.size());
+        for (size_t i = 0; i < expected.boxes.size(); i++) {
+            CHECK(actual.boxes[i].x == Approx(expected.boxes[i].x).margin(0.0001));
+            CHECK(actual.boxes[i].y == Approx(expected.boxes[i].y).margin(0.0001));
+            CHECK(actual.boxes[i].width == Approx(expected.boxes[i].width).margin(0.0001));
+            CHECK(actual.boxes[i].height == Approx(expected.boxes[i].height).margin(0.0001));
+            CHECK(actual.confidences[i] == Approx(expected.confidences[i]).margin(0.0001));
+        }
+    }
+}
+
+TEST_CASE( "Every frame is tracked with a detection interval", "[libopenshot][opencv][objectdetection][.yolo]" )
+{
+    std::stringstream path;
+    path << TEST_MEDIA_PATH << "run.mp4";
+
+    REQUIRE(HasDetectionMedia());
+
+    openshot::Clip c1(path.str());
+    c1.Open();
+
+    // The frames between detections are predicted by the tracker
+    CVObjectDetection objectDetector(EffectInfo(4, 8), processingController);
+    objectDetector.detectObjectsClip(c1, 1, 40, true);
+
+    CHECK(objectDetector.detectionsData.size() == 40);
+    for (size_t frame = 1; frame <= 40; frame++) {
+        REQUIRE(objectDetector.detectionsData.count(frame) == 1);
+        CHECK(objectDetector.detectionsData.at(frame).frameId == frame);
+    }
+}
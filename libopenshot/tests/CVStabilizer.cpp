@@ -12,14 +12,19 @@
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
 #include <sstream>
+#include <map>
 #include <memory>
 #include <cmath>
 
 #include "openshot_catch.h"
 
+#include "CacheMemory.h"
 #include "Clip.h"
 #include "CVStabilization.h"  // for TransformParam, CamTrajectory, CVStabilization
+#include "DummyReader.h"
+#include "Json.h"
 #include "ProcessingController.h"
+#include "effects/Stabilizer.h"
 
 using namespace openshot;
 
@@ -116,4 +121,150 @@ TEST_CASE( "SaveLoad_Protobuf", "[libopenshot][opencv][stabilizer]" )
     CHECK((int) (ct_1.x * 10000) == (int) (ct_2.x * 10000));
     CHECK((int) (ct_1.y * 10000) == (int) (ct_2.y * 10000));
     CHECK((int) (ct_1.a * 10000) == (int) (ct_2.a * 10000));
+
+    // Load the same data in the Stabilizer effect
+    Stabilizer effect;
+    REQUIRE(effect.LoadStabilizedData("stabilizer.data"));
+    std::map<size_t, EffectTransformParam> transformations = effect.TransformationData();
+    CHECK(transformations.size() == stabilizer_1.transformationData.size());
+    CHECK(effect.TrajectoryData().size() == stabilizer_1.trajectoryData.size());
+    REQUIRE(transformations.count(20) == 1);
+    CHECK((int) (tp_1.dx * 10000) == (int) (transformations[20].dx * 10000));
+    CHECK((int) (tp_1.dy * 10000) == (int) (transformations[20].dy * 10000));
+    CHECK((int) (tp_1.da * 10000) == (int) (transformations[20].da * 10000));
+}
+
+TEST_CASE( "Find the transformations of sparse frames", "[libopenshot][opencv][stabilizer]" )
+{
+    // Sparse frame numbers are looked up in a sorted vector (instead of a huge range of frames)
+    StabilizationData data;
+    data.first_frame = 3;
+    data.frame_numbers = {3, 10, 2000000000};
+    data.transformations = {EffectTransformParam(1, 0, 0), EffectTransformParam(2, 0, 0), EffectTransformParam(3, 0, 0)};
+    data.has_transformation = {true, true, true};
+
+    CHECK(data.Transformation(2) == nullptr);
+    CHECK(data.Transformation(4) == nullptr);
+    CHECK(data.Transformation(2000000001) == nullptr);
+    REQUIRE(data.Transformation(10) != nullptr);
+    CHECK(data.Transformation(10)->dx == 2);
+    REQUIRE(data.Transformation(2000000000) != nullptr);
+    CHECK(data.Transformation(2000000000)->dx == 3);
+    CHECK(data.FrameNumber(2) == 2000000000);
+
+    // A range of frames is indexed from the first frame
+    data.frame_numbers.clear();
+    data.has_transformation[1] = false;
+    REQUIRE(data.Transformation(3) != nullptr);
+    CHECK(data.Transformation(3)->dx == 1);
+    CHECK(data.Transformation(4) == nullptr);
+    REQUIRE(data.Transformation(5) != nullptr);
+    CHECK(data.Transformation(5)->dx == 3);
+    CHECK(data.Transformation(6) == nullptr);
+    CHECK(data.FrameNumber(2) == 5);
+}
+
+// Stabilize the frames of a clip from 1 to end (which gives a transformation for each frame after the first)
+static void StabilizeFrames(CVStabilization& stabilizer, openshot::Clip& clip, size_t end) {
+    stabilizer.stabilizeClip(clip, 1, end, true);
+    REQUIRE(stabilizer.transformationData.size() == end - 1);
+    REQUIRE(stabilizer.trajectoryData.size() == end - 1);
+}
+
+// Get the settings of a stabilizer (with a number of workers, and optionally a smaller analysis width)
+static std::string StabilizerJson(int threads, int analysisWidth = 0) {
+    Json::Value root;
+    root["protobuf_data_path"] = "stabilizer.data";
+    root["smoothing-window"] = 30;
+    root["threads"] = threads;
+    root["analysis-width"] = analysisWidth;
+    return root.toStyledString();
+}
+
+TEST_CASE( "Stabilize segments in parallel", "[libopenshot][opencv][stabilizer]" )
+{
+    std::stringstream path;
+    path << TEST_MEDIA_PATH << "test.avi";
+    openshot::Clip c1(path.str());
+    c1.Open();
+
+    // 90 frames are split into 3 segments of 30 frames (each decoded by its own copy of the clip)
+    CVStabilization serial(StabilizerJson(1), stabilizer_pc);
+    StabilizeFrames(serial, c1, 90);
+    CVStabilization parallel(StabilizerJson(3), stabilizer_pc);
+    StabilizeFrames(parallel, c1, 90);
+
+    // Every frame has the same transformation as when the frames are analysed in order
+    REQUIRE(parallel.transformationData.size() == serial.transformationData.size());
+    for (const auto& frame : serial.transformationData) {
+        REQUIRE(parallel.transformationData.count(frame.first) == 1);
+        const TransformParam& tp = parallel.transformationData.at(frame.first);
+        CHECK(tp.dx == Approx(frame.second.dx).margin(0.00001));
+        CHECK(tp.dy == Approx(frame.second.dy).margin(0.00001));
+        CHECK(tp.da == Approx(frame.second.da).margin(0.00001));
+
+        const CamTrajectory& expected = serial.trajectoryData.at(frame.first);
+        const CamTrajectory& ct = parallel.trajectoryData.at(frame.first);
+        CHECK(ct.x == Approx(expected.x).margin(0.00001));
+        CHECK(ct.y == Approx(expected.y).margin(0.00001));
+        CHECK(ct.a == Approx(expected.a).margin(0.00001));
+    }
+}
+
+TEST_CASE( "Stabilize a clip which can't be copied", "[libopenshot][opencv][stabilizer]" )
+{
+    std::stringstream path;
+    path << TEST_MEDIA_PATH << "test.avi";
+    openshot::Clip c1(path.str());
+    c1.Open();
+
+    // A DummyReader of cached frames (which are not part of its JSON, so the clip is analysed by a single worker)
+    openshot::CacheMemory cache;
+    for (int64_t frame_number = 1; frame_number <= 60; frame_number++)
+        cache.Add(c1.Reader()->GetFrame(frame_number));
+    openshot::DummyReader reader(openshot::Fraction(30, 1), 640, 360, 44100, 2, 2.0, &cache);
+    reader.Open();
+    openshot::Clip dummy(&reader);
+    dummy.Open();
+
+    CVStabilization expected(StabilizerJson(1), stabilizer_pc);
+    StabilizeFrames(expected, c1, 60);
+    CVStabilization stabilizer(StabilizerJson(2), stabilizer_pc);
+    StabilizeFrames(stabilizer, dummy, 60);
+
+    REQUIRE(stabilizer.transformationData.size() == expected.transformationData.size());
+    for (const auto& frame : expected.transformationData) {
+        const TransformParam& tp = stabilizer.transformationData.at(frame.first);
+        CHECK(tp.dx == Approx(frame.second.dx).margin(0.00001));
+        CHECK(tp.dy == Approx(frame.second.dy).margin(0.00001));
+        CHECK(tp.da == Approx(frame.second.da).margin(0.00001));
+    }
+}
+
+TEST_CASE( "Stabilize at a smaller analysis width", "[libopenshot][opencv][stabilizer]" )
+{
+    std::stringstream path;
+    path << TEST_MEDIA_PATH << "test.avi";
+    openshot::Clip c1(path.str());
+    c1.Open();
+
+    CVStabilization full(StabilizerJson(1), stabilizer_pc);
+    StabilizeFrames(full, c1, 60);
+    CVStabilization half(StabilizerJson(1, 320), stabilizer_pc);
+    StabilizeFrames(half, c1, 60);
+
+    // The motion found in the half size frames is scaled back to the size of the video (so it's close to the
+    // motion found in the full size frames, on average)
+    REQUIRE(half.transformationData.size() == full.transformationData.size());
+    double dx_error = 0.0, dy_error = 0.0, da_error = 0.0;
+    for (const auto& frame : full.transformationData) {
+        const TransformParam& tp = half.transformationData.at(frame.first);
+        dx_error += std::fabs(tp.dx - frame.second.dx);
+        dy_error += std::fabs(tp.dy - frame.second.dy);
+        da_error += std::fabs(tp.da - frame.second.da);
+    }
+    const double frames = full.transformationData.size();
+    CHECK(dx_error / frames < 0.002);
+    CHECK(dy_error / frames < 0.002);
+    CHECK(da_error / frames < 0.002);
 }
@@ -18,6 +18,9 @@
 
 #include "Clip.h"
 #include "CVTracker.h"  // for FrameData, CVTracker
+#include "Json.h"
+#include "TrackedObjectBBox.h"
+#include "effects/Tracker.h"
 #include "ProcessingController.h"
 #include "Exceptions.h"
 
@@ -184,3 +187,120 @@ TEST_CASE( "SaveLoad_Protobuf", "[libopenshot][opencv][tracker]" )
     CHECK(height_1 == Approx(height_2).margin(0.01));
 
 }
+
+TEST_CASE( "Track_Multiple_Objects", "[libopenshot][opencv][tracker]" )
+{
+    // Create a video clip
+    std::stringstream path;
+    path << TEST_MEDIA_PATH << "test.avi";
+
+    // Open clip
+    openshot::Clip c1(path.str());
+    c1.Open();
+
+    std::string json_data = R"proto(
+    {
+        "protobuf_data_path": "kcf_multi_tracker.data",
+        "tracker-type": "KCF",
+        "regions": [
+            {
+                "normalized_x": 0.459375,
+                "normalized_y": 0.28333,
+                "normalized_width": 0.28125,
+                "normalized_height": 0.461111,
+                "first-frame": 1
+            },
+            {
+                "normalized_x": 0.1,
+                "normalized_y": 0.1,
+                "normalized_width": 0.2,
+                "normalized_height": 0.2
+            }
+        ]
+    } )proto";
+
+    // Create tracker
+    ProcessingController tracker_pc;
+    CVTracker kcfTracker(json_data, tracker_pc);
+    CHECK(kcfTracker.ObjectCount() == 2);
+
+    // Track clip for frames 0-20
+    kcfTracker.trackClip(c1, 1, 20, true);
+
+    // The first object is tracked like a single object
+    FrameData fd = kcfTracker.GetTrackedData(20);
+    int x = (float)fd.x1 * 640;
+    int y = (float)fd.y1 * 360;
+    int width = ((float)fd.x2*640) - x;
+    int height = ((float)fd.y2*360) - y;
+
+    CHECK(x == Approx(256).margin(1));
+    CHECK(y == Approx(132).margin(1));
+    CHECK(width == Approx(180).margin(1));
+    CHECK(height == Approx(166).margin(2));
+
+    // The second object starts at its region, and is tracked like it would be on its own
+    FrameData first_2 = kcfTracker.GetTrackedData(1, 1);
+    CHECK(first_2.x1 == Approx(0.1).margin(0.01));
+    CHECK(first_2.y1 == Approx(0.1).margin(0.01));
+    CHECK(first_2.x2 == Approx(0.3).margin(0.01));
+    CHECK(first_2.y2 == Approx(0.3).margin(0.01));
+
+    std::string single_json = R"proto(
+    {
+        "protobuf_data_path": "kcf_single_tracker.data",
+        "tracker-type": "KCF",
+        "region": {
+            "normalized_x": 0.1,
+            "normalized_y": 0.1,
+            "normalized_width": 0.2,
+            "normalized_height": 0.2,
+            "first-frame": 1
+        }
+    } )proto";
+    ProcessingController single_pc;
+    CVTracker singleTracker(single_json, single_pc);
+    singleTracker.trackClip(c1, 1, 20, true);
+    FrameData expected_2 = singleTracker.GetTrackedData(20);
+
+    FrameData fd_2 = kcfTracker.GetTrackedData(20, 1);
+    CHECK(fd_2.x1 == Approx(expected_2.x1).margin(0.001));
+    CHECK(fd_2.y1 == Approx(expected_2.y1).margin(0.001));
+    CHECK(fd_2.x2 == Approx(expected_2.x2).margin(0.001));
+    CHECK(fd_2.y2 == Approx(expected_2.y2).margin(0.001));
+
+    // KCF keeps the size of the box
+    CHECK(fd_2.x2 - fd_2.x1 == Approx(0.2).margin(0.02));
+    CHECK(fd_2.y2 - fd_2.y1 == Approx(0.2).margin(0.02));
+    CHECK(kcfTracker.GetTrackedData(20, 2).x1 == -1.0f);
+
+    // Save and load both objects
+    kcfTracker.SaveTrackedData();
+    CVTracker loadedTracker(json_data, tracker_pc);
+    loadedTracker._LoadTrackedData();
+
+    CHECK(loadedTracker.ObjectCount() == 2);
+    CHECK(loadedTracker.GetTrackedData(20).x1 == Approx(fd.x1).margin(0.01));
+    CHECK(loadedTracker.GetTrackedData(20, 1).x1 == Approx(fd_2.x1).margin(0.01));
+    CHECK(loadedTracker.GetTrackedData(20, 1).y2 == Approx(fd_2.y2).margin(0.01));
+
+    // The Tracker effect loads both objects
+    Tracker tracker("kcf_multi_tracker.data");
+    REQUIRE(tracker.trackedObjects.size() == 2);
+    auto box_2 = std::dynamic_pointer_cast<TrackedObjectBBox>(tracker.trackedObjects.at(1));
+    REQUIRE(box_2);
+    CHECK(box_2->Id() == "1");
+    BBox bbox_2 = box_2->GetBox(20);
+    CHECK(bbox_2.cx == Approx((fd_2.x1 + fd_2.x2) / 2).margin(0.01));
+    CHECK(bbox_2.cy == Approx((fd_2.y1 + fd_2.y2) / 2).margin(0.01));
+    CHECK(bbox_2.width == Approx(fd_2.x2 - fd_2.x1).margin(0.01));
+    CHECK(bbox_2.height == Approx(fd_2.y2 - fd_2.y1).margin(0.01));
+
+    // Both objects are visible
+    Json::Value visible = openshot::stringToJson(tracker.GetVisibleObjects(20));
+    REQUIRE(visible["visible_objects_index"].size() == 2);
+    CHECK(visible["visible_objects_index"][0].asInt() == 0);
+    CHECK(visible["visible_objects_index"][1].asInt() == 1);
+    CHECK(visible["visible_objects_id"][0].asString() == "0");
+    CHECK(visible["visible_objects_id"][1].asString() == "1");
+}
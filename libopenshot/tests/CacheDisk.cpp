@@ -11,6 +11,7 @@
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
 #include <memory>
+#include <vector>
 #include <QDir>
 
 #include "openshot_catch.h"
@@ -241,3 +242,63 @@ TEST_CASE( "JSON", "[libopenshot][cachedisk]" )
 	c.Clear();
 	temp_path.removeRecursively();
 }
+
+TEST_CASE( "raw format", "[libopenshot][cachedisk]" )
+{
+	QDir temp_path = QDir::tempPath() + QString("/raw-format/");
+
+	// Create raw cache object (full size)
+	CacheDisk c(temp_path.path().toStdString(), "RAW", 1.0, 1.0);
+
+	// Add frames with picture and audio data
+	for (int i = 1; i <= 20; i++)
+	{
+		auto f = std::make_shared<openshot::Frame>(i, 640, 360, "#000000", 500, 2);
+		f->AddColor(640, 360, i % 2 ? "Blue" : "Red");
+		std::vector<float> samples(500);
+		for (int s = 0; s < 500; s++)
+			samples[s] = (s - 250) / (250.0f + i);
+		f->AddAudio(true, 0, 0, samples.data(), 500, 1.0);
+		f->AddAudio(true, 1, 0, samples.data(), 500, -1.0);
+		c.Add(f);
+	}
+
+	CHECK(c.Count() == 20);
+	CHECK(c.GetBytes() >= 20 * 640 * 360 * 4);
+
+	// Read frame back (pixels and samples are exact)
+	auto f = c.GetFrame(7);
+	REQUIRE(f != nullptr);
+	CHECK(f->number == 7);
+	CHECK(f->GetWidth() == 640);
+	CHECK(f->GetHeight() == 360);
+	CHECK(f->GetPixels(100)[0] == 0);
+	CHECK(f->GetPixels(100)[2] == 255);
+	CHECK(f->GetAudioChannelsCount() == 2);
+	CHECK(f->GetAudioSamplesCount() == 500);
+	CHECK(f->ChannelsLayout() == LAYOUT_STEREO);
+	CHECK(f->SampleRate() == 44100);
+	CHECK(f->GetAudioSamples(0)[400] == (400 - 250) / (250.0f + 7));
+	CHECK(f->GetAudioSamples(1)[400] == -(400 - 250) / (250.0f + 7));
+
+	// Remove frames (bytes are released)
+	auto start_bytes = c.GetBytes();
+	c.Remove(1, 10);
+	CHECK(c.Count() == 10);
+	CHECK(c.GetBytes() == start_bytes / 2);
+	CHECK(c.GetFrame(7) == nullptr);
+	CHECK(c.GetFrame(12) != nullptr);
+
+	// Add frames after removing (appended to the segment file)
+	c.Add(std::make_shared<openshot::Frame>(30, 320, 180, "Green"));
+	CHECK(c.Count() == 11);
+	CHECK(c.GetFrame(30)->GetWidth() == 320);
+
+	// Clear cache
+	c.Clear();
+	CHECK(c.Count() == 0);
+	CHECK(c.GetBytes() == 0);
+
+	// Delete cache directory
+	temp_path.removeRecursively();
+}
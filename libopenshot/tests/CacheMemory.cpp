@@ -295,6 +295,72 @@ TEST_CASE( "multiple remove", "[libopenshot][cachememory]" )
 }
 
 
+TEST_CASE( "GetBytes", "[libopenshot][cachememory]" )
+{
+	// Create cache object
+	CacheMemory c;
+
+	// Add frames of the same size
+	auto f1 = std::make_shared<Frame>(1, 320, 240, "#000000");
+	f1->AddColor(320, 240, "#000000");
+	int64_t frame_bytes = f1->GetBytes();
+	for (int i = 1; i <= 10; i++)
+	{
+		auto f = std::make_shared<Frame>(i, 320, 240, "#000000");
+		f->AddColor(320, 240, "#000000");
+		c.Add(f);
+	}
+	CHECK(c.GetBytes() == 10 * frame_bytes);
+
+	// Removing frames (and missing frames) updates the total
+	c.Remove(3, 5);
+	c.Remove(100);
+	CHECK(c.GetBytes() == 7 * frame_bytes);
+
+	// Frames which grow after being cached are updated when touched
+	auto f20 = std::make_shared<Frame>(20, 640, 480, "#000000");
+	c.Add(f20);
+	int64_t total_bytes = c.GetBytes();
+	int64_t small_bytes = f20->GetBytes();
+	f20->AddColor(640, 480, "#000000");
+	c.Touch(20);
+	CHECK(c.GetBytes() == total_bytes - small_bytes + f20->GetBytes());
+
+	c.Clear();
+	CHECK(c.GetBytes() == 0);
+}
+
+TEST_CASE( "multi-threaded access", "[libopenshot][cachememory]" )
+{
+	// Create cache object (which evicts frames while other threads read)
+	auto f = std::make_shared<Frame>(1, 64, 64, "#000000");
+	f->AddColor(64, 64, "#000000");
+	CacheMemory c(50 * f->GetBytes());
+
+	int mismatched_frames = 0;
+	#pragma omp parallel for reduction(+:mismatched_frames)
+	for (int i = 0; i < 4000; i++)
+	{
+		int64_t frame_number = (i * 7) % 200 + 1;
+		if (i % 2) {
+			auto new_frame = std::make_shared<Frame>(frame_number, 64, 64, "#000000");
+			new_frame->AddColor(64, 64, "#000000");
+			c.Add(new_frame);
+		} else {
+			auto cached_frame = c.GetFrame(frame_number);
+			if (cached_frame && cached_frame->number != frame_number)
+				mismatched_frames++;
+			if (i % 100 == 0)
+				c.Remove(frame_number, frame_number + 3);
+		}
+	}
+
+	// Byte count still matches the cached frames
+	CHECK(mismatched_frames == 0);
+	CHECK(c.Count() <= 50);
+	CHECK(c.GetBytes() == c.Count() * f->GetBytes());
+}
+
 
 TEST_CASE( "JSON", "[libopenshot][cachememory]" )
 {
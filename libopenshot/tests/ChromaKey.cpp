@@ -11,8 +11,11 @@
 //
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
+#include <cmath>
+#include <cstdlib>
 #include <sstream>
 #include <memory>
+#include <vector>
 
 #include "Frame.h"
 #include "effects/ChromaKey.h"
@@ -20,6 +23,10 @@
 #include <QColor>
 #include <QImage>
 
+#if USE_BABL
+#include <babl/babl.h>
+#endif
+
 // Stream output formatter for QColor, needed so Catch2 can display
 // values when CHECK(qcolor1 == qcolor2) comparisons fail
 std::ostream& operator << ( std::ostream& os, QColor const& value ) {
@@ -29,6 +36,7 @@ std::ostream& operator << ( std::ostream& os, QColor const& value ) {
 }
 
 #include "openshot_catch.h"
+#include "test_utils.h"
 
 using namespace openshot;
 
@@ -69,3 +77,144 @@ TEST_CASE( "threshold", "[libopenshot][effect][chromakey]" )
     CHECK(pix_e == expected);
 }
 
+
+TEST_CASE( "basic keying matches the color distance", "[libopenshot][effect][chromakey]" )
+{
+    // An odd width leaves pixels after the last group of 4 pixels in each row
+    QImage image = RandomPaletteImage(203, 37, 64, 1);
+    openshot::Color key(40, 180, 70, 255);
+    const int threshold = 150;
+
+    auto frame = std::make_shared<openshot::Frame>(1, 203, 37, "#000000");
+    frame->AddImage(std::make_shared<QImage>(image));
+    openshot::ChromaKey e(key, openshot::Keyframe(threshold), openshot::Keyframe(20.0));
+    std::shared_ptr<QImage> output = e.GetFrame(frame, 1)->GetImage();
+
+    int keyed = 0;
+    for (int y = 0; y < image.height(); y++) {
+        const unsigned char *pixel = image.constScanLine(y);
+        const unsigned char *result = output->constScanLine(y);
+        for (int x = 0; x < image.width(); x++, pixel += 4, result += 4) {
+            float A = pixel[3];
+            long R = A > 0 ? (unsigned char) ((pixel[0] / A) * 255.0) : 0;
+            long G = A > 0 ? (unsigned char) ((pixel[1] / A) * 255.0) : 0;
+            long B = A > 0 ? (unsigned char) ((pixel[2] / A) * 255.0) : 0;
+
+            // Basic keying has no halo
+            bool matched = openshot::Color::GetDistance(R, G, B, 40, 180, 70) <= threshold;
+            for (int channel = 0; channel < 4; channel++)
+                CHECK(result[channel] == (matched ? 0 : pixel[channel]));
+            keyed += matched;
+        }
+    }
+    CHECK(keyed > 0);
+    CHECK(keyed < image.width() * image.height());
+}
+
+#if USE_BABL
+TEST_CASE( "Cb,Cr keying with a halo", "[libopenshot][effect][chromakey]" )
+{
+    QImage image = RandomPaletteImage(97, 29, 200, 2);
+    const int threshold = 40;
+    const int halo = 30;
+
+    // Get the Cb,Cr distance of each pixel from a key color with babl
+    babl_init();
+    const Babl *fish = babl_fish(babl_format("R'G'B'A u8"), babl_format("Y'CbCr u8"));
+    auto distances = [&](int red, int green, int blue) {
+        unsigned char mask_in[4] = {(unsigned char) red, (unsigned char) green, (unsigned char) blue, 255};
+        unsigned char mask[3];
+        babl_process(fish, mask_in, mask, 1);
+
+        std::vector<unsigned char> converted(size_t(image.width()) * image.height() * 3);
+        for (int y = 0; y < image.height(); y++)
+            babl_process(fish, image.constScanLine(y), &converted[size_t(y) * image.width() * 3], image.width());
+
+        std::vector<float> result;
+        for (size_t i = 0; i < converted.size(); i += 3) {
+            int db = (int) converted[i + 1] - mask[1];
+            int dr = (int) converted[i + 2] - mask[2];
+            result.push_back(std::sqrt(db * db + dr * dr));
+        }
+        return result;
+    };
+
+    auto frame = std::make_shared<openshot::Frame>(1, 97, 29, "#000000");
+    openshot::Color key(20, 210, 60, 255);
+    openshot::ChromaKey e(key, openshot::Keyframe(threshold), openshot::Keyframe(halo), openshot::CHROMAKEY_YCBCR);
+
+    openshot::ChromaKey shared(key, openshot::Keyframe(threshold), openshot::Keyframe(halo), openshot::CHROMAKEY_YCBCR);
+
+    // The first frame calculates the distances, the second frame caches them and the third frame uses the
+    // cached distances (shared with another effect). The fourth frame has a new key color (which isn't
+    // cached until the fifth frame).
+    for (int pass = 0; pass < 5; pass++) {
+        if (pass == 3)
+            e.SetJson(R"({"color": {"red": {"Points": [{"co": {"X": 1, "Y": 200}}]}, "green": {"Points": [{"co": {"X": 1, "Y": 30}}]}, "blue": {"Points": [{"co": {"X": 1, "Y": 90}}]}}})");
+        std::vector<float> expected = pass < 3 ? distances(20, 210, 60) : distances(200, 30, 90);
+
+        frame->AddImage(std::make_shared<QImage>(image));
+        if (pass == 2)
+            shared.GetFrame(std::make_shared<openshot::Frame>(1, 97, 29, "#000000"), 1);
+        std::shared_ptr<QImage> output = (pass == 2 ? shared : e).GetFrame(frame, 1)->GetImage();
+
+        int keyed = 0, faded = 0;
+        for (int y = 0; y < image.height(); y++) {
+            const unsigned char *pixel = image.constScanLine(y);
+            const unsigned char *result = output->constScanLine(y);
+            for (int x = 0; x < image.width(); x++, pixel += 4, result += 4) {
+                float tmp = expected[size_t(y) * image.width() + x];
+                for (int channel = 0; channel < 4; channel++) {
+                    if (tmp <= threshold) {
+                        CHECK(result[channel] == 0);
+                    } else if (tmp <= threshold + halo) {
+                        // Cached distances are rounded to 1/128, which can change faded pixels by 1
+                        float alphamult = (tmp - threshold) / halo;
+                        CHECK(std::abs(result[channel] - (unsigned char) (pixel[channel] * alphamult)) <= 1);
+                    } else {
+                        CHECK(result[channel] == pixel[channel]);
+                    }
+                }
+                keyed += tmp <= threshold;
+                faded += tmp > threshold && tmp <= threshold + halo;
+            }
+        }
+        CHECK(keyed > 0);
+        CHECK(faded > 0);
+    }
+}
+
+TEST_CASE( "CIE distance keying matches with cached distances", "[libopenshot][effect][chromakey]" )
+{
+    QImage image = RandomPaletteImage(101, 31, 200, 3);
+
+    // Key the color of the first pixel (the babl methods take the premultiplied color as is)
+    const unsigned char *first = image.constScanLine(0);
+    openshot::Color key(first[0], first[1], first[2], 255);
+    openshot::ChromaKey e(key, openshot::Keyframe(15), openshot::Keyframe(20), openshot::CHROMAKEY_CIE_DISTANCE);
+    openshot::ChromaKey shared(key, openshot::Keyframe(15), openshot::Keyframe(20), openshot::CHROMAKEY_CIE_DISTANCE);
+
+    auto frame = std::make_shared<openshot::Frame>(1, 101, 31, "#000000");
+    auto key_image = [&](openshot::ChromaKey& effect) {
+        frame->AddImage(std::make_shared<QImage>(image));
+        return *effect.GetFrame(frame, 1)->GetImage();
+    };
+
+    // The first frame calculates the CIEDE2000 distance of each pixel directly (without a table)
+    QImage expected = key_image(e);
+    int keyed = 0;
+    for (int y = 0; y < expected.height(); y++)
+        for (int x = 0; x < expected.width(); x++)
+            keyed += expected.constScanLine(y)[x * 4 + 3] == 0;
+    CHECK(keyed > 0);
+    CHECK(keyed < expected.width() * expected.height());
+
+    // The second frame fills the distance table, and the third frame looks the distances up in it
+    CHECK(MaxDifference(key_image(e), expected) == 0);
+    CHECK(MaxDifference(key_image(e), expected) == 0);
+
+    // Another effect keying the same color shares the table
+    shared.GetFrame(std::make_shared<openshot::Frame>(1, 101, 31, "#000000"), 1);
+    CHECK(MaxDifference(key_image(shared), expected) == 0);
+}
+#endif
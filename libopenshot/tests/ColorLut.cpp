@@ -0,0 +1,215 @@
+/**
+ * @file
+ * @brief Unit tests for openshot::ColorLut
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include "ColorLut.h"
+#include "openshot_catch.h"
+
+using namespace openshot;
+
+// Create the colors of a table, from a function of each point (0.0 to 1.0)
+template <typename Function>
+static std::vector<float> TableColors(int size, Function function) {
+	std::vector<float> colors;
+	for (int b = 0; b < size; b++)
+		for (int g = 0; g < size; g++)
+			for (int r = 0; r < size; r++) {
+				float point[3] = {r / float(size - 1), g / float(size - 1), b / float(size - 1)};
+				function(point);
+				colors.insert(colors.end(), point, point + 3);
+			}
+	return colors;
+}
+
+// Write the text of a .cube file
+static void WriteFile(const std::string& path, const std::string& text) {
+	QFile file(QString::fromStdString(path));
+	REQUIRE(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+	file.write(text.data(), text.size());
+	file.close();
+}
+
+TEST_CASE( "Parse .cube text", "[libopenshot][colorlut]" )
+{
+	const std::string text =
+		"# Created by hand\n"
+		"TITLE \"Swap red and blue\"\n"
+		"DOMAIN_MIN 0.0 0.0 0.0\n"
+		"DOMAIN_MAX 1.0 1.0 1.0\n"
+		"LUT_3D_SIZE 2\n"
+		"\n"
+		"0 0 0\n"
+		"0 0 1\r\n"
+		"  0 1 0\n"
+		"0 1 1\n"
+		"# A comment between points\n"
+		"1 0 0\n"
+		"1 0 1\n"
+		"1.0 1.0 0.0\n"
+		"1e0 1 1\n";
+
+	int size = 0;
+	std::vector<float> colors;
+	REQUIRE(ColorLut::Parse(text, size, colors));
+	CHECK(size == 2);
+	REQUIRE(colors.size() == 24);
+	CHECK(colors[3] == 0.0f);
+	CHECK(colors[5] == 1.0f);
+	CHECK(colors[18] == 1.0f);
+	CHECK(colors[20] == 0.0f);
+	CHECK(colors[21] == 1.0f);
+
+	// Missing points, missing sizes and invalid sizes are rejected
+	CHECK_FALSE(ColorLut::Parse("LUT_3D_SIZE 2\n0 0 0\n1 1 1\n", size, colors));
+	CHECK_FALSE(ColorLut::Parse("0 0 0\n1 1 1\n", size, colors));
+	CHECK_FALSE(ColorLut::Parse("LUT_3D_SIZE 1\n0 0 0\n", size, colors));
+	CHECK_FALSE(ColorLut::Parse("", size, colors));
+	CHECK(size == 2);
+}
+
+TEST_CASE( "Linear tables are interpolated exactly", "[libopenshot][colorlut]" )
+{
+	// Tetrahedral interpolation of a linear function is exact (within the 16-bit packing of the points)
+	ColorLut identity("identity", 17, TableColors(17, [](float*) {}));
+	ColorLut mixed("mixed", 9, TableColors(9, [](float* point) {
+		float r = point[0], g = point[1], b = point[2];
+		point[0] = 0.5f * r + 0.25f * g + 0.1f;
+		point[1] = 1.0f - b;
+		point[2] = 0.3f * r + 0.3f * g + 0.3f * b;
+	}));
+
+	// Odd numbers of pixels (so both the SIMD loop and the remaining pixels are used)
+	const int pixels = 1003;
+	std::vector<float> red(pixels), green(pixels), blue(pixels);
+	std::srand(1);
+	for (int i = 0; i < pixels; i++) {
+		red[i] = float(std::rand() % 25501) / 100.0f;
+		green[i] = float(std::rand() % 25501) / 100.0f;
+		blue[i] = float(std::rand() % 25501) / 100.0f;
+	}
+	red[0] = 255.0f; green[0] = 255.0f; blue[0] = 255.0f;
+	red[1] = 0.0f; green[1] = 0.0f; blue[1] = 0.0f;
+
+	std::vector<float> new_red(pixels), new_green(pixels), new_blue(pixels);
+	identity.Lookup(red.data(), green.data(), blue.data(), new_red.data(), new_green.data(), new_blue.data(), pixels);
+	float difference = 0.0f;
+	for (int i = 0; i < pixels; i++) {
+		difference = std::max(difference, std::abs(new_red[i] - red[i]));
+		difference = std::max(difference, std::abs(new_green[i] - green[i]));
+		difference = std::max(difference, std::abs(new_blue[i] - blue[i]));
+	}
+	CHECK(difference < 0.01f);
+
+	mixed.Lookup(red.data(), green.data(), blue.data(), new_red.data(), new_green.data(), new_blue.data(), pixels);
+	difference = 0.0f;
+	for (int i = 0; i < pixels; i++) {
+		difference = std::max(difference, std::abs(new_red[i] - (0.5f * red[i] + 0.25f * green[i] + 25.5f)));
+		difference = std::max(difference, std::abs(new_green[i] - (255.0f - blue[i])));
+		difference = std::max(difference, std::abs(new_blue[i] - 0.3f * (red[i] + green[i] + blue[i])));
+	}
+	CHECK(difference < 0.01f);
+
+	// Colors outside 0 to 255 are clamped to the edges of the table
+	const float outside[5] = {-20.0f, 300.0f, 255.0f, 0.0f, 1e9f};
+	float results[3][5];
+	identity.Lookup(outside, outside, outside, results[0], results[1], results[2], 5);
+	CHECK(results[0][0] == Approx(0.0f).margin(0.01f));
+	CHECK(results[1][1] == Approx(255.0f).margin(0.01f));
+	CHECK(results[2][4] == Approx(255.0f).margin(0.01f));
+}
+
+TEST_CASE( "Neutral colors stay neutral", "[libopenshot][colorlut]" )
+{
+	// A curve applied to every channel keeps grays gray (which trilinear interpolation does not)
+	ColorLut curve("curve", 5, TableColors(5, [](float* point) {
+		for (int channel = 0; channel < 3; channel++)
+			point[channel] = std::sqrt(point[channel]);
+	}));
+
+	float grays[256];
+	for (int i = 0; i < 256; i++)
+		grays[i] = float(i);
+	float red[256], green[256], blue[256];
+	curve.Lookup(grays, grays, grays, red, green, blue, 256);
+	for (int i = 0; i < 256; i++) {
+		CHECK(red[i] == green[i]);
+		CHECK(red[i] == blue[i]);
+	}
+
+	// Points of the table are looked up exactly
+	CHECK(red[0] == Approx(0.0f).margin(0.01f));
+	CHECK(red[255] == Approx(255.0f).margin(0.01f));
+	float half[1] = {127.5f};
+	curve.Lookup(half, half, half, red, green, blue, 1);
+	CHECK(red[0] == Approx(std::sqrt(0.5f) * 255.0f).margin(0.01f));
+}
+
+TEST_CASE( "Load and cache .cube files", "[libopenshot][colorlut]" )
+{
+	std::stringstream example_path;
+	example_path << TEST_MEDIA_PATH << "example-lut.cube";
+	std::shared_ptr<const ColorLut> example = ColorLut::Load(example_path.str());
+	REQUIRE(example);
+	CHECK(example->Size() == 33);
+
+	// Files are only parsed once (and every effect shares the same table)
+	CHECK(ColorLut::Load(example_path.str()) == example);
+
+	// Missing files (and files which are not 3D LUTs) can't be loaded
+	const std::string path = QDir::temp().filePath("libopenshot-test-lut.cube").toStdString();
+	QFile::remove(QString::fromStdString(path));
+	CHECK_FALSE(ColorLut::Load(path));
+	CHECK_FALSE(ColorLut::Load(""));
+	WriteFile(path, "LUT_3D_SIZE 2\n0 0 0\n");
+	CHECK_FALSE(ColorLut::Load(path));
+
+	// Changed files are parsed again
+	WriteFile(path, "LUT_3D_SIZE 2\n0 0 0\n1 0 0\n0 1 0\n1 1 0\n0 0 1\n1 0 1\n0 1 1\n1 1 1\n");
+	std::shared_ptr<const ColorLut> lut = ColorLut::Load(path);
+	REQUIRE(lut);
+	CHECK(lut->Size() == 2);
+	CHECK(lut->Key() != example->Key());
+
+	// Clearing the cache does not free tables which are still in use
+	ColorLut::ClearCache();
+	std::shared_ptr<const ColorLut> reloaded = ColorLut::Load(path);
+	REQUIRE(reloaded);
+	CHECK(reloaded != lut);
+	CHECK(reloaded->Key() == lut->Key());
+	CHECK(example->Size() == 33);
+
+	// Files which are rewritten with the same modification time (but a different size) have a new key
+	QFile file(QString::fromStdString(path));
+	QDateTime modified = QFileInfo(file).lastModified();
+	WriteFile(path, "LUT_3D_SIZE 2\n0 0 0\n1 0 0\n0 1 0\n1 1 0\n0 0 1\n1 0 1\n0 1 1\n0.5 0.5 0.5\n");
+	REQUIRE(file.open(QIODevice::Append));
+	REQUIRE(file.setFileTime(modified, QFileDevice::FileModificationTime));
+	file.close();
+	std::shared_ptr<const ColorLut> rewritten = ColorLut::Load(path);
+	REQUIRE(rewritten);
+	CHECK(rewritten != reloaded);
+	CHECK(rewritten->Key() != reloaded->Key());
+
+	QFile::remove(QString::fromStdString(path));
+}
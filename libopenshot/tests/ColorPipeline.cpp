@@ -0,0 +1,291 @@
+/**
+ * @file
+ * @brief Unit tests for openshot::ColorPipeline
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <QImage>
+
+#include "openshot_catch.h"
+#include "test_utils.h"
+
+#include "ColorPipeline.h"
+#include "Frame.h"
+#include "Settings.h"
+#include "effects/Blur.h"
+#include "effects/Brightness.h"
+#include "effects/Hue.h"
+#include "effects/Negate.h"
+#include "effects/Saturation.h"
+
+using namespace openshot;
+
+// Constrain a color value from 0 to 255
+static int Constrain(int color_value) {
+	return color_value < 0 ? 0 : (color_value > 255 ? 255 : color_value);
+}
+
+// The scalar loop of Brightness (before color effects were vectorized)
+static void ScalarBrightness(QImage& image, float brightness_value, float contrast_value) {
+	unsigned char *pixels = image.bits();
+	float factor = (259 * (contrast_value + 255)) / (255 * (259 - contrast_value));
+	for (int pixel = 0; pixel < image.width() * image.height(); ++pixel) {
+		float alpha_percent = pixels[pixel * 4 + 3] / 255.0;
+		for (int channel = 0; channel < 3; channel++) {
+			unsigned char color = pixels[pixel * 4 + channel] / alpha_percent;
+			color = Constrain((factor * (color - 128)) + 128);
+			pixels[pixel * 4 + channel] = Constrain(color + (255 * brightness_value));
+			pixels[pixel * 4 + channel] *= alpha_percent;
+		}
+	}
+}
+
+// The scalar loop of Saturation (before color effects were vectorized)
+static void ScalarSaturation(QImage& image, float saturation_value, float saturation_value_R, float saturation_value_G, float saturation_value_B) {
+	const double pR = .299;
+	const double pG = .587;
+	const double pB = .114;
+	unsigned char *pixels = image.bits();
+	for (int pixel = 0; pixel < image.width() * image.height(); ++pixel) {
+		float alpha_percent = pixels[pixel * 4 + 3] / 255.0;
+		int R = pixels[pixel * 4 + 0] / alpha_percent;
+		int G = pixels[pixel * 4 + 1] / alpha_percent;
+		int B = pixels[pixel * 4 + 2] / alpha_percent;
+
+		double p = sqrt((R * R * pR) + (G * G * pG) + (B * B * pB));
+		R = Constrain(p + (R - p) * saturation_value);
+		G = Constrain(p + (G - p) * saturation_value);
+		B = Constrain(p + (B - p) * saturation_value);
+
+		const double p_r = sqrt(R * R * pR);
+		const double p_g = sqrt(G * G * pG);
+		const double p_b = sqrt(B * B * pB);
+		const int Rr = p_r + (R - p_r) * saturation_value_R;
+		const int Gr = p_r + (0 - p_r) * saturation_value_R;
+		const int Br = p_r + (0 - p_r) * saturation_value_R;
+		const int Rg = p_g + (0 - p_g) * saturation_value_G;
+		const int Gg = p_g + (G - p_g) * saturation_value_G;
+		const int Bg = p_g + (0 - p_g) * saturation_value_G;
+		const int Rb = p_b + (0 - p_b) * saturation_value_B;
+		const int Gb = p_b + (0 - p_b) * saturation_value_B;
+		const int Bb = p_b + (B - p_b) * saturation_value_B;
+
+		pixels[pixel * 4 + 0] = Constrain(Rr + Rg + Rb) * alpha_percent;
+		pixels[pixel * 4 + 1] = Constrain(Gr + Gg + Gb) * alpha_percent;
+		pixels[pixel * 4 + 2] = Constrain(Br + Bg + Bb) * alpha_percent;
+	}
+}
+
+// The scalar loop of Hue (before color effects were vectorized)
+static void ScalarHue(QImage& image, float hue_value) {
+	double degrees = 360.0 * hue_value;
+	float cosA = cos(degrees*3.14159265f/180);
+	float sinA = sin(degrees*3.14159265f/180);
+	float matrix[3] = {
+		cosA + (1.0f - cosA) / 3.0f,
+		1.0f/3.0f * (1.0f - cosA) - sqrtf(1.0f/3.0f) * sinA,
+		1.0f/3.0f * (1.0f - cosA) + sqrtf(1.0f/3.0f) * sinA
+	};
+	unsigned char *pixels = image.bits();
+	for (int pixel = 0; pixel < image.width() * image.height(); ++pixel) {
+		float alpha_percent = pixels[pixel * 4 + 3] / 255.0;
+		int R = pixels[pixel * 4 + 0] / alpha_percent;
+		int G = pixels[pixel * 4 + 1] / alpha_percent;
+		int B = pixels[pixel * 4 + 2] / alpha_percent;
+		pixels[pixel * 4 + 0] = Constrain(R * matrix[0] + G * matrix[1] + B * matrix[2]) * alpha_percent;
+		pixels[pixel * 4 + 1] = Constrain(R * matrix[2] + G * matrix[0] + B * matrix[1]) * alpha_percent;
+		pixels[pixel * 4 + 2] = Constrain(R * matrix[1] + G * matrix[2] + B * matrix[0]) * alpha_percent;
+	}
+}
+
+TEST_CASE( "Only color effects are added", "[libopenshot][colorpipeline]" )
+{
+	Brightness brightness(Keyframe(0.1), Keyframe(10.0));
+	Negate negate;
+	Blur blur;
+
+	ColorPipeline pipeline;
+	CHECK(pipeline.Add(&brightness, 1));
+	CHECK(pipeline.Add(&negate, 1));
+	CHECK_FALSE(pipeline.Add(&blur, 1));
+	CHECK(pipeline.Count() == 2);
+
+	auto frame = RandomFrame(16, 16, 1);
+	frame = pipeline.Apply(frame);
+	CHECK(pipeline.Count() == 0);
+}
+
+TEST_CASE( "Fused effects match separate effects", "[libopenshot][colorpipeline]" )
+{
+	Brightness brightness(Keyframe(0.1), Keyframe(20.0));
+	Saturation saturation(Keyframe(1.5), Keyframe(0.8), Keyframe(1.2), Keyframe(1.0));
+	Hue hue(Keyframe(0.3));
+	Negate negate;
+	std::vector<EffectBase*> effects = {&brightness, &saturation, &hue, &negate};
+
+	// Apply each effect separately
+	auto expected = RandomFrame(67, 45, 2);
+	for (auto effect : effects)
+		expected = effect->GetFrame(expected, 1);
+
+	// Apply all effects in a single pass
+	auto actual = RandomFrame(67, 45, 2);
+	ColorPipeline pipeline;
+	for (auto effect : effects)
+		REQUIRE(pipeline.Add(effect, 1));
+	actual = pipeline.Apply(actual);
+
+	CHECK(MaxDifference(*expected->GetImage(), *actual->GetImage()) == 0);
+}
+
+TEST_CASE( "Kernels match scalar", "[libopenshot][colorpipeline]" )
+{
+	Brightness brightness(Keyframe(0.1), Keyframe(20.0));
+	Saturation saturation(Keyframe(1.5), Keyframe(0.8), Keyframe(1.2), Keyframe(1.0));
+	Hue hue(Keyframe(0.3));
+	std::vector<EffectBase*> effects = {&brightness, &saturation, &hue};
+
+	std::string default_kernel = ColorPipeline::Kernel();
+	CHECK(ColorPipeline::SupportedKernels().front() == default_kernel);
+	CHECK_FALSE(ColorPipeline::SetKernel("unknown"));
+
+	for (bool opaque : {true, false}) {
+		// Apply the effects with the scalar kernels
+		REQUIRE(ColorPipeline::SetKernel("scalar"));
+		auto expected = RandomFrame(301, 37, 4, opaque);
+		for (auto effect : effects)
+			expected = effect->GetFrame(expected, 1);
+
+		// All other kernels must match exactly
+		for (const std::string& kernel : ColorPipeline::SupportedKernels()) {
+			REQUIRE(ColorPipeline::SetKernel(kernel));
+			CHECK(ColorPipeline::Kernel() == kernel);
+			auto actual = RandomFrame(301, 37, 4, opaque);
+			for (auto effect : effects)
+				actual = effect->GetFrame(actual, 1);
+			CHECK(MaxDifference(*expected->GetImage(), *actual->GetImage()) == 0);
+		}
+	}
+	ColorPipeline::SetKernel(default_kernel);
+}
+
+TEST_CASE( "Compare to scalar effects", "[libopenshot][colorpipeline]" )
+{
+	Brightness brightness(Keyframe(0.1), Keyframe(20.0));
+	Saturation saturation(Keyframe(1.5), Keyframe(0.8), Keyframe(1.2), Keyframe(1.0));
+	Hue hue(Keyframe(0.3));
+
+	// Opaque pixels are identical. Translucent pixels can differ slightly, since removing alpha no longer
+	// truncates exact multiples of alpha down (which contrast and saturation then amplify)
+	for (bool opaque : {true, false}) {
+		int tolerance = opaque ? 0 : 2;
+
+		auto expected = RandomFrame(97, 61, 5, opaque);
+		auto actual = RandomFrame(97, 61, 5, opaque);
+		ScalarBrightness(*expected->GetImage(), 0.1, 20.0);
+		actual = brightness.GetFrame(actual, 1);
+		CHECK(MaxDifference(*expected->GetImage(), *actual->GetImage()) <= tolerance);
+
+		expected = RandomFrame(97, 61, 6, opaque);
+		actual = RandomFrame(97, 61, 6, opaque);
+		ScalarSaturation(*expected->GetImage(), 1.5, 0.8, 1.2, 1.0);
+		actual = saturation.GetFrame(actual, 1);
+		CHECK(MaxDifference(*expected->GetImage(), *actual->GetImage()) <= tolerance);
+
+		expected = RandomFrame(97, 61, 7, opaque);
+		actual = RandomFrame(97, 61, 7, opaque);
+		ScalarHue(*expected->GetImage(), 0.3);
+		actual = hue.GetFrame(actual, 1);
+		CHECK(MaxDifference(*expected->GetImage(), *actual->GetImage()) <= tolerance);
+	}
+}
+
+TEST_CASE( "Baked lookup table", "[libopenshot][colorpipeline]" )
+{
+	Brightness brightness(Keyframe(-0.05), Keyframe(5.0));
+	Saturation saturation(Keyframe(1.3), Keyframe(1.0), Keyframe(1.0), Keyframe(1.0));
+	Hue hue(Keyframe(0.1));
+
+	auto expected = RandomFrame(64, 64, 3);
+	expected = brightness.GetFrame(expected, 1);
+	expected = saturation.GetFrame(expected, 1);
+	expected = hue.GetFrame(expected, 1);
+
+	Settings::Instance()->COLOR_LUT_SIZE = 33;
+
+	// The table is only baked for the 2nd frame with the same values
+	for (int frame_number = 1; frame_number <= 2; frame_number++) {
+		auto actual = RandomFrame(64, 64, 3);
+		ColorPipeline pipeline;
+		REQUIRE(pipeline.Add(&brightness, frame_number));
+		REQUIRE(pipeline.Add(&saturation, frame_number));
+		REQUIRE(pipeline.Add(&hue, frame_number));
+		actual = pipeline.Apply(actual);
+
+		if (frame_number == 1)
+			CHECK(MaxDifference(*expected->GetImage(), *actual->GetImage()) == 0);
+		else
+			CHECK(MaxDifference(*expected->GetImage(), *actual->GetImage()) <= 6);
+	}
+
+	Settings::Instance()->COLOR_LUT_SIZE = 0;
+}
+
+TEST_CASE( "Animated effects don't evict baked lookup tables", "[libopenshot][colorpipeline]" )
+{
+	Brightness brightness(Keyframe(0.05), Keyframe(3.0));
+	Saturation saturation(Keyframe(0.7), Keyframe(1.0), Keyframe(1.0), Keyframe(1.0));
+
+	// Brightness which changes on every frame
+	Keyframe animated_brightness;
+	animated_brightness.AddPoint(1, -0.2);
+	animated_brightness.AddPoint(100, 0.2);
+	Brightness animated(animated_brightness, Keyframe(0.0));
+
+	auto expected = RandomFrame(64, 64, 4);
+	expected = brightness.GetFrame(expected, 1);
+	expected = saturation.GetFrame(expected, 1);
+
+	Settings::Instance()->COLOR_LUT_SIZE = 33;
+
+	// Apply the static effects (the 1st frame is exact, and later frames use the baked table, which is
+	// interpolated, so some colors differ slightly)
+	auto apply_static = [&](int64_t frame_number) {
+		auto actual = RandomFrame(64, 64, 4);
+		ColorPipeline pipeline;
+		REQUIRE(pipeline.Add(&brightness, frame_number));
+		REQUIRE(pipeline.Add(&saturation, frame_number));
+		return MaxDifference(*expected->GetImage(), *pipeline.Apply(actual)->GetImage());
+	};
+	CHECK(apply_static(1) == 0);
+	int baked_difference = apply_static(2);
+	CHECK(baked_difference > 0);
+	CHECK(baked_difference <= 6);
+
+	// Many frames of animated effects are never baked
+	for (int64_t frame_number = 1; frame_number <= 40; frame_number++) {
+		auto actual = RandomFrame(16, 16, 5);
+		ColorPipeline pipeline;
+		REQUIRE(pipeline.Add(&animated, frame_number));
+		REQUIRE(pipeline.Add(&saturation, frame_number));
+		pipeline.Apply(actual);
+	}
+
+	// The static effects still use their baked table
+	CHECK(apply_static(3) == baked_difference);
+
+	Settings::Instance()->COLOR_LUT_SIZE = 0;
+}
@@ -0,0 +1,173 @@
+/**
+ * @file
+ * @brief Unit tests for openshot::Compositor
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <QColor>
+#include <QImage>
+#include <QPainter>
+#include <QTransform>
+
+#include "openshot_catch.h"
+#include "test_utils.h"
+
+#include "Compositor.h"
+
+using namespace openshot;
+
+// Get a random alpha for a pixel (a quarter of the pixels are opaque, and some are fully transparent)
+static int RandomAlpha() {
+	return (std::rand() % 4 == 0) ? 255 : ((std::rand() % 4 == 0) ? 0 : std::rand() % 256);
+}
+
+TEST_CASE( "Blend row", "[libopenshot][compositor]" )
+{
+	// Opaque blue background
+	unsigned char destination[8] = {0, 0, 255, 255, 0, 0, 255, 255};
+
+	// Half transparent red, and fully transparent
+	const unsigned char source[8] = {128, 0, 0, 128, 0, 0, 0, 0};
+	Compositor::BlendRow(destination, source, 2);
+	CHECK((int)destination[0] == 128);
+	CHECK((int)destination[1] == 0);
+	CHECK((int)destination[2] == 127);
+	CHECK((int)destination[3] == 255);
+	CHECK((int)destination[4] == 0);
+	CHECK((int)destination[6] == 255);
+	CHECK((int)destination[7] == 255);
+
+	// Opaque white at half opacity
+	const unsigned char white[8] = {255, 255, 255, 255, 255, 255, 255, 255};
+	Compositor::BlendRow(destination, white, 2, 128);
+	CHECK((int)destination[0] == 192);
+	CHECK((int)destination[1] == 128);
+	CHECK((int)destination[2] == 191);
+	CHECK((int)destination[3] == 255);
+	CHECK((int)destination[4] == 128);
+	CHECK((int)destination[6] == 255);
+}
+
+TEST_CASE( "Unsupported images", "[libopenshot][compositor]" )
+{
+	QImage destination(32, 32, QImage::Format_RGBA8888_Premultiplied);
+	QImage source(16, 16, QImage::Format_ARGB32);
+	destination.fill(Qt::transparent);
+	source.fill(Qt::red);
+
+	// Other image formats and projections are left to QPainter
+	CHECK_FALSE(Compositor::Composite(destination, source, QTransform()));
+	QImage premultiplied = source.convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+	QTransform projection(1.0, 0.0, 0.001, 0.0, 1.0, 0.001, 0.0, 0.0, 1.0);
+	CHECK_FALSE(Compositor::Composite(destination, premultiplied, projection));
+	CHECK(destination.pixelColor(8, 8).alpha() == 0);
+
+	// A transform which can't be inverted draws nothing
+	QTransform flat;
+	flat.scale(0.0, 1.0);
+	CHECK(Compositor::Composite(destination, premultiplied, flat));
+	CHECK(destination.pixelColor(0, 8).alpha() == 0);
+}
+
+TEST_CASE( "Kernels match scalar", "[libopenshot][compositor]" )
+{
+	QImage source = RandomImage(301, 203, 1, RandomAlpha);
+	QImage background = RandomImage(320, 240, 2, RandomAlpha);
+
+	std::vector<QTransform> transforms(6);
+	transforms[1].translate(13, -7);
+	transforms[2].translate(10.3, 5.6);
+	transforms[3].scale(0.667, 0.667);
+	transforms[4].translate(50, 20);
+	transforms[4].rotate(30);
+	transforms[4].scale(1.7, 1.3);
+	transforms[5].scale(2.5, 2.5);
+
+	std::string default_kernel = Compositor::Kernel();
+	CHECK(Compositor::SupportedKernels().front() == default_kernel);
+	CHECK_FALSE(Compositor::SetKernel("unknown"));
+
+	for (const QTransform& transform : transforms) {
+		for (float opacity : {1.0f, 0.5f}) {
+			for (CompositeFilter filter : {COMPOSITE_BILINEAR, COMPOSITE_BICUBIC}) {
+				// Composite with the scalar kernels
+				QImage expected = background.copy();
+				REQUIRE(Compositor::SetKernel("scalar"));
+				REQUIRE(Compositor::Composite(expected, source, transform, opacity, filter));
+
+				// All other kernels must match exactly
+				for (const std::string& kernel : Compositor::SupportedKernels()) {
+					QImage actual = background.copy();
+					REQUIRE(Compositor::SetKernel(kernel));
+					CHECK(Compositor::Kernel() == kernel);
+					REQUIRE(Compositor::Composite(actual, source, transform, opacity, filter));
+					CHECK(MaxDifference(expected, actual, 0, 0, 320, 240) == 0);
+				}
+			}
+		}
+	}
+	Compositor::SetKernel(default_kernel);
+}
+
+TEST_CASE( "Compare to QPainter", "[libopenshot][compositor]" )
+{
+	QImage source = RandomImage(200, 100, 3, RandomAlpha);
+	QImage background = RandomImage(320, 240, 4, RandomAlpha);
+
+	SECTION("translate") {
+		for (float opacity : {1.0f, 0.3f}) {
+			QTransform transform;
+			transform.translate(60, 40);
+
+			QImage expected = background.copy();
+			QPainter painter(&expected);
+			painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform, true);
+			painter.setTransform(transform);
+			painter.setOpacity(opacity);
+			painter.drawImage(0, 0, source);
+			painter.end();
+
+			QImage actual = background.copy();
+			REQUIRE(Compositor::Composite(actual, source, transform, opacity));
+			CHECK(MaxDifference(expected, actual, 0, 0, 320, 240) <= 2);
+		}
+	}
+
+	SECTION("scale") {
+		// Smooth gradient (so small differences in interpolation weights are small differences in color)
+		QImage gradient(64, 32, QImage::Format_RGBA8888_Premultiplied);
+		for (int y = 0; y < gradient.height(); y++)
+			for (int x = 0; x < gradient.width(); x++)
+				gradient.setPixelColor(x, y, QColor(x * 4, y * 8, 128, 255));
+
+		QTransform transform;
+		transform.translate(20, 30);
+		transform.scale(3.0, 3.0);
+
+		QImage expected = background.copy();
+		QPainter painter(&expected);
+		painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform, true);
+		painter.setTransform(transform);
+		painter.drawImage(0, 0, gradient);
+		painter.end();
+
+		QImage actual = background.copy();
+		REQUIRE(Compositor::Composite(actual, gradient, transform));
+
+		// Fully covered pixels (edges are anti-aliased differently)
+		CHECK(MaxDifference(expected, actual, 22, 32, 210, 124) <= 4);
+		CHECK(actual.pixelColor(21, 31).alpha() == 255);
+		CHECK(actual.pixelColor(211, 125).alpha() == 255);
+	}
+}
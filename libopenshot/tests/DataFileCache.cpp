@@ -0,0 +1,161 @@
+/**
+ * @file
+ * @brief Unit tests for openshot::DataFileCache
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <QDir>
+#include <QFile>
+
+#include "DataFileCache.h"
+#include "openshot_catch.h"
+
+using namespace openshot;
+
+// The data of a test file (its text)
+struct TextData {
+	std::string text;
+};
+
+// Write a test file
+static void WriteFile(const std::string& path, const std::string& text) {
+	QFile file(QString::fromStdString(path));
+	REQUIRE(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+	file.write(text.data(), text.size());
+	file.close();
+}
+
+TEST_CASE( "Load and share data files", "[libopenshot][datafilecache]" )
+{
+	const std::string path = QDir::temp().filePath("libopenshot-test-data-file.txt").toStdString();
+	QFile::remove(QString::fromStdString(path));
+
+	// Parse the text of a file (files which start with "bad" are invalid)
+	int parsed = 0;
+	auto load = [&parsed](const std::string& path, TextData& data) {
+		parsed++;
+		std::ifstream input(path, std::ios::binary);
+		data.text.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+		return data.text.compare(0, 3, "bad") != 0;
+	};
+
+	// Missing and invalid files can't be loaded
+	CHECK_FALSE(DataFileCache<TextData>::Load(path, load));
+	CHECK_FALSE(DataFileCache<TextData>::Load("", load));
+	CHECK(parsed == 0);
+	WriteFile(path, "bad data");
+	CHECK_FALSE(DataFileCache<TextData>::Load(path, load));
+	CHECK(parsed == 1);
+
+	// Invalid files are only parsed again once they change
+	CHECK_FALSE(DataFileCache<TextData>::Load(path, load));
+	CHECK(parsed == 1);
+
+	// Files are only parsed once (and every object shares the same data)
+	WriteFile(path, "tracked data");
+	std::shared_ptr<const TextData> data = DataFileCache<TextData>::Load(path, load);
+	REQUIRE(data);
+	CHECK(data->text == "tracked data");
+	CHECK(DataFileCache<TextData>::Load(path, load) == data);
+	CHECK(parsed == 2);
+
+	// Changed files are parsed again
+	WriteFile(path, "more tracked data");
+	std::shared_ptr<const TextData> changed = DataFileCache<TextData>::Load(path, load);
+	REQUIRE(changed);
+	CHECK(changed->text == "more tracked data");
+	CHECK(parsed == 3);
+
+	// Clearing the cache does not free data which is still in use
+	DataFileCache<TextData>::Clear();
+	std::shared_ptr<const TextData> reloaded = DataFileCache<TextData>::Load(path, load);
+	REQUIRE(reloaded);
+	CHECK(reloaded != changed);
+	CHECK(reloaded->text == changed->text);
+	CHECK(data->text == "tracked data");
+	CHECK(parsed == 4);
+
+	QFile::remove(QString::fromStdString(path));
+}
+
+TEST_CASE( "Create data which can't be default constructed", "[libopenshot][datafilecache]" )
+{
+	const std::string path = QDir::temp().filePath("libopenshot-test-data-file-create.txt").toStdString();
+	WriteFile(path, "created data");
+
+	// Create the data from the path and modification time of the file (and only keep 1 file at once)
+	typedef DataFileCache<std::pair<std::string, qint64>, 1> PairFileCache;
+	qint64 created_modified = 0;
+	auto create = [&created_modified](const std::string& path, qint64 modified) {
+		created_modified = modified;
+		return std::make_shared<const std::pair<std::string, qint64>>(path, modified);
+	};
+	auto data = PairFileCache::Create(path, create);
+	REQUIRE(data);
+	CHECK(data->first == path);
+	CHECK(data->second == created_modified);
+	CHECK(created_modified > 0);
+	CHECK(PairFileCache::Create(path, create) == data);
+
+	// A new file replaces the cached file, once the cache is full
+	const std::string other_path = path + ".other";
+	WriteFile(other_path, "other data");
+	auto other = PairFileCache::Create(other_path, create);
+	REQUIRE(other);
+	CHECK(other->first == other_path);
+	auto recreated = PairFileCache::Create(path, create);
+	REQUIRE(recreated);
+	CHECK(recreated != data);
+	CHECK(recreated->first == path);
+
+	PairFileCache::Clear();
+	QFile::remove(QString::fromStdString(path));
+	QFile::remove(QString::fromStdString(other_path));
+}
+
+TEST_CASE( "Replace the file which was cached first", "[libopenshot][datafilecache]" )
+{
+	const std::string path = QDir::temp().filePath("libopenshot-test-data-file-oldest.txt").toStdString();
+	const std::string paths[] = {path + ".1", path + ".2", path + ".3"};
+	for (const std::string& file_path : paths)
+		WriteFile(file_path, file_path);
+
+	// Only keep 2 files at once
+	typedef DataFileCache<TextData, 2> TwoFileCache;
+	int parsed = 0;
+	auto load = [&parsed](const std::string& path, TextData& data) {
+		parsed++;
+		data.text = path;
+		return true;
+	};
+	auto first = TwoFileCache::Load(paths[0], load);
+	auto second = TwoFileCache::Load(paths[1], load);
+	REQUIRE(first);
+	REQUIRE(second);
+	CHECK(parsed == 2);
+
+	// The third file replaces the first file (and the second file is still cached)
+	CHECK(TwoFileCache::Load(paths[2], load));
+	CHECK(parsed == 3);
+	CHECK(TwoFileCache::Load(paths[1], load) == second);
+	CHECK(parsed == 3);
+	auto reloaded = TwoFileCache::Load(paths[0], load);
+	CHECK(reloaded != first);
+	CHECK(parsed == 4);
+
+	TwoFileCache::Clear();
+	for (const std::string& file_path : paths)
+		QFile::remove(QString::fromStdString(file_path));
+}
@@ -13,6 +13,8 @@
 #include <sstream>
 #include <memory>
 
+#include <QDir>
+
 #include "openshot_catch.h"
 
 #include "FFmpegReader.h"
@@ -20,6 +22,8 @@
 #include "Frame.h"
 #include "Timeline.h"
 #include "Json.h"
+#include "SeekIndex.h"
+#include "Settings.h"
 
 using namespace openshot;
 
@@ -225,6 +229,72 @@ TEST_CASE( "Multiple_Open_and_Close", "[libopenshot][ffmpegreader]" )
 	r.Close();
 }
 
+TEST_CASE( "Read_Ahead", "[libopenshot][ffmpegreader]" )
+{
+	std::stringstream path;
+	path << TEST_MEDIA_PATH << "sintel_trailer-720p.mp4";
+
+	// Reader without read-ahead
+	FFmpegReader r1(path.str());
+	r1.Open();
+
+	// Reader which decodes ahead on a background thread
+	Settings::Instance()->READ_AHEAD_FRAMES = 8;
+	FFmpegReader r2(path.str());
+	r2.Open();
+
+	// Sequential frames (and a seek) match
+	for (int64_t frame_number : {1, 2, 3, 4, 5, 10, 20, 21, 22, 23, 500, 501, 502, 503}) {
+		std::shared_ptr<Frame> f1 = r1.GetFrame(frame_number);
+		std::shared_ptr<Frame> f2 = r2.GetFrame(frame_number);
+		CHECK(f2->number == frame_number);
+		CHECK(f2->GetAudioSamplesCount() == f1->GetAudioSamplesCount());
+		CHECK(f2->GetImage()->pixel(640, 360) == f1->GetImage()->pixel(640, 360));
+	}
+
+	// Read-ahead stops with the reader
+	Settings::Instance()->READ_AHEAD_FRAMES = 0;
+	r2.Close();
+	r1.Close();
+}
+
+TEST_CASE( "Seek_Index", "[libopenshot][ffmpegreader]" )
+{
+	std::stringstream path;
+	path << TEST_MEDIA_PATH << "sintel_trailer-720p.mp4";
+
+	// Reader without a seek index
+	FFmpegReader r1(path.str());
+	r1.Open();
+
+	// Save an index (so the 2nd reader loads it, instead of building it in the background)
+	QDir index_folder(QDir::tempPath() + QString("/seek-index-reader-test/"));
+	Settings::Instance()->SEEK_INDEX_PATH = index_folder.path().toStdString();
+	SeekIndex index;
+	REQUIRE(index.Build(path.str(), r1.info.video_stream_index));
+	REQUIRE(index.Save(path.str()));
+
+	// Reader which seeks to indexed keyframes
+	Settings::Instance()->ENABLE_SEEK_INDEX = true;
+	FFmpegReader r2(path.str());
+	r2.Open();
+
+	// Forward, backward, and nearby seeks match
+	for (int64_t frame_number : {300, 100, 1000, 40, 1200, 1240, 700, 760}) {
+		std::shared_ptr<Frame> f1 = r1.GetFrame(frame_number);
+		std::shared_ptr<Frame> f2 = r2.GetFrame(frame_number);
+		CHECK(f2->number == frame_number);
+		CHECK(f2->GetAudioSamplesCount() == f1->GetAudioSamplesCount());
+		CHECK(f2->GetImage()->pixel(640, 360) == f1->GetImage()->pixel(640, 360));
+	}
+
+	Settings::Instance()->ENABLE_SEEK_INDEX = false;
+	Settings::Instance()->SEEK_INDEX_PATH = "";
+	r2.Close();
+	r1.Close();
+	index_folder.removeRecursively();
+}
+
 TEST_CASE( "verify parent Timeline", "[libopenshot][ffmpegreader]" )
 {
 	// Create a reader
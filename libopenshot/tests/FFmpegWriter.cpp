@@ -72,6 +72,58 @@ TEST_CASE( "Webm", "[libopenshot][ffmpegwriter]" )
 	CHECK((int)pixels[pixel_index + 3] == Approx(255).margin(7));
 }
 
+TEST_CASE( "Async", "[libopenshot][ffmpegwriter]" )
+{
+	// Reader
+	std::stringstream path;
+	path << TEST_MEDIA_PATH << "sintel_trailer-720p.mp4";
+	FFmpegReader r(path.str());
+	r.Open();
+
+	/* WRITER ---------------- */
+	FFmpegWriter w("Async-output1.webm");
+
+	// Set options (and encode on background threads)
+	w.SetAudioOptions(true, "libvorbis", 44100, 2, LAYOUT_STEREO, 188000);
+	w.SetVideoOptions(true, "libvpx", Fraction(24,1), 1280, 720, Fraction(1,1), false, false, 30000000);
+	w.SetAsync(true, 4);
+
+	// Open writer
+	w.Open();
+
+	// Can't re-configure a running pipeline
+	CHECK_THROWS_AS(w.SetAsync(false), InvalidOptions);
+
+	// Write some frames (more than the queue size)
+	w.WriteFrame(&r, 24, 50);
+
+	// Close writer (which drains all queued frames) & reader
+	w.Close();
+	r.Close();
+
+	FFmpegReader r1("Async-output1.webm");
+	r1.Open();
+
+	// Verify all frames were written
+	CHECK(r1.GetFrame(1)->GetAudioChannelsCount() == 2);
+	CHECK(r1.info.fps.num == 24);
+	CHECK(r1.info.fps.den == 1);
+	CHECK(r1.info.video_length == Approx(27).margin(1));
+
+	// Get a specific frame
+	std::shared_ptr<Frame> f = r1.GetFrame(8);
+
+	// Check image properties on scanline 500, pixel 112 (same as synchronous writing)
+	const unsigned char* pixels = f->GetPixels(500);
+	int pixel_index = 112 * 4;
+	CHECK((int)pixels[pixel_index] == Approx(23).margin(7));
+	CHECK((int)pixels[pixel_index + 1] == Approx(23).margin(7));
+	CHECK((int)pixels[pixel_index + 2] == Approx(23).margin(7));
+	CHECK((int)pixels[pixel_index + 3] == Approx(255).margin(7));
+
+	r1.Close();
+}
+
 TEST_CASE( "Options_Overloads", "[libopenshot][ffmpegwriter]" )
 {
 	// Reader
@@ -11,6 +11,7 @@
 //
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
+#include <cstring>
 #include <sstream>
 #include <memory>
 
@@ -27,6 +28,7 @@
 #include "openshot_catch.h"
 
 #include "Clip.h"
+#include "FFmpegUtilities.h"
 #include "Fraction.h"
 #include "Frame.h"
 
@@ -138,6 +140,36 @@ TEST_CASE( "Copy_Constructor", "[libopenshot][frame]" )
 	CHECK(f1.GetAudioSamplesCount() == f2.GetAudioSamplesCount());
 }
 
+TEST_CASE( "Copy_On_Write", "[libopenshot][frame]" )
+{
+	// Add a raw pixel buffer (owned by the frame)
+	const int width = 64;
+	const int height = 32;
+	auto buffer = (unsigned char*) aligned_malloc(width * height * 4, 32);
+	memset(buffer, 255, width * height * 4);
+	auto f1 = std::make_shared<Frame>(1, width, height, "#000000");
+	f1->AddImage(width, height, 4, QImage::Format_RGBA8888_Premultiplied, buffer);
+
+	// The buffer is used directly (and can be modified in place)
+	CHECK(f1->GetImage()->constBits() == buffer);
+	CHECK(f1->GetImage()->bits() == buffer);
+
+	// Copies share the image
+	Frame f2(*f1);
+	CHECK(f2.GetImage()->constBits() == buffer);
+
+	// Until it is modified
+	f2.GetImage()->bits()[0] = 0;
+	CHECK(f2.GetImage()->constBits() != buffer);
+	CHECK(f1->GetImage()->constBits() == buffer);
+	CHECK(f1->GetPixels()[0] == 255);
+	CHECK(f2.GetPixels()[0] == 0);
+
+	// Buffer is freed with the last image using it
+	f1.reset();
+	CHECK(f2.GetPixels()[1] == 255);
+}
+
 #ifdef USE_OPENCV
 TEST_CASE( "Convert_Image", "[libopenshot][opencv][frame]" )
 {
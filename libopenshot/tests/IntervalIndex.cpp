@@ -0,0 +1,139 @@
+/**
+ * @file
+ * @brief Unit tests for openshot::IntervalIndex
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <vector>
+
+#include "openshot_catch.h"
+
+#include "IntervalIndex.h"
+
+using namespace openshot;
+
+TEST_CASE( "Find intervals by frame", "[libopenshot][intervalindex]" )
+{
+	IntervalIndex<int> index;
+	index.Update({
+		{1, 0, 1, 30},
+		{2, 0, 20, 60},
+		{3, 1, 10, 90},
+		{4, 2, 100, 200}
+	});
+	CHECK(index.Count() == 4);
+
+	std::vector<int> results;
+	index.Find(25, 25, results);
+	CHECK(results == std::vector<int>({1, 2, 3}));
+
+	results.clear();
+	index.Find(95, 100, results);
+	CHECK(results == std::vector<int>({4}));
+
+	results.clear();
+	index.Find(300, 300, results);
+	CHECK(results.empty());
+
+	// Intervals include both the start and end frames
+	results.clear();
+	index.Find(30, 30, results);
+	CHECK(results == std::vector<int>({1, 2, 3}));
+	results.clear();
+	index.Find(31, 31, results);
+	CHECK(results == std::vector<int>({2, 3}));
+}
+
+TEST_CASE( "Find intervals by layer", "[libopenshot][intervalindex]" )
+{
+	IntervalIndex<int> index;
+	index.Update({
+		{1, 0, 1, 30},
+		{2, 5, 20, 60},
+		{3, 5, 1, 90}
+	});
+
+	std::vector<int> results;
+	index.Find(5, 25, 25, results);
+	CHECK(results == std::vector<int>({2, 3}));
+
+	results.clear();
+	index.Find(3, 25, 25, results);
+	CHECK(results.empty());
+}
+
+TEST_CASE( "Results keep the original order", "[libopenshot][intervalindex]" )
+{
+	// Items on the same layer are returned in the order they were passed in
+	// (not by start frame), since that is the order they are combined in.
+	IntervalIndex<int> index;
+	index.Update({
+		{1, 0, 50, 100},
+		{2, 0, 1, 100},
+		{3, 0, 25, 100}
+	});
+
+	std::vector<int> results;
+	index.Find(60, 60, results);
+	CHECK(results == std::vector<int>({1, 2, 3}));
+}
+
+TEST_CASE( "Update and Clear", "[libopenshot][intervalindex]" )
+{
+	IntervalIndex<int> index;
+	index.Update({
+		{1, 0, 1, 30},
+		{2, 1, 1, 30}
+	});
+
+	// Move item 1, and remove layer 1
+	index.Update({
+		{1, 0, 100, 130}
+	});
+	CHECK(index.Count() == 1);
+
+	std::vector<int> results;
+	index.Find(10, 10, results);
+	CHECK(results.empty());
+	index.Find(110, 110, results);
+	CHECK(results == std::vector<int>({1}));
+
+	index.Clear();
+	CHECK(index.Count() == 0);
+	results.clear();
+	index.Find(110, 110, results);
+	CHECK(results.empty());
+}
+
+TEST_CASE( "Matches a linear scan", "[libopenshot][intervalindex]" )
+{
+	// Build a large number of overlapping intervals on a few layers
+	std::vector<IntervalIndex<int>::Interval> intervals;
+	for (int layer = 0; layer < 4; layer++) {
+		for (int item = 0; item < 500; item++) {
+			int64_t start = (item * 37 + layer * 11) % 2000 + 1;
+			int64_t end = start + (item * 13) % 150;
+			intervals.push_back({layer * 1000 + item, layer, start, end});
+		}
+	}
+	IntervalIndex<int> index;
+	index.Update(intervals);
+
+	for (int64_t frame = 1; frame <= 2200; frame += 7) {
+		std::vector<int> expected;
+		for (const auto& interval : intervals) {
+			if (interval.start <= frame + 2 && interval.end >= frame)
+				expected.push_back(interval.item);
+		}
+
+		std::vector<int> results;
+		index.Find(frame, frame + 2, results);
+		CHECK(results == expected);
+	}
+}
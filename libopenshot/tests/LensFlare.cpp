@@ -105,4 +105,30 @@ TEST_CASE("LensFlare brightness scales intensity", "[effect][lensflare]")
     QColor cHigh   = outHigh->GetImage()->pixelColor(2, 2);
 
     CHECK(cLow.red() < cHigh.red());
-}
\ No newline at end of file
+}
+
+TEST_CASE("LensFlare overlay is rebuilt when parameters change", "[effect][lensflare]")
+{
+    LensFlare cached, fresh;
+    cached.x = Keyframe(-0.2);
+    cached.y = Keyframe(0.3);
+
+    // The same parameters produce the same flare (from the cached overlay)
+    auto first = cached.GetFrame(makeGrayFrame(), 1);
+    auto second = cached.GetFrame(makeGrayFrame(), 1);
+    for (int y = 0; y < 5; ++y)
+        for (int x = 0; x < 5; ++x)
+            CHECK(first->GetImage()->pixelColor(x, y) == second->GetImage()->pixelColor(x, y));
+
+    // Moving the flare matches a new effect at the same position
+    cached.x = Keyframe(0.0);
+    cached.y = Keyframe(0.0);
+    fresh.x = Keyframe(0.0);
+    fresh.y = Keyframe(0.0);
+    auto moved = cached.GetFrame(makeGrayFrame(), 1);
+    auto expected = fresh.GetFrame(makeGrayFrame(), 1);
+    for (int y = 0; y < 5; ++y)
+        for (int x = 0; x < 5; ++x)
+            CHECK(moved->GetImage()->pixelColor(x, y) == expected->GetImage()->pixelColor(x, y));
+    CHECK(moved->GetImage()->pixelColor(2, 2) != first->GetImage()->pixelColor(2, 2));
+}
@@ -0,0 +1,80 @@
+/**
+ * @file
+ * @brief Unit tests for openshot::STFT
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "audio_effects/STFT.h"
+#include "openshot_catch.h"
+
+using namespace openshot;
+
+// Create a signal with 2 channels
+static juce::AudioBuffer<float> Signal(int samples) {
+	juce::AudioBuffer<float> audio(2, samples);
+	for (int channel = 0; channel < 2; channel++)
+		for (int sample = 0; sample < samples; sample++)
+			audio.setSample(channel, sample, 0.5f * std::sin(0.013f * (channel + 1) * sample) + 0.3f * std::sin(0.31f * sample));
+	return audio;
+}
+
+// Process a signal with an STFT, in blocks of a number of samples
+static juce::AudioBuffer<float> Process(const juce::AudioBuffer<float>& signal, int block_size, int window_type) {
+	STFT stft;
+	stft.setup(2);
+	stft.updateParameters(512, 4, window_type);
+
+	juce::AudioBuffer<float> output(signal);
+	for (int start = 0; start < output.getNumSamples(); start += block_size) {
+		const int samples = std::min(block_size, output.getNumSamples() - start);
+		juce::AudioBuffer<float> block(output.getArrayOfWritePointers(), 2, start, samples);
+		stft.process(block);
+	}
+	return output;
+}
+
+TEST_CASE( "Output does not depend on the block size", "[libopenshot][stft]" )
+{
+	const juce::AudioBuffer<float> signal = Signal(10000);
+	const juce::AudioBuffer<float> expected = Process(signal, 1470, HANN);
+
+	for (int block_size : {1, 100, 128, 512, 4000}) {
+		const juce::AudioBuffer<float> output = Process(signal, block_size, HANN);
+		float difference = 0.0f;
+		for (int channel = 0; channel < 2; channel++)
+			for (int sample = 0; sample < signal.getNumSamples(); sample++)
+				difference = std::max(difference, std::abs(output.getSample(channel, sample) - expected.getSample(channel, sample)));
+		CHECK(difference == 0.0f);
+	}
+}
+
+TEST_CASE( "Unmodified spectrum reconstructs the signal", "[libopenshot][stft]" )
+{
+	// The output is delayed by the FFT size (and overlapping windows add up to the original signal)
+	const juce::AudioBuffer<float> signal = Signal(10000);
+	for (int window_type : {RECTANGULAR, HANN}) {
+		const juce::AudioBuffer<float> output = Process(signal, 1470, window_type);
+		float difference = 0.0f;
+		for (int channel = 0; channel < 2; channel++)
+			for (int sample = 1024; sample < signal.getNumSamples(); sample++)
+				difference = std::max(difference, std::abs(output.getSample(channel, sample) - signal.getSample(channel, sample - 512)));
+		CHECK(difference < 0.01f);
+	}
+}
+
+TEST_CASE( "FFT plans are shared", "[libopenshot][stft]" )
+{
+	CHECK(STFT::GetFFT(10) == STFT::GetFFT(10));
+	CHECK(STFT::GetFFT(10) != STFT::GetFFT(11));
+	CHECK(STFT::GetFFT(11)->getSize() == 2048);
+}
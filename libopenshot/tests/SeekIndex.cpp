@@ -0,0 +1,96 @@
+/**
+ * @file
+ * @brief Unit tests for openshot::SeekIndex
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <limits>
+#include <sstream>
+
+#include <QDir>
+
+#include "openshot_catch.h"
+
+#include "FFmpegReader.h"
+#include "SeekIndex.h"
+#include "Settings.h"
+
+using namespace openshot;
+
+TEST_CASE( "Build and find keyframes", "[libopenshot][seekindex]" )
+{
+	std::stringstream path;
+	path << TEST_MEDIA_PATH << "sintel_trailer-720p.mp4";
+	FFmpegReader r(path.str());
+
+	SeekIndex index;
+	CHECK(index.Count() == 0);
+	REQUIRE(index.Build(path.str(), r.info.video_stream_index));
+	CHECK(index.StreamIndex() == r.info.video_stream_index);
+	CHECK(index.Count() > 1);
+
+	// Nothing before the first keyframe
+	SeekIndex::Entry first;
+	REQUIRE(index.Find(0, first));
+	SeekIndex::Entry keyframe;
+	CHECK_FALSE(index.Find(first.pts - 1, keyframe));
+
+	// Timestamps between keyframes find the previous keyframe
+	SeekIndex::Entry last;
+	REQUIRE(index.Find(std::numeric_limits<int64_t>::max(), last));
+	CHECK(last.pts > first.pts);
+	REQUIRE(index.Find(last.pts - 1, keyframe));
+	CHECK(keyframe.pts < last.pts);
+	REQUIRE(index.Find(last.pts, keyframe));
+	CHECK(keyframe.pts == last.pts);
+	CHECK(keyframe.pos == last.pos);
+
+	// Missing file
+	CHECK_FALSE(index.Build("invalid-path.mp4", 0));
+	CHECK(index.Count() == 0);
+}
+
+TEST_CASE( "Save and load", "[libopenshot][seekindex]" )
+{
+	std::stringstream path;
+	path << TEST_MEDIA_PATH << "sintel_trailer-720p.mp4";
+	FFmpegReader r(path.str());
+	int video_stream = r.info.video_stream_index;
+
+	QDir index_folder(QDir::tempPath() + QString("/seek-index-test/"));
+	Settings::Instance()->SEEK_INDEX_PATH = index_folder.path().toStdString();
+
+	SeekIndex index;
+	REQUIRE(index.Build(path.str(), video_stream));
+	CHECK(index.Save(path.str()));
+	CHECK(QFile::exists(QString::fromStdString(SeekIndex::IndexPath(path.str()))));
+
+	SeekIndex loaded;
+	CHECK(loaded.Load(path.str(), video_stream));
+	CHECK(loaded.Count() == index.Count());
+	CHECK(loaded.StreamIndex() == video_stream);
+
+	SeekIndex::Entry expected;
+	SeekIndex::Entry keyframe;
+	REQUIRE(index.Find(std::numeric_limits<int64_t>::max(), expected));
+	REQUIRE(loaded.Find(std::numeric_limits<int64_t>::max(), keyframe));
+	CHECK(keyframe.pts == expected.pts);
+	CHECK(keyframe.pos == expected.pos);
+
+	// An index only matches the stream it was built for
+	CHECK_FALSE(loaded.Load(path.str(), video_stream + 1));
+	CHECK(loaded.Count() == 0);
+
+	// No index for missing files
+	CHECK(SeekIndex::IndexPath("invalid-path.mp4").empty());
+	CHECK_FALSE(loaded.Load("invalid-path.mp4", video_stream));
+
+	index_folder.removeRecursively();
+	Settings::Instance()->SEEK_INDEX_PATH = "";
+}
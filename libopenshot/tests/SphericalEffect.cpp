@@ -10,12 +10,16 @@
 //
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <memory>
 #include <QImage>
 #include <QColor>
 #include "Frame.h"
 #include "effects/SphericalProjection.h"
 #include "openshot_catch.h"
+#include "test_utils.h"
 
 using namespace openshot;
 
@@ -144,3 +148,114 @@ TEST_CASE("fisheye mode yaw has no effect at center", "[effect][spherical]")
     e.yaw = Keyframe(45.0);
     CHECK(centerPixel(e, f) == QColor(255,255,255,255));
 }
+
+// The per-pixel projection of SphericalProjection (before it used a remap table, which clamps positions to the edges)
+static QImage referenceProjection(const QImage& src_img, double yaw_d, double pitch_d, double roll_d,
+                                  double fov_d, int projection_mode, int invert, int interpolation)
+{
+    int W = src_img.width(), H = src_img.height();
+    int bpl = src_img.bytesPerLine();
+    const uchar* src = src_img.constBits();
+    QImage output(W, H, QImage::Format_ARGB32);
+    output.fill(Qt::black);
+
+    double yaw_r   = yaw_d * M_PI/180.0;
+    double pitch_r = pitch_d * M_PI/180.0;
+    double roll_r  = -roll_d * M_PI/180.0 + M_PI;
+    double fov_r   = fov_d * M_PI/180.0;
+
+    double sy = sin(yaw_r),  cy = cos(yaw_r);
+    double sp = sin(pitch_r), cp = cos(pitch_r);
+    double sr = sin(roll_r), cr = cos(roll_r);
+    double r00 = cy*cr + sy*sp*sr, r01 = -cy*sr + sy*sp*cr, r02 = sy*cp;
+    double r10 = cp*sr,            r11 = cp*cr,            r12 = -sp;
+    double r20 = -sy*cr + cy*sp*sr, r21 = sy*sr + cy*sp*cr, r22 = cy*cp;
+    double hx = tan(fov_r*0.5);
+    double vy = hx * double(H)/W;
+
+    for (int yy = 0; yy < H; yy++) {
+        uchar* dst_row = output.scanLine(yy);
+        double ndc_y = (2.0*(yy + 0.5)/H - 1.0) * vy;
+        for (int xx = 0; xx < W; xx++) {
+            double ndc_x = (2.0*(xx + 0.5)/W - 1.0) * hx;
+            double vx = ndc_x, vy2 = -ndc_y, vz = -1.0;
+            double inv = 1.0/sqrt(vx*vx + vy2*vy2 + vz*vz);
+            vx *= inv; vy2 *= inv; vz *= inv;
+            double dx = r00*vx + r01*vy2 + r02*vz;
+            double dy = r10*vx + r11*vy2 + r12*vz;
+            double dz = r20*vx + r21*vy2 + r22*vz;
+            if (projection_mode < 2 && invert) {
+                dx = -dx;
+                dz = -dz;
+            }
+            double uf, vf;
+            if (projection_mode == 2) {
+                double cos_t = dz * (invert ? -1.0 : 1.0);
+                double theta = acos(cos_t);
+                double rpx = (theta / fov_r) * (W/2.0);
+                double phi = atan2(dy, dx);
+                uf = W*0.5 + rpx*cos(phi);
+                vf = H*0.5 + rpx*sin(phi);
+            }
+            else {
+                double lon = atan2(dx, dz);
+                double lat = asin(dy);
+                if (projection_mode == 1)
+                    lon = std::clamp(lon, -M_PI/2.0, M_PI/2.0);
+                uf = ((lon + (projection_mode? M_PI/2.0 : M_PI))
+                      / (projection_mode? M_PI : 2.0*M_PI)) * W;
+                vf = (lat + M_PI/2.0)/M_PI * H;
+            }
+            // Positions beyond the edges are clamped (instead of extrapolating the edge pixels)
+            uf = std::clamp(uf, 0.0, double(W));
+            vf = std::clamp(vf, 0.0, double(H));
+            uchar* d = dst_row + xx*4;
+            int x0 = std::clamp(int(std::floor(uf)), 0, W-1);
+            int y0 = std::clamp(int(std::floor(vf)), 0, H-1);
+            if (interpolation == 0) {
+                const uchar* s = src + y0*bpl + x0*4;
+                d[0] = s[0]; d[1] = s[1]; d[2] = s[2]; d[3] = s[3];
+            }
+            else {
+                int x1 = std::clamp(x0 + 1, 0, W-1);
+                int y1 = std::clamp(y0 + 1, 0, H-1);
+                double dxr = std::min(uf - x0, 1.0), dyr = std::min(vf - y0, 1.0);
+                for (int c = 0; c < 4; c++) {
+                    double v0 = src[y0*bpl + x0*4 + c]*(1-dxr) + src[y0*bpl + x1*4 + c]*dxr;
+                    double v1 = src[y1*bpl + x0*4 + c]*(1-dxr) + src[y1*bpl + x1*4 + c]*dxr;
+                    d[c] = uchar(v0*(1-dyr) + v1*dyr + 0.5);
+                }
+            }
+        }
+    }
+    return output;
+}
+
+TEST_CASE("remap table matches per-pixel projection", "[effect][spherical]")
+{
+    QImage src = RandomBytes(96, 48, QImage::Format_ARGB32, 7);
+
+    struct Case { int mode, invert, interpolation; double fov; };
+    for (const Case& c : { Case{0, 0, 0, 100.0}, Case{0, 1, 1, 100.0}, Case{1, 0, 1, 120.0}, Case{2, 0, 0, 180.0}, Case{2, 1, 1, 90.0} }) {
+        SphericalProjection e(Keyframe(30.0), Keyframe(-20.0), Keyframe(10.0), Keyframe(c.fov));
+        e.projection_mode = c.mode;
+        e.invert = c.invert;
+        e.interpolation = c.interpolation;
+        QImage expected = referenceProjection(src, 30.0, -20.0, 10.0, c.fov, c.mode, c.invert, c.interpolation);
+
+        // Bilinear weights are rounded to 1/256th of a pixel (so blended channels differ by at most 1)
+        for (int repeat = 0; repeat < 2; repeat++) {
+            auto f = std::make_shared<Frame>();
+            *f->GetImage() = src.copy();
+            QImage actual = *e.GetFrame(f, 1)->GetImage();
+            CHECK(MaxDifference(expected, actual) <= (c.interpolation ? 1 : 0));
+        }
+
+        // Changing a keyframe rebuilds the table
+        e.yaw = Keyframe(-60.0);
+        expected = referenceProjection(src, -60.0, -20.0, 10.0, c.fov, c.mode, c.invert, c.interpolation);
+        auto f = std::make_shared<Frame>();
+        *f->GetImage() = src.copy();
+        CHECK(MaxDifference(expected, *e.GetFrame(f, 1)->GetImage()) <= (c.interpolation ? 1 : 0));
+    }
+}
@@ -10,10 +10,13 @@
 //
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
+#include <algorithm>
+#include <cmath>
 #include <string>
 #include <sstream>
 #include <memory>
 #include <list>
+#include <vector>
 #include <omp.h>
 
 #include "openshot_catch.h"
@@ -805,6 +808,114 @@ TEST_CASE( "Multi-threaded Timeline Add/Remove Clip", "[libopenshot][timeline]"
 	t = NULL;
 }
 
+TEST_CASE( "Multi-threaded Timeline GetFrame matches serial render", "[libopenshot][timeline]" )
+{
+	std::stringstream path;
+	path << TEST_MEDIA_PATH << "test.mp4";
+	std::stringstream path_overlay;
+	path_overlay << TEST_MEDIA_PATH << "front3.png";
+
+	// Render the same two-track timeline serially and in parallel
+	Clip serial_video(path.str());
+	Clip serial_overlay(path_overlay.str());
+	serial_overlay.Layer(1);
+	serial_overlay.End(0.5);
+	Timeline serial(1280, 720, Fraction(30, 1), 44100, 2, LAYOUT_STEREO);
+	serial.AddClip(&serial_video);
+	serial.AddClip(&serial_overlay);
+	serial.Open();
+
+	Clip parallel_video(path.str());
+	Clip parallel_overlay(path_overlay.str());
+	parallel_overlay.Layer(1);
+	parallel_overlay.End(0.5);
+	Timeline parallel(1280, 720, Fraction(30, 1), 44100, 2, LAYOUT_STEREO);
+	parallel.AddClip(&parallel_video);
+	parallel.AddClip(&parallel_overlay);
+	parallel.Open();
+
+	const int frame_count = 30;
+	std::vector<std::shared_ptr<Frame>> parallel_frames(frame_count);
+#pragma omp parallel for
+	for (int index = 0; index < frame_count; index++) {
+		parallel_frames[index] = parallel.GetFrame(index + 1);
+	}
+
+	int pixel_row = 200;
+	int pixel_index = 230 * 4;
+	for (int index = 0; index < frame_count; index++) {
+		std::shared_ptr<Frame> expected = serial.GetFrame(index + 1);
+		std::shared_ptr<Frame> actual = parallel_frames[index];
+		REQUIRE(actual != nullptr);
+		CHECK(actual->number == index + 1);
+		for (int channel = 0; channel < 4; channel++) {
+			CHECK((int)actual->GetPixels(pixel_row)[pixel_index + channel] == (int)expected->GetPixels(pixel_row)[pixel_index + channel]);
+		}
+		CHECK(actual->GetAudioSamplesCount() == expected->GetAudioSamplesCount());
+	}
+
+	// Concurrent requests for the same frame share a single render
+	std::vector<std::shared_ptr<Frame>> same_frames(8);
+#pragma omp parallel for
+	for (int index = 0; index < 8; index++) {
+		same_frames[index] = parallel.GetFrame(frame_count + 1);
+	}
+	for (const auto& f : same_frames) {
+		CHECK(f == same_frames[0]);
+	}
+
+	serial.Close();
+	parallel.Close();
+}
+
+TEST_CASE( "Audio-only Timeline GetFrame", "[libopenshot][timeline]" )
+{
+	std::stringstream path;
+	path << TEST_MEDIA_PATH << "sintel_trailer-720p.mp4";
+
+	// Render the same timeline (with a volume keyframe) normally, and in audio-only mode
+	Clip normal_clip(path.str());
+	normal_clip.volume = Keyframe(0.5);
+	Timeline normal(1280, 720, Fraction(30, 1), 44100, 2, LAYOUT_STEREO);
+	normal.AddClip(&normal_clip);
+	normal.Open();
+
+	Clip audio_clip(path.str());
+	audio_clip.volume = Keyframe(0.5);
+	Timeline audio(1280, 720, Fraction(30, 1), 44100, 2, LAYOUT_STEREO);
+	audio.AddClip(&audio_clip);
+	audio.AudioOnly(true);
+	audio.Open();
+	CHECK(audio.AudioOnly());
+	CHECK(audio_clip.AudioOnly());
+	CHECK(audio_clip.Reader()->AudioOnly());
+
+	for (int64_t number = 1; number <= 30; number++) {
+		std::shared_ptr<Frame> expected = normal.GetFrame(number);
+		std::shared_ptr<Frame> actual = audio.GetFrame(number);
+		CHECK(expected->has_image_data);
+		CHECK_FALSE(actual->has_image_data);
+		REQUIRE(actual->GetAudioSamplesCount() == expected->GetAudioSamplesCount());
+		REQUIRE(actual->GetAudioChannelsCount() == expected->GetAudioChannelsCount());
+		float max_difference = 0.0;
+		for (int channel = 0; channel < actual->GetAudioChannelsCount(); channel++) {
+			const float* actual_samples = actual->GetAudioSampleBuffer()->getReadPointer(channel);
+			const float* expected_samples = expected->GetAudioSampleBuffer()->getReadPointer(channel);
+			for (int sample = 0; sample < actual->GetAudioSamplesCount(); sample++)
+				max_difference = std::max(max_difference, std::abs(actual_samples[sample] - expected_samples[sample]));
+		}
+		CHECK(max_difference < 0.0001);
+	}
+
+	// Leaving audio-only mode renders images again
+	audio.AudioOnly(false);
+	CHECK_FALSE(audio_clip.Reader()->AudioOnly());
+	CHECK(audio.GetFrame(31)->has_image_data);
+
+	normal.Close();
+	audio.Close();
+}
+
 TEST_CASE( "ApplyJSONDiff and FrameMappers", "[libopenshot][timeline]" )
 {
 	// Create a timeline
@@ -0,0 +1,64 @@
+/**
+ * @file
+ * @brief Unit tests for Wave effect
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#include <QImage>
+
+#include "Frame.h"
+#include "effects/Wave.h"
+#include "openshot_catch.h"
+#include "test_utils.h"
+
+using namespace openshot;
+
+// The per-pixel loop of Wave (before rows were shifted at once)
+static QImage ScalarWave(const QImage& image, double time, double wavelength_value, double amplitude_value,
+	double multiplier_value, double shift_x_value, double speed_y_value) {
+	QImage result = image.copy();
+	const unsigned char *original_pixels = image.constBits();
+	unsigned char *pixels = result.bits();
+	int64_t pixel_count = int64_t(image.width()) * image.height();
+	for (int64_t pixel = 0; pixel < pixel_count; ++pixel) {
+		int Y = pixel / image.width();
+		float noiseVal = (100 + Y * 0.001) * multiplier_value;
+		float noiseAmp = noiseVal * amplitude_value;
+		float waveformVal = sin((Y * wavelength_value) + (time * speed_y_value));
+		float waveVal = (waveformVal + shift_x_value) * noiseAmp;
+
+		int64_t source_px = round(pixel + waveVal);
+		if (source_px < 0)
+			source_px = 0;
+		if (source_px >= pixel_count)
+			source_px = pixel_count - 1;
+		memcpy(&pixels[pixel * 4], &original_pixels[source_px * 4], sizeof(char) * 4);
+	}
+	return result;
+}
+
+TEST_CASE( "Wave matches per-pixel shifts", "[libopenshot][effect][wave]" )
+{
+	// Small shifts, and shifts larger than the image (which repeat the first and last pixels)
+	for (double amplitude : {0.3, 40.0}) {
+		Wave wave(Keyframe(0.06), Keyframe(amplitude), Keyframe(0.2), Keyframe(0.1), Keyframe(0.2));
+		for (int64_t frame_number : {1, 17}) {
+			auto frame = RandomFrame(97, 43, 1);
+			QImage expected = ScalarWave(*frame->GetImage(), frame_number, 0.06, amplitude, 0.2, 0.1, 0.2);
+
+			frame = wave.GetFrame(frame, frame_number);
+			CHECK(*frame->GetImage() == expected);
+		}
+	}
+}
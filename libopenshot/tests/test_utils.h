@@ -0,0 +1,115 @@
+/**
+ * @file
+ * @brief Helpers shared by the unit tests (random images and frames, and comparing them)
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2024 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_TEST_UTILS_H
+#define OPENSHOT_TEST_UTILS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include <QColor>
+#include <QImage>
+
+#include "Frame.h"
+
+// Create an image of random (but valid) premultiplied pixels, with the alpha of each pixel from random_alpha()
+template <typename Alpha>
+inline QImage RandomImage(int width, int height, unsigned int seed, Alpha random_alpha) {
+	QImage image(width, height, QImage::Format_RGBA8888_Premultiplied);
+	std::srand(seed);
+	for (int y = 0; y < height; y++) {
+		unsigned char *pixels = image.scanLine(y);
+		for (int x = 0; x < width; x++) {
+			int alpha = random_alpha();
+			for (int channel = 0; channel < 3; channel++)
+				pixels[x * 4 + channel] = alpha ? std::rand() % (alpha + 1) : 0;
+			pixels[x * 4 + 3] = alpha;
+		}
+	}
+	return image;
+}
+
+// Create an image of random pixels (opaque, or with random alpha from 1 to 255)
+inline QImage RandomImage(int width, int height, unsigned int seed, bool opaque = true) {
+	return RandomImage(width, height, seed, [opaque]() { return opaque ? 255 : 1 + std::rand() % 255; });
+}
+
+// Create a frame of random pixels (opaque, or with random alpha from 1 to 255)
+inline std::shared_ptr<openshot::Frame> RandomFrame(int width, int height, unsigned int seed, bool opaque = true) {
+	auto frame = std::make_shared<openshot::Frame>(1, width, height, "#000000");
+	frame->AddImage(std::make_shared<QImage>(RandomImage(width, height, seed, opaque)));
+	return frame;
+}
+
+// Create an image of random premultiplied pixels, from a palette of colors (so colors are repeated)
+inline QImage RandomPaletteImage(int width, int height, int colors, unsigned int seed) {
+	QImage image(width, height, QImage::Format_RGBA8888_Premultiplied);
+	std::srand(seed);
+	std::vector<QColor> palette;
+	for (int i = 0; i < colors; i++)
+		palette.emplace_back(std::rand() % 256, std::rand() % 256, std::rand() % 256, i % 3 ? 255 : std::rand() % 256);
+	for (int y = 0; y < height; y++) {
+		unsigned char *pixel = image.scanLine(y);
+		for (int x = 0; x < width; x++, pixel += 4) {
+			const QColor& color = palette[std::rand() % colors];
+			pixel[3] = color.alpha();
+			pixel[0] = color.red() * color.alpha() / 255;
+			pixel[1] = color.green() * color.alpha() / 255;
+			pixel[2] = color.blue() * color.alpha() / 255;
+		}
+	}
+	return image;
+}
+
+// Create an image of random bytes, in any format (so premultiplied pixels are not always valid)
+inline QImage RandomBytes(int width, int height, QImage::Format format, unsigned int seed) {
+	QImage image(width, height, format);
+	std::srand(seed);
+	for (int y = 0; y < height; y++) {
+		unsigned char *pixels = image.scanLine(y);
+		for (int x = 0; x < width * image.depth() / 8; x++)
+			pixels[x] = std::rand() % 256;
+	}
+	return image;
+}
+
+// Get the largest difference between the channels of 2 images (in a region)
+inline int MaxDifference(const QImage& image1, const QImage& image2, int left, int top, int right, int bottom) {
+	const int bytes_per_pixel = image1.depth() / 8;
+	int difference = 0;
+	for (int y = top; y < bottom; y++) {
+		const unsigned char *pixels1 = image1.constScanLine(y);
+		const unsigned char *pixels2 = image2.constScanLine(y);
+		for (int x = left * bytes_per_pixel; x < right * bytes_per_pixel; x++)
+			difference = std::max(difference, std::abs(pixels1[x] - pixels2[x]));
+	}
+	return difference;
+}
+
+// Get the largest difference between the channels of 2 images
+inline int MaxDifference(const QImage& image1, const QImage& image2) {
+	return MaxDifference(image1, image2, 0, 0, image1.width(), image1.height());
+}
+
+// Get the largest difference between the audio samples of 2 frames
+inline float MaxSampleDifference(std::shared_ptr<openshot::Frame> frame1, std::shared_ptr<openshot::Frame> frame2) {
+	float difference = 0.0f;
+	for (int channel = 0; channel < frame1->audio->getNumChannels(); channel++)
+		for (int sample = 0; sample < frame1->audio->getNumSamples(); sample++)
+			difference = std::max(difference, std::abs(frame1->audio->getSample(channel, sample) - frame2->audio->getSample(channel, sample)));
+	return difference;
+}
+
+#endif // OPENSHOT_TEST_UTILS_H